@@ -1,6 +1,15 @@
 // (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
 
 #include "matrix.hpp"
+#include "matrix_cache.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 // Тестовый комментарий. Можно удалить.
 
@@ -166,23 +175,105 @@ bool Matrix::isColInRange(int col) const
 	return (col >= 0 && col < this->cols);
 }
 
+// Рабочий буфер потока для операций "на месте". Растет до максимального 
+// требуемого размера и далее не перевыделяется.
+static double * threadWorkspace(std::size_t n)
+{
+    static thread_local std::vector< double > workspace;
+    if (workspace.size() < n)
+    {
+        workspace.resize(n);
+    }
+    return workspace.data();
+}
+
 // Выделение памяти под матрицу. Условно считаем входные данные стирильными.
-bool Matrix::allocateMemory(int rows, int cols)
+// Все элементы размещаются одним непрерывным блоком, которым владеет Buffer.
+// Размещение больших блоков по NUMA-узлам определяется MatrixMemory.
+bool Matrix::allocateMemory(int rows, int cols, bool zeroed)
 {
+	Buffer * newBuffer = nullptr;
 	try {
-		this->matrix = new double*[rows];
-		for (int r = 0; r < rows; r++)
-		{
-			this->matrix[r] = new double[cols];
-		}
+		newBuffer = new Buffer;
 	}
 	// Если системе не удалосы выделить память, обрабатываем исключение
 	catch (std::bad_alloc& ba) {
 		return false;
 	}
+	if ( ! MatrixMemory::allocate(static_cast< std::size_t >(rows) * cols, newBuffer->region, zeroed) )
+	{
+		delete newBuffer;
+		return false;
+	}
+	newBuffer->refCount.store(1);
+	newBuffer->pins.store(0);
+	this->buffer = newBuffer;
+	this->data   = newBuffer->region.data;
 	return true;
 } // bool Matrix::allocateMemory(int rows, int cols)
 
+// Освобождает ссылку на буфер. Память удаляется последним владельцем.
+void Matrix::releaseMemory()
+{
+	if (this->buffer != nullptr && this->buffer->refCount.fetch_sub(1) == 1)
+	{
+		MatrixMemory::release(this->buffer->region);
+		delete this->buffer;
+	}
+	this->buffer = nullptr;
+	this->data   = nullptr;
+} // void Matrix::releaseMemory()
+
+// Подключает объект к буферу другой матрицы без копирования элементов.
+// В закрепленный буфер пишут тайлы, поэтому копия получает собственные элементы.
+void Matrix::shareBuffer(const Matrix & _source)
+{
+	if (_source.buffer->pins.load() > 0)
+	{
+		if (this->allocateMemory(_source.rows, _source.cols) == false)
+		{
+			throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+		}
+		MatrixMemory::copy(this->buffer->region, _source.data, _source.elementCount());
+		return;
+	}
+
+	_source.buffer->refCount.fetch_add(1);
+	this->buffer = _source.buffer;
+	this->data   = _source.data;
+} // void Matrix::shareBuffer(const Matrix & _source)
+
+// Отделяет собственную копию буфера, если он разделяется с другими матрицами.
+// Счетчик старого буфера уменьшается только после копирования, поэтому
+// одновременное отделение нескольких копий в разных потоках безопасно.
+void Matrix::detach()
+{
+	if (this->buffer == nullptr || this->buffer->refCount.load() == 1)
+	{
+		return;
+	}
+
+	Buffer * shared = this->buffer;
+	if (this->allocateMemory(this->rows, this->cols) == false)
+	{
+		this->buffer = shared;
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+	MatrixMemory::copy(this->buffer->region, shared->region.data, this->elementCount());
+
+	if (shared->refCount.fetch_sub(1) == 1)
+	{
+		MatrixMemory::release(shared->region);
+		delete shared;
+	}
+} // void Matrix::detach()
+
+// Количество элементов матрицы
+std::size_t Matrix::elementCount() const
+{
+	return static_cast< std::size_t >(this->rows) * this->cols;
+}
+
 void Matrix::setNumRows(int rows)
 {
 	this->rows = rows;
@@ -202,37 +293,61 @@ void Matrix::setNumColumns(int cols)
 // Конструкторы класса Matrix
 // ---------------------------------------------------------------------------------
 
-// Конструктор копий
+// Конструктор копий. В режиме copy-on-write копия разделяет буфер с оригиналом,
+// иначе элементы копируются одним блоком.
 Matrix::Matrix(const Matrix & _copy)
+	: rows(0), cols(0), buffer(nullptr), data(nullptr)
 {
 	this->setNumRows(_copy.getNumRows());
 	this->setNumColumns(_copy.getNumColumns());
+	if (_copy.buffer == nullptr)
+	{
+		return;
+	}
+
+	if (Matrix::isCopyOnWrite())
+	{
+		this->shareBuffer(_copy);
+		return;
+	}
+
 	if (this->allocateMemory(rows, cols) == false)
 	{
         throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
 	}
+	MatrixMemory::copy(this->buffer->region, _copy.data, this->elementCount());
+}
 
-	for (int r = 0; r < this->getNumRows(); r++)
+// Копия, разделяющая буфер (для кэша произведений)
+Matrix::Matrix(const Matrix & _source, Shared)
+	: rows(_source.rows), cols(_source.cols), buffer(nullptr), data(nullptr)
+{
+	if (_source.buffer != nullptr)
 	{
-		for (int c = 0; c < this->getNumColumns(); c++)
-		{
-			this->matrix[r][c] = _copy[r][c];
-		}
+		this->shareBuffer(_source);
 	}
 }
 
-// Конструктор перемещения (?)
+// Конструктор перемещения. Временный объект остается пустым (0 x 0) и 
+// корректно уничтожается.
 Matrix::Matrix(Matrix && _temporary)
 {
-	this->rows      = std::move(_temporary.rows);
-	this->cols      = std::move(_temporary.cols);
-    this->matrix    = std::move(_temporary.matrix);
+	this->rows      = _temporary.rows;
+	this->cols      = _temporary.cols;
+	this->buffer    = _temporary.buffer;
+	this->data      = _temporary.data;
+
+	_temporary.rows   = 0;
+	_temporary.cols   = 0;
+	_temporary.buffer = nullptr;
+	_temporary.data   = nullptr;
 }
 
 // Конструктор, принимающий количество строк и столбцов, заполняющий матрицу нулями. 
 // Если количество строк или столбцов не является положительным числом, 
 // генерируется исключение с текстом "Invalid dimensions".
 Matrix::Matrix(int rows, int cols) 
+	: rows(0), cols(0), buffer(nullptr), data(nullptr)
 {
 	if ( ! Matrix::isValidDimension(rows, cols))
 	{
@@ -242,25 +357,40 @@ Matrix::Matrix(int rows, int cols)
 	this->setNumRows(rows);
 	this->setNumColumns(cols);
 
-	if (this->allocateMemory(rows, cols) == false)
+	// Большие матрицы получают нулевые страницы ОС без явной записи нулей
+	// (при политике first-touch - с параллельным обнулением)
+	if (this->allocateMemory(rows, cols, true) == false)
 	{
 		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
 	}
+} // Matrix::Matrix(int rows, int cols)
 
-	for (int r = 0; r < rows; r++)
+// Конструктор без инициализации элементов
+const Matrix::Uninitialized Matrix::uninitialized = Matrix::Uninitialized();
+
+Matrix::Matrix(int rows, int cols, Uninitialized) 
+	: rows(0), cols(0), buffer(nullptr), data(nullptr)
+{
+	if ( ! Matrix::isValidDimension(rows, cols))
 	{
-		for (int c = 0; c < cols; c++)
-		{
-			this->matrix[r][c] = 0;
-		}
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
 	}
-} // Matrix::Matrix(int rows, int cols)
+
+	this->setNumRows(rows);
+	this->setNumColumns(cols);
+
+	if (this->allocateMemory(rows, cols) == false)
+	{
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+} // Matrix::Matrix(int rows, int cols, Uninitialized)
 
 // Конструктор, принимающий количество строк и столбцов, а также указатель на массив 
 // данных типа double.Если количество строк или столбцов не является положительным числом, 
 // генерируется исключение с текстом "Invalid dimensions", 
 // а при отсутствии переданных данных - с текстом "Bad data pointer".
 Matrix::Matrix(int rows, int cols, const double * input)
+	: rows(0), cols(0), buffer(nullptr), data(nullptr)
 {
 	// Проверка входных данных
 	if ( ! Matrix::isValidDimension(rows, cols) )
@@ -285,7 +415,7 @@ Matrix::Matrix(int rows, int cols, const double * input)
 	{
 		for (int c = 0; c < cols; c++)
 		{
-			this->matrix[r][c] = input[c + r*cols];
+			this->data[r * this->cols + c] = input[c + r*cols];
 		}
 	}
 } // Matrix::Matrix(int rows, int cols, const double * input)
@@ -296,12 +426,7 @@ Matrix::Matrix(int rows, int cols, const double * input)
 // Деструктор класса Matrix
 // ---------------------------------------------------------------------------------
 Matrix::~Matrix(){
-	for (int r = 0; r < this->getNumRows(); r++)
-	{
-		delete[] this->matrix[r];
-	}
-	delete[] this->matrix;
-	this->matrix = nullptr;
+	this->releaseMemory();
 }
 // =================================================================================
 
@@ -323,7 +448,7 @@ bool operator == (const Matrix& left, const Matrix& right)
     {
         for (int col = 0; col < left.getNumColumns(); col++) 
         {
-            if ( left.matrix[row][col] != right.matrix[row][col]) return false;
+            if ( left.data[row * left.cols + col] != right.data[row * right.cols + col]) return false;
         }
     }
     
@@ -335,6 +460,30 @@ bool operator != ( const Matrix& left, const Matrix& right )
     return !(left == right);
 }
 
+// Приближенное сравнение с абсолютным (atol) и относительным (rtol) допусками
+Matrix::Comparison Matrix::approxEqual(const Matrix& a, const Matrix& b, double atol, double rtol)
+{
+    Matrix::Comparison result;
+    if ( a.getNumColumns() != b.getNumColumns() ||
+         a.getNumRows() != b.getNumRows() )
+    {
+        result.equal        = false;
+        result.maxDeviation = std::numeric_limits<double>::infinity();
+        return result;
+    }
+    if ( a.elementCount() == 0 || a.data == b.data )
+    {
+        result.equal        = true;
+        result.maxDeviation = 0.0;
+        return result;
+    }
+    
+    MatrixKernels::ApproxStats stats = MatrixKernels::compareApprox(a.elementCount(), a.data, b.data, rtol);
+    result.equal        = ! stats.hasNan && stats.maxExcess <= atol;
+    result.maxDeviation = stats.hasNan ? std::numeric_limits<double>::quiet_NaN() : stats.maxDeviation;
+    return result;
+}
+
 // =================================================================================
 
 // =================================================================================
@@ -348,18 +497,14 @@ const Matrix operator + ( const Matrix& left, const Matrix& right )
         throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
     }
     
-    Matrix sum_result = Matrix(left.getNumRows(), left.getNumColumns());
+    Matrix sum_result = Matrix(left.getNumRows(), left.getNumColumns(), Matrix::uninitialized);
     
-    for (int row = 0; row < left.getNumRows(); row++)
+    // Переполнение дает inf в результате; поэлементная операция не зависит 
+    // от порядка вычислений и воспроизводима в любом режиме
+    if ( ! MatrixKernels::streamCombine(MatrixKernels::AddOperation, left.elementCount(), 
+                                        left.data, right.data, sum_result.data) )
     {
-        for (int col = 0; col < left.getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleAdditionSafe(left.matrix[row][col], right.matrix[row][col]) )
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            sum_result[row][col] = left.matrix[row][col] + right.matrix[row][col];
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     
     return sum_result; 
@@ -373,18 +518,14 @@ const Matrix operator - ( const Matrix& left, const Matrix& right )
         throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
     }
     
-    Matrix sum_result = Matrix(left.getNumRows(), left.getNumColumns());
+    Matrix sum_result = Matrix(left.getNumRows(), left.getNumColumns(), Matrix::uninitialized);
     
-    for (int row = 0; row < left.getNumRows(); row++)
+    // Переполнение дает inf в результате; поэлементная операция не зависит 
+    // от порядка вычислений и воспроизводима в любом режиме
+    if ( ! MatrixKernels::streamCombine(MatrixKernels::SubtractOperation, left.elementCount(), 
+                                        left.data, right.data, sum_result.data) )
     {
-        for (int col = 0; col < left.getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleSubstractionSafe(left.matrix[row][col], right.matrix[row][col]) )
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            sum_result[row][col] = left.matrix[row][col] - right.matrix[row][col];
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     
     return sum_result; 
@@ -398,16 +539,12 @@ Matrix& Matrix::operator += ( const Matrix& right )
         throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
     }
     
-    for (int row = 0; row < this->getNumRows(); row++)
+    this->detach();
+    
+    if ( ! MatrixKernels::streamCombine(MatrixKernels::AddOperation, this->elementCount(), 
+                                        this->data, right.data, this->data) )
     {
-        for (int col = 0; col < this->getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleAdditionSafe(this->matrix[row][col], right.matrix[row][col]) )
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            this->matrix[row][col] += right.matrix[row][col];
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     
     return *this; 
@@ -421,16 +558,12 @@ Matrix& Matrix::operator -= ( const Matrix& right )
         throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
     }
     
-    for (int row = 0; row < this->getNumRows(); row++)
+    this->detach();
+    
+    if ( ! MatrixKernels::streamCombine(MatrixKernels::SubtractOperation, this->elementCount(), 
+                                        this->data, right.data, this->data) )
     {
-        for (int col = 0; col < this->getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleSubstractionSafe(this->matrix[row][col], right.matrix[row][col]) )
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            this->matrix[row][col] -= right.matrix[row][col];
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     
     return *this; 
@@ -441,6 +574,148 @@ Matrix& Matrix::operator -= ( const Matrix& right )
 // =================================================================================
 // Перегруженные операторы умножения матриц: *, *=.
 // ---------------------------------------------------------------------------------
+// Структура квадратной матрицы, распознаваемая оператором * для выбора ядра
+enum MatrixStructure { StructureGeneral, StructureDiagonal, StructureUpper, StructureLower };
+
+// Минимальный порядок квадратного сомножителя, для которого проверяется структура:
+// для малых матриц проверка не окупается
+static const int STRUCTURE_DETECT_MIN = 64;
+
+// Проверяет, равны ли нулю все элементы под (below) или над главной диагональю.
+// Для плотной матрицы проверка прерывается на первом же ненулевом элементе.
+static bool isTriangleZero ( const double * data, int n, bool below )
+{
+    for ( int i = 0; i < n; i++ )
+    {
+        const double * row = data + static_cast< std::size_t >( i ) * n;
+        const int jBegin = below ? 0 : i + 1;
+        const int jEnd   = below ? i : n;
+        for ( int j = jBegin; j < jEnd; j++ )
+        {
+            if ( row[ j ] != 0.0 )
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static MatrixStructure detectStructure ( const double * data, int rows, int cols )
+{
+    if ( rows != cols || rows < STRUCTURE_DETECT_MIN )
+    {
+        return StructureGeneral;
+    }
+    const bool upper = isTriangleZero( data, rows, true );
+    const bool lower = isTriangleZero( data, rows, false );
+    if ( upper && lower )
+    {
+        return StructureDiagonal;
+    }
+    return upper ? StructureUpper : ( lower ? StructureLower : StructureGeneral );
+}
+
+// Умножение с треугольным или диагональным квадратным сомножителем (left - слева).
+// Результат уже содержит копию другого сомножителя и пересчитывается на месте.
+static void multiplyStructured ( 
+        MatrixStructure structure, bool left
+    ,   const double * factor, int n
+    ,   double * result, int rows, int cols 
+)
+{
+    if ( structure == StructureDiagonal )
+    {
+        std::vector< double > d( n );
+        for ( int i = 0; i < n; i++ )
+        {
+            d[ i ] = factor[ static_cast< std::size_t >( i ) * n + i ];
+        }
+        MatrixKernels::diagonalScale( left, rows, cols, d.data(), result, cols, result, cols );
+    }
+    else
+    {
+        MatrixKernels::trmm( left, structure == StructureUpper, false, rows, cols, factor, n, result, cols );
+    }
+}
+
+// Выбор ядра умножения: GEMV для векторов, структурированные сомножители,
+// смешанная точность или GEMM. Результат целиком записывается в target; 
+// targetRegion - область памяти target, если это буфер новой матрицы (копия 
+// сомножителя выполняется с учетом размещения страниц), иначе nullptr.
+void Matrix::multiplyInto ( const Matrix& left, const Matrix& right, 
+                            double * target, const MatrixMemory::Region * targetRegion )
+{
+    const int rows = left.getNumRows(), cols = right.getNumColumns();
+    auto copyFactor = [ & ] ( const Matrix & factor )
+    {
+        if ( targetRegion != nullptr )
+        {
+            MatrixMemory::copy(*targetRegion, factor.data, factor.elementCount());
+        }
+        else
+        {
+            std::memcpy(target, factor.data, factor.elementCount() * sizeof(double));
+        }
+    };
+
+    // Произведения с вектором (n x 1 или 1 x n) вычисляются ядром GEMV:
+    // столбец правой матрицы и строка левой хранятся непрерывно
+    if ( right.getNumColumns() == 1 )
+    {
+        MatrixKernels::gemv(false, left.rows, left.cols, 1.0, left.data, left.cols, 
+                            right.data, 0.0, target);
+    }
+    else if ( left.getNumRows() == 1 )
+    {
+        MatrixKernels::gemv(true, right.rows, right.cols, 1.0, right.data, right.cols, 
+                            left.data, 0.0, target);
+    }
+    else
+    {
+        // Диагональный или треугольный квадратный сомножитель умножается за 
+        // O(n^2) или вдвое меньшее число операций, чем плотный
+        const MatrixStructure leftStructure = detectStructure(left.data, left.rows, left.cols);
+        const MatrixStructure rightStructure = ( leftStructure == StructureGeneral )
+                                             ? detectStructure(right.data, right.rows, right.cols)
+                                             : StructureGeneral;
+        if ( leftStructure != StructureGeneral )
+        {
+            copyFactor(right);
+            multiplyStructured(leftStructure, true, left.data, left.rows, target, rows, cols);
+        }
+        else if ( rightStructure != StructureGeneral )
+        {
+            copyFactor(left);
+            multiplyStructured(rightStructure, false, right.data, right.rows, target, rows, cols);
+        }
+        else if ( Matrix::multiplyPrecision.load() != Matrix::DoublePrecision )
+        {
+            MatrixKernels::gemmMixed(
+                    Matrix::multiplyPrecision.load() == Matrix::BFloat16Precision
+                ,   Matrix::multiplyAccumulation.load() == Matrix::AccumulateFloat
+                ,   Matrix::multiplyRefinementSteps.load()
+                ,   rows, cols, left.getNumColumns()
+                ,   left.data, left.cols
+                ,   right.data, right.cols
+                ,   target, cols
+            );
+        }
+        else
+        {
+            MatrixKernels::gemm(
+                    false, false
+                ,   rows, cols, left.getNumColumns()
+                ,   1.0
+                ,   left.data, left.cols
+                ,   right.data, right.cols
+                ,   0.0
+                ,   target, cols
+            );
+        }
+    }
+}
+
 const Matrix operator * ( const Matrix& left, const Matrix& right )
 {
     // Если количество столбцов левой матрицы не соответствует количеству строк 
@@ -449,37 +724,82 @@ const Matrix operator * ( const Matrix& left, const Matrix& right )
     {
         throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
     }
-    double temp = 0;
-    Matrix mul_result = Matrix(left.getNumRows(), right.getNumColumns());
-    
-    // Проходимся по строкам и столбцам результирующей матрицы
-    // и заполняем ее
-    for (int row = 0; row < mul_result.getNumRows(); row++)
+    // Повторное произведение тех же операндов берется из кэша (см. matrix_cache.hpp)
+    // без выделения памяти под результат
+    ProductCache::Key cacheKey;
+    const bool cacheable = ProductCache::makeKey(left, right, cacheKey);
+    if ( cacheable )
     {
-        for (int col = 0; col < mul_result.getNumColumns(); col++) 
+        std::unique_ptr< Matrix > cached = ProductCache::find(cacheKey);
+        if ( cached )
         {
-            for (int col_left = 0; col_left < left.getNumColumns(); col_left++) 
-            {
-                if ( ! Matrix::isDoubleMultiplicationSafe(
-                        left.matrix[row][col_left], right.matrix[col_left][col]))
-                {
-                    throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-                }
-                
-                temp = left.matrix[row][col_left] * right.matrix[col_left][col];
-                
-                if ( ! Matrix::isDoubleAdditionSafe(mul_result[row][col],temp))
-                {
-                    throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-                }
-                mul_result[row][col] =  mul_result[row][col] + temp;
-            }
+            return std::move(*cached);
         }
     }
+
+    // Все ядра перезаписывают результат полностью (beta = 0)
+    Matrix mul_result = Matrix(left.getNumRows(), right.getNumColumns(), Matrix::uninitialized);
+    Matrix::multiplyInto(left, right, mul_result.data, &mul_result.buffer->region);
+    
+    // Переполнение при умножении или суммировании дает inf/NaN в результате
+    if ( ! MatrixKernels::allFinite(mul_result.elementCount(), mul_result.data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
     
+    if ( cacheable )
+    {
+        ProductCache::insert(cacheKey, mul_result);
+    }
     return mul_result; 
 }
 
+// Тот же выбор ядра, кэш и режим точности, что и у оператора *. Для квадратного
+// множителя произведение собирается в рабочем буфере потока и копируется 
+// обратно; при переполнении матрица не изменяется.
+Matrix& Matrix::operator *= ( const Matrix& right )
+{
+    if ( this->getNumColumns() != right.getNumRows() )
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    // Форма результата меняется - без выделения памяти не обойтись
+    if ( right.getNumColumns() != right.getNumRows() )
+    {
+        *this = *this * right;
+        return *this;
+    }
+
+    ProductCache::Key cacheKey;
+    const bool cacheable = ProductCache::makeKey(*this, right, cacheKey);
+    if ( cacheable )
+    {
+        std::unique_ptr< Matrix > cached = ProductCache::find(cacheKey);
+        if ( cached )
+        {
+            *this = std::move(*cached);
+            return *this;
+        }
+    }
+
+    const std::size_t count = this->elementCount();
+    double * target = threadWorkspace(count);
+    Matrix::multiplyInto(*this, right, target, nullptr);
+    if ( ! MatrixKernels::allFinite(count, target) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+
+    this->detach();
+    std::memcpy(this->data, target, count * sizeof(double));
+    if ( cacheable )
+    {
+        ProductCache::insert(cacheKey, *this);
+    }
+    return *this;
+}
+
 
 // =================================================================================
 
@@ -489,18 +809,10 @@ const Matrix operator * ( const Matrix& left, const Matrix& right )
 // ---------------------------------------------------------------------------------
 const Matrix operator * ( const Matrix& m, const double& _multiplier )
 {
-    Matrix mul_result = Matrix(m.getNumRows(), m.getNumColumns());
-    
-    for (int row = 0; row < m.getNumRows(); row++)
+    Matrix mul_result = Matrix(m.getNumRows(), m.getNumColumns(), Matrix::uninitialized);
+    if ( ! MatrixKernels::streamScale(m.elementCount(), _multiplier, m.data, mul_result.data) )
     {
-        for (int col = 0; col < m.getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleMultiplicationSafe(m.matrix[row][col],_multiplier))
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            mul_result[row][col] = m.matrix[row][col] * _multiplier;
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     return mul_result; 
 }
@@ -512,16 +824,10 @@ const Matrix operator * ( const double& _multiplier, const Matrix& m )
 
 Matrix& Matrix::operator *= ( const double& _multiplier )
 {
-    for (int row = 0; row < this->getNumRows(); row++)
+    this->detach();
+    if ( ! MatrixKernels::streamScale(this->elementCount(), _multiplier, this->data, this->data) )
     {
-        for (int col = 0; col < this->getNumColumns(); col++) 
-        {
-            if ( ! Matrix::isDoubleMultiplicationSafe(this->matrix[row][col], _multiplier))
-            {
-                throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
-            }
-            this->matrix[row][col] *= _multiplier;
-        }
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
     }
     return *this;  
 }
@@ -530,57 +836,940 @@ Matrix& Matrix::operator *= ( const double& _multiplier )
 
 
 // =================================================================================
-// Операторы присвоения и перемещения
+// Операции "на месте" в стиле BLAS
 // ---------------------------------------------------------------------------------
 
-// Оператор присвоения
-Matrix& Matrix::operator =(const Matrix& right)
+// this = this + alpha * X
+Matrix& Matrix::axpy(double alpha, const Matrix& X)
 {
-    this->setNumRows(right.getNumRows());
-	this->setNumColumns(right.getNumColumns());
-	if (this->allocateMemory(rows, cols) == false)
-	{
-        throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
-	}
-
-	for (int r = 0; r < this->getNumRows(); r++)
-	{
-		for (int c = 0; c < this->getNumColumns(); c++)
-		{
-			this->matrix[r][c] = right[r][c];
-		}
-	}
+    if (this->getNumColumns()   != X.getNumColumns() ||
+        this->getNumRows()      != X.getNumRows() )
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    this->detach();
+    MatrixKernels::axpy(this->elementCount(), alpha, X.data, this->data);
+    
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
     return *this;
 }
 
-
-// Оператор перемещения
-Matrix& Matrix::operator =(Matrix && right)
+// this = alpha * this + beta * X
+Matrix& Matrix::scaleAdd(double alpha, double beta, const Matrix& X)
 {
-    this->rows      = std::move(right.rows);
-	this->cols      = std::move(right.cols);
-    this->matrix    = std::move(right.matrix);
+    if (this->getNumColumns()   != X.getNumColumns() ||
+        this->getNumRows()      != X.getNumRows() )
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    this->detach();
+    MatrixKernels::axpby(this->elementCount(), beta, X.data, alpha, this->data);
+    
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
 }
 
+// this = alpha * op(A) * op(B) + beta * this
+Matrix& Matrix::gemm(double alpha, const Matrix& A, const Matrix& B, double beta,
+                     TransposeFlag transA, TransposeFlag transB)
+{
+    const int m  = (transA == Trans) ? A.getNumColumns() : A.getNumRows();
+    const int k  = (transA == Trans) ? A.getNumRows()    : A.getNumColumns();
+    const int kB = (transB == Trans) ? B.getNumColumns() : B.getNumRows();
+    const int n  = (transB == Trans) ? B.getNumRows()    : B.getNumColumns();
+    
+    if ( k != kB || m != this->getNumRows() || n != this->getNumColumns() )
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    // После отделения буфер this может совпадать с A или B, только если это
+    // один и тот же объект. Тогда результат собирается в рабочем буфере потока.
+    this->detach();
+    const bool aliased = (A.data == this->data || B.data == this->data);
+    double * target = aliased ? threadWorkspace(this->elementCount()) : this->data;
+    
+    if ( aliased && beta != 0.0 )
+    {
+        std::memcpy(target, this->data, this->elementCount() * sizeof(double));
+    }
+    
+    MatrixKernels::gemm(
+            transA == Trans, transB == Trans
+        ,   m, n, k
+        ,   alpha
+        ,   A.data, A.cols
+        ,   B.data, B.cols
+        ,   beta
+        ,   target, this->cols
+    );
+    
+    if ( aliased )
+    {
+        std::memcpy(this->data, target, this->elementCount() * sizeof(double));
+    }
+    
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
+}
 
+// this = this + alpha * x * y^T
+Matrix& Matrix::ger(double alpha, const Vector& x, const Vector& y)
+{
+    if ( x.getSize() != this->getNumRows() || y.getSize() != this->getNumColumns() )
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    this->detach();
+    MatrixKernels::ger(this->rows, this->cols, alpha, x.getData(), y.getData(), this->data, this->cols);
+    
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
+}
 // =================================================================================
 
 
+
 // =================================================================================
-// Геттеры класса Matrix
+// Поэлементные операции
 // ---------------------------------------------------------------------------------
-int Matrix::getNumRows(void) const
+void Matrix::forEachRowBlock(int rows, int cols, const std::function< void (std::size_t, std::size_t) > & body)
 {
-	return this->rows;
+    const std::size_t rowLength = static_cast< std::size_t >(cols);
+    ThreadPool::RangeBody rowsBody = [ & ] (std::size_t from, std::size_t to)
+    {
+        body(from * rowLength, to * rowLength);
+    };
+    if (static_cast< std::size_t >(rows) * cols >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+    {
+        ThreadPool::instance().parallelFor(0, rows, 
+            std::max< std::size_t >(1, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4 / rowLength), rowsBody);
+    }
+    else
+    {
+        rowsBody(0, rows);
+    }
 }
 
-int Matrix::getNumColumns(void) const
+// Векторизованное ядро встроенной функции
+static void (* elementKernel(Matrix::ElementFunction function))(std::size_t, const double *, double *)
+{
+    switch (function)
+    {
+        case Matrix::Exp:     return MatrixKernels::vexp;
+        case Matrix::Log:     return MatrixKernels::vlog;
+        case Matrix::Tanh:    return MatrixKernels::vtanh;
+        case Matrix::Sigmoid: return MatrixKernels::vsigmoid;
+        case Matrix::Relu:    return MatrixKernels::vrelu;
+    }
+    throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+}
+
+const Matrix hadamard(const Matrix& left, const Matrix& right)
+{
+    if (left.rows != right.rows || left.cols != right.cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+
+    Matrix result(left.rows, left.cols, Matrix::uninitialized);
+    const double * a = left.data;
+    const double * b = right.data;
+    double * target = result.data;
+    Matrix::forEachRowBlock(left.rows, left.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        MatrixKernels::multiplyElements(to - from, a + from, b + from, target + from);
+    });
+
+    if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return result;
+}
+
+const Matrix divide(const Matrix& left, const Matrix& right)
+{
+    if (left.rows != right.rows || left.cols != right.cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+
+    Matrix result(left.rows, left.cols, Matrix::uninitialized);
+    const double * a = left.data;
+    const double * b = right.data;
+    double * target = result.data;
+    Matrix::forEachRowBlock(left.rows, left.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        MatrixKernels::divideElements(to - from, a + from, b + from, target + from);
+    });
+
+    if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return result;
+}
+
+Matrix& Matrix::multiplyElements(const Matrix& right)
+{
+    if (this->rows != right.rows || this->cols != right.cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+
+    this->detach();
+    double * target = this->data;
+    const double * source = right.data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        MatrixKernels::multiplyElements(to - from, target + from, source + from, target + from);
+    });
+
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
+}
+
+Matrix& Matrix::divideElements(const Matrix& right)
+{
+    if (this->rows != right.rows || this->cols != right.cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+
+    this->detach();
+    double * target = this->data;
+    const double * source = right.data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        MatrixKernels::divideElements(to - from, target + from, source + from, target + from);
+    });
+
+    // Деление на ноль дает inf или NaN
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
+}
+
+const Matrix Matrix::map(ElementFunction function) const
+{
+    Matrix result(this->rows, this->cols, Matrix::uninitialized);
+    const auto kernel = elementKernel(function);
+    const double * source = this->data;
+    double * target = result.data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        kernel(to - from, source + from, target + from);
+    });
+
+    if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return result;
+}
+
+Matrix& Matrix::apply(ElementFunction function)
+{
+    const auto kernel = elementKernel(function);
+    this->detach();
+    double * target = this->data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        kernel(to - from, target + from, target + from);
+    });
+
+    if ( ! MatrixKernels::allFinite(this->elementCount(), this->data) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+    return *this;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Операции с распространением
+// ---------------------------------------------------------------------------------
+static MatrixKernels::ElementOperation elementOperation(Matrix::BroadcastOperation operation)
+{
+    switch (operation)
+    {
+        case Matrix::Add:      return MatrixKernels::AddOperation;
+        case Matrix::Subtract: return MatrixKernels::SubtractOperation;
+        case Matrix::Multiply: return MatrixKernels::MultiplyOperation;
+        case Matrix::Divide:   return MatrixKernels::DivideOperation;
+    }
+    throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+}
+
+// target(i, j) = source(i, j) op vector[j] (вектор-строка) или op vector[i] 
+// (вектор-столбец) для матриц rows x cols. target может совпадать с source.
+static void broadcastInto(int rows, int cols, Matrix::BroadcastOperation operation, bool rowVector,
+                          const double * source, const Vector& vector, double * target)
+{
+    if (vector.getSize() != (rowVector ? cols : rows))
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+
+    const MatrixKernels::ElementOperation op = elementOperation(operation);
+    const std::size_t rowLength = static_cast< std::size_t >(cols);
+    const double * values = vector.getData();
+    ThreadPool::RangeBody body = [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t i = from; i < to; i++)
+        {
+            const std::size_t offset = i * rowLength;
+            if (rowVector)
+            {
+                MatrixKernels::combineElements(op, rowLength, source + offset, values, target + offset);
+            }
+            else
+            {
+                MatrixKernels::combineScalar(op, rowLength, source + offset, values[i], target + offset);
+            }
+        }
+    };
+    if (static_cast< std::size_t >(rows) * cols >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+    {
+        ThreadPool::instance().parallelFor(0, rows, 
+            std::max< std::size_t >(1, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4 / rowLength), body);
+    }
+    else
+    {
+        body(0, rows);
+    }
+
+    if ( ! MatrixKernels::allFinite(static_cast< std::size_t >(rows) * cols, target) )
+    {
+        throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+    }
+}
+
+Matrix& Matrix::broadcastRow(BroadcastOperation operation, const Vector& row)
+{
+    this->detach();
+    broadcastInto(this->rows, this->cols, operation, true, this->data, row, this->data);
+    return *this;
+}
+
+Matrix& Matrix::broadcastColumn(BroadcastOperation operation, const Vector& column)
+{
+    this->detach();
+    broadcastInto(this->rows, this->cols, operation, false, this->data, column, this->data);
+    return *this;
+}
+
+const Matrix broadcastRow(const Matrix& m, Matrix::BroadcastOperation operation, const Vector& row)
+{
+    Matrix result(m.rows, m.cols, Matrix::uninitialized);
+    broadcastInto(m.rows, m.cols, operation, true, m.data, row, result.data);
+    return result;
+}
+
+const Matrix broadcastColumn(const Matrix& m, Matrix::BroadcastOperation operation, const Vector& column)
+{
+    Matrix result(m.rows, m.cols, Matrix::uninitialized);
+    broadcastInto(m.rows, m.cols, operation, false, m.data, column, result.data);
+    return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Составление матриц из частей
+// ---------------------------------------------------------------------------------
+const Matrix hstack(const std::vector< Matrix >& parts)
+{
+    if (parts.empty())
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    int cols = 0;
+    for (const Matrix& part : parts)
+    {
+        if (part.rows != parts[0].rows)
+        {
+            throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+        }
+        cols += part.cols;
+    }
+
+    // Строка результата - последовательность строк частей
+    Matrix result(parts[0].rows, cols, Matrix::uninitialized);
+    const std::size_t rowLength = static_cast< std::size_t >(cols);
+    double * target = result.data;
+    Matrix::forEachRowBlock(result.rows, result.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t offset = from; offset < to; offset += rowLength)
+        {
+            const std::size_t row = offset / rowLength;
+            double * output = target + offset;
+            for (const Matrix& part : parts)
+            {
+                std::memcpy(output, part.data + row * part.cols, part.cols * sizeof(double));
+                output += part.cols;
+            }
+        }
+    });
+    return result;
+}
+
+const Matrix vstack(const std::vector< Matrix >& parts)
+{
+    if (parts.empty())
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    int rows = 0;
+    for (const Matrix& part : parts)
+    {
+        if (part.cols != parts[0].cols)
+        {
+            throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+        }
+        rows += part.rows;
+    }
+
+    // Элементы результата - последовательность буферов частей; каждый блок
+    // строк копирует пересечение своего диапазона с буферами частей
+    Matrix result(rows, parts[0].cols, Matrix::uninitialized);
+    double * target = result.data;
+    Matrix::forEachRowBlock(result.rows, result.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        std::size_t partBegin = 0;
+        for (const Matrix& part : parts)
+        {
+            const std::size_t partEnd = partBegin + part.elementCount();
+            const std::size_t begin = std::max(from, partBegin), end = std::min(to, partEnd);
+            if (begin < end)
+            {
+                std::memcpy(target + begin, part.data + (begin - partBegin), (end - begin) * sizeof(double));
+            }
+            partBegin = partEnd;
+        }
+    });
+    return result;
+}
+
+Matrix& Matrix::reshape(int rows, int cols)
+{
+    if ( ! Matrix::isValidDimension(rows, cols) )
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    if (static_cast< std::size_t >(rows) * cols != this->elementCount())
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    this->setNumRows(rows);
+    this->setNumColumns(cols);
+    return *this;
+}
+
+const Matrix Matrix::reshaped(int rows, int cols) const
+{
+    Matrix result(*this);
+    result.reshape(rows, cols);
+    return result;
+}
+
+const Matrix Matrix::selectRows(const std::vector< int >& indices) const
+{
+    if (indices.empty())
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    for (int index : indices)
+    {
+        if ( ! this->isRowInRange(index) )
+        {
+            throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+        }
+    }
+
+    Matrix result(static_cast< int >(indices.size()), this->cols, Matrix::uninitialized);
+    const std::size_t rowLength = static_cast< std::size_t >(this->cols);
+    const double * source = this->data;
+    double * target = result.data;
+    forEachRowBlock(result.rows, result.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t offset = from; offset < to; offset += rowLength)
+        {
+            std::memcpy(target + offset, source + indices[offset / rowLength] * rowLength, rowLength * sizeof(double));
+        }
+    });
+    return result;
+}
+
+Matrix& Matrix::scatterRows(const std::vector< int >& indices, const Matrix& source)
+{
+    if (source.rows != static_cast< int >(indices.size()) || source.cols != this->cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    // Для каждой строки - номер последней записываемой в нее строки source,
+    // чтобы при повторах результат не зависел от порядка обработки блоков
+    std::vector< int > writer(this->rows, -1);
+    for (std::size_t k = 0; k < indices.size(); k++)
+    {
+        if ( ! this->isRowInRange(indices[k]) )
+        {
+            throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+        }
+        writer[indices[k]] = static_cast< int >(k);
+    }
+
+    this->detach();
+    if (source.data == this->data)
+    {
+        const Matrix copy(source);
+        return this->scatterRows(indices, copy);
+    }
+
+    const std::size_t rowLength = static_cast< std::size_t >(this->cols);
+    const double * input = source.data;
+    double * target = this->data;
+    forEachRowBlock(source.rows, source.cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t offset = from; offset < to; offset += rowLength)
+        {
+            const std::size_t k = offset / rowLength;
+            if (writer[indices[k]] == static_cast< int >(k))
+            {
+                std::memcpy(target + indices[k] * rowLength, input + offset, rowLength * sizeof(double));
+            }
+        }
+    });
+    return *this;
+}
+// =================================================================================
+
+
+
+// =================================================================================
+// Операторы присвоения и перемещения
+// ---------------------------------------------------------------------------------
+
+// Оператор присвоения. В режиме copy-on-write буфер правой матрицы разделяется,
+// иначе собственный буфер переиспользуется, если размеры совпадают.
+// Закрепленный тайлами буфер не освобождается: элементы копируются в него,
+// а присвоение матрицы другого размера генерирует исключение.
+Matrix& Matrix::operator =(const Matrix& right)
+{
+    if (this == &right)
+    {
+        return *this;
+    }
+
+    if (this->buffer != nullptr && this->buffer->pins.load() > 0)
+    {
+        if (this->elementCount() != right.elementCount())
+        {
+            throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+        }
+        this->setNumRows(right.getNumRows());
+        this->setNumColumns(right.getNumColumns());
+        MatrixMemory::copy(this->buffer->region, right.data, this->elementCount());
+        return *this;
+    }
+
+    // Общий буфер (например, после reshaped) - совпадают данные, но не обязательно размеры
+    if (this->buffer != nullptr && this->buffer == right.buffer)
+    {
+        this->setNumRows(right.getNumRows());
+        this->setNumColumns(right.getNumColumns());
+        return *this;
+    }
+
+    // Закрепленный буфер копируется обычным путем (см. shareBuffer)
+    if (Matrix::isCopyOnWrite() && right.buffer != nullptr && right.buffer->pins.load() == 0)
+    {
+        this->releaseMemory();
+        this->setNumRows(right.getNumRows());
+        this->setNumColumns(right.getNumColumns());
+        this->shareBuffer(right);
+        return *this;
+    }
+
+    bool canReuse = this->buffer != nullptr 
+                 && this->buffer->refCount.load() == 1 
+                 && this->elementCount() == right.elementCount();
+    if ( ! canReuse )
+    {
+        this->releaseMemory();
+        if (right.buffer != nullptr && this->allocateMemory(right.rows, right.cols) == false)
+        {
+            this->setNumRows(0);
+            this->setNumColumns(0);
+            throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+        }
+    }
+
+    this->setNumRows(right.getNumRows());
+	this->setNumColumns(right.getNumColumns());
+	if (right.buffer != nullptr)
+	{
+		MatrixMemory::copy(this->buffer->region, right.data, this->elementCount());
+	}
+    return *this;
+}
+
+
+// Оператор перемещения
+// Объекты обмениваются ресурсами, старые ресурсы освобождаются вместе с временным объектом.
+// Закрепленный буфер остается у матрицы, элементы копируются.
+Matrix& Matrix::operator =(Matrix && right)
+{
+    if (this->buffer != nullptr && this->buffer->pins.load() > 0)
+    {
+        return *this = static_cast< const Matrix & >(right);
+    }
+
+    std::swap(this->rows,   right.rows);
+    std::swap(this->cols,   right.cols);
+    std::swap(this->buffer, right.buffer);
+    std::swap(this->data,   right.data);
+    return *this;
+}
+
+
+// =================================================================================
+
+
+// =================================================================================
+// Геттеры класса Matrix
+// ---------------------------------------------------------------------------------
+int Matrix::getNumRows(void) const
+{
+	return this->rows;
+}
+
+int Matrix::getNumColumns(void) const
 {
 	return this->cols;
 }
 // =================================================================================
 
 
+// =================================================================================
+// Редукции
+// ---------------------------------------------------------------------------------
+double Matrix::sum() const
+{
+    return MatrixKernels::sum(this->elementCount(), this->data);
+}
+
+// Для пустой (перемещенной) матрицы минимум и максимум не определены
+double Matrix::minElement() const
+{
+    if (this->elementCount() == 0)
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    double minValue, maxValue;
+    MatrixKernels::minMax(this->elementCount(), this->data, minValue, maxValue);
+    return minValue;
+}
+
+double Matrix::maxElement() const
+{
+    if (this->elementCount() == 0)
+    {
+        throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+    }
+    double minValue, maxValue;
+    MatrixKernels::minMax(this->elementCount(), this->data, minValue, maxValue);
+    return maxValue;
+}
+
+double Matrix::normFrobenius() const
+{
+    return MatrixKernels::normFrobenius(this->elementCount(), this->data);
+}
+
+// Суммы модулей по столбцам накапливаются построчным проходом с компенсацией 
+// Кэхэна (столбцы независимы, поэтому внутренний цикл векторизуется); потоки 
+// обрабатывают непересекающиеся блоки столбцов. Норма пустой матрицы - 0.
+double Matrix::norm1() const
+{
+    if (this->elementCount() == 0)
+    {
+        return 0.0;
+    }
+
+    std::vector< double > columnSums(this->cols, 0.0), compensation(this->cols, 0.0);
+    const int numRows = this->rows, numCols = this->cols;
+    const double * source = this->data;
+    
+    ThreadPool::RangeBody body = [ & ] (std::size_t from, std::size_t to)
+    {
+        for (int row = 0; row < numRows; row++)
+        {
+            const double * rowData = source + static_cast< std::size_t >(row) * numCols;
+            for (std::size_t col = from; col < to; col++)
+            {
+                const double y = std::fabs(rowData[col]) - compensation[col];
+                const double t = columnSums[col] + y;
+                compensation[col] = (t - columnSums[col]) - y;
+                columnSums[col] = t;
+            }
+        }
+    };
+    if (this->elementCount() >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+    {
+        ThreadPool::instance().parallelFor(0, numCols, 256, body);
+    }
+    else
+    {
+        body(0, numCols);
+    }
+    
+    return *std::max_element(columnSums.begin(), columnSums.end());
+}
+
+double Matrix::normInf() const
+{
+    if (this->elementCount() == 0)
+    {
+        return 0.0;
+    }
+
+    std::vector< double > rowSums(this->rows, 0.0);
+    const int numCols = this->cols;
+    const double * source = this->data;
+    
+    ThreadPool::RangeBody body = [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t row = from; row < to; row++)
+        {
+            rowSums[row] = MatrixKernels::absSum(numCols, source + row * numCols);
+        }
+    };
+    if (this->elementCount() >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+    {
+        ThreadPool::instance().parallelFor(0, this->rows, 
+            std::max< std::size_t >(1, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4 / numCols), body);
+    }
+    else
+    {
+        body(0, this->rows);
+    }
+    
+    return *std::max_element(rowSums.begin(), rowSums.end());
+}
+
+// Диагональные элементы разбросаны по памяти, поэтому вместо попарного 
+// суммирования используется компенсированное суммирование Кэхэна
+double Matrix::trace() const
+{
+    if (this->rows != this->cols)
+    {
+        throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+    }
+    
+    double result = 0.0, compensation = 0.0;
+    for (int i = 0; i < this->rows; i++)
+    {
+        const double y = this->data[static_cast< std::size_t >(i) * this->cols + i] - compensation;
+        const double t = result + y;
+        compensation = (t - result) - y;
+        result = t;
+    }
+    return result;
+}
+
+// Каждая строка суммируется попарно, строки распределяются между потоками
+Vector Matrix::rowSums() const
+{
+    Vector result(this->rows);
+    double * sums = result.getData();
+    const std::size_t rowLength = static_cast< std::size_t >(this->cols);
+    const double * source = this->data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t offset = from; offset < to; offset += rowLength)
+        {
+            sums[offset / rowLength] = MatrixKernels::sum(rowLength, source + offset);
+        }
+    });
+    return result;
+}
+
+Vector Matrix::rowMeans() const
+{
+    Vector result = this->rowSums();
+    MatrixKernels::combineScalar(MatrixKernels::DivideOperation, this->rows, result.getData(), 
+                                 this->cols, result.getData());
+    return result;
+}
+
+Vector Matrix::columnSums() const
+{
+    Vector result(this->cols);
+    MatrixKernels::columnSums(this->rows, this->cols, this->data, this->cols, result.getData());
+    return result;
+}
+
+Vector Matrix::columnMeans() const
+{
+    Vector result = this->columnSums();
+    MatrixKernels::combineScalar(MatrixKernels::DivideOperation, this->cols, result.getData(), 
+                                 this->rows, result.getData());
+    return result;
+}
+
+std::vector< int > Matrix::rowArgMax() const
+{
+    std::vector< int > result(this->rows);
+    const std::size_t rowLength = static_cast< std::size_t >(this->cols);
+    const double * source = this->data;
+    forEachRowBlock(this->rows, this->cols, [ & ] (std::size_t from, std::size_t to)
+    {
+        for (std::size_t offset = from; offset < to; offset += rowLength)
+        {
+            result[offset / rowLength] = static_cast< int >(MatrixKernels::argMax(rowLength, source + offset));
+        }
+    });
+    return result;
+}
+
+std::vector< int > Matrix::columnArgMax() const
+{
+    std::vector< int > result(this->cols);
+    MatrixKernels::columnArgMax(this->rows, this->cols, this->data, this->cols, result.data());
+    return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Режим copy-on-write
+// ---------------------------------------------------------------------------------
+std::atomic< bool > Matrix::copyOnWriteEnabled( false );
+
+void Matrix::setCopyOnWrite(bool enabled)
+{
+	Matrix::copyOnWriteEnabled.store(enabled);
+}
+
+bool Matrix::isCopyOnWrite()
+{
+	return Matrix::copyOnWriteEnabled.load();
+}
+
+// Возвращает true, если буфер матрицы в данный момент разделяется с другими матрицами
+bool Matrix::isShared() const
+{
+	return this->buffer != nullptr && this->buffer->refCount.load() > 1;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Воспроизводимый режим
+// ---------------------------------------------------------------------------------
+void Matrix::setReproducible(bool enabled)
+{
+	MatrixKernels::setReproducible(enabled);
+}
+
+bool Matrix::isReproducible()
+{
+	return MatrixKernels::isReproducible();
+}
+// =================================================================================
+
+
+// =================================================================================
+// Умножение со смешанной точностью
+// ---------------------------------------------------------------------------------
+std::atomic< int > Matrix::multiplyPrecision( Matrix::DoublePrecision );
+std::atomic< int > Matrix::multiplyAccumulation( Matrix::AccumulateDouble );
+std::atomic< int > Matrix::multiplyRefinementSteps( 0 );
+
+void Matrix::setMultiplyPrecision(Precision precision, Accumulation accumulation, int refinementSteps)
+{
+	Matrix::multiplyPrecision.store(precision);
+	Matrix::multiplyAccumulation.store(accumulation);
+	Matrix::multiplyRefinementSteps.store(std::max(refinementSteps, 0));
+}
+
+Matrix::MixedPrecision Matrix::getMultiplyPrecision()
+{
+	MixedPrecision result;
+	result.precision = static_cast< Precision >(Matrix::multiplyPrecision.load());
+	result.accumulation = static_cast< Accumulation >(Matrix::multiplyAccumulation.load());
+	result.refinementSteps = Matrix::multiplyRefinementSteps.load();
+	return result;
+}
+
+const Matrix Matrix::multiplyMixed(const Matrix& left, const Matrix& right,
+                                   Precision precision, Accumulation accumulation,
+                                   int refinementSteps, AccuracyReport * report)
+{
+	if ( left.cols != right.rows )
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(left.rows, right.cols, Matrix::uninitialized);
+	if ( precision == DoublePrecision )
+	{
+		MatrixKernels::gemm(false, false, left.rows, right.cols, left.cols, 1.0,
+		                    left.data, left.cols, right.data, right.cols, 0.0, result.data, result.cols);
+	}
+	else
+	{
+		MatrixKernels::gemmMixed(precision == BFloat16Precision, accumulation == AccumulateFloat, 
+		                         refinementSteps, left.rows, right.cols, left.cols,
+		                         left.data, left.cols, right.data, right.cols, result.data, result.cols);
+	}
+	if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+
+	if ( report != nullptr )
+	{
+		Matrix reference(left.rows, right.cols, Matrix::uninitialized);
+		MatrixKernels::gemm(false, false, left.rows, right.cols, left.cols, 1.0,
+		                    left.data, left.cols, right.data, right.cols, 0.0, reference.data, reference.cols);
+		Matrix difference(result);
+		difference.axpy(-1.0, reference);
+		const double referenceNorm = reference.normFrobenius();
+		report->maxAbsError = std::max(std::fabs(difference.minElement()), std::fabs(difference.maxElement()));
+		report->relativeError = referenceNorm > 0.0 ? difference.normFrobenius() / referenceNorm 
+		                                            : difference.normFrobenius();
+		report->unitRoundoff = precision == DoublePrecision ? std::ldexp(1.0, -53)
+		                     : precision == SinglePrecision ? std::ldexp(1.0, -24) 
+		                                                    : std::ldexp(1.0, -8);
+	}
+	return result;
+}
+// =================================================================================
+
+
 // =================================================================================
 // Операторы индексной выборки для чтения и для записи. При попытке доступа по 
 // некорректному номеру строки или столбца должно генерироваться исключение с 
@@ -597,7 +1786,8 @@ Matrix::MatrixRowAccessor< const Matrix > Matrix::operator[] (int _rowIndex) con
 	return MatrixRowAccessor< const Matrix >(*this, _rowIndex);
 }
 
-// Оператор индексной выборки для записи.
+// Оператор индексной выборки для записи. Разделяемый буфер отделяется до 
+// возврата аксессора, т.к. через него возможна запись.
 // Возвращает: Объект типа Matrix::MatrixRowAccessor
 Matrix::MatrixRowAccessor< Matrix > Matrix::operator[] (int _rowIndex)
 {
@@ -605,6 +1795,7 @@ Matrix::MatrixRowAccessor< Matrix > Matrix::operator[] (int _rowIndex)
 	{
 		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
 	}
+	this->detach();
 	return MatrixRowAccessor< Matrix >(*this, _rowIndex);
 }
 // =================================================================================
@@ -630,7 +1821,7 @@ Matrix::MatrixRowAccessor< Matrix > Matrix::operator[] (int _rowIndex)
 // строки - символами новой строки (\n).
 // ---------------------------------------------------------------------------------
 
-std::ostream& operator << (std::ostream &stream, Matrix& m)
+std::ostream& operator << (std::ostream &stream, const Matrix& m)
 {
 	for (int r = 0; r < m.getNumRows(); r++)
 	{
@@ -8,14 +8,59 @@
 #include <stdexcept>
 #include <limits> // для проверки выхода за пределы типа double
 #include <math.h>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix_memory.hpp"
+
+class Vector;
+class DiagonalMatrix;
+class TriangularMatrix;
+class SymmetricMatrix;
+class BandedMatrix;
+class Sketch;
+class DistributedMatrix;
+class CompressedMatrix;
+class Convolution;
+class UpdatableInverse;
+class CholeskyFactorization;
+class ProductCache;
+template< typename > class BasicTiling;
+struct SymmetricEigen;
+struct SingularValueDecomposition;
 
 class Matrix
 {
 
 /*-----------------------------------------------------------------*/
 private:
+	// Буфер элементов матрицы со счетчиком ссылок. Элементы хранятся построчно
+	// в одном непрерывном блоке памяти. При включенном режиме copy-on-write 
+	// несколько объектов Matrix могут разделять один буфер до первой записи.
+	// Закрепленный буфер (pins > 0, на него ссылаются изменяемые тайлы) не 
+	// разделяется: копии получают собственные элементы.
+	struct Buffer
+	{
+		MatrixMemory::Region region;
+		std::atomic< int > refCount;
+		std::atomic< int > pins;
+	};
+
 	int rows, cols;
-	double ** matrix;
+	Buffer * buffer;
+	double * data; // = buffer->data, кэшируется для быстрого доступа
+
+	// Глобальный переключатель режима copy-on-write (по умолчанию выключен)
+	static std::atomic< bool > copyOnWriteEnabled;
+
+	// Глобальная настройка точности оператора * (см. setMultiplyPrecision)
+	static std::atomic< int > multiplyPrecision;
+	static std::atomic< int > multiplyAccumulation;
+	static std::atomic< int > multiplyRefinementSteps;
 
 	// Проверяет, чтобы количество строк и столбцов было положительно
 	static bool isValidDimension(int rows, int cols);
@@ -36,7 +81,35 @@ private:
 	bool isColInRange(int col) const;
 
 	// Выделение памяти под матрицу. Условно считаем входные данные стирильными.
-	bool allocateMemory(int rows, int cols);
+	// При zeroed == true память гарантированно заполнена нулями.
+	bool allocateMemory(int rows, int cols, bool zeroed = false);
+
+	// Освобождает ссылку на буфер. Память удаляется последним владельцем.
+	void releaseMemory();
+
+	// Подключает объект к буферу другой матрицы без копирования элементов.
+	// Закрепленный буфер копируется.
+	void shareBuffer(const Matrix & _source);
+
+	// Тег конструктора копии, разделяющей буфер независимо от режима copy-on-write
+	// (кроме закрепленного буфера)
+	struct Shared {};
+	Matrix(const Matrix & _source, Shared);
+
+	// Выбор ядра оператора * (см. matrix.cpp); target не пересекается с сомножителями
+	static void multiplyInto(const Matrix & left, const Matrix & right, 
+	                         double * target, const MatrixMemory::Region * targetRegion);
+
+	// Вызывает body(from, to) для диапазонов элементов из целых строк матрицы
+	// rows x cols; при достаточном количестве элементов - параллельно
+	static void forEachRowBlock(int rows, int cols, const std::function< void (std::size_t, std::size_t) > & body);
+
+	// Отделяет собственную копию буфера, если он разделяется с другими матрицами.
+	// Вызывается перед любой записью в элементы.
+	void detach();
+
+	// Количество элементов матрицы
+	std::size_t elementCount() const;
 
 	void setNumRows(int rows);
 
@@ -52,6 +125,17 @@ public:
 	// генерируется исключение с текстом "Invalid dimensions".
 	Matrix(int rows, int cols);
 
+	// Тег конструктора без инициализации элементов: Matrix(rows, cols, Matrix::uninitialized).
+	// Используется, когда все элементы будут сразу перезаписаны, например, 
+	// результатами операторов. Чтение элементов до записи не допускается.
+	struct Uninitialized {};
+	static const Uninitialized uninitialized;
+
+	// Конструктор, принимающий количество строк и столбцов, но не заполняющий матрицу.
+	// Если количество строк или столбцов не является положительным числом, 
+	// генерируется исключение с текстом "Invalid dimensions".
+	Matrix(int rows, int cols, Uninitialized);
+
 	// Конструктор, принимающий количество строк и столбцов, а также указатель на массив 
 	// данных типа double.Если количество строк или столбцов не является положительным числом, 
 	// генерируется исключение с текстом "Invalid dimensions", 
@@ -71,6 +155,18 @@ public:
 	friend bool operator==(const Matrix& left, const Matrix& right);
 	friend bool operator!= (const Matrix& left, const Matrix& right);
 
+	// Приближенное сравнение: матрицы равны, если их размеры совпадают и для всех
+	// элементов |a - b| <= atol + rtol * |b|. Элементы NaN никогда не равны.
+	// Кроме признака равенства возвращается максимальное отклонение max |a - b|
+	// (для матриц разного размера - бесконечность).
+	struct Comparison
+	{
+		bool equal;
+		double maxDeviation;
+	};
+	static Comparison approxEqual(const Matrix& a, const Matrix& b, 
+	                              double atol = 1e-9, double rtol = 1e-9);
+
 	// Перегруженные операторы сложения и вычитания матриц: +, +=, -, -=.
 	friend const Matrix operator+ ( const Matrix& left, const Matrix& right );
 	friend const Matrix operator- ( const Matrix& left, const Matrix& right );
@@ -78,6 +174,10 @@ public:
 	Matrix& operator-= ( const Matrix& right );
 
 	// Перегруженные операторы умножения матриц: *, *=.
+	// Оператор *= выбирает ядро так же, как *, (структура сомножителей, режим 
+	// точности, кэш произведений) и дает тот же результат. Произведение 
+	// вычисляется в рабочем буфере потока и копируется обратно, поэтому для 
+	// квадратного множителя память не выделяется (при выключенном кэше).
 	friend const Matrix operator * (const Matrix& m, const Matrix& _multiplier);
 	Matrix& operator *= (const Matrix& _multiplier);
 
@@ -86,6 +186,117 @@ public:
 	friend const Matrix operator * (const double& _multiplier, const Matrix& m);
 	Matrix& operator *= (const double& _multiplier);
 
+	// =================================================================================
+	// Операции "на месте" в стиле BLAS. Не создают временных матриц и не выделяют
+	// память на горячем пути. Если в результате получено переполнение (inf или NaN),
+	// генерируется исключение с текстом "Values are out of range"; содержимое
+	// матрицы при этом уже изменено.
+	// ---------------------------------------------------------------------------------
+	enum TransposeFlag { NoTrans = 0, Trans = 1 };
+
+	// this = this + alpha * X
+	Matrix& axpy(double alpha, const Matrix& X);
+
+	// this = alpha * this + beta * X
+	Matrix& scaleAdd(double alpha, double beta, const Matrix& X);
+
+	// this = alpha * op(A) * op(B) + beta * this, где op(X) = X или X^T.
+	// Допускается передача самой матрицы в качестве A или B.
+	Matrix& gemm(double alpha, const Matrix& A, const Matrix& B, double beta,
+	             TransposeFlag transA = NoTrans, TransposeFlag transB = NoTrans);
+
+	// this = this + alpha * x * y^T (обновление ранга 1, GER).
+	// Длина x должна совпадать с количеством строк, y - столбцов.
+	Matrix& ger(double alpha, const Vector& x, const Vector& y);
+	// =================================================================================
+
+	// =================================================================================
+	// Поэлементные операции без обращения к элементам через operator[]. Большие
+	// матрицы обрабатываются параллельно блоками строк. Для матриц разного
+	// размера генерируется исключение с текстом "Size mismatch".
+	// ---------------------------------------------------------------------------------
+	// Поэлементное произведение (Адамара) и поэлементное частное. Если в результате
+	// получены inf или NaN, генерируется исключение с текстом "Values are out of range".
+	friend const Matrix hadamard(const Matrix& left, const Matrix& right);
+	friend const Matrix divide(const Matrix& left, const Matrix& right);
+	Matrix& multiplyElements(const Matrix& right);
+	Matrix& divideElements(const Matrix& right);
+
+	// Встроенные векторизованные функции (погрешность указана в matrix_kernels.hpp).
+	// Если в результате получены inf или NaN (например, логарифм отрицательного
+	// элемента), генерируется исключение с текстом "Values are out of range";
+	// apply при этом уже изменил содержимое матрицы.
+	enum ElementFunction { Exp, Log, Tanh, Sigmoid, Relu };
+	const Matrix map(ElementFunction function) const;
+	Matrix& apply(ElementFunction function);
+
+	// Произвольная функция f(double) -> double, подставляемая в цикл по элементам
+	// без косвенного вызова. f вызывается одновременно из нескольких потоков,
+	// результат на переполнение не проверяется.
+	template< typename Function >
+	const Matrix map(Function f) const;
+
+	template< typename Function >
+	Matrix& apply(Function f);
+
+	// result(i, j) = f(left(i, j), right(i, j))
+	template< typename Function >
+	static const Matrix zipWith(const Matrix& left, const Matrix& right, Function f);
+	// =================================================================================
+
+	// =================================================================================
+	// Операции с распространением (broadcasting): вектор-строка применяется к каждой
+	// строке, вектор-столбец - к каждому столбцу матрицы за один проход, без
+	// построения матрицы из повторенного вектора. Длина вектора-строки должна
+	// совпадать с количеством столбцов, вектора-столбца - с количеством строк,
+	// иначе генерируется исключение с текстом "Size mismatch". Если в результате
+	// получены inf или NaN, генерируется исключение с текстом "Values are out of range".
+	// ---------------------------------------------------------------------------------
+	enum BroadcastOperation { Add, Subtract, Multiply, Divide };
+
+	// this(i, j) = this(i, j) op row[j]
+	Matrix& broadcastRow(BroadcastOperation operation, const Vector& row);
+
+	// this(i, j) = this(i, j) op column[i]
+	Matrix& broadcastColumn(BroadcastOperation operation, const Vector& column);
+
+	// Те же операции с записью в новую матрицу
+	friend const Matrix broadcastRow(const Matrix& m, BroadcastOperation operation, const Vector& row);
+	friend const Matrix broadcastColumn(const Matrix& m, BroadcastOperation operation, const Vector& column);
+	// =================================================================================
+
+	// =================================================================================
+	// Составление матриц из частей. Строки и блоки строк копируются целиком
+	// (memcpy), большие матрицы - параллельно.
+	// ---------------------------------------------------------------------------------
+	// Объединение по горизонтали (количество строк частей должно совпадать) и по
+	// вертикали (должно совпадать количество столбцов), иначе генерируется
+	// исключение с текстом "Size mismatch". Для пустого набора частей - с текстом
+	// "Invalid dimensions".
+	friend const Matrix hstack(const std::vector< Matrix >& parts);
+	friend const Matrix vstack(const std::vector< Matrix >& parts);
+
+	// Изменение размеров с сохранением порядка элементов (построчно) за O(1):
+	// элементы хранятся непрерывно, поэтому меняются только размеры. reshaped
+	// возвращает копию (в режиме copy-on-write - также за O(1)). Если количество
+	// элементов не совпадает, генерируется исключение с текстом "Size mismatch",
+	// при неположительных размерах - с текстом "Invalid dimensions".
+	Matrix& reshape(int rows, int cols);
+	const Matrix reshaped(int rows, int cols) const;
+
+	// Выборка строк: result(k, :) = this(indices[k], :). Номера могут повторяться.
+	// При некорректном номере генерируется исключение с текстом "Out of range",
+	// для пустого набора номеров - с текстом "Invalid dimensions".
+	const Matrix selectRows(const std::vector< int >& indices) const;
+
+	// Запись строк: this(indices[k], :) = source(k, :). При повторяющихся номерах
+	// записывается строка source с наибольшим k. Количество строк source должно
+	// совпадать с количеством номеров, столбцов - с количеством столбцов матрицы,
+	// иначе генерируется исключение с текстом "Size mismatch"; при некорректном
+	// номере - с текстом "Out of range" (матрица при этом не изменяется).
+	Matrix& scatterRows(const std::vector< int >& indices, const Matrix& source);
+	// =================================================================================
+
     // Оператор присвоения
 	Matrix & operator=(const Matrix & right);
 
@@ -96,12 +307,132 @@ public:
 	// Глобальный оператор вывода содержимого матрицы в стандартный поток. 
 	// Столбцы должны разделяться символами табуляции (\t), 
 	// строки - символами новой строки (\n).
-	friend std::ostream& operator << (std::ostream &stream, Matrix& m);
+	friend std::ostream& operator << (std::ostream &stream, const Matrix& m);
 
 	int getNumRows(void) const;
 
 	int getNumColumns(void) const;
 
+	// =================================================================================
+	// Редукции. Суммы вычисляются попарным суммированием, большие матрицы 
+	// обрабатываются параллельно.
+	// ---------------------------------------------------------------------------------
+	// Сумма всех элементов
+	double sum() const;
+
+	// Минимальный и максимальный элементы. Для пустой (перемещенной) матрицы 
+	// генерируется исключение с текстом "Invalid dimensions".
+	double minElement() const;
+	double maxElement() const;
+
+	// Норма Фробениуса: корень из суммы квадратов элементов
+	double normFrobenius() const;
+
+	// Норма 1: максимальная сумма модулей по столбцам (0 для пустой матрицы)
+	double norm1() const;
+
+	// Норма бесконечность: максимальная сумма модулей по строкам (0 для пустой матрицы)
+	double normInf() const;
+
+	// След квадратной матрицы (сумма Кэхэна по диагонали). 
+	// Для неквадратной матрицы генерируется исключение с текстом "Size mismatch".
+	double trace() const;
+
+	// Суммы и средние значения по строкам (длина результата - количество строк)
+	// и по столбцам (длина - количество столбцов)
+	Vector rowSums() const;
+	Vector rowMeans() const;
+	Vector columnSums() const;
+	Vector columnMeans() const;
+
+	// Номер столбца максимального элемента каждой строки и номер строки
+	// максимального элемента каждого столбца. Среди равных выбирается наименьший
+	// номер, NaN пропускаются (для строки или столбца из одних NaN - 0).
+	std::vector< int > rowArgMax() const;
+	std::vector< int > columnArgMax() const;
+	// =================================================================================
+
+	// =================================================================================
+	// Режим copy-on-write
+	// ---------------------------------------------------------------------------------
+	// При включенном режиме копирование матрицы выполняется за O(1): копия разделяет
+	// буфер с оригиналом, а собственная копия элементов создается при первой записи
+	// через неконстантный operator[] или модифицирующие операторы (+=, -=, *=).
+	// Внимание: ссылки double&, полученные до копирования, продолжают указывать 
+	// в общий буфер, поэтому режим включается явно.
+	static void setCopyOnWrite(bool enabled);
+	static bool isCopyOnWrite();
+
+	// Возвращает true, если буфер матрицы в данный момент разделяется с другими матрицами
+	bool isShared() const;
+
+	// =================================================================================
+	// Воспроизводимый режим
+	// ---------------------------------------------------------------------------------
+	// Суммы, нормы, операторы * и + дают побитово одинаковый результат при любом 
+	// количестве потоков и на любой машине с IEEE-754 double: редукции выполняются
+	// фиксированным деревом по 8 дорожкам, разбиение на блоки не зависит от 
+	// количества потоков, умножение и сложение не сливаются в FMA. Умножение со
+	// смешанной точностью в этом режиме всегда накапливает произведения в double.
+	// Начальное значение задается переменной окружения MATRIX_REPRODUCIBLE=1.
+	static void setReproducible(bool enabled);
+	static bool isReproducible();
+	// =================================================================================
+
+	// =================================================================================
+	// Умножение со смешанной точностью
+	// ---------------------------------------------------------------------------------
+	// Сомножители округляются до float или bfloat16 (эмулируется на float).
+	// AccumulateDouble (по умолчанию): произведения округленных сомножителей 
+	// накапливаются в double без ошибки накопления - по стоимости это обычное
+	// умножение в double.
+	// AccumulateFloat: упакованные блоки умножаются микроядром на пакетах float,
+	// суммы накапливаются в float внутри блоков и в double между блоками; за счет
+	// вдвое более широких пакетов это в несколько раз быстрее умножения в double,
+	// но ошибка накопления в float (порядка единицы округления float) остается.
+	// Каждый шаг уточнения (refinementSteps) добавляет произведения остатков 
+	// округления: шаг s - s + 1 умножений поправок, которые в обоих режимах
+	// выполняются микроядром float, поэтому первый шаг дешевле умножения в 
+	// double. С AccumulateDouble одного шага для float достаточно для точности
+	// double.
+	enum Precision { DoublePrecision, SinglePrecision, BFloat16Precision };
+	enum Accumulation { AccumulateDouble, AccumulateFloat };
+
+	struct MixedPrecision
+	{
+		Precision precision;
+		Accumulation accumulation;
+		int refinementSteps;
+	};
+
+	// Точность, используемая оператором * для матриц общего вида 
+	// (по умолчанию DoublePrecision - обычное умножение в double)
+	static void setMultiplyPrecision(Precision precision, 
+	                                 Accumulation accumulation = AccumulateDouble,
+	                                 int refinementSteps = 0);
+	static MixedPrecision getMultiplyPrecision();
+
+	// Достигнутая точность относительно умножения в double
+	struct AccuracyReport
+	{
+		double maxAbsError;       // max |C - C_double|
+		double relativeError;     // ||C - C_double||_F / ||C_double||_F
+		double unitRoundoff;      // единица округления формата сомножителей
+	};
+
+	// Произведение с заданной точностью независимо от глобальной настройки.
+	// Если передан report, дополнительно вычисляется произведение в double
+	// и заполняется отчет о точности.
+	static const Matrix multiplyMixed(const Matrix& left, const Matrix& right,
+	                                  Precision precision,
+	                                  Accumulation accumulation = AccumulateDouble,
+	                                  int refinementSteps = 0,
+	                                  AccuracyReport * report = nullptr);
+	// =================================================================================
+
+	// Асинхронные операции над матрицами (см. matrix_async.hpp)
+	struct async;
+
 /*------------------------------------------------------------------*/
 
 	template< typename _MatrixType >
@@ -114,6 +445,10 @@ public:
 			:	m_matrix( _matrix )
 			,	m_rowIndex( _rowIndex )
 		{}
+
+		// Для константной матрицы запись через аксессор невозможна: элемент
+		// возвращается по значению, чтобы не изменить разделяемый буфер
+		typedef typename std::conditional< std::is_const< _MatrixType >::value, double, double& >::type Reference;
             
 		// Операторы индексной выборки - версии для чтения и для записи
 		double operator[] (int _columnIndex) const
@@ -122,17 +457,19 @@ public:
             {
                 throw new Matrix::OutOfRangeException();
             }
-            return this->m_matrix.matrix[this->m_rowIndex][_columnIndex];
+            return this->m_matrix.data[ 
+                    static_cast< std::size_t >(this->m_rowIndex) * this->m_matrix.cols + _columnIndex ];
         }
         
         
-		double& operator[] (int _columnIndex)
+		Reference operator[] (int _columnIndex)
         {
             if (!this->m_matrix.isColInRange(_columnIndex))
             {
                 throw new Matrix::OutOfRangeException();
             }
-            return this->m_matrix.matrix[this->m_rowIndex][_columnIndex];
+            return this->m_matrix.data[ 
+                    static_cast< std::size_t >(this->m_rowIndex) * this->m_matrix.cols + _columnIndex ];
         }
 	};
     
@@ -141,10 +478,52 @@ public:
 
 	template< typename > friend class MatrixRowAccessor;
 
+	// Векторные ядра работают непосредственно с буфером матрицы
+	friend class Vector;
+
+	// Структурированные матрицы (см. structured.hpp) используют буфер как плотное хранилище
+	friend class DiagonalMatrix;
+	friend class TriangularMatrix;
+	friend class SymmetricMatrix;
+	friend class BandedMatrix;
+
+	// Матричная экспонента решает систему LU-разложением непосредственно в буфере
+	friend Matrix expm(const Matrix & A);
+
+	// Спектральные разложения (см. matrix_spectral.hpp) читают буфер без копирования по элементам
+	friend SymmetricEigen eigenSymmetric(const Matrix & A);
+	friend SingularValueDecomposition svd(const Matrix & A);
+	friend SingularValueDecomposition randomizedSvd(const Matrix & A, int rank, int oversampling,
+	                                                int powerIterations, unsigned long long seed);
+	friend Matrix orthonormalBasis(const Matrix & Y);
+
+	// Операторы случайного сжатия (см. matrix_sketch.hpp) применяются к буферу напрямую
+	friend class Sketch;
+
+	// Распределенное умножение (см. matrix_distributed.hpp) копирует блоки буфера в общую память
+	friend class DistributedMatrix;
+
+	// Сжатое хранение (см. matrix_compressed.hpp) кодирует и распаковывает буфер поблочно
+	friend class CompressedMatrix;
+
+	// Свертка (см. matrix_convolution.hpp) раскладывает окна буфера и пишет результат напрямую
+	friend class Convolution;
+
+	// Инкрементальные обновления (см. matrix_incremental.hpp) разлагают буфер на месте
+	friend class UpdatableInverse;
+	friend class CholeskyFactorization;
+
+	// Кэш произведений (см. matrix_cache.hpp) хэширует буфер и выдает разделяемые результаты
+	friend class ProductCache;
+
+	// Разбиение на тайлы (см. matrix_tiles.hpp) выдает представления фрагментов буфера
+	template< typename > friend class BasicTiling;
+
 /*------------------------------------------------------------------*/
 
 	// Операторы индексной выборки для чтения и для записи. При попытке доступа по 
 	// некорректному номеру строки или столбца должно генерироваться исключение с текстом "Out of range".
+	// Неконстантная версия отделяет собственный буфер в режиме copy-on-write.
 	//MatrixRowAccessor<double>& operator[ ](int row) {}
 	MatrixRowAccessor< const Matrix > operator[] (int _rowIndex) const;
 
@@ -218,8 +597,90 @@ public:
         SizeMismatchException(std::string func, unsigned int line, std::string file) 
             : Exception("Size mismatch", func, line, file) {}
     };
+
+    struct SingularMatrixException : Matrix::Exception
+    {
+        SingularMatrixException() : Exception("Singular matrix") {}
+        SingularMatrixException(std::string func, unsigned int line, std::string file) 
+            : Exception("Singular matrix", func, line, file) {}
+    };
+
+    struct ProcessFailedException : Matrix::Exception
+    {
+        ProcessFailedException() : Exception("Process failed") {}
+        ProcessFailedException(std::string func, unsigned int line, std::string file) 
+            : Exception("Process failed", func, line, file) {}
+    };
+
+    struct CorruptedDataException : Matrix::Exception
+    {
+        CorruptedDataException() : Exception("Corrupted data") {}
+        CorruptedDataException(std::string func, unsigned int line, std::string file) 
+            : Exception("Corrupted data", func, line, file) {}
+    };
+
+    struct BlockingWaitException : Matrix::Exception
+    {
+        BlockingWaitException() : Exception("Blocking wait in worker thread") {}
+        BlockingWaitException(std::string func, unsigned int line, std::string file) 
+            : Exception("Blocking wait in worker thread", func, line, file) {}
+    };
 };
 
 /*****************************************************************************/
 
+template< typename Function >
+const Matrix Matrix::map(Function f) const
+{
+	Matrix result(this->rows, this->cols, Matrix::uninitialized);
+	const double * source = this->data;
+	double * target = result.data;
+	forEachRowBlock(this->rows, this->cols, [&] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t i = from; i < to; i++)
+		{
+			target[i] = f(source[i]);
+		}
+	});
+	return result;
+}
+
+template< typename Function >
+Matrix& Matrix::apply(Function f)
+{
+	this->detach();
+	double * target = this->data;
+	forEachRowBlock(this->rows, this->cols, [&] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t i = from; i < to; i++)
+		{
+			target[i] = f(target[i]);
+		}
+	});
+	return *this;
+}
+
+template< typename Function >
+const Matrix Matrix::zipWith(const Matrix& left, const Matrix& right, Function f)
+{
+	if (left.rows != right.rows || left.cols != right.cols)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(left.rows, left.cols, Matrix::uninitialized);
+	const double * a = left.data;
+	const double * b = right.data;
+	double * target = result.data;
+	forEachRowBlock(left.rows, left.cols, [&] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t i = from; i < to; i++)
+		{
+			target[i] = f(a[i], b[i]);
+		}
+	});
+	return result;
+}
+
+/*****************************************************************************/
+
 #endif //  _MATRIX_HPP_
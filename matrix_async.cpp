@@ -0,0 +1,289 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_async.hpp"
+#include "threadpool.hpp"
+
+using MatrixAsyncDetail::Node;
+
+// =================================================================================
+// Планировщик графа задач
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+void launch ( std::shared_ptr< Node > const & _node );
+
+// Отмечает узел завершенным и запускает зависимые узлы, у которых
+// больше не осталось незавершенных входов
+void complete ( std::shared_ptr< Node > const & _node )
+{
+    std::vector< std::shared_ptr< Node > > dependents;
+    std::vector< std::function< void () > > continuations;
+    {
+        std::lock_guard< std::mutex > lock( _node->mutex );
+        _node->done = true;
+        _node->inputs.clear();
+        dependents.swap( _node->dependents );
+        continuations.swap( _node->continuations );
+    }
+    _node->finished.notify_all();
+
+    for ( std::size_t i = 0; i < dependents.size(); i++ )
+    {
+        bool ready;
+        {
+            std::lock_guard< std::mutex > lock( dependents[ i ]->mutex );
+            ready = ( -- dependents[ i ]->pendingInputs == 0 );
+        }
+        if ( ready )
+        {
+            launch( dependents[ i ] );
+        }
+    }
+    for ( std::size_t i = 0; i < continuations.size(); i++ )
+    {
+        continuations[ i ]();
+    }
+}
+
+// Выполняет операцию узла. Ошибка любого входа передается узлу без вычисления.
+void run ( std::shared_ptr< Node > const & _node )
+{
+    std::vector< const Matrix * > arguments;
+    for ( std::size_t i = 0; i < _node->inputs.size() && ! _node->error; i++ )
+    {
+        if ( _node->inputs[ i ]->error )
+        {
+            _node->error = _node->inputs[ i ]->error;
+        }
+        else
+        {
+            arguments.push_back( _node->inputs[ i ]->result.get() );
+        }
+    }
+
+    if ( ! _node->error )
+    {
+        try
+        {
+            _node->result.reset( new Matrix( _node->compute( arguments ) ) );
+        }
+        catch ( ... )
+        {
+            _node->error = std::current_exception();
+        }
+    }
+    _node->compute = nullptr;
+    complete( _node );
+}
+
+void launch ( std::shared_ptr< Node > const & _node )
+{
+    std::shared_ptr< Node > node = _node;
+    ThreadPool::instance().submit( [ node ] { run( node ); } );
+}
+
+// Завершенный узел с готовой матрицей
+std::shared_ptr< Node > makeReadyNode ( const Matrix & _matrix )
+{
+    std::shared_ptr< Node > node = std::make_shared< Node >();
+    node->result.reset( new Matrix( _matrix ) );
+    node->pendingInputs = 0;
+    node->done = true;
+    return node;
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// MatrixFuture
+// ---------------------------------------------------------------------------------
+MatrixFuture::MatrixFuture ()
+{
+}
+
+MatrixFuture::MatrixFuture ( std::shared_ptr< Node > _node )
+    :   m_node( _node )
+{
+}
+
+bool MatrixFuture::isReady () const
+{
+    if ( ! m_node )
+    {
+        return false;
+    }
+    std::lock_guard< std::mutex > lock( m_node->mutex );
+    return m_node->done;
+}
+
+void MatrixFuture::wait () const
+{
+    if ( ! m_node )
+    {
+        throw new Matrix::BadDataPtrException( __func__, __LINE__, __FILE__ );
+    }
+    std::unique_lock< std::mutex > lock( m_node->mutex );
+    if ( ! m_node->done && ThreadPool::isWorkerThread() )
+    {
+        throw new Matrix::BlockingWaitException( __func__, __LINE__, __FILE__ );
+    }
+    m_node->finished.wait( lock, [ this ] { return m_node->done; } );
+}
+
+const Matrix & MatrixFuture::get () const
+{
+    wait();
+    if ( m_node->error )
+    {
+        std::rethrow_exception( m_node->error );
+    }
+    return * m_node->result;
+}
+
+void MatrixFuture::onReady ( std::function< void () > _callback ) const
+{
+    if ( ! m_node )
+    {
+        throw new Matrix::BadDataPtrException( __func__, __LINE__, __FILE__ );
+    }
+    {
+        std::lock_guard< std::mutex > lock( m_node->mutex );
+        if ( ! m_node->done )
+        {
+            m_node->continuations.push_back( std::move( _callback ) );
+            return;
+        }
+    }
+    _callback();
+}
+// =================================================================================
+
+
+// =================================================================================
+// Операции
+// ---------------------------------------------------------------------------------
+Matrix::async::Operand::Operand ( const Matrix & _matrix )
+    :   m_node( makeReadyNode( _matrix ) )
+{
+}
+
+Matrix::async::Operand::Operand ( const MatrixFuture & _future )
+    :   m_node( _future.m_node )
+{
+    if ( ! m_node )
+    {
+        throw new Matrix::BadDataPtrException( __func__, __LINE__, __FILE__ );
+    }
+}
+
+MatrixFuture Matrix::async::schedule ( 
+        std::function< Matrix ( std::vector< const Matrix * > const & ) > _compute
+    ,   std::vector< Operand > const & _inputs 
+)
+{
+    std::shared_ptr< Node > node = std::make_shared< Node >();
+    node->compute = _compute;
+    node->done = false;
+    // Дополнительная единица не дает запустить узел, пока регистрируются входы
+    node->pendingInputs = _inputs.size() + 1;
+
+    for ( std::size_t i = 0; i < _inputs.size(); i++ )
+    {
+        std::shared_ptr< Node > const & input = _inputs[ i ].m_node;
+        node->inputs.push_back( input );
+
+        bool inputDone;
+        {
+            std::lock_guard< std::mutex > lock( input->mutex );
+            inputDone = input->done;
+            if ( ! inputDone )
+            {
+                input->dependents.push_back( node );
+            }
+        }
+        if ( inputDone )
+        {
+            std::lock_guard< std::mutex > lock( node->mutex );
+            -- node->pendingInputs;
+        }
+    }
+
+    bool ready;
+    {
+        std::lock_guard< std::mutex > lock( node->mutex );
+        ready = ( -- node->pendingInputs == 0 );
+    }
+    if ( ready )
+    {
+        launch( node );
+    }
+    return MatrixFuture( node );
+}
+
+MatrixFuture Matrix::async::multiply ( Operand _left, Operand _right )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _left );
+    inputs.push_back( _right );
+    return schedule( [] ( std::vector< const Matrix * > const & args ) { return Matrix( * args[ 0 ] * * args[ 1 ] ); }, inputs );
+}
+
+MatrixFuture Matrix::async::add ( Operand _left, Operand _right )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _left );
+    inputs.push_back( _right );
+    return schedule( [] ( std::vector< const Matrix * > const & args ) { return Matrix( * args[ 0 ] + * args[ 1 ] ); }, inputs );
+}
+
+MatrixFuture Matrix::async::subtract ( Operand _left, Operand _right )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _left );
+    inputs.push_back( _right );
+    return schedule( [] ( std::vector< const Matrix * > const & args ) { return Matrix( * args[ 0 ] - * args[ 1 ] ); }, inputs );
+}
+
+MatrixFuture Matrix::async::scale ( Operand _m, double _multiplier )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _m );
+    return schedule( [ _multiplier ] ( std::vector< const Matrix * > const & args ) { return Matrix( * args[ 0 ] * _multiplier ); }, inputs );
+}
+
+MatrixFuture Matrix::async::gemm ( 
+        double _alpha, Operand _A, Operand _B, double _beta, Operand _C
+    ,   TransposeFlag _transA, TransposeFlag _transB 
+)
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _A );
+    inputs.push_back( _B );
+    inputs.push_back( _C );
+    return schedule( 
+        [ = ] ( std::vector< const Matrix * > const & args ) 
+        { 
+            Matrix result( * args[ 2 ] );
+            result.gemm( _alpha, * args[ 0 ], * args[ 1 ], _beta, _transA, _transB );
+            return result;
+        }, inputs );
+}
+
+MatrixFuture Matrix::async::apply ( UnaryFunction _function, Operand _input )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _input );
+    return schedule( [ _function ] ( std::vector< const Matrix * > const & args ) { return _function( * args[ 0 ] ); }, inputs );
+}
+
+MatrixFuture Matrix::async::apply ( BinaryFunction _function, Operand _left, Operand _right )
+{
+    std::vector< Operand > inputs;
+    inputs.push_back( _left );
+    inputs.push_back( _right );
+    return schedule( [ _function ] ( std::vector< const Matrix * > const & args ) { return _function( * args[ 0 ], * args[ 1 ] ); }, inputs );
+}
+// =================================================================================
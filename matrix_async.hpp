@@ -0,0 +1,165 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_ASYNC_HPP_
+#define _MATRIX_ASYNC_HPP_
+
+/*****************************************************************************/
+
+#include "matrix.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined( __cpp_impl_coroutine ) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define MATRIX_HAVE_COROUTINES 1
+#endif
+
+/*****************************************************************************/
+
+// Асинхронные операции над матрицами. Каждая операция становится узлом графа 
+// задач (DAG): узел запускается на внутреннем пуле потоков, как только готовы
+// все его входы - матрицы или результаты других асинхронных операций. 
+// Независимые узлы выполняются одновременно, зависимые - строго после своих входов.
+//
+//     MatrixFuture ab = Matrix::async::multiply( a, b );
+//     MatrixFuture cd = Matrix::async::multiply( c, d );   // параллельно с ab
+//     MatrixFuture r  = Matrix::async::add( ab, cd );      // после ab и cd
+//     const Matrix & result = r.get();
+//
+// Входные матрицы копируются в момент постановки операции (в режиме 
+// copy-on-write - за O(1)), поэтому их можно изменять сразу после вызова.
+// Ядра внутри узла распараллеливаются на том же пуле: свободные потоки 
+// присоединяются к узлу, поэтому одиночное умножение использует все ядра, а
+// независимые узлы делят потоки между собой.
+//
+// Функции узлов и обратные вызовы onReady выполняются в рабочих потоках и не
+// должны ожидать незавершенные операции: поток пула, заблокированный в get(),
+// может оказаться нужен самой ожидаемой операции. Такое ожидание отклоняется
+// исключением с текстом "Blocking wait in worker thread"; зависимость следует
+// передавать как вход операции.
+
+class MatrixFuture;
+
+namespace MatrixAsyncDetail
+{
+
+// Узел графа задач
+struct Node
+{
+    std::function< Matrix ( std::vector< const Matrix * > const & ) > compute;
+    std::vector< std::shared_ptr< Node > > inputs;
+    std::vector< std::shared_ptr< Node > > dependents;
+    std::vector< std::function< void () > > continuations;
+
+    std::unique_ptr< Matrix > result;
+    std::exception_ptr error;
+    std::size_t pendingInputs;
+    bool done;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+} // namespace MatrixAsyncDetail
+
+/*****************************************************************************/
+
+// Будущий результат асинхронной операции
+class MatrixFuture
+{
+
+/*-----------------------------------------------------------------*/
+
+public:
+
+    MatrixFuture ();
+
+    // Готов ли результат (операция завершена успешно или с исключением)
+    bool isReady () const;
+
+    // Ожидает завершения операции. В рабочем потоке пула (в функции узла или
+    // обратном вызове) ожидание незавершенной операции генерирует исключение
+    // с текстом "Blocking wait in worker thread".
+    void wait () const;
+
+    // Ожидает завершения и возвращает результат. Исключение, выброшенное 
+    // операцией или одним из ее входов, перевыбрасывается здесь.
+    const Matrix & get () const;
+
+    // Вызывает _callback после завершения операции (сразу, если она уже завершена).
+    // Обратный вызов выполняется в потоке, завершившем операцию.
+    void onReady ( std::function< void () > _callback ) const;
+
+#if defined( MATRIX_HAVE_COROUTINES )
+    // Поддержка co_await: сопрограмма возобновляется после завершения операции
+    // в потоке, который ее завершил. Результат возвращается копией, так как 
+    // временный MatrixFuture в выражении co_await не переживает его.
+    bool await_ready () const { return isReady(); }
+    void await_suspend ( std::coroutine_handle<> _handle ) const { onReady( [ _handle ] { _handle.resume(); } ); }
+    Matrix await_resume () const { return get(); }
+#endif
+
+/*-----------------------------------------------------------------*/
+
+private:
+
+    friend struct Matrix::async;
+
+    explicit MatrixFuture ( std::shared_ptr< MatrixAsyncDetail::Node > _node );
+
+    std::shared_ptr< MatrixAsyncDetail::Node > m_node;
+
+/*-----------------------------------------------------------------*/
+
+};
+
+/*****************************************************************************/
+
+struct Matrix::async
+{
+    // Вход асинхронной операции: готовая матрица или результат другой операции
+    class Operand
+    {
+    public:
+        Operand ( const Matrix & _matrix );
+        Operand ( const MatrixFuture & _future );
+
+    private:
+        friend struct Matrix::async;
+        std::shared_ptr< MatrixAsyncDetail::Node > m_node;
+    };
+
+    typedef std::function< Matrix ( const Matrix & ) > UnaryFunction;
+    typedef std::function< Matrix ( const Matrix &, const Matrix & ) > BinaryFunction;
+
+    static MatrixFuture multiply ( Operand _left, Operand _right );
+    static MatrixFuture add ( Operand _left, Operand _right );
+    static MatrixFuture subtract ( Operand _left, Operand _right );
+    static MatrixFuture scale ( Operand _m, double _multiplier );
+
+    // alpha * op(A) * op(B) + beta * C
+    static MatrixFuture gemm ( 
+            double _alpha, Operand _A, Operand _B, double _beta, Operand _C
+        ,   TransposeFlag _transA = NoTrans, TransposeFlag _transB = NoTrans 
+    );
+
+    // Произвольные пользовательские операции над одним или двумя входами
+    static MatrixFuture apply ( UnaryFunction _function, Operand _input );
+    static MatrixFuture apply ( BinaryFunction _function, Operand _left, Operand _right );
+
+private:
+
+    static MatrixFuture schedule ( 
+            std::function< Matrix ( std::vector< const Matrix * > const & ) > _compute
+        ,   std::vector< Operand > const & _inputs 
+    );
+};
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_ASYNC_HPP_
@@ -0,0 +1,232 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+// Замеры производительности операций над матрицами.
+// Сборка: g++ -std=c++11 -O2 -pthread matrix_bench.cpp <исходники библиотеки>
+// Количество потоков задается переменной окружения MATRIX_NUM_THREADS.
+
+#include "matrix.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <vector>
+
+/*****************************************************************************/
+
+// Минимальное время из нескольких повторов, в миллисекундах
+static double measure ( int _repeats, const std::function< void () > & _body )
+{
+	double best = 0.0;
+	for ( int r = 0; r < _repeats; r++ )
+	{
+		const auto start = std::chrono::steady_clock::now();
+		_body();
+		const std::chrono::duration< double, std::milli > elapsed = std::chrono::steady_clock::now() - start;
+		if ( r == 0 || elapsed.count() < best )
+		{
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+static Matrix benchMatrix ( int _rows, int _cols, int _seed )
+{
+	Matrix result( _rows, _cols );
+	for ( int i = 0; i < _rows; i++ )
+	{
+		for ( int j = 0; j < _cols; j++ )
+		{
+			result[ i ][ j ] = ( ( i * 131 + j * 71 + _seed * 17 ) % 1009 ) / 1009.0 - 0.5;
+		}
+	}
+	return result;
+}
+
+/*****************************************************************************/
+
+// Стоимость воспроизводимого режима относительно обычного
+static void benchReproducibleMode ()
+{
+	std::printf( "Reproducible mode cost (%d threads)\n", ThreadPool::instance().getNumThreads() );
+	std::printf( "%-24s %8s %12s %12s %8s\n", "operation", "n", "fast, ms", "repro, ms", "ratio" );
+
+	const int sizes[] = { 256, 512, 1024 };
+	for ( int n : sizes )
+	{
+		const Matrix a = benchMatrix( n, n, 1 );
+		const Matrix b = benchMatrix( n, n, 2 );
+		const Matrix c = benchMatrix( n, n, 3 );
+		const int repeats = n >= 1024 ? 3 : 5;
+		volatile double sink = 0.0;
+
+		struct Case
+		{
+			const char * name;
+			std::function< void () > body;
+		};
+		const Case cases[] = {
+			{ "operator*",      [ & ] { Matrix p = a * b; sink = sink + p[ 0 ][ 0 ]; } },
+			{ "operator+ chain", [ & ] { Matrix s = a + b + c + a; sink = sink + s[ 0 ][ 0 ]; } },
+			{ "sum",            [ & ] { sink = sink + a.sum(); } },
+			{ "normFrobenius",  [ & ] { sink = sink + a.normFrobenius(); } },
+			{ "normInf",        [ & ] { sink = sink + a.normInf(); } },
+		};
+
+		for ( const Case & benchCase : cases )
+		{
+			Matrix::setReproducible( false );
+			const double fast = measure( repeats, benchCase.body );
+			Matrix::setReproducible( true );
+			const double reproducible = measure( repeats, benchCase.body );
+			Matrix::setReproducible( false );
+			std::printf( "%-24s %8d %12.3f %12.3f %8.2f\n",
+			             benchCase.name, n, fast, reproducible, reproducible / fast );
+		}
+	}
+	std::printf( "\n" );
+}
+
+/*****************************************************************************/
+
+// Пропускная способность поэлементных операций в сравнении с триадой STREAM
+// (a = b + s * c над массивами double тем же пулом потоков). Байты считаются
+// как в STREAM: чтение источников и запись результата, без чтения строк
+// результата перед записью. "cached" - обычная запись, "streaming" - запись
+// в обход кэша (порог MatrixKernels::streamingThreshold() равен нулю).
+// operator+ и operator* включают выделение памяти под результат.
+static void benchStreaming ()
+{
+	std::printf( "Streaming element-wise operations (%d threads, LLC threshold %zu bytes)\n",
+	             ThreadPool::instance().getNumThreads(), MatrixKernels::streamingThreshold() );
+	std::printf( "%-24s %10s %14s %14s\n", "operation", "elements", "cached, GB/s", "streaming, GB/s" );
+
+	const std::size_t defaultThreshold = MatrixKernels::streamingThreshold();
+	const int sizes[] = { 1 << 18, 1 << 21, 1 << 23 };
+	for ( int n : sizes )
+	{
+		const int rows = 1024;
+		const int cols = n / rows;
+		std::vector< double > a( n ), b( n ), c( n );
+		for ( int i = 0; i < n; i++ )
+		{
+			b[ i ] = ( i * 131 % 1009 ) / 1009.0 - 0.5;
+			c[ i ] = 0.5 + ( i * 71 % 1013 ) / 1013.0;
+		}
+		Matrix x( rows, cols, b.data() );
+		const Matrix y( rows, cols, c.data() );
+		const double scalar = 3.0;
+		const int repeats = 5;
+		volatile double sink = 0.0;
+
+		struct Case
+		{
+			const char * name;
+			int arrays;
+			std::function< void () > body;
+		};
+		const Case cases[] = {
+			{ "STREAM triad", 3, [ & ] 
+				{ 
+					double * target = a.data();
+					const double * source1 = b.data();
+					const double * source2 = c.data();
+					ThreadPool::instance().parallelForStatic( 0, n, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4, 
+						[ = ] ( std::size_t from, std::size_t to )
+						{
+							for ( std::size_t i = from; i < to; i++ )
+							{
+								target[ i ] = source1[ i ] + scalar * source2[ i ];
+							}
+						} );
+					sink = sink + a[ 0 ];
+				} },
+			{ "operator+",    3, [ & ] { Matrix s = x + y; sink = sink + s[ 0 ][ 0 ]; } },
+			{ "operator-",    3, [ & ] { Matrix s = x - y; sink = sink + s[ 0 ][ 0 ]; } },
+			{ "operator*",    2, [ & ] { Matrix s = x * scalar; sink = sink + s[ 0 ][ 0 ]; } },
+			{ "operator+=",   3, [ & ] { x += y; sink = sink + x[ 0 ][ 0 ]; } },
+			{ "operator-=",   3, [ & ] { x -= y; sink = sink + x[ 0 ][ 0 ]; } },
+		};
+
+		const double megabytes = static_cast< double >( n ) * sizeof( double ) / 1e6;
+		for ( const Case & benchCase : cases )
+		{
+			MatrixKernels::setStreamingThreshold( std::numeric_limits< std::size_t >::max() );
+			const double cached = measure( repeats, benchCase.body );
+			MatrixKernels::setStreamingThreshold( 0 );
+			const double streaming = measure( repeats, benchCase.body );
+			MatrixKernels::setStreamingThreshold( defaultThreshold );
+			std::printf( "%-24s %10d %14.2f %14.2f\n", benchCase.name, n, 
+			             benchCase.arrays * megabytes / cached, benchCase.arrays * megabytes / streaming );
+		}
+	}
+	std::printf( "\n" );
+}
+
+/*****************************************************************************/
+
+// Умножение со смешанной точностью в сравнении с умножением в double:
+// время, ускорение и относительная ошибка (отчет multiplyMixed)
+static void benchMixedPrecision ()
+{
+	std::printf( "Mixed-precision multiply vs double (%d threads)\n", ThreadPool::instance().getNumThreads() );
+	std::printf( "%-28s %6s %10s %10s %8s %12s\n", "mode", "n", "double, ms", "mixed, ms", "speedup", "rel. error" );
+
+	struct Mode
+	{
+		const char * name;
+		Matrix::Precision precision;
+		Matrix::Accumulation accumulation;
+		int refinementSteps;
+	};
+	const Mode modes[] = {
+		{ "float, float accumulation",  Matrix::SinglePrecision,   Matrix::AccumulateFloat,  0 },
+		{ "bf16, float accumulation",   Matrix::BFloat16Precision, Matrix::AccumulateFloat,  0 },
+		{ "bf16, float acc., 1 step",   Matrix::BFloat16Precision, Matrix::AccumulateFloat,  1 },
+		{ "float, double accumulation", Matrix::SinglePrecision,   Matrix::AccumulateDouble, 0 },
+		{ "float, double acc., 1 step", Matrix::SinglePrecision,   Matrix::AccumulateDouble, 1 },
+	};
+
+	const int sizes[] = { 256, 512, 1024 };
+	for ( int n : sizes )
+	{
+		const Matrix a = benchMatrix( n, n, 1 );
+		const Matrix b = benchMatrix( n, n, 2 );
+		const int repeats = n >= 1024 ? 3 : 5;
+		volatile double sink = 0.0;
+
+		const double reference = measure( repeats, [ & ] 
+		{
+			Matrix p = Matrix::multiplyMixed( a, b, Matrix::DoublePrecision );
+			sink = sink + p[ 0 ][ 0 ];
+		} );
+		for ( const Mode & mode : modes )
+		{
+			const double mixed = measure( repeats, [ & ] 
+			{
+				Matrix p = Matrix::multiplyMixed( a, b, mode.precision, mode.accumulation, mode.refinementSteps );
+				sink = sink + p[ 0 ][ 0 ];
+			} );
+			Matrix::AccuracyReport report;
+			Matrix::multiplyMixed( a, b, mode.precision, mode.accumulation, mode.refinementSteps, &report );
+			std::printf( "%-28s %6d %10.3f %10.3f %8.2f %12.2e\n", 
+			             mode.name, n, reference, mixed, reference / mixed, report.relativeError );
+		}
+	}
+	std::printf( "\n" );
+}
+
+/*****************************************************************************/
+
+int main ()
+{
+	benchReproducibleMode();
+	benchStreaming();
+	benchMixedPrecision();
+	return 0;
+}
+
+/*****************************************************************************/
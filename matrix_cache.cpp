@@ -0,0 +1,375 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_cache.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// =================================================================================
+// Хэш содержимого
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+typedef std::uint64_t Word;
+
+const Word PRIME32_1 = 0x9E3779B1ULL;
+const Word PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const Word PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const Word PRIME64_3 = 0x165667B19E3779F9ULL;
+const Word PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+
+// Ключевой материал: дорожка l полосы s использует SECRET[s % 16 + l],
+// поэтому перестановка полос внутри сегмента меняет хэш
+const Word SECRET[ 24 ] = {
+	0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+	0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL, 0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL,
+	0xCB00C391BB52283CULL, 0xA32E531B8B65D088ULL, 0x4EF90DA297486471ULL, 0xD8ACDEA946EF1938ULL,
+	0x3F349CE33F76FAA8ULL, 0x1D4F0BC7C7BBDCF9ULL, 0x3159B4CD4BE0518AULL, 0x647378D9C97E9FC8ULL,
+	0xC3EBD33483ACC5EAULL, 0xEB6313FAFFA081C5ULL, 0x49DAF0B751DD0D17ULL, 0x9E68D429265516D3ULL,
+	0xFCA1477D58BE162BULL, 0xCE31D07AD1B8F88FULL, 0x280416958F3ACB45ULL, 0x7E404BBBCAFBD7AFULL
+};
+
+// Полос (по 8 слов) между перемешиваниями аккумуляторов и слов в блоке,
+// хэшируемом одной задачей
+const std::size_t STRIPES_PER_SEGMENT = 16;
+const std::size_t HASH_BLOCK = std::size_t( 1 ) << 16;
+
+inline Word avalanche ( Word h )
+{
+	h ^= h >> 37;
+	h *= 0x165667919E3779F9ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+// Старшая и младшая половины 128-битного произведения, свернутые XOR
+inline Word multiplyFold ( Word a, Word b )
+{
+	const Word aLow = a & 0xFFFFFFFFULL, aHigh = a >> 32;
+	const Word bLow = b & 0xFFFFFFFFULL, bHigh = b >> 32;
+	const Word lowLow = aLow * bLow, highLow = aHigh * bLow, lowHigh = aLow * bHigh, highHigh = aHigh * bHigh;
+	const Word cross = ( lowLow >> 32 ) + ( highLow & 0xFFFFFFFFULL ) + lowHigh;
+	const Word high = highHigh + ( highLow >> 32 ) + ( cross >> 32 );
+	const Word low = ( cross << 32 ) | ( lowLow & 0xFFFFFFFFULL );
+	return high ^ low;
+}
+
+// Полоса из 8 слов: acc[l] += w + lo32(w ^ s) * hi32(w ^ s). Дорожки
+// независимы, поэтому цикл векторизуется (умножение 32 x 32 -> 64).
+inline void accumulateStripe ( Word * acc, const Word * words, const Word * secret )
+{
+	for ( int l = 0; l < 8; l++ )
+	{
+		const Word key = words[ l ] ^ secret[ l ];
+		acc[ l ] += words[ l ] + ( key & 0xFFFFFFFFULL ) * ( key >> 32 );
+	}
+}
+
+inline void scramble ( Word * acc )
+{
+	for ( int l = 0; l < 8; l++ )
+	{
+		acc[ l ] ^= acc[ l ] >> 47;
+		acc[ l ] ^= SECRET[ 16 + l ];
+		acc[ l ] *= PRIME32_1;
+	}
+}
+
+// 128-битный хэш count 64-битных слов (битовых представлений элементов)
+// с начальным значением seed. Слова копируются через memcpy, что
+// компилируется в обычные загрузки без нарушения правил алиасинга.
+ProductCache::Hash hashWords ( const void * data, std::size_t count, Word seed )
+{
+	const unsigned char * bytes = static_cast< const unsigned char * >( data );
+	Word acc[ 8 ] = { PRIME32_1, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_1 ^ seed, PRIME64_2 ^ seed, PRIME64_1 };
+	Word words[ 8 ];
+	std::size_t stripe = 0, i = 0;
+	const std::size_t segment = 8 * STRIPES_PER_SEGMENT;
+	for ( ; i + segment <= count; i += segment, stripe += STRIPES_PER_SEGMENT )
+	{
+		for ( std::size_t s = 0; s < STRIPES_PER_SEGMENT; s++ )
+		{
+			std::memcpy( words, bytes + ( i + 8 * s ) * sizeof( Word ), sizeof( words ) );
+			accumulateStripe( acc, words, SECRET + s );
+		}
+		scramble( acc );
+	}
+	for ( ; i + 8 <= count; i += 8, stripe++ )
+	{
+		std::memcpy( words, bytes + i * sizeof( Word ), sizeof( words ) );
+		accumulateStripe( acc, words, SECRET + stripe % STRIPES_PER_SEGMENT );
+	}
+	// Остаток дополняется нулями; длина учитывается при свертке
+	std::fill( words, words + 8, Word( 0 ) );
+	std::memcpy( words, bytes + i * sizeof( Word ), ( count - i ) * sizeof( Word ) );
+	accumulateStripe( acc, words, SECRET + stripe % STRIPES_PER_SEGMENT );
+	scramble( acc );
+
+	ProductCache::Hash result;
+	result.low = count * PRIME64_1 ^ seed;
+	result.high = ~count * PRIME64_2 ^ seed;
+	for ( int l = 0; l < 8; l += 2 )
+	{
+		result.low += multiplyFold( acc[ l ] ^ SECRET[ l ], acc[ l + 1 ] ^ SECRET[ l + 1 ] );
+		result.high += multiplyFold( acc[ l ] ^ SECRET[ 8 + l ], acc[ l + 1 ] ^ SECRET[ 9 + l ] );
+	}
+	result.low = avalanche( result.low );
+	result.high = avalanche( result.high );
+	return result;
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Сегменты кэша
+// ---------------------------------------------------------------------------------
+// Сегмент: очередь LRU (начало - последние использованные) и индекс по ключу
+struct ProductCacheShard
+{
+	typedef ProductCache::Key Key;
+
+	struct Entry
+	{
+		Key key;
+		Matrix result;
+		std::size_t bytes;
+	};
+
+	struct KeyHash
+	{
+		std::size_t operator() ( const Key & key ) const
+		{
+			return static_cast< std::size_t >( key.left.low ^ ( key.right.low * PRIME64_3 ) );
+		}
+	};
+
+	struct KeyEqual
+	{
+		bool operator() ( const Key & a, const Key & b ) const
+		{
+			return a.left.low == b.left.low && a.left.high == b.left.high
+			    && a.right.low == b.right.low && a.right.high == b.right.high
+			    && a.rows == b.rows && a.inner == b.inner && a.cols == b.cols && a.mode == b.mode;
+		}
+	};
+
+	std::mutex lock;
+	std::list< Entry > order;
+	std::unordered_map< Key, std::list< Entry >::iterator, KeyHash, KeyEqual > index;
+	std::size_t bytes = 0;
+
+	// Сегмент, которому принадлежит ключ
+	static ProductCacheShard & of ( const Key & key );
+
+	// Вытеснение с конца очереди, пока общий объем кэша больше capacity и в
+	// сегменте больше keep результатов. Вызывается под lock.
+	std::size_t trim ( std::size_t capacity, std::size_t keep = 0 );
+};
+
+namespace
+{
+
+std::size_t capacityFromEnvironment ()
+{
+	const char * value = std::getenv( "MATRIX_PRODUCT_CACHE_BYTES" );
+	return value != nullptr ? static_cast< std::size_t >( std::strtoull( value, nullptr, 10 ) ) : 0;
+}
+
+std::atomic< std::size_t > gs_capacity( capacityFromEnvironment() );
+std::atomic< std::size_t > gs_bytes( 0 );
+std::atomic< std::size_t > gs_hits( 0 );
+std::atomic< std::size_t > gs_misses( 0 );
+std::atomic< std::size_t > gs_evictions( 0 );
+
+ProductCacheShard gs_shards[ ProductCache::SHARDS ];
+
+} // namespace
+
+ProductCacheShard & ProductCacheShard::of ( const Key & key )
+{
+	return gs_shards[ ( key.left.high ^ key.right.high ) % ProductCache::SHARDS ];
+}
+
+std::size_t ProductCacheShard::trim ( std::size_t capacity, std::size_t keep )
+{
+	std::size_t evicted = 0;
+	while ( gs_bytes.load() > capacity && this->order.size() > keep )
+	{
+		this->bytes -= this->order.back().bytes;
+		gs_bytes.fetch_sub( this->order.back().bytes );
+		this->index.erase( this->order.back().key );
+		this->order.pop_back();
+		evicted++;
+	}
+	return evicted;
+}
+// =================================================================================
+
+
+// =================================================================================
+// ProductCache
+// ---------------------------------------------------------------------------------
+// Блоки по HASH_BLOCK слов хэшируются параллельно, затем хэшируется массив
+// хэшей блоков; разбиение не зависит от количества потоков
+ProductCache::Hash ProductCache::hash(const Matrix & m)
+{
+	const std::size_t count = m.elementCount();
+	const double * elements = m.data;
+	const Word shape = (static_cast< Word >(m.rows) << 32) | static_cast< Word >(m.cols);
+	if (count <= HASH_BLOCK)
+	{
+		return hashWords(elements, count, shape);
+	}
+
+	const std::size_t blocks = (count + HASH_BLOCK - 1) / HASH_BLOCK;
+	std::vector< Word > blockHashes(2 * blocks);
+	ThreadPool::instance().parallelFor(0, blocks, 1, [ & ] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t b = from; b < to; b++)
+		{
+			const std::size_t begin = b * HASH_BLOCK;
+			const Hash h = hashWords(elements + begin, std::min(count, begin + HASH_BLOCK) - begin, b);
+			blockHashes[2 * b] = h.low;
+			blockHashes[2 * b + 1] = h.high;
+		}
+	});
+	return hashWords(blockHashes.data(), blockHashes.size(), shape);
+}
+
+void ProductCache::setCapacity(std::size_t bytes)
+{
+	gs_capacity.store(bytes);
+	for (ProductCacheShard & shard : gs_shards)
+	{
+		std::lock_guard< std::mutex > guard(shard.lock);
+		gs_evictions.fetch_add(shard.trim(bytes));
+	}
+}
+
+std::size_t ProductCache::getCapacity()
+{
+	return gs_capacity.load();
+}
+
+void ProductCache::clear()
+{
+	for (ProductCacheShard & shard : gs_shards)
+	{
+		std::lock_guard< std::mutex > guard(shard.lock);
+		shard.trim(0);
+	}
+}
+
+ProductCache::Statistics ProductCache::getStatistics()
+{
+	Statistics stats;
+	stats.hits = gs_hits.load();
+	stats.misses = gs_misses.load();
+	stats.evictions = gs_evictions.load();
+	stats.entries = 0;
+	stats.bytes = 0;
+	for (ProductCacheShard & shard : gs_shards)
+	{
+		std::lock_guard< std::mutex > guard(shard.lock);
+		stats.entries += shard.order.size();
+		stats.bytes += shard.bytes;
+	}
+	return stats;
+}
+
+void ProductCache::resetStatistics()
+{
+	gs_hits.store(0);
+	gs_misses.store(0);
+	gs_evictions.store(0);
+}
+
+bool ProductCache::makeKey(const Matrix & left, const Matrix & right, Key & key)
+{
+	const std::size_t work = static_cast< std::size_t >(left.rows) * left.cols * right.cols;
+	if (gs_capacity.load(std::memory_order_relaxed) == 0 || work < MIN_WORK)
+	{
+		return false;
+	}
+	key.left = ProductCache::hash(left);
+	key.right = ProductCache::hash(right);
+	key.rows = left.rows;
+	key.inner = left.cols;
+	key.cols = right.cols;
+	// Настройки, от которых зависят биты результата
+	key.mode = Matrix::multiplyPrecision.load()
+	         | Matrix::multiplyAccumulation.load() << 4
+	         | Matrix::multiplyRefinementSteps.load() << 8
+	         | (Matrix::isReproducible() ? 1 : 0) << 24;
+	return true;
+}
+
+std::unique_ptr< Matrix > ProductCache::find(const Key & key)
+{
+	ProductCacheShard & shard = ProductCacheShard::of(key);
+	std::lock_guard< std::mutex > guard(shard.lock);
+	auto found = shard.index.find(key);
+	if (found == shard.index.end())
+	{
+		gs_misses.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	shard.order.splice(shard.order.begin(), shard.order, found->second);
+	gs_hits.fetch_add(1, std::memory_order_relaxed);
+	return std::unique_ptr< Matrix >(new Matrix(found->second->result, Matrix::Shared()));
+}
+
+void ProductCache::insert(const Key & key, const Matrix & result)
+{
+	const std::size_t bytes = result.elementCount() * sizeof(double);
+	const std::size_t capacity = gs_capacity.load();
+	if (bytes > capacity)
+	{
+		return;
+	}
+
+	ProductCacheShard & shard = ProductCacheShard::of(key);
+	{
+		std::lock_guard< std::mutex > guard(shard.lock);
+		// Произведение могло быть вычислено и добавлено другим потоком
+		if (shard.index.find(key) != shard.index.end())
+		{
+			return;
+		}
+		ProductCacheShard::Entry entry = { key, Matrix(result, Matrix::Shared()), bytes };
+		shard.order.push_front(std::move(entry));
+		shard.index[key] = shard.order.begin();
+		shard.bytes += bytes;
+		gs_bytes.fetch_add(bytes);
+		// Новый результат остается в сегменте
+		gs_evictions.fetch_add(shard.trim(capacity, 1), std::memory_order_relaxed);
+	}
+
+	// Места не хватило - вытесняются результаты других сегментов. Мьютексы
+	// захватываются по одному, поэтому взаимная блокировка невозможна.
+	for (ProductCacheShard & other : gs_shards)
+	{
+		if (gs_bytes.load() <= capacity)
+		{
+			break;
+		}
+		if (&other != &shard)
+		{
+			std::lock_guard< std::mutex > guard(other.lock);
+			gs_evictions.fetch_add(other.trim(capacity), std::memory_order_relaxed);
+		}
+	}
+}
+// =================================================================================
@@ -0,0 +1,100 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_CACHE_HPP_
+#define _MATRIX_CACHE_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <memory>
+
+// Кэш результатов оператора * для повторяющихся произведений. Ключ - 128-битные
+// хэши содержимого обоих сомножителей, их размеры и настройки умножения
+// (точность и воспроизводимый режим), поэтому результат берется из кэша только
+// для побитово тех же операндов. Хэш устроен как XXH3: восемь независимых
+// 64-битных дорожек с умножением 32 x 32 -> 64, которые компилятор
+// векторизует; блоки больших матриц хэшируются параллельно.
+//
+// Кэш разделен на SHARDS сегментов со своими мьютексами и очередями LRU.
+// Общий объем хранимых результатов ограничен capacity, и кэшируется любой
+// результат не больше capacity. При переполнении вытесняются давно 
+// использованные результаты сначала из сегмента нового результата, затем из
+// остальных сегментов (LRU внутри сегмента, а не по всему кэшу).
+// Результат из кэша разделяет буфер с хранимым экземпляром независимо от
+// глобального режима copy-on-write: первая запись в него создает собственную
+// копию, поэтому кэш не может быть изменен через выданные матрицы.
+//
+// Кэш выключен по умолчанию (capacity = 0); начальный объем в байтах задается
+// переменной окружения MATRIX_PRODUCT_CACHE_BYTES. Кэшируются только
+// произведения с m * n * k >= MIN_WORK - для меньших хэширование сопоставимо
+// по стоимости с умножением. Оператор *= использует кэш так же, как *.
+
+/*****************************************************************************/
+
+class ProductCache
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	static const int SHARDS = 16;
+	static const std::size_t MIN_WORK = std::size_t( 1 ) << 18;
+
+	// 128-битный хэш содержимого и размеров матрицы
+	struct Hash
+	{
+		unsigned long long low;
+		unsigned long long high;
+	};
+
+	// Счетчики с момента запуска (или resetStatistics) и текущее заполнение
+	struct Statistics
+	{
+		std::size_t hits;
+		std::size_t misses;
+		std::size_t evictions;
+		std::size_t entries;
+		std::size_t bytes;
+	};
+
+	static Hash hash(const Matrix & m);
+
+	// Объем кэша в байтах; 0 выключает кэш. При уменьшении лишние результаты
+	// вытесняются сразу.
+	static void setCapacity(std::size_t bytes);
+	static std::size_t getCapacity();
+
+	static void clear();
+
+	static Statistics getStatistics();
+
+	// Обнуление счетчиков попаданий, промахов и вытеснений
+	static void resetStatistics();
+
+private:
+	struct Key
+	{
+		Hash left;
+		Hash right;
+		int rows, inner, cols;
+		int mode;
+	};
+
+	// Ключ произведения left * right; false, если произведение не кэшируется
+	// (кэш выключен или произведение слишком мало)
+	static bool makeKey(const Matrix & left, const Matrix & right, Key & key);
+
+	// Поиск: при попадании - матрица, разделяющая буфер с кэшем, иначе nullptr.
+	// Вызывается до выделения памяти под результат.
+	static std::unique_ptr< Matrix > find(const Key & key);
+
+	static void insert(const Key & key, const Matrix & result);
+
+	friend const Matrix operator * (const Matrix & left, const Matrix & right);
+	friend Matrix & Matrix::operator *= (const Matrix & right);
+	friend struct ProductCacheShard;
+};
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_CACHE_HPP_
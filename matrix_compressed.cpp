@@ -0,0 +1,500 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_compressed.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+// =================================================================================
+// Кодек блока
+// ---------------------------------------------------------------------------------
+// Формат блока: байт предсказателя, затем для каждой из 8 байтовых плоскостей
+// байт режима, длина данных (4 байта) и сами данные.
+namespace
+{
+
+enum Predictor { PREDICT_XOR = 0, PREDICT_DELTA = 1 };
+enum PlaneMode { PLANE_RAW = 0, PLANE_RLE = 1 };
+
+const char MAGIC[ 4 ] = { 'C', 'M', 'X', '1' };
+
+// Наибольший размер блока: предсказатель и 8 несжатых плоскостей
+const std::size_t MAX_BLOCK_BYTES = 1 + 8 * (5 + CompressedMatrix::BLOCK_ELEMENTS);
+
+// Наименьший размер блока в файле: размер и контрольная сумма, предсказатель
+// и 8 плоскостей не короче одного байта данных
+const std::size_t MIN_STORED_BLOCK_BYTES = 8 + 1 + 8 * (5 + 1);
+
+// Остатки предсказания по предыдущему элементу. Целочисленная разность
+// переводится в zigzag-код, чтобы малые отрицательные разности тоже имели
+// нулевые старшие байты.
+void predict(Predictor predictor, const std::uint64_t * bits, std::size_t count, std::uint64_t * residuals)
+{
+	std::uint64_t previous = 0;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (predictor == PREDICT_XOR)
+		{
+			residuals[ i ] = bits[ i ] ^ previous;
+		}
+		else
+		{
+			const std::int64_t delta = static_cast< std::int64_t >(bits[ i ] - previous);
+			residuals[ i ] = (static_cast< std::uint64_t >(delta) << 1) ^ static_cast< std::uint64_t >(delta >> 63);
+		}
+		previous = bits[ i ];
+	}
+}
+
+void unpredict(Predictor predictor, const std::uint64_t * residuals, std::size_t count, std::uint64_t * bits)
+{
+	std::uint64_t previous = 0;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (predictor == PREDICT_XOR)
+		{
+			bits[ i ] = residuals[ i ] ^ previous;
+		}
+		else
+		{
+			const std::uint64_t delta = (residuals[ i ] >> 1) ^ (~(residuals[ i ] & 1) + 1);
+			bits[ i ] = previous + delta;
+		}
+		previous = bits[ i ];
+	}
+}
+
+// PackBits: управляющий байт n < 128 - далее n + 1 байт как есть,
+// n >= 128 - следующий байт повторяется n - 125 раз (от 3 до 130)
+void packBits(const unsigned char * input, std::size_t count, std::vector< unsigned char > & output)
+{
+	std::size_t i = 0;
+	while (i < count)
+	{
+		std::size_t run = 1;
+		while (i + run < count && run < 130 && input[ i + run ] == input[ i ])
+		{
+			run++;
+		}
+		if (run >= 3)
+		{
+			output.push_back(static_cast< unsigned char >(run + 125));
+			output.push_back(input[ i ]);
+			i += run;
+			continue;
+		}
+
+		// Литерал продолжается до начала повтора из трех байт
+		const std::size_t start = i;
+		while (i < count && i - start < 128)
+		{
+			if (i + 2 < count && input[ i ] == input[ i + 1 ] && input[ i ] == input[ i + 2 ])
+			{
+				break;
+			}
+			i++;
+		}
+		output.push_back(static_cast< unsigned char >(i - start - 1));
+		output.insert(output.end(), input + start, input + i);
+	}
+}
+
+bool unpackBits(const unsigned char * input, std::size_t size, unsigned char * output, std::size_t count)
+{
+	std::size_t in = 0, out = 0;
+	while (in < size)
+	{
+		const unsigned int control = input[ in++ ];
+		if (control < 128)
+		{
+			const std::size_t length = control + 1;
+			if (in + length > size || out + length > count)
+			{
+				return false;
+			}
+			std::memcpy(output + out, input + in, length);
+			in += length;
+			out += length;
+		}
+		else
+		{
+			const std::size_t length = control - 125;
+			if (in >= size || out + length > count)
+			{
+				return false;
+			}
+			std::memset(output + out, input[ in++ ], length);
+			out += length;
+		}
+	}
+	return out == count;
+}
+
+void appendUint32(std::vector< unsigned char > & output, std::uint32_t value)
+{
+	for (int b = 0; b < 4; b++)
+	{
+		output.push_back(static_cast< unsigned char >(value >> (8 * b)));
+	}
+}
+
+std::uint32_t readUint32(const unsigned char * input)
+{
+	std::uint32_t value = 0;
+	for (int b = 0; b < 4; b++)
+	{
+		value |= static_cast< std::uint32_t >(input[ b ]) << (8 * b);
+	}
+	return value;
+}
+
+void encodeWith(Predictor predictor, const std::uint64_t * bits, std::size_t count,
+                std::vector< unsigned char > & output)
+{
+	std::vector< std::uint64_t > residuals(count);
+	predict(predictor, bits, count, residuals.data());
+
+	output.clear();
+	output.push_back(static_cast< unsigned char >(predictor));
+	std::vector< unsigned char > plane(count), packed;
+	for (int b = 0; b < 8; b++)
+	{
+		for (std::size_t i = 0; i < count; i++)
+		{
+			plane[ i ] = static_cast< unsigned char >(residuals[ i ] >> (8 * b));
+		}
+		packed.clear();
+		packBits(plane.data(), count, packed);
+
+		const bool raw = packed.size() >= count;
+		const std::vector< unsigned char > & data = raw ? plane : packed;
+		output.push_back(static_cast< unsigned char >(raw ? PLANE_RAW : PLANE_RLE));
+		appendUint32(output, static_cast< std::uint32_t >(data.size()));
+		output.insert(output.end(), data.begin(), data.end());
+	}
+}
+
+void encodeBlock(const double * values, std::size_t count, std::vector< unsigned char > & output)
+{
+	std::vector< std::uint64_t > bits(count);
+	std::memcpy(bits.data(), values, count * sizeof(double));
+
+	std::vector< unsigned char > alternative;
+	encodeWith(PREDICT_XOR, bits.data(), count, output);
+	encodeWith(PREDICT_DELTA, bits.data(), count, alternative);
+	if (alternative.size() < output.size())
+	{
+		output.swap(alternative);
+	}
+	output.shrink_to_fit();
+}
+
+bool decodeBlock(const std::vector< unsigned char > & input, double * values, std::size_t count)
+{
+	if (input.empty() || input[ 0 ] > PREDICT_DELTA)
+	{
+		return false;
+	}
+	const Predictor predictor = static_cast< Predictor >(input[ 0 ]);
+
+	std::vector< std::uint64_t > residuals(count, 0);
+	std::vector< unsigned char > plane(count);
+	std::size_t position = 1;
+	for (int b = 0; b < 8; b++)
+	{
+		if (position + 5 > input.size())
+		{
+			return false;
+		}
+		const unsigned char mode = input[ position ];
+		const std::size_t size = readUint32(&input[ position + 1 ]);
+		position += 5;
+		if (position + size > input.size())
+		{
+			return false;
+		}
+		if (mode == PLANE_RAW)
+		{
+			if (size != count)
+			{
+				return false;
+			}
+			std::memcpy(plane.data(), &input[ position ], count);
+		}
+		else if (mode != PLANE_RLE || !unpackBits(&input[ position ], size, plane.data(), count))
+		{
+			return false;
+		}
+		position += size;
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			residuals[ i ] |= static_cast< std::uint64_t >(plane[ i ]) << (8 * b);
+		}
+	}
+	if (position != input.size())
+	{
+		return false;
+	}
+
+	std::vector< std::uint64_t > bits(count);
+	unpredict(predictor, residuals.data(), count, bits.data());
+	std::memcpy(values, bits.data(), count * sizeof(double));
+	return true;
+}
+
+void decodeOrThrow(const std::vector< unsigned char > & input, double * values, std::size_t count)
+{
+	if (!decodeBlock(input, values, count))
+	{
+		throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+	}
+}
+
+// Блоки обрабатываются параллельно, если матрица достаточно велика
+void runBlocks(std::size_t blocks, std::size_t elements, ThreadPool::RangeBody const & body)
+{
+	if (elements >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+	{
+		ThreadPool::instance().parallelFor(0, blocks, 1, body);
+	}
+	else
+	{
+		body(0, blocks);
+	}
+}
+
+// Контрольная сумма блока в файле (FNV-1a)
+std::uint32_t checksum(const std::vector< unsigned char > & block)
+{
+	std::uint32_t hash = 2166136261u;
+	for (unsigned char byte : block)
+	{
+		hash = (hash ^ byte) * 16777619u;
+	}
+	return hash;
+}
+
+template< typename T >
+void writeValue(std::ostream & stream, T value)
+{
+	stream.write(reinterpret_cast< const char * >(&value), sizeof(value));
+}
+
+template< typename T >
+T readValue(std::istream & stream)
+{
+	T value = T();
+	if (!stream.read(reinterpret_cast< char * >(&value), sizeof(value)))
+	{
+		throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+	}
+	return value;
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// CompressedMatrix
+// ---------------------------------------------------------------------------------
+CompressedMatrix::CompressedMatrix(int _rows, int _cols)
+	: rows(_rows), cols(_cols), cachedBlock(-1)
+{
+}
+
+CompressedMatrix::CompressedMatrix(const Matrix & m)
+	: rows(m.getNumRows()), cols(m.getNumColumns()), cachedBlock(-1)
+{
+	const std::size_t elements = m.elementCount();
+	blocks.resize((elements + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS);
+	runBlocks(blocks.size(), elements, [&] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t b = from; b < to; b++)
+		{
+			encodeBlock(m.data + b * BLOCK_ELEMENTS, blockCount(b), blocks[ b ]);
+		}
+	});
+}
+
+std::size_t CompressedMatrix::blockCount(std::size_t index) const
+{
+	const std::size_t elements = static_cast< std::size_t >(rows) * cols;
+	return std::min< std::size_t >(BLOCK_ELEMENTS, elements - index * BLOCK_ELEMENTS);
+}
+
+int CompressedMatrix::getNumRows(void) const
+{
+	return rows;
+}
+
+int CompressedMatrix::getNumColumns(void) const
+{
+	return cols;
+}
+
+std::size_t CompressedMatrix::getCompressedSize(void) const
+{
+	std::size_t size = 0;
+	for (const std::vector< unsigned char > & block : blocks)
+	{
+		size += block.size();
+	}
+	return size;
+}
+
+double CompressedMatrix::getCompressionRatio(void) const
+{
+	const std::size_t size = getCompressedSize();
+	if (size == 0)
+	{
+		return 1.0;
+	}
+	return static_cast< double >(rows) * cols * sizeof(double) / size;
+}
+
+double CompressedMatrix::at(int row, int col) const
+{
+	if (row < 0 || row >= rows || col < 0 || col >= cols)
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	const std::size_t index = static_cast< std::size_t >(row) * cols + col;
+	const int block = static_cast< int >(index / BLOCK_ELEMENTS);
+	if (block != cachedBlock)
+	{
+		cache.resize(BLOCK_ELEMENTS);
+		cachedBlock = -1;
+		decodeOrThrow(blocks[ block ], cache.data(), blockCount(block));
+		cachedBlock = block;
+	}
+	return cache[ index % BLOCK_ELEMENTS ];
+}
+
+Matrix CompressedMatrix::decompress(void) const
+{
+	Matrix result(rows, cols, Matrix::uninitialized);
+	runBlocks(blocks.size(), result.elementCount(), [&] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t b = from; b < to; b++)
+		{
+			decodeOrThrow(blocks[ b ], result.data + b * BLOCK_ELEMENTS, blockCount(b));
+		}
+	});
+	return result;
+}
+
+void CompressedMatrix::forEachBlock(const BlockVisitor & visitor) const
+{
+	runBlocks(blocks.size(), static_cast< std::size_t >(rows) * cols, [&] (std::size_t from, std::size_t to)
+	{
+		std::vector< double > values(BLOCK_ELEMENTS);
+		for (std::size_t b = from; b < to; b++)
+		{
+			decodeOrThrow(blocks[ b ], values.data(), blockCount(b));
+			visitor(b * BLOCK_ELEMENTS, values.data(), blockCount(b));
+		}
+	});
+}
+
+double CompressedMatrix::sum(void) const
+{
+	// Частичные суммы складываются по порядку блоков: результат не зависит
+	// от количества потоков
+	std::vector< double > partial(blocks.size(), 0.0);
+	forEachBlock([&] (std::size_t offset, const double * values, std::size_t count)
+	{
+		double s = 0.0;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			s += values[ i ];
+		}
+		partial[ offset / BLOCK_ELEMENTS ] = s;
+	});
+
+	double total = 0.0;
+	for (double s : partial)
+	{
+		total += s;
+	}
+	return total;
+}
+
+void CompressedMatrix::save(std::ostream & stream) const
+{
+	stream.write(MAGIC, sizeof(MAGIC));
+	writeValue< std::int32_t >(stream, rows);
+	writeValue< std::int32_t >(stream, cols);
+	for (const std::vector< unsigned char > & block : blocks)
+	{
+		writeValue< std::uint32_t >(stream, static_cast< std::uint32_t >(block.size()));
+		writeValue< std::uint32_t >(stream, checksum(block));
+		stream.write(reinterpret_cast< const char * >(block.data()), block.size());
+	}
+	if (!stream)
+	{
+		throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+	}
+}
+
+CompressedMatrix CompressedMatrix::load(std::istream & stream)
+{
+	char magic[ sizeof(MAGIC) ];
+	if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+	}
+	const std::int32_t rows = readValue< std::int32_t >(stream);
+	const std::int32_t cols = readValue< std::int32_t >(stream);
+	if (rows <= 0 || cols <= 0)
+	{
+		throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+	}
+
+	// Размеры из заголовка проверяются по остатку потока до выделения памяти:
+	// все блоки должны в нем поместиться. Если размер потока неизвестен, блоки
+	// добавляются по мере чтения и поврежденный заголовок обнаруживается
+	// при достижении конца потока.
+	CompressedMatrix result(rows, cols);
+	const std::size_t elements = static_cast< std::size_t >(rows) * cols;
+	const std::size_t count = (elements + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS;
+	const std::streampos position = stream.tellg();
+	if (position != std::streampos(-1))
+	{
+		stream.seekg(0, std::ios::end);
+		const std::streampos end = stream.tellg();
+		stream.seekg(position);
+		if (!stream || end < position || static_cast< std::size_t >(end - position) / MIN_STORED_BLOCK_BYTES < count)
+		{
+			throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+		}
+		result.blocks.reserve(count);
+	}
+	for (std::size_t b = 0; b < count; b++)
+	{
+		const std::uint32_t size = readValue< std::uint32_t >(stream);
+		const std::uint32_t expected = readValue< std::uint32_t >(stream);
+		if (size > MAX_BLOCK_BYTES)
+		{
+			throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+		}
+		result.blocks.push_back(std::vector< unsigned char >(size));
+		std::vector< unsigned char > & block = result.blocks.back();
+		if (!stream.read(reinterpret_cast< char * >(block.data()), size) || checksum(block) != expected)
+		{
+			throw new Matrix::CorruptedDataException(__func__, __LINE__, __FILE__);
+		}
+	}
+
+	// Каждый блок проверяется распаковкой, чтобы поврежденные данные
+	// обнаруживались при загрузке, а не при первом обращении
+	result.forEachBlock([] (std::size_t, const double *, std::size_t) {});
+	return result;
+}
+// =================================================================================
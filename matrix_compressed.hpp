@@ -0,0 +1,91 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_COMPRESSED_HPP_
+#define _MATRIX_COMPRESSED_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+// Сжатое без потерь хранение редко используемых матриц. Элементы (построчно)
+// делятся на блоки по BLOCK_ELEMENTS; в каждом блоке битовое представление
+// элемента заменяется разностью с предыдущим (XOR или целочисленной
+// разностью - выбирается лучшая), байты разностей группируются по номеру
+// байта (byte shuffle), и каждая из 8 групп кодируется RLE (PackBits) или
+// хранится как есть. У гладких данных полной точности предсказуемы только
+// знак, порядок и старшие биты мантиссы, и выигрыш невелик (около 1.2-1.5 раза;
+// двумерное предсказание по соседней строке его практически не увеличивает).
+// В несколько раз сжимаются данные с короткой мантиссой: целые, отсчеты на
+// равномерной сетке, значения, округленные до float, и повторяющиеся значения.
+
+/*****************************************************************************/
+
+class CompressedMatrix
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	static const int BLOCK_ELEMENTS = 8192;
+
+	// Обработчик блока: count элементов начиная с элемента offset (построчно)
+	typedef std::function< void (std::size_t offset, const double * values, std::size_t count) > BlockVisitor;
+
+private:
+	int rows;
+	int cols;
+	std::vector< std::vector< unsigned char > > blocks;
+
+	// Последний распакованный блок для поэлементного доступа
+	mutable int cachedBlock;
+	mutable std::vector< double > cache;
+
+	std::size_t blockCount(std::size_t index) const;
+
+public:
+
+	// Сжатие матрицы; крупные матрицы сжимаются параллельно по блокам
+	explicit CompressedMatrix(const Matrix & m);
+
+	int getNumRows(void) const;
+	int getNumColumns(void) const;
+
+	// Объем сжатых данных в байтах и коэффициент сжатия (исходный объем / сжатый);
+	// для пустой матрицы коэффициент равен 1
+	std::size_t getCompressedSize(void) const;
+	double getCompressionRatio(void) const;
+
+	// Элемент (row, col): распаковывается только содержащий его блок.
+	// Повторные обращения к тому же блоку его не распаковывают, поэтому
+	// одновременный доступ из нескольких потоков не допускается.
+	// При некорректном номере генерируется исключение с текстом "Out of range".
+	double at(int row, int col) const;
+
+	// Полная распаковка
+	Matrix decompress(void) const;
+
+	// Потоковая обработка: блоки распаковываются по одному во временный буфер
+	// задачи и передаются visitor, полная матрица не восстанавливается.
+	// Блоки обрабатываются параллельно, поэтому visitor должен допускать
+	// одновременные вызовы для разных блоков.
+	void forEachBlock(const BlockVisitor & visitor) const;
+
+	// Сумма элементов без полной распаковки
+	double sum(void) const;
+
+	// Двоичный формат: заголовок, размеры и сжатые блоки с контрольными
+	// суммами (порядок байт узла). При ошибке записи или чтения, а также для
+	// поврежденных данных генерируется исключение с текстом "Corrupted data".
+	void save(std::ostream & stream) const;
+	static CompressedMatrix load(std::istream & stream);
+
+private:
+	CompressedMatrix(int _rows, int _cols);
+};
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_COMPRESSED_HPP_
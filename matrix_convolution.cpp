@@ -0,0 +1,436 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_convolution.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+typedef std::complex< double > Complex;
+
+// Элементов во вспомогательной матрице im2col одной полосы (2 МБ)
+const std::size_t COLUMN_BUFFER_ELEMENTS = 1 << 18;
+
+// Столбцов БПФ, обрабатываемых одной задачей
+const int FFT_COLUMN_PANEL = 16;
+
+// Относительная стоимость одной бабочки БПФ по сравнению с умножением-сложением
+// в GEMV (комплексная арифметика и доступ к памяти без векторизации)
+const double FFT_BUTTERFLY_COST = 4.0;
+
+void runParallel(std::size_t count, std::size_t work, ThreadPool::RangeBody const & body)
+{
+	if (work >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+	{
+		ThreadPool::instance().parallelFor(0, count, 1, body);
+	}
+	else
+	{
+		body(0, count);
+	}
+}
+
+int nextPowerOfTwo(int n)
+{
+	int result = 1;
+	while (result < n)
+	{
+		result *= 2;
+	}
+	return result;
+}
+
+// Геометрия результата: размеры и смещение начала относительно режима Full
+struct Geometry
+{
+	int rows, cols;
+	int rowOffset, colOffset;
+};
+
+Geometry geometry(int H, int W, int kh, int kw, Convolution::Mode mode)
+{
+	Geometry g;
+	switch (mode)
+	{
+	case Convolution::Same:
+		g.rows = H;
+		g.cols = W;
+		g.rowOffset = (kh - 1) / 2;
+		g.colOffset = (kw - 1) / 2;
+		break;
+	case Convolution::Valid:
+		if (kh > H || kw > W)
+		{
+			throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+		}
+		g.rows = H - kh + 1;
+		g.cols = W - kw + 1;
+		g.rowOffset = kh - 1;
+		g.colOffset = kw - 1;
+		break;
+	default:
+		g.rows = H + kh - 1;
+		g.cols = W + kw - 1;
+		g.rowOffset = 0;
+		g.colOffset = 0;
+		break;
+	}
+	return g;
+}
+
+// Корни из единицы exp(-2 pi i k / n), k < n / 2
+std::vector< Complex > fftRoots(int n)
+{
+	std::vector< Complex > roots(std::max(n / 2, 1));
+	const double pi = std::acos(-1.0);
+	for (int k = 0; k < n / 2; k++)
+	{
+		const double angle = -2.0 * pi * k / n;
+		roots[k] = Complex(std::cos(angle), std::sin(angle));
+	}
+	return roots;
+}
+
+// Итеративное БПФ по основанию 2 на месте (без нормировки обратного преобразования)
+void fftLine(Complex * a, int n, const Complex * roots, bool inverse)
+{
+	for (int i = 1, j = 0; i < n; i++)
+	{
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j)
+		{
+			std::swap(a[i], a[j]);
+		}
+	}
+	for (int length = 2; length <= n; length *= 2)
+	{
+		const int half = length / 2, step = n / length;
+		for (int start = 0; start < n; start += length)
+		{
+			for (int k = 0; k < half; k++)
+			{
+				const Complex w = inverse ? std::conj(roots[k * step]) : roots[k * step];
+				const Complex u = a[start + k];
+				const Complex v = a[start + k + half] * w;
+				a[start + k] = u + v;
+				a[start + k + half] = u - v;
+			}
+		}
+	}
+}
+
+// Двумерное БПФ массива P x Q (построчно). Прямое преобразование строк
+// выполняется только для первых activeRows строк (остальные нулевые),
+// обратное - только для строк [firstRow, lastRow), нужных результату.
+void fft2d(std::vector< Complex > & data, int P, int Q, bool inverse, int firstRow, int lastRow)
+{
+	const std::vector< Complex > rowRoots = fftRoots(Q), columnRoots = fftRoots(P);
+	const std::size_t work = static_cast< std::size_t >(P) * Q * 8;
+
+	ThreadPool::RangeBody rows = [ & ] ( std::size_t from, std::size_t to )
+	{
+		for (std::size_t r = from; r < to; r++)
+		{
+			fftLine(data.data() + r * Q, Q, rowRoots.data(), inverse);
+		}
+	};
+	ThreadPool::RangeBody columns = [ & ] ( std::size_t from, std::size_t to )
+	{
+		std::vector< Complex > column(static_cast< std::size_t >(P) * FFT_COLUMN_PANEL);
+		for (std::size_t panel = from; panel < to; panel++)
+		{
+			const int c0 = static_cast< int >(panel) * FFT_COLUMN_PANEL;
+			const int width = std::min(FFT_COLUMN_PANEL, Q - c0);
+			for (int r = 0; r < P; r++)
+			{
+				for (int c = 0; c < width; c++)
+				{
+					column[static_cast< std::size_t >(c) * P + r] = data[static_cast< std::size_t >(r) * Q + c0 + c];
+				}
+			}
+			for (int c = 0; c < width; c++)
+			{
+				fftLine(column.data() + static_cast< std::size_t >(c) * P, P, columnRoots.data(), inverse);
+			}
+			for (int r = 0; r < P; r++)
+			{
+				for (int c = 0; c < width; c++)
+				{
+					data[static_cast< std::size_t >(r) * Q + c0 + c] = column[static_cast< std::size_t >(c) * P + r];
+				}
+			}
+		}
+	};
+	const std::size_t panels = (Q + FFT_COLUMN_PANEL - 1) / FFT_COLUMN_PANEL;
+
+	// Прямое: строки, затем столбцы; обратное - в обратном порядке
+	if (!inverse)
+	{
+		runParallel(lastRow - firstRow, work, [ & ] ( std::size_t from, std::size_t to ) { rows(firstRow + from, firstRow + to); });
+		runParallel(panels, work, columns);
+	}
+	else
+	{
+		runParallel(panels, work, columns);
+		runParallel(lastRow - firstRow, work, [ & ] ( std::size_t from, std::size_t to ) { rows(firstRow + from, firstRow + to); });
+	}
+}
+
+// Свертка (корреляция при flip == false) через БПФ. Изображение - вещественная
+// часть, ядро - мнимая; спектры разделяются по симметрии:
+// A(k) = (Z(k) + conj(Z(-k))) / 2, B(k) = (Z(k) - conj(Z(-k))) / 2i.
+void convolveFft(const double * image, int H, int W, const double * kernel, int kh, int kw,
+                 bool flip, const Geometry & g, double * result)
+{
+	const int P = nextPowerOfTwo(H + kh - 1), Q = nextPowerOfTwo(W + kw - 1);
+	std::vector< Complex > z(static_cast< std::size_t >(P) * Q);
+	for (int i = 0; i < H; i++)
+	{
+		for (int j = 0; j < W; j++)
+		{
+			z[static_cast< std::size_t >(i) * Q + j].real(image[static_cast< std::size_t >(i) * W + j]);
+		}
+	}
+	for (int p = 0; p < kh; p++)
+	{
+		for (int q = 0; q < kw; q++)
+		{
+			// Корреляция сводится к свертке с отраженным ядром
+			const int sp = flip ? p : kh - 1 - p, sq = flip ? q : kw - 1 - q;
+			z[static_cast< std::size_t >(p) * Q + q].imag(kernel[static_cast< std::size_t >(sp) * kw + sq]);
+		}
+	}
+
+	fft2d(z, P, Q, false, 0, std::max(H, kh));
+
+	// Произведение спектров эрмитово: C(-k) = conj(C(k)); строки u и -u
+	// обрабатываются одной задачей
+	const double scale = 1.0 / (4.0 * P * Q);
+	runParallel(P / 2 + 1, static_cast< std::size_t >(P) * Q, [ & ] ( std::size_t from, std::size_t to )
+	{
+		for (std::size_t u = from; u < to; u++)
+		{
+			const int mu = (P - static_cast< int >(u)) % P;
+			for (int v = 0; v < Q; v++)
+			{
+				const int mv = (Q - v) % Q;
+				// Каждая пара (k, -k) обрабатывается один раз
+				if (mu == static_cast< int >(u) && mv < v)
+				{
+					continue;
+				}
+				Complex & a = z[u * Q + v];
+				Complex & b = z[static_cast< std::size_t >(mu) * Q + mv];
+				const Complex sum = a + std::conj(b), difference = a - std::conj(b);
+				// A * B = sum * difference / 4i
+				const Complex product = sum * difference * Complex(0.0, -scale);
+				a = product;
+				b = std::conj(product);
+			}
+		}
+	});
+
+	fft2d(z, P, Q, true, g.rowOffset, g.rowOffset + g.rows);
+	for (int i = 0; i < g.rows; i++)
+	{
+		const Complex * source = z.data() + static_cast< std::size_t >(i + g.rowOffset) * Q + g.colOffset;
+		double * target = result + static_cast< std::size_t >(i) * g.cols;
+		for (int j = 0; j < g.cols; j++)
+		{
+			target[j] = source[j].real();
+		}
+	}
+}
+
+// Свертка набора ядер через im2col: строка вспомогательной матрицы - окно
+// изображения для одного элемента результата, столбец - элемент ядра
+void convolveIm2col(const double * image, int H, int W, const std::vector< const double * > & kernels,
+                    int kh, int kw, bool flip, const Geometry & g, const std::vector< double * > & results)
+{
+	const int count = static_cast< int >(kernels.size());
+	const int window = kh * kw;
+
+	// Матрица ядер window x count: элемент (p, q) окна умножается на
+	// kernel(kh - 1 - p, kw - 1 - q) для свертки и на kernel(p, q) для корреляции
+	std::vector< double > weights(static_cast< std::size_t >(window) * count);
+	for (int t = 0; t < count; t++)
+	{
+		for (int p = 0; p < kh; p++)
+		{
+			for (int q = 0; q < kw; q++)
+			{
+				const int sp = flip ? kh - 1 - p : p, sq = flip ? kw - 1 - q : q;
+				weights[static_cast< std::size_t >(p * kw + q) * count + t] = kernels[t][static_cast< std::size_t >(sp) * kw + sq];
+			}
+		}
+	}
+
+	const int panelRows = static_cast< int >(std::max< std::size_t >(1,
+		COLUMN_BUFFER_ELEMENTS / (static_cast< std::size_t >(g.cols) * window)));
+	const std::size_t panels = (g.rows + panelRows - 1) / panelRows;
+	const std::size_t work = static_cast< std::size_t >(g.rows) * g.cols * window * count;
+
+	runParallel(panels, work, [ & ] ( std::size_t from, std::size_t to )
+	{
+		std::vector< double > columns(static_cast< std::size_t >(std::min(panelRows, g.rows)) * g.cols * window);
+		std::vector< double > products(count > 1 ? static_cast< std::size_t >(std::min(panelRows, g.rows)) * g.cols * count : 0);
+		for (std::size_t panel = from; panel < to; panel++)
+		{
+			const int r0 = static_cast< int >(panel) * panelRows;
+			const int rowsInPanel = std::min(panelRows, g.rows - r0);
+
+			for (int i = 0; i < rowsInPanel; i++)
+			{
+				for (int j = 0; j < g.cols; j++)
+				{
+					double * row = columns.data() + (static_cast< std::size_t >(i) * g.cols + j) * window;
+					// Левый верхний угол окна в координатах изображения
+					const int top = r0 + i + g.rowOffset - kh + 1;
+					const int left = j + g.colOffset - kw + 1;
+					const int qBegin = std::max(0, -left), qEnd = std::min(kw, W - left);
+					for (int p = 0; p < kh; p++)
+					{
+						double * target = row + static_cast< std::size_t >(p) * kw;
+						const int si = top + p;
+						if (si < 0 || si >= H || qBegin >= qEnd)
+						{
+							std::fill(target, target + kw, 0.0);
+							continue;
+						}
+						const double * source = image + static_cast< std::size_t >(si) * W + left;
+						std::fill(target, target + qBegin, 0.0);
+						std::copy(source + qBegin, source + qEnd, target + qBegin);
+						std::fill(target + qEnd, target + kw, 0.0);
+					}
+				}
+			}
+
+			const int m = rowsInPanel * g.cols;
+			if (count == 1)
+			{
+				// Полоса результата непрерывна и заполняется напрямую
+				MatrixKernels::gemv(false, m, window, 1.0, columns.data(), window, weights.data(), 0.0,
+				                    results[0] + static_cast< std::size_t >(r0) * g.cols);
+				continue;
+			}
+			MatrixKernels::gemm(false, false, m, count, window, 1.0, columns.data(), window,
+			                    weights.data(), count, 0.0, products.data(), count);
+			for (int e = 0; e < m; e++)
+			{
+				for (int t = 0; t < count; t++)
+				{
+					results[t][static_cast< std::size_t >(r0) * g.cols + e] = products[static_cast< std::size_t >(e) * count + t];
+				}
+			}
+		}
+	});
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Convolution
+// ---------------------------------------------------------------------------------
+Convolution::Method Convolution::chooseMethod(int imageRows, int imageCols, int kernelRows, int kernelCols, int kernelCount)
+{
+	// im2col: умножение-сложение на каждый элемент ядра для каждого элемента
+	// результата; БПФ: прямое и обратное преобразования по P * Q * log2(P * Q)
+	// бабочек плюс прямое преобразование каждого ядра
+	const double outputs = static_cast< double >(imageRows + kernelRows - 1) * (imageCols + kernelCols - 1);
+	const double direct = outputs * kernelRows * kernelCols * kernelCount;
+	const double P = nextPowerOfTwo(imageRows + kernelRows - 1), Q = nextPowerOfTwo(imageCols + kernelCols - 1);
+	const double fft = FFT_BUTTERFLY_COST * P * Q * std::log2(P * Q) * kernelCount;
+	return fft < direct ? Fft : Im2col;
+}
+
+std::vector< Matrix > Convolution::compute(const Matrix & image, const std::vector< Matrix > & kernels,
+                                           Mode mode, Method method, bool flip)
+{
+	if (kernels.empty())
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	const int H = image.rows, W = image.cols;
+	const int kh = kernels[0].rows, kw = kernels[0].cols;
+	for (const Matrix & kernel : kernels)
+	{
+		if (kernel.rows != kh || kernel.cols != kw)
+		{
+			throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+		}
+	}
+	const Geometry g = geometry(H, W, kh, kw, mode);
+
+	std::vector< Matrix > results;
+	results.reserve(kernels.size());
+	std::vector< const double * > kernelData;
+	std::vector< double * > resultData;
+	for (const Matrix & kernel : kernels)
+	{
+		results.push_back(Matrix(g.rows, g.cols, Matrix::uninitialized));
+		kernelData.push_back(kernel.data);
+		resultData.push_back(results.back().data);
+	}
+
+	if (method == Automatic)
+	{
+		method = chooseMethod(H, W, kh, kw, static_cast< int >(kernels.size()));
+	}
+	if (method == Fft)
+	{
+		for (std::size_t t = 0; t < kernels.size(); t++)
+		{
+			convolveFft(image.data, H, W, kernelData[t], kh, kw, flip, g, resultData[t]);
+		}
+	}
+	else
+	{
+		convolveIm2col(image.data, H, W, kernelData, kh, kw, flip, g, resultData);
+	}
+
+	for (const Matrix & result : results)
+	{
+		if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+		{
+			throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+		}
+	}
+	return results;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Свертка и корреляция
+// ---------------------------------------------------------------------------------
+Matrix convolve2d(const Matrix & image, const Matrix & kernel, Convolution::Mode mode, Convolution::Method method)
+{
+	return Convolution::compute(image, std::vector< Matrix >(1, kernel), mode, method, true)[0];
+}
+
+Matrix correlate2d(const Matrix & image, const Matrix & kernel, Convolution::Mode mode, Convolution::Method method)
+{
+	return Convolution::compute(image, std::vector< Matrix >(1, kernel), mode, method, false)[0];
+}
+
+std::vector< Matrix > convolve2d(const Matrix & image, const std::vector< Matrix > & kernels,
+                                 Convolution::Mode mode, Convolution::Method method)
+{
+	return Convolution::compute(image, kernels, mode, method, true);
+}
+// =================================================================================
@@ -0,0 +1,75 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_CONVOLUTION_HPP_
+#define _MATRIX_CONVOLUTION_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <vector>
+
+// Двумерная свертка и корреляция. Два способа вычисления:
+//  - im2col: окна изображения для полосы строк результата раскладываются в
+//    строки вспомогательной матрицы, которая умножается на ядро (GEMV, для
+//    набора ядер - блочный GEMM). Полосы обрабатываются параллельно;
+//  - FFT: изображение и ядро дополняются нулями до степеней двойки, оба
+//    преобразуются одним комплексным БПФ (ядро - мнимая часть), спектры
+//    перемножаются, результат - обратное БПФ. Строки и столбцы БПФ
+//    обрабатываются параллельно. Погрешность - порядка
+//    eps * log(размер) * max|результат|, а не относительная поэлементная.
+// Автоматический выбор сравнивает оценки работы обоих способов.
+
+/*****************************************************************************/
+
+class Convolution
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	// Размер результата для изображения H x W и ядра kh x kw:
+	//  Full  - (H + kh - 1) x (W + kw - 1), все частичные перекрытия;
+	//  Same  - H x W, центр ядра - в строке (kh - 1) / 2, столбце (kw - 1) / 2;
+	//  Valid - (H - kh + 1) x (W - kw + 1), только полные перекрытия.
+	enum Mode { Full, Same, Valid };
+
+	enum Method { Automatic, Im2col, Fft };
+
+	// Способ, который Automatic выбирает для заданных размеров
+	static Method chooseMethod(int imageRows, int imageCols, int kernelRows, int kernelCols, int kernelCount = 1);
+
+private:
+	static std::vector< Matrix > compute(const Matrix & image, const std::vector< Matrix > & kernels,
+	                                     Mode mode, Method method, bool flip);
+
+	friend Matrix convolve2d(const Matrix & image, const Matrix & kernel, Mode mode, Method method);
+	friend Matrix correlate2d(const Matrix & image, const Matrix & kernel, Mode mode, Method method);
+	friend std::vector< Matrix > convolve2d(const Matrix & image, const std::vector< Matrix > & kernels,
+	                                        Mode mode, Method method);
+};
+
+/*****************************************************************************/
+
+// Свертка: result(i, j) = сумма image(i - p, j - q) * kernel(p, q) (вне
+// изображения - нули), со смещением результата согласно mode. Для Valid
+// ядро не должно превышать изображение, иначе генерируется исключение с
+// текстом "Size mismatch".
+Matrix convolve2d(const Matrix & image, const Matrix & kernel,
+                  Convolution::Mode mode = Convolution::Full,
+                  Convolution::Method method = Convolution::Automatic);
+
+// Корреляция: свертка с ядром, отраженным по обеим осям
+Matrix correlate2d(const Matrix & image, const Matrix & kernel,
+                   Convolution::Mode mode = Convolution::Full,
+                   Convolution::Method method = Convolution::Automatic);
+
+// Свертка одного изображения с набором ядер одинакового размера: окна
+// раскладываются один раз, все ядра применяются одним GEMM. Для ядер разного
+// размера генерируется исключение с текстом "Size mismatch", для пустого
+// набора - с текстом "Invalid dimensions".
+std::vector< Matrix > convolve2d(const Matrix & image, const std::vector< Matrix > & kernels,
+                                 Convolution::Mode mode = Convolution::Full,
+                                 Convolution::Method method = Convolution::Automatic);
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_CONVOLUTION_HPP_
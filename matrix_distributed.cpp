@@ -0,0 +1,496 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_distributed.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+struct ProcessGroup::Header
+{
+	std::atomic< int > arrived;
+	std::atomic< int > generation;
+	std::atomic< int > aborted;
+};
+
+namespace
+{
+
+// Заголовок занимает отдельную строку кэша, буферы выравниваются по 64 байтам
+const std::size_t HEADER_BYTES = 64;
+const std::size_t BUFFER_ALIGNMENT = 64 / sizeof(double);
+
+// Анонимная разделяемая память: после fork() одни и те же страницы видны
+// родителю и всем дочерним процессам
+class SharedRegion
+{
+	void * address;
+	std::size_t bytes;
+
+	SharedRegion(const SharedRegion &);
+	SharedRegion & operator = (const SharedRegion &);
+
+public:
+	explicit SharedRegion(std::size_t _bytes)
+		: bytes(std::max< std::size_t >(_bytes, 1))
+	{
+		address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (address == MAP_FAILED)
+		{
+			throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+		}
+	}
+
+	~SharedRegion()
+	{
+		munmap(address, bytes);
+	}
+
+	void * get() const
+	{
+		return address;
+	}
+};
+
+// Номер части, содержащей элемент index, при делении count на parts частей
+int partOf(int count, int parts, int index)
+{
+	int part = 0;
+	while (part + 1 < parts && ProcessGrid::partBegin(count, parts, part + 1) <= index)
+	{
+		part++;
+	}
+	return part;
+}
+
+int partSize(int count, int parts, int index)
+{
+	return ProcessGrid::partBegin(count, parts, index + 1) - ProcessGrid::partBegin(count, parts, index);
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// ProcessGroup
+// ---------------------------------------------------------------------------------
+ProcessGroup::ProcessGroup(Header * _header, double * _buffers, int _rank, int _size, std::size_t _bufferSize)
+	: header(_header), buffers(_buffers), rank(_rank), size(_size), bufferSize(_bufferSize)
+{
+}
+
+void ProcessGroup::run(int size, std::size_t bufferSize, const std::function< void (ProcessGroup &) > & body)
+{
+	if (size < 1)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+
+	const std::size_t stride = (bufferSize + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+	SharedRegion segment(HEADER_BYTES + size * stride * sizeof(double));
+	Header * header = new (segment.get()) Header();
+	double * buffers = reinterpret_cast< double * >(static_cast< char * >(segment.get()) + HEADER_BYTES);
+
+	// Процессоры делятся между процессами группы
+	const int threads = std::max(1, ThreadPool::instance().getNumThreads() / size);
+
+	// Иначе буферизованный вывод родителя повторился бы в каждом дочернем процессе
+	std::fflush(nullptr);
+
+	std::vector< pid_t > children;
+	for (int r = 0; r < size; r++)
+	{
+		const pid_t pid = fork();
+		if (pid == 0)
+		{
+			int status = 0;
+			try
+			{
+				ThreadPool::instance().reinitializeAfterFork(threads);
+				ProcessGroup group(header, buffers, r, size, stride);
+				body(group);
+			}
+			catch (...)
+			{
+				header->aborted.store(1);
+				status = 1;
+			}
+			std::fflush(nullptr);
+			_exit(status);
+		}
+		if (pid < 0)
+		{
+			header->aborted.store(1);
+			break;
+		}
+		children.push_back(pid);
+	}
+
+	// Процессы опрашиваются по очереди: ожидание одного из них не должно
+	// мешать заметить аварийное завершение другого
+	bool failed = (static_cast< int >(children.size()) != size);
+	while (!children.empty())
+	{
+		bool reaped = false;
+		for (std::size_t i = 0; i < children.size(); i++)
+		{
+			int status = 0;
+			const pid_t result = waitpid(children[i], &status, WNOHANG);
+			if (result == 0 || (result < 0 && errno == EINTR))
+			{
+				continue;
+			}
+			if (result < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			{
+				failed = true;
+				header->aborted.store(1);
+			}
+			children.erase(children.begin() + i);
+			reaped = true;
+			break;
+		}
+		if (!reaped)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	if (failed)
+	{
+		throw new Matrix::ProcessFailedException(__func__, __LINE__, __FILE__);
+	}
+}
+
+int ProcessGroup::getRank(void) const
+{
+	return rank;
+}
+
+int ProcessGroup::getSize(void) const
+{
+	return size;
+}
+
+std::size_t ProcessGroup::getBufferSize(void) const
+{
+	return bufferSize;
+}
+
+double * ProcessGroup::getBuffer(int _rank) const
+{
+	if (_rank < 0 || _rank >= size)
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return buffers + _rank * bufferSize;
+}
+
+// Барьер со сменой поколения: последний пришедший процесс обнуляет счетчик
+// и увеличивает номер поколения, остальные ждут его изменения
+void ProcessGroup::barrier()
+{
+	const int generation = header->generation.load(std::memory_order_acquire);
+	if (header->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == size)
+	{
+		header->arrived.store(0, std::memory_order_relaxed);
+		header->generation.fetch_add(1, std::memory_order_release);
+	}
+	else
+	{
+		while (header->generation.load(std::memory_order_acquire) == generation)
+		{
+			if (header->aborted.load(std::memory_order_relaxed))
+			{
+				break;
+			}
+			std::this_thread::yield();
+		}
+	}
+	if (header->aborted.load(std::memory_order_relaxed))
+	{
+		throw new Matrix::ProcessFailedException(__func__, __LINE__, __FILE__);
+	}
+}
+
+void ProcessGroup::broadcast(double * data, std::size_t count, int root)
+{
+	const double * source = getBuffer(root);
+	for (std::size_t offset = 0; offset < count; offset += bufferSize)
+	{
+		const std::size_t chunk = std::min(bufferSize, count - offset);
+		if (rank == root)
+		{
+			std::memcpy(getBuffer(root), data + offset, chunk * sizeof(double));
+		}
+		barrier();
+		if (rank != root)
+		{
+			std::memcpy(data + offset, source, chunk * sizeof(double));
+		}
+		// Буфер корня можно перезаписывать только после того, как его прочитали все
+		barrier();
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// ProcessGrid
+// ---------------------------------------------------------------------------------
+ProcessGrid::ProcessGrid(ProcessGroup & _group, int _rows, int _cols)
+	: group(&_group), rows(_rows), cols(_cols)
+{
+	if (_rows < 1 || _cols < 1 || _rows * _cols != _group.getSize())
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+}
+
+ProcessGroup & ProcessGrid::getGroup(void) const
+{
+	return *group;
+}
+
+int ProcessGrid::getNumRows(void) const
+{
+	return rows;
+}
+
+int ProcessGrid::getNumColumns(void) const
+{
+	return cols;
+}
+
+int ProcessGrid::getRow(void) const
+{
+	return group->getRank() / cols;
+}
+
+int ProcessGrid::getCol(void) const
+{
+	return group->getRank() % cols;
+}
+
+int ProcessGrid::rankOf(int row, int col) const
+{
+	return row * cols + col;
+}
+
+int ProcessGrid::partBegin(int count, int parts, int index)
+{
+	return index * (count / parts) + std::min(index, count % parts);
+}
+// =================================================================================
+
+
+// =================================================================================
+// DistributedMatrix
+// ---------------------------------------------------------------------------------
+DistributedMatrix::DistributedMatrix(const ProcessGrid & _grid, int _rows, int _cols)
+	: grid(&_grid), rows(_rows), cols(_cols)
+	, local(1, 1)
+{
+	if (_rows < _grid.getNumRows() || _cols < _grid.getNumColumns())
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	local = Matrix(partSize(rows, _grid.getNumRows(), _grid.getRow()),
+	               partSize(cols, _grid.getNumColumns(), _grid.getCol()));
+}
+
+DistributedMatrix::DistributedMatrix(const ProcessGrid & _grid, const Matrix & full)
+	: DistributedMatrix(_grid, full.getNumRows(), full.getNumColumns())
+{
+	const int rowBegin = getRowBegin();
+	const int colBegin = getColBegin();
+	const int localCols = local.getNumColumns();
+	for (int i = 0; i < local.getNumRows(); i++)
+	{
+		std::memcpy(local.data + static_cast< std::size_t >(i) * localCols, 
+		            full.data + static_cast< std::size_t >(rowBegin + i) * cols + colBegin,
+		            localCols * sizeof(double));
+	}
+}
+
+const ProcessGrid & DistributedMatrix::getGrid(void) const
+{
+	return *grid;
+}
+
+int DistributedMatrix::getNumRows(void) const
+{
+	return rows;
+}
+
+int DistributedMatrix::getNumColumns(void) const
+{
+	return cols;
+}
+
+int DistributedMatrix::getRowBegin(void) const
+{
+	return ProcessGrid::partBegin(rows, grid->getNumRows(), grid->getRow());
+}
+
+int DistributedMatrix::getColBegin(void) const
+{
+	return ProcessGrid::partBegin(cols, grid->getNumColumns(), grid->getCol());
+}
+
+Matrix & DistributedMatrix::getLocal(void)
+{
+	return local;
+}
+
+const Matrix & DistributedMatrix::getLocal(void) const
+{
+	return local;
+}
+
+void DistributedMatrix::gather(double * full) const
+{
+	const int rowBegin = getRowBegin();
+	const int colBegin = getColBegin();
+	const int localCols = local.getNumColumns();
+	for (int i = 0; i < local.getNumRows(); i++)
+	{
+		std::memcpy(full + static_cast< std::size_t >(rowBegin + i) * cols + colBegin, 
+		            local.data + static_cast< std::size_t >(i) * localCols,
+		            localCols * sizeof(double));
+	}
+}
+
+void DistributedMatrix::multiply(const DistributedMatrix & A, const DistributedMatrix & B,
+                                 DistributedMatrix & C, int panelWidth)
+{
+	if (A.grid != B.grid || A.grid != C.grid || A.cols != B.rows || C.rows != A.rows || C.cols != B.cols)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+
+	const ProcessGrid & grid = *A.grid;
+	ProcessGroup & group = grid.getGroup();
+	const int gridRows = grid.getNumRows();
+	const int gridCols = grid.getNumColumns();
+	const int myRow = grid.getRow();
+	const int myCol = grid.getCol();
+	const int inner = A.cols;
+
+	// Размер области полосы A в буфере одинаков у всех процессов
+	const int maxRows = (A.rows + gridRows - 1) / gridRows;
+	const int maxCols = (B.cols + gridCols - 1) / gridCols;
+	const int width = static_cast< int >(std::min< std::size_t >(std::max(panelWidth, 1),
+	                                     group.getBufferSize() / (maxRows + maxCols)));
+	if (width < 1)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+
+	const int localRows = A.local.getNumRows();
+	const int localInnerA = A.local.getNumColumns();
+	const int localCols = B.local.getNumColumns();
+	const int innerBeginA = A.getColBegin();
+	const int innerBeginB = B.getRowBegin();
+
+	C.local = Matrix(localRows, localCols);
+	double * own = group.getBuffer(group.getRank());
+
+	int k = 0;
+	while (k < inner)
+	{
+		// Полоса не пересекает границ блоков ни A (по столбцам), ни B (по строкам)
+		const int ownerCol = partOf(inner, gridCols, k);
+		const int ownerRow = partOf(inner, gridRows, k);
+		const int end = std::min(k + width, std::min(ProcessGrid::partBegin(inner, gridCols, ownerCol + 1),
+		                                             ProcessGrid::partBegin(inner, gridRows, ownerRow + 1)));
+		const int w = end - k;
+
+		if (myCol == ownerCol)
+		{
+			for (int i = 0; i < localRows; i++)
+			{
+				std::memcpy(own + static_cast< std::size_t >(i) * w, 
+				            A.local.data + static_cast< std::size_t >(i) * localInnerA + (k - innerBeginA), 
+				            w * sizeof(double));
+			}
+		}
+		if (myRow == ownerRow)
+		{
+			std::memcpy(own + static_cast< std::size_t >(maxRows) * w, 
+			            B.local.data + static_cast< std::size_t >(k - innerBeginB) * localCols,
+			            static_cast< std::size_t >(w) * localCols * sizeof(double));
+		}
+		group.barrier();
+
+		const double * panelA = group.getBuffer(grid.rankOf(myRow, ownerCol));
+		const double * panelB = group.getBuffer(grid.rankOf(ownerRow, myCol)) + static_cast< std::size_t >(maxRows) * w;
+		MatrixKernels::gemm(false, false, localRows, localCols, w, 1.0, panelA, w, panelB, localCols,
+		                    1.0, C.local.data, localCols);
+
+		// Буферы следующей полосы перезаписываются только после того, как текущую прочитали все
+		group.barrier();
+		k = end;
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// Распределенное произведение
+// ---------------------------------------------------------------------------------
+Matrix distributedMultiply(const Matrix & A, const Matrix & B, int gridRows, int gridCols)
+{
+	if (A.getNumColumns() != B.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const int m = A.getNumRows();
+	const int n = B.getNumColumns();
+	const int inner = A.getNumColumns();
+	if (gridRows < 1 || gridCols < 1 || m < gridRows || n < gridCols || inner < gridRows || inner < gridCols)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+
+	const int panelWidth = 128;
+	const std::size_t bufferSize = static_cast< std::size_t >((m + gridRows - 1) / gridRows
+	                                                          + (n + gridCols - 1) / gridCols) * panelWidth;
+
+	// Процессы записывают свои блоки C непосредственно в общий результат
+	SharedRegion result(static_cast< std::size_t >(m) * n * sizeof(double));
+	double * product = static_cast< double * >(result.get());
+
+	ProcessGroup::run(gridRows * gridCols, bufferSize, [&] (ProcessGroup & group)
+	{
+		ProcessGrid grid(group, gridRows, gridCols);
+		DistributedMatrix localA(grid, A);
+		DistributedMatrix localB(grid, B);
+		DistributedMatrix localC(grid, m, n);
+		DistributedMatrix::multiply(localA, localB, localC, panelWidth);
+		localC.gather(product);
+	});
+
+	if (!MatrixKernels::allFinite(static_cast< std::size_t >(m) * n, product))
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return Matrix(m, n, product);
+}
+// =================================================================================
@@ -0,0 +1,154 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_DISTRIBUTED_HPP_
+#define _MATRIX_DISTRIBUTED_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <functional>
+
+// Распределенное умножение матриц несколькими процессами одного узла.
+// Процессы обмениваются блоками через сегмент разделяемой памяти (локальный
+// аналог MPI), локальные произведения блоков вычисляет обычное ядро GEMM.
+// Если один из процессов завершился с ошибкой, генерируется исключение
+// с текстом "Process failed".
+
+/*****************************************************************************/
+
+// Группа из size процессов с общими буферами обмена: у каждого процесса
+// (ранга) свой буфер из bufferSize элементов, доступный всем остальным.
+class ProcessGroup
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	// Счетчики барьера и признак аварийного завершения (в начале сегмента)
+	struct Header;
+
+	Header * header;
+	double * buffers;
+	int rank;
+	int size;
+	std::size_t bufferSize;
+
+	ProcessGroup(Header * _header, double * _buffers, int _rank, int _size, std::size_t _bufferSize);
+
+public:
+
+	// Запускает size дочерних процессов (fork), каждый выполняет body со своим
+	// рангом, и дожидается их завершения. Пул потоков каждого процесса
+	// получает свою долю процессоров. Если size < 1, генерируется исключение
+	// с текстом "Invalid dimensions".
+	static void run(int size, std::size_t bufferSize, const std::function< void (ProcessGroup &) > & body);
+
+	int getRank(void) const;
+	int getSize(void) const;
+	std::size_t getBufferSize(void) const;
+
+	// Буфер обмена процесса _rank
+	double * getBuffer(int _rank) const;
+
+	// Ожидание всех процессов группы. Если другой процесс завершился с
+	// ошибкой, генерируется исключение с текстом "Process failed".
+	void barrier();
+
+	// Рассылка count элементов data от процесса root всем остальным
+	// (частями по размеру буфера обмена)
+	void broadcast(double * data, std::size_t count, int root);
+};
+
+/*****************************************************************************/
+
+// Двумерная решетка процессов rows x cols: ранг r = row * cols + col
+class ProcessGrid
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	ProcessGroup * group;
+	int rows;
+	int cols;
+
+public:
+
+	// Если rows * cols не равно размеру группы, генерируется исключение
+	// с текстом "Invalid dimensions"
+	ProcessGrid(ProcessGroup & _group, int _rows, int _cols);
+
+	ProcessGroup & getGroup(void) const;
+	int getNumRows(void) const;
+	int getNumColumns(void) const;
+
+	// Положение текущего процесса в решетке
+	int getRow(void) const;
+	int getCol(void) const;
+
+	int rankOf(int row, int col) const;
+
+	// Начало части index при делении count элементов на parts почти равных частей
+	static int partBegin(int count, int parts, int index);
+};
+
+/*****************************************************************************/
+
+// Матрица, разбитая на блоки по решетке процессов: процесс (row, col)
+// хранит только строки [partBegin(rows, gridRows, row), ...) и столбцы
+// [partBegin(cols, gridCols, col), ...). Каждое измерение должно быть не
+// меньше соответствующего измерения решетки, иначе генерируется исключение
+// с текстом "Invalid dimensions".
+class DistributedMatrix
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	const ProcessGrid * grid;
+	int rows;
+	int cols;
+	Matrix local;
+
+public:
+
+	// Нулевая матрица rows x cols
+	DistributedMatrix(const ProcessGrid & _grid, int _rows, int _cols);
+
+	// Блок текущего процесса полной матрицы full
+	DistributedMatrix(const ProcessGrid & _grid, const Matrix & full);
+
+	const ProcessGrid & getGrid(void) const;
+	int getNumRows(void) const;
+	int getNumColumns(void) const;
+	int getRowBegin(void) const;
+	int getColBegin(void) const;
+
+	Matrix & getLocal(void);
+	const Matrix & getLocal(void) const;
+
+	// Копирует блок текущего процесса в полную матрицу rows x cols,
+	// хранящуюся построчно (например, в разделяемой памяти)
+	void gather(double * full) const;
+
+	// C = A * B алгоритмом SUMMA: внутренняя размерность обрабатывается
+	// полосами шириной до panelWidth; владельцы полосы A (столбец решетки)
+	// и полосы B (строка решетки) выкладывают их в свои буферы обмена, после
+	// чего каждый процесс добавляет произведение полос к своему блоку C.
+	// Ширина полосы уменьшается, если полосы не помещаются в буфер обмена.
+	// Если размеры не согласованы, генерируется исключение с текстом "Size mismatch".
+	static void multiply(const DistributedMatrix & A, const DistributedMatrix & B,
+	                     DistributedMatrix & C, int panelWidth = 128);
+};
+
+/*****************************************************************************/
+
+// Произведение A * B, вычисленное gridRows * gridCols процессами по SUMMA.
+// Каждый процесс хранит только свои блоки A, B и C, но полные A и B должны 
+// находиться в памяти вызывающего процесса (дочерние процессы получают их при
+// fork), а результат собирается в общем сегменте размером m * n. Для матриц,
+// которые не помещаются в память одного процесса, блоки следует заполнять в
+// каждом процессе и вызывать DistributedMatrix::multiply напрямую.
+Matrix distributedMultiply(const Matrix & A, const Matrix & B, int gridRows, int gridCols);
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_DISTRIBUTED_HPP_
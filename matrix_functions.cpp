@@ -0,0 +1,274 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_functions.hpp"
+#include "matrix_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+static void checkSquare ( const Matrix & _matrix )
+{
+	if ( _matrix.getNumRows() != _matrix.getNumColumns() )
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+}
+
+// m = m + c * I
+static void addIdentity ( Matrix & m, double c )
+{
+	for (int i = 0; i < m.getNumRows(); i++)
+	{
+		m[i][i] += c;
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// Степень матрицы
+// ---------------------------------------------------------------------------------
+Matrix pow(const Matrix & A, unsigned long long k)
+{
+	checkSquare(A);
+	const int n = A.getNumRows();
+
+	Matrix result(n, n);
+	if (k == 0)
+	{
+		addIdentity(result, 1.0);
+		return result;
+	}
+
+	// base = A^(2^i); произведения пишутся в scratch и меняются местами с целью
+	Matrix base(A);
+	Matrix scratch(n, n, Matrix::uninitialized);
+	bool resultIsIdentity = true;
+	for ( ;; )
+	{
+		if (k & 1)
+		{
+			if (resultIsIdentity)
+			{
+				result = base;
+				resultIsIdentity = false;
+			}
+			else
+			{
+				scratch.gemm(1.0, result, base, 0.0);
+				std::swap(result, scratch);
+			}
+		}
+		k >>= 1;
+		if (k == 0)
+		{
+			break;
+		}
+		scratch.gemm(1.0, base, base, 0.0);
+		std::swap(base, scratch);
+	}
+	return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Многочлен от матрицы (схема Паттерсона-Стокмейера)
+// ---------------------------------------------------------------------------------
+Matrix polynomial(const Matrix & A, const std::vector< double > & coefficients)
+{
+	checkSquare(A);
+	const int n = A.getNumRows();
+	Matrix result(n, n);
+	if (coefficients.empty())
+	{
+		return result;
+	}
+
+	// p(A) = B_0 + B_1 * A^s + ... + B_(r-1) * A^(s(r-1)), где
+	// B_j = c[js] * I + c[js+1] * A + ... + c[js+s-1] * A^(s-1).
+	// Многочлен по A^s вычисляется схемой Горнера.
+	const int degree = static_cast< int >(coefficients.size()) - 1;
+	const int s = std::max(1, static_cast< int >(std::ceil(std::sqrt(degree + 1.0))));
+	const int r = (degree + s) / s;
+
+	// powers[i] = A^i, i = 1..s (A^s нужна только при r > 1)
+	const int highest = (r > 1) ? s : s - 1;
+	std::vector< Matrix > powers;
+	powers.reserve(highest + 1);
+	powers.push_back(Matrix(1, 1));
+	if (highest >= 1)
+	{
+		powers.push_back(A);
+	}
+	for (int i = 2; i <= highest; i++)
+	{
+		powers.push_back(Matrix(n, n, Matrix::uninitialized));
+		powers[i].gemm(1.0, powers[i - 1], A, 0.0);
+	}
+
+	// target = target + B_j
+	auto addBlock = [ & ] ( Matrix & target, int j )
+	{
+		for (int i = 0; i < s && j * s + i <= degree; i++)
+		{
+			const double c = coefficients[j * s + i];
+			if (c == 0.0)
+			{
+				continue;
+			}
+			if (i == 0)
+			{
+				addIdentity(target, c);
+			}
+			else
+			{
+				target.axpy(c, powers[i]);
+			}
+		}
+	};
+
+	addBlock(result, r - 1);
+	if (r > 1)
+	{
+		Matrix scratch(n, n, Matrix::uninitialized);
+		for (int j = r - 2; j >= 0; j--)
+		{
+			scratch.gemm(1.0, result, powers[s], 0.0);
+			addBlock(scratch, j);
+			std::swap(result, scratch);
+		}
+	}
+	return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Матричная экспонента
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Коэффициенты числителя аппроксимации Паде [m/m] для exp(x)
+const double PADE3[]  = { 120.0, 60.0, 12.0, 1.0 };
+const double PADE5[]  = { 30240.0, 15120.0, 3360.0, 420.0, 30.0, 1.0 };
+const double PADE7[]  = { 17297280.0, 8648640.0, 1995840.0, 277200.0, 25200.0, 1512.0, 56.0, 1.0 };
+const double PADE9[]  = { 17643225600.0, 8821612800.0, 2075673600.0, 302702400.0, 30270240.0,
+                          2162160.0, 110880.0, 3960.0, 90.0, 1.0 };
+const double PADE13[] = { 64764752532480000.0, 32382376266240000.0, 7771770303897600.0,
+                          1187353796428800.0, 129060195264000.0, 10559470521600.0,
+                          670442572800.0, 33522128640.0, 1323241920.0, 40840800.0,
+                          960960.0, 16380.0, 182.0, 1.0 };
+
+// Максимальная норма ||A||_1, при которой аппроксимация степени m
+// дает точность double без масштабирования
+const double THETA3  = 1.495585217958292e-2;
+const double THETA5  = 2.539398330063230e-1;
+const double THETA7  = 9.504178996162932e-1;
+const double THETA9  = 2.097847961257068e0;
+const double THETA13 = 5.371920351148152e0;
+
+} // namespace
+
+Matrix expm(const Matrix & A)
+{
+	checkSquare(A);
+	if ( ! MatrixKernels::allFinite(A.elementCount(), A.data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	const int n = A.getNumRows();
+	const double norm = A.norm1();
+
+	int degree = 13;
+	const double * b = PADE13;
+	if (norm <= THETA3)      { degree = 3; b = PADE3; }
+	else if (norm <= THETA5) { degree = 5; b = PADE5; }
+	else if (norm <= THETA7) { degree = 7; b = PADE7; }
+	else if (norm <= THETA9) { degree = 9; b = PADE9; }
+
+	// Масштабирование: ||A / 2^squarings||_1 <= THETA13
+	int squarings = 0;
+	Matrix scaled(A);
+	if (degree == 13 && norm > THETA13)
+	{
+		squarings = static_cast< int >(std::ceil(std::log2(norm / THETA13)));
+		scaled.scaleAdd(std::ldexp(1.0, -squarings), 0.0, A);
+	}
+
+	// U - нечетная часть числителя, V - четная: r(A) = (V - U)^(-1) * (V + U)
+	Matrix A2(n, n, Matrix::uninitialized), A4(n, n, Matrix::uninitialized), A6(n, n, Matrix::uninitialized);
+	Matrix U(n, n), V(n, n), scratch(n, n);
+	A2.gemm(1.0, scaled, scaled, 0.0);
+	if (degree >= 5)
+	{
+		A4.gemm(1.0, A2, A2, 0.0);
+	}
+	if (degree >= 7)
+	{
+		A6.gemm(1.0, A4, A2, 0.0);
+	}
+
+	if (degree == 13)
+	{
+		// U = A * (A6 * (b13 A6 + b11 A4 + b9 A2) + b7 A6 + b5 A4 + b3 A2 + b1 I)
+		scratch.scaleAdd(0.0, b[13], A6).axpy(b[11], A4).axpy(b[9], A2);
+		V.gemm(1.0, A6, scratch, 0.0);
+		V.axpy(b[7], A6).axpy(b[5], A4).axpy(b[3], A2);
+		addIdentity(V, b[1]);
+		U.gemm(1.0, scaled, V, 0.0);
+
+		// V = A6 * (b12 A6 + b10 A4 + b8 A2) + b6 A6 + b4 A4 + b2 A2 + b0 I
+		scratch.scaleAdd(0.0, b[12], A6).axpy(b[10], A4).axpy(b[8], A2);
+		V.gemm(1.0, A6, scratch, 0.0);
+		V.axpy(b[6], A6).axpy(b[4], A4).axpy(b[2], A2);
+		addIdentity(V, b[0]);
+	}
+	else
+	{
+		// Четные степени A^(2j): A2, A4, A6, A8 (A8 - в буфере U до его использования)
+		Matrix * even[] = { nullptr, &A2, &A4, &A6, &U };
+		if (degree == 9)
+		{
+			U.gemm(1.0, A6, A2, 0.0);
+		}
+		addIdentity(scratch, b[1]);
+		addIdentity(V, b[0]);
+		for (int j = 1; 2 * j <= degree; j++)
+		{
+			scratch.axpy(b[2 * j + 1], *even[j]);
+			V.axpy(b[2 * j], *even[j]);
+		}
+		U.gemm(1.0, scaled, scratch, 0.0);
+	}
+
+	// Решение (V - U) * X = (V + U): P = V + U в scratch, Q = V - U в V
+	scratch.scaleAdd(0.0, 1.0, V).axpy(1.0, U);
+	V.axpy(-1.0, U);
+	std::vector< int > pivots(n);
+	V.detach();
+	scratch.detach();
+	if ( ! MatrixKernels::getrf(n, V.data, V.cols, pivots.data()) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	MatrixKernels::getrs(n, n, V.data, V.cols, pivots.data(), scratch.data, scratch.cols);
+	if ( ! MatrixKernels::allFinite(scratch.elementCount(), scratch.data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+
+	// Возведение в квадрат squarings раз
+	for (int i = 0; i < squarings; i++)
+	{
+		U.gemm(1.0, scratch, scratch, 0.0);
+		std::swap(U, scratch);
+	}
+	return scratch;
+}
+// =================================================================================
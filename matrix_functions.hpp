@@ -0,0 +1,35 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_FUNCTIONS_HPP_
+#define _MATRIX_FUNCTIONS_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <vector>
+
+// Функции от квадратных матриц. Все буферы выделяются заранее, промежуточные
+// произведения вычисляются методом Matrix::gemm поочередно в два буфера
+// ("пинг-понг"), поэтому на каждом шаге память не выделяется.
+// Для неквадратной матрицы генерируется исключение с текстом "Size mismatch",
+// при переполнении - с текстом "Values are out of range".
+
+/*****************************************************************************/
+
+// Степень A^k бинарным возведением: не более 2 * log2(k) умножений.
+// A^0 - единичная матрица.
+Matrix pow(const Matrix & A, unsigned long long k);
+
+// Значение многочлена c[0] * I + c[1] * A + ... + c[d] * A^d по схеме
+// Паттерсона-Стокмейера: около 2 * sqrt(d) умножений матриц вместо d.
+// Для пустого списка коэффициентов возвращается нулевая матрица.
+Matrix polynomial(const Matrix & A, const std::vector< double > & coefficients);
+
+// Матричная экспонента: аппроксимация Паде степени 3, 5, 7, 9 или 13
+// с масштабированием и возведением в квадрат (алгоритм Хайэма, 2005).
+// Для матрицы с бесконечными или NaN элементами бросает ValsOutOfRangeException.
+Matrix expm(const Matrix & A);
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_FUNCTIONS_HPP_
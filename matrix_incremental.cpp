@@ -0,0 +1,393 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_incremental.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+static void checkSquare ( const Matrix & _matrix )
+{
+	if ( _matrix.getNumRows() != _matrix.getNumColumns() )
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+}
+
+// Размеры сомножителей обновления ранга k: U - rows x k, V - k x cols
+static void checkUpdate ( const Matrix & U, const Matrix & V, int rows, int cols )
+{
+	if (U.getNumRows() != rows || V.getNumColumns() != cols || U.getNumColumns() != V.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// CachedProduct
+// ---------------------------------------------------------------------------------
+CachedProduct::CachedProduct(const Matrix & A, const Matrix & B)
+	: left(A), right(B), product(A * B)
+{
+}
+
+const Matrix & CachedProduct::getLeft(void) const
+{
+	return this->left;
+}
+
+const Matrix & CachedProduct::getRight(void) const
+{
+	return this->right;
+}
+
+const Matrix & CachedProduct::getProduct(void) const
+{
+	return this->product;
+}
+
+// Строки произведения зависят только от соответствующих строк A, поэтому
+// новые строки умножаются на B и записываются теми же правилами, что и в A
+void CachedProduct::setLeftRows(const std::vector< int > & rows, const Matrix & values)
+{
+	this->left.scatterRows(rows, values);
+	Matrix rowsProduct(values.getNumRows(), this->right.getNumColumns(), Matrix::uninitialized);
+	rowsProduct.gemm(1.0, values, this->right, 0.0);
+	this->product.scatterRows(rows, rowsProduct);
+}
+
+void CachedProduct::updateLeft(const Matrix & U, const Matrix & V)
+{
+	checkUpdate(U, V, this->left.getNumRows(), this->left.getNumColumns());
+
+	Matrix VB(V.getNumRows(), this->right.getNumColumns(), Matrix::uninitialized);
+	VB.gemm(1.0, V, this->right, 0.0);
+	this->product.gemm(1.0, U, VB, 1.0);
+	this->left.gemm(1.0, U, V, 1.0);
+}
+
+void CachedProduct::updateRight(const Matrix & U, const Matrix & V)
+{
+	checkUpdate(U, V, this->right.getNumRows(), this->right.getNumColumns());
+
+	Matrix AU(this->left.getNumRows(), U.getNumColumns(), Matrix::uninitialized);
+	AU.gemm(1.0, this->left, U, 0.0);
+	this->product.gemm(1.0, AU, V, 1.0);
+	this->right.gemm(1.0, U, V, 1.0);
+}
+
+void CachedProduct::refresh(void)
+{
+	this->product.gemm(1.0, this->left, this->right, 0.0);
+}
+// =================================================================================
+
+
+// =================================================================================
+// UpdatableInverse
+// ---------------------------------------------------------------------------------
+Matrix UpdatableInverse::invert(const Matrix & A)
+{
+	checkSquare(A);
+	const int n = A.rows;
+
+	Matrix lu(A), result(n, n);
+	for (int i = 0; i < n; i++)
+	{
+		result.data[static_cast< std::size_t >(i) * n + i] = 1.0;
+	}
+	std::vector< int > pivots(n);
+	lu.detach();
+	if ( ! MatrixKernels::getrf(n, lu.data, n, pivots.data()) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	MatrixKernels::getrs(n, n, lu.data, n, pivots.data(), result.data, n);
+	if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	return result;
+}
+
+UpdatableInverse::UpdatableInverse(const Matrix & A)
+	: matrix(A), inverse(UpdatableInverse::invert(A))
+{
+}
+
+int UpdatableInverse::getSize(void) const
+{
+	return this->matrix.getNumRows();
+}
+
+const Matrix & UpdatableInverse::getMatrix(void) const
+{
+	return this->matrix;
+}
+
+const Matrix & UpdatableInverse::getInverse(void) const
+{
+	return this->inverse;
+}
+
+// (A + U V)^-1 = A^-1 - A^-1 U (I + V A^-1 U)^-1 V A^-1
+void UpdatableInverse::update(const Matrix & U, const Matrix & V)
+{
+	const int n = this->getSize();
+	checkUpdate(U, V, n, n);
+	const int k = U.cols;
+
+	Matrix AU(n, k, Matrix::uninitialized), VA(k, n, Matrix::uninitialized);
+	AU.gemm(1.0, this->inverse, U, 0.0);
+	VA.gemm(1.0, V, this->inverse, 0.0);
+
+	// Система k x k: (I + V A^-1 U) X = V A^-1, решение записывается в VA
+	Matrix capacitance(k, k, Matrix::uninitialized);
+	capacitance.gemm(1.0, V, AU, 0.0);
+	for (int i = 0; i < k; i++)
+	{
+		capacitance.data[static_cast< std::size_t >(i) * k + i] += 1.0;
+	}
+	std::vector< int > pivots(k);
+	if ( ! MatrixKernels::getrf(k, capacitance.data, k, pivots.data()) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	MatrixKernels::getrs(k, n, capacitance.data, k, pivots.data(), VA.data, n);
+	if ( ! MatrixKernels::allFinite(VA.elementCount(), VA.data) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+
+	this->inverse.gemm(-1.0, AU, VA, 1.0);
+	this->matrix.gemm(1.0, U, V, 1.0);
+}
+
+// Замена строк - обновление с U из единичных столбцов и V = новые строки - старые
+void UpdatableInverse::setRows(const std::vector< int > & rows, const Matrix & values)
+{
+	const int n = this->getSize();
+	if (values.rows != static_cast< int >(rows.size()) || values.cols != n)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+
+	// Для каждого номера строки - последняя записываемая в нее строка values
+	std::vector< int > writer(n, -1);
+	for (std::size_t k = 0; k < rows.size(); k++)
+	{
+		if (rows[k] < 0 || rows[k] >= n)
+		{
+			throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+		}
+		writer[rows[k]] = static_cast< int >(k);
+	}
+	std::vector< int > targets, sources;
+	for (int i = 0; i < n; i++)
+	{
+		if (writer[i] >= 0)
+		{
+			targets.push_back(i);
+			sources.push_back(writer[i]);
+		}
+	}
+
+	const int k = static_cast< int >(targets.size());
+	Matrix U(n, k);
+	for (int j = 0; j < k; j++)
+	{
+		U.data[static_cast< std::size_t >(targets[j]) * k + j] = 1.0;
+	}
+	Matrix V = values.selectRows(sources);
+	V.axpy(-1.0, this->matrix.selectRows(targets));
+	this->update(U, V);
+}
+
+Matrix UpdatableInverse::solve(const Matrix & B) const
+{
+	if (B.rows != this->getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(B.rows, B.cols, Matrix::uninitialized);
+	result.gemm(1.0, this->inverse, B, 0.0);
+	return result;
+}
+
+void UpdatableInverse::refresh(void)
+{
+	this->inverse = UpdatableInverse::invert(this->matrix);
+}
+// =================================================================================
+
+
+// =================================================================================
+// CholeskyFactorization
+// ---------------------------------------------------------------------------------
+// Построчный вариант с правосторонним обновлением: строка k множителя R
+// делится на R(k, k), затем из строк j > k оставшегося треугольника
+// вычитается R(k, j) * R(k, :). Строки обновляются параллельно.
+CholeskyFactorization::CholeskyFactorization(const Matrix & A)
+	: factor(A.rows, A.cols)
+{
+	checkSquare(A);
+	const int n = A.rows;
+	double * R = this->factor.data;
+	for (int i = 0; i < n; i++)
+	{
+		std::copy(A.data + static_cast< std::size_t >(i) * n + i, A.data + static_cast< std::size_t >(i + 1) * n,
+		          R + static_cast< std::size_t >(i) * n + i);
+	}
+
+	for (int k = 0; k < n; k++)
+	{
+		double * rowK = R + static_cast< std::size_t >(k) * n;
+		// Отрицательная или нулевая (в том числе NaN) диагональ
+		if ( ! (rowK[k] > 0.0) )
+		{
+			throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+		}
+		rowK[k] = std::sqrt(rowK[k]);
+		MatrixKernels::scale(n - k - 1, 1.0 / rowK[k], rowK + k + 1);
+
+		ThreadPool::RangeBody body = [ = ] (std::size_t from, std::size_t to)
+		{
+			for (std::size_t j = from; j < to; j++)
+			{
+				MatrixKernels::axpy(n - j, -rowK[j], rowK + j, R + j * n + j);
+			}
+		};
+		const std::size_t trailing = static_cast< std::size_t >(n - k - 1);
+		if (trailing * trailing / 2 >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+		{
+			ThreadPool::instance().parallelFor(k + 1, n,
+				std::max< std::size_t >(1, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4 / trailing), body);
+		}
+		else
+		{
+			body(k + 1, n);
+		}
+	}
+}
+
+int CholeskyFactorization::getSize(void) const
+{
+	return this->factor.getNumRows();
+}
+
+const Matrix & CholeskyFactorization::getFactor(void) const
+{
+	return this->factor;
+}
+
+// R^T Y = B, затем R X = Y. Для первого решения строится R^T, так как trsm
+// читает треугольник без транспонирования.
+Matrix CholeskyFactorization::solve(const Matrix & B) const
+{
+	const int n = this->getSize();
+	if (B.rows != n)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+
+	Matrix lower(n, n, Matrix::uninitialized);
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			lower.data[static_cast< std::size_t >(i) * n + j] = this->factor.data[static_cast< std::size_t >(j) * n + i];
+		}
+	}
+	Matrix result(B);
+	result.detach();
+	MatrixKernels::trsm(true, false, false, n, B.cols, lower.data, n, result.data, B.cols);
+	MatrixKernels::trsm(true, true, false, n, B.cols, this->factor.data, n, result.data, B.cols);
+	return result;
+}
+
+// Строка k множителя поворачивается вместе с остатком x (гиперболически при
+// sign < 0); строки R читаются непрерывно
+void CholeskyFactorization::rankOneUpdate(double * x, double sign)
+{
+	const int n = this->getSize();
+	this->factor.detach();
+	double * R = this->factor.data;
+	for (int k = 0; k < n; k++)
+	{
+		double * rowK = R + static_cast< std::size_t >(k) * n;
+		const double squared = rowK[k] * rowK[k] + sign * x[k] * x[k];
+		if ( ! (squared > 0.0) )
+		{
+			throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+		}
+		const double r = std::sqrt(squared);
+		const double c = r / rowK[k], s = x[k] / rowK[k];
+		rowK[k] = r;
+		for (int i = k + 1; i < n; i++)
+		{
+			rowK[i] = (rowK[i] + sign * s * x[i]) / c;
+			x[i] = c * x[i] - s * rowK[i];
+		}
+	}
+}
+
+void CholeskyFactorization::update(const Vector & x)
+{
+	if (x.getSize() != this->getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	std::vector< double > work(x.getData(), x.getData() + x.getSize());
+	this->rankOneUpdate(work.data(), 1.0);
+}
+
+void CholeskyFactorization::update(const Matrix & X)
+{
+	const int n = this->getSize();
+	if (X.rows != n)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	std::vector< double > work(n);
+	for (int j = 0; j < X.cols; j++)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			work[i] = X.data[static_cast< std::size_t >(i) * X.cols + j];
+		}
+		this->rankOneUpdate(work.data(), 1.0);
+	}
+}
+
+// A - x x^T положительно определена тогда и только тогда, когда |p| < 1 для
+// R^T p = x; проверка выполняется до изменения множителя
+void CholeskyFactorization::downdate(const Vector & x)
+{
+	const int n = this->getSize();
+	if (x.getSize() != n)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const double * R = this->factor.data;
+	std::vector< double > p(x.getData(), x.getData() + n);
+	for (int k = 0; k < n; k++)
+	{
+		const double * rowK = R + static_cast< std::size_t >(k) * n;
+		p[k] /= rowK[k];
+		MatrixKernels::axpy(n - k - 1, -p[k], rowK + k + 1, p.data() + k + 1);
+	}
+	if ( ! (MatrixKernels::dot(n, p.data(), p.data()) < 1.0) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+
+	std::vector< double > work(x.getData(), x.getData() + n);
+	this->rankOneUpdate(work.data(), -1.0);
+}
+// =================================================================================
@@ -0,0 +1,142 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_INCREMENTAL_HPP_
+#define _MATRIX_INCREMENTAL_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+#include "vector.hpp"
+
+#include <vector>
+
+// Поддержание результатов при малых изменениях исходных данных без полного
+// пересчета. Обновление ранга k везде записывается как A += U * V, где U имеет
+// размер n x k, а V - k x n (для CachedProduct - согласно размерам A).
+//  - CachedProduct хранит A, B и C = A * B. Замена строк A пересчитывает только
+//    эти строки C; обновления ранга k добавляют к C произведение через
+//    промежуточную матрицу ранга k.
+//  - UpdatableInverse хранит A^-1 и обновляет его по формуле
+//    Шермана-Моррисона-Вудбери за O(n^2 k) вместо O(n^3).
+//  - CholeskyFactorization хранит множитель Холецкого A = R^T * R и
+//    обновляет его при A +- x * x^T вращениями за O(n^2).
+// Погрешность округления накапливается с каждым обновлением, refresh()
+// пересчитывает результат по текущим исходным данным.
+
+/*****************************************************************************/
+
+class CachedProduct
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	Matrix left;
+	Matrix right;
+	Matrix product;
+
+public:
+
+	// Если количество столбцов A не совпадает с количеством строк B,
+	// генерируется исключение с текстом "Size mismatch"
+	CachedProduct(const Matrix & A, const Matrix & B);
+
+	const Matrix & getLeft(void) const;
+	const Matrix & getRight(void) const;
+	const Matrix & getProduct(void) const;
+
+	// A(rows[k], :) = values(k, :); пересчитываются только строки rows
+	// произведения за O(k n p). Правила для размеров, номеров и повторов -
+	// как в Matrix::scatterRows.
+	void setLeftRows(const std::vector< int > & rows, const Matrix & values);
+
+	// A += U * V, C += U * (V * B): O(k (n p + m p)) вместо O(m n p)
+	void updateLeft(const Matrix & U, const Matrix & V);
+
+	// B += U * V, C += (A * U) * V: O(k (m n + m p))
+	void updateRight(const Matrix & U, const Matrix & V);
+
+	// C = A * B заново
+	void refresh(void);
+};
+
+/*****************************************************************************/
+
+class UpdatableInverse
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	Matrix matrix;
+	Matrix inverse;
+
+	// Обратная матрица через LU-разложение. Для вырожденной матрицы
+	// генерируется исключение с текстом "Singular matrix".
+	static Matrix invert(const Matrix & A);
+
+public:
+
+	// Для неквадратной матрицы генерируется исключение с текстом "Size mismatch",
+	// для вырожденной - с текстом "Singular matrix"
+	explicit UpdatableInverse(const Matrix & A);
+
+	int getSize(void) const;
+
+	const Matrix & getMatrix(void) const;
+	const Matrix & getInverse(void) const;
+
+	// A += U * V. Решается только система k x k (I + V * A^-1 * U). Если
+	// обновленная матрица вырождена, генерируется исключение с текстом
+	// "Singular matrix", а матрица и обратная к ней не изменяются.
+	void update(const Matrix & U, const Matrix & V);
+
+	// A(rows[k], :) = values(k, :) как обновление ранга, равного количеству
+	// различных номеров (при повторах записывается последняя строка)
+	void setRows(const std::vector< int > & rows, const Matrix & values);
+
+	// X = A^-1 * B
+	Matrix solve(const Matrix & B) const;
+
+	// A^-1 заново по текущей матрице
+	void refresh(void);
+};
+
+/*****************************************************************************/
+
+class CholeskyFactorization
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	// Верхнетреугольный множитель R (под диагональю - нули)
+	Matrix factor;
+
+	// R^T R += sign * x x^T; x используется как рабочий массив
+	void rankOneUpdate(double * x, double sign);
+
+public:
+
+	// Разложение симметричной положительно определенной матрицы (читается
+	// верхний треугольник). Для неквадратной матрицы генерируется исключение с
+	// текстом "Size mismatch", для не положительно определенной - с текстом
+	// "Singular matrix".
+	explicit CholeskyFactorization(const Matrix & A);
+
+	int getSize(void) const;
+
+	// Множитель R: A = R^T * R
+	const Matrix & getFactor(void) const;
+
+	// X = A^-1 * B двумя треугольными решениями
+	Matrix solve(const Matrix & B) const;
+
+	// A + x * x^T и A + X * X^T (X размера n x k - k обновлений ранга 1)
+	void update(const Vector & x);
+	void update(const Matrix & X);
+
+	// A - x * x^T. Если результат не положительно определен, генерируется
+	// исключение с текстом "Singular matrix", множитель не изменяется.
+	void downdate(const Vector & x);
+};
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_INCREMENTAL_HPP_
@@ -0,0 +1,2200 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_kernels.hpp"
+#include "matrix_simd.hpp"
+#include "matrix_tuning.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#if defined( __linux__ )
+#include <unistd.h>
+#endif
+
+// Отключение слияния умножения и сложения в FMA для ядер воспроизводимого 
+// режима. Clang по умолчанию сливает операции только внутри одного выражения,
+// поэтому для него достаточно раздельных операторов.
+#if defined( __GNUC__ ) && ! defined( __clang__ )
+#define MATRIX_NO_FP_CONTRACT __attribute__(( optimize( "fp-contract=off" ) ))
+#else
+#define MATRIX_NO_FP_CONTRACT
+#endif
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Воспроизводимый режим (см. MatrixKernels::setReproducible)
+bool reproducibleFromEnvironment ()
+{
+    const char * value = std::getenv( "MATRIX_REPRODUCIBLE" );
+    return value != nullptr && std::atoi( value ) != 0;
+}
+
+std::atomic< bool > reproducibleMode( reproducibleFromEnvironment() );
+
+// Количество дорожек суммирования воспроизводимых ядер; не зависит от ширины SIMD
+const std::size_t EXACT_LANES = 8;
+
+
+// Размеры блоков GEMM по умолчанию: блок A (MC x KC) помещается в L2, 
+// строка блока B (KC x NC) - в L1 при проходе по j. Фактические размеры 
+// берутся из GemmConfig; константы используются воспроизводимым режимом
+// и умножением со смешанной точностью.
+const int GEMM_MC = 64;
+const int GEMM_KC = 256;
+const int GEMM_NC = 512;
+const int GEMM_UNROLL = 4;
+constexpr double GEMM_PARALLEL_WORK = static_cast< double >( MatrixKernels::PARALLEL_MIN_ELEMENTS ) * 64;
+
+// Текущая конфигурация GEMM. Инициализируется константами (до начала 
+// динамической инициализации), кэш автонастройки загружается при первом обращении,
+// если конфигурация еще не установлена явно (gemmConfigSet).
+std::mutex gemmConfigMutex;
+std::once_flag gemmConfigLoaded;
+std::atomic< bool > gemmConfigSet( false );
+MatrixKernels::GemmConfig currentGemmConfig = { GEMM_MC, GEMM_KC, GEMM_NC, GEMM_UNROLL, GEMM_PARALLEL_WORK };
+
+// Рабочий буфер для упаковки транспонированных блоков B. Свой для каждого потока,
+// растет до максимального требуемого размера и далее не перевыделяется.
+double * packBuffer ( std::size_t n )
+{
+    static thread_local std::vector< double > buffer;
+    if ( buffer.size() < n )
+    {
+        buffer.resize( n );
+    }
+    return buffer.data();
+}
+
+// Элемент op(A)(i, p)
+inline double elementAt ( const double * A, int lda, bool trans, int i, int p )
+{
+    return trans ? A[ static_cast< std::size_t >( p ) * lda + i ] 
+                 : A[ static_cast< std::size_t >( i ) * lda + p ];
+}
+
+// Микроядро: c[0..n) += a0*b0[] + a1*b1[] + a2*b2[] + a3*b3[].
+// Четыре строки B за проход сокращают число чтений/записей C вчетверо.
+inline void updateRow4 ( 
+        int n, double * __restrict__ c
+    ,   double a0, const double * __restrict__ b0
+    ,   double a1, const double * __restrict__ b1
+    ,   double a2, const double * __restrict__ b2
+    ,   double a3, const double * __restrict__ b3 
+)
+{
+    for ( int j = 0; j < n; j++ )
+    {
+        c[ j ] += a0 * b0[ j ] + a1 * b1[ j ] + a2 * b2[ j ] + a3 * b3[ j ];
+    }
+}
+
+inline void updateRow1 ( int n, double * __restrict__ c, double a0, const double * __restrict__ b0 )
+{
+    for ( int j = 0; j < n; j++ )
+    {
+        c[ j ] += a0 * b0[ j ];
+    }
+}
+
+inline void updateRow2 ( 
+        int n, double * __restrict__ c
+    ,   double a0, const double * __restrict__ b0
+    ,   double a1, const double * __restrict__ b1
+)
+{
+    for ( int j = 0; j < n; j++ )
+    {
+        c[ j ] += a0 * b0[ j ] + a1 * b1[ j ];
+    }
+}
+
+// Восемь строк B за проход: b - первая строка, ldb - шаг между строками
+inline void updateRow8 ( int n, double * __restrict__ c, const double * a, const double * __restrict__ b, int ldb )
+{
+    const double * __restrict__ b4 = b + 4 * static_cast< std::size_t >( ldb );
+    for ( int j = 0; j < n; j++ )
+    {
+        c[ j ] += ( a[ 0 ] * b[ j ] + a[ 1 ] * b[ j + ldb ] + a[ 2 ] * b[ j + 2 * ldb ] + a[ 3 ] * b[ j + 3 * ldb ] )
+                + ( a[ 4 ] * b4[ j ] + a[ 5 ] * b4[ j + ldb ] + a[ 6 ] * b4[ j + 2 * ldb ] + a[ 7 ] * b4[ j + 3 * ldb ] );
+    }
+}
+
+// Варианты микроядер без FMA для воспроизводимого режима
+MATRIX_NO_FP_CONTRACT void updateRow4Exact ( 
+        int n, double * __restrict__ c
+    ,   double a0, const double * __restrict__ b0
+    ,   double a1, const double * __restrict__ b1
+    ,   double a2, const double * __restrict__ b2
+    ,   double a3, const double * __restrict__ b3 
+)
+{
+    for ( int j = 0; j < n; j++ )
+    {
+        const double p0 = a0 * b0[ j ];
+        const double p1 = a1 * b1[ j ];
+        const double p2 = a2 * b2[ j ];
+        const double p3 = a3 * b3[ j ];
+        const double s = ( ( p0 + p1 ) + p2 ) + p3;
+        c[ j ] += s;
+    }
+}
+
+MATRIX_NO_FP_CONTRACT void updateRow1Exact ( int n, double * __restrict__ c, double a0, const double * __restrict__ b0 )
+{
+    for ( int j = 0; j < n; j++ )
+    {
+        const double p = a0 * b0[ j ];
+        c[ j ] += p;
+    }
+}
+
+// Количество строк на одну часть parallelFor, чтобы часть содержала
+// не меньше PARALLEL_MIN_ELEMENTS / 4 элементов
+inline std::size_t rowGrain ( int n )
+{
+    return std::max< std::size_t >( 1, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4 / std::max( n, 1 ) );
+}
+
+// Размер блока редукций. Разбиение на блоки фиксировано и не зависит от 
+// количества потоков, поэтому результат суммирования воспроизводим.
+const std::size_t REDUCTION_BLOCK = 4096;
+
+// Вычисляет blockFn(from, to) для каждого блока REDUCTION_BLOCK элементов
+// (параллельно для больших n) и возвращает частичные результаты по порядку блоков
+template< typename T, typename BlockFn >
+std::vector< T > reduceBlocks ( std::size_t n, BlockFn blockFn )
+{
+    const std::size_t blocks = ( n + REDUCTION_BLOCK - 1 ) / REDUCTION_BLOCK;
+    std::vector< T > partial( blocks );
+    ThreadPool::RangeBody body = [ & ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t b = from; b < to; b++ )
+        {
+            partial[ b ] = blockFn( b * REDUCTION_BLOCK, std::min( n, ( b + 1 ) * REDUCTION_BLOCK ) );
+        }
+    };
+    if ( n >= MatrixKernels::PARALLEL_MIN_ELEMENTS )
+    {
+        ThreadPool::instance().parallelFor( 0, blocks, 1, body );
+    }
+    else
+    {
+        body( 0, blocks );
+    }
+    return partial;
+}
+
+double pairwiseSumExact ( const double * x, std::size_t n );
+
+// Попарное (каскадное) суммирование: погрешность растет как O(log n) вместо O(n).
+// Листья по 8 * width элементов суммируются SIMD-аккумуляторами.
+double pairwiseSum ( const double * x, std::size_t n )
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) )
+    {
+        return pairwiseSumExact( x, n );
+    }
+    using namespace MatrixSimd;
+    const std::size_t leaf = 8 * Pack::width;
+
+    if ( n <= 16 * leaf )
+    {
+        Pack acc[ 8 ];
+        for ( int j = 0; j < 8; j++ )
+        {
+            acc[ j ] = Pack::zero();
+        }
+        std::size_t i = 0;
+        for ( ; i + leaf <= n; i += leaf )
+        {
+            for ( int j = 0; j < 8; j++ )
+            {
+                acc[ j ] = acc[ j ] + Pack::load( x + i + j * Pack::width );
+            }
+        }
+        Pack total = ( ( acc[ 0 ] + acc[ 1 ] ) + ( acc[ 2 ] + acc[ 3 ] ) ) 
+                   + ( ( acc[ 4 ] + acc[ 5 ] ) + ( acc[ 6 ] + acc[ 7 ] ) );
+        double result = horizontalSum( total );
+        for ( ; i < n; i++ )
+        {
+            result += x[ i ];
+        }
+        return result;
+    }
+
+    // Делим по границе листа, чтобы SIMD-часть оставалась полной
+    const std::size_t half = ( n / 2 / leaf ) * leaf;
+    return pairwiseSum( x, half ) + pairwiseSum( x + half, n - half );
+}
+
+// Свертка дорожек воспроизводимых ядер фиксированным деревом
+inline double combineLanes ( const double * lane )
+{
+    return ( ( lane[ 0 ] + lane[ 1 ] ) + ( lane[ 2 ] + lane[ 3 ] ) ) 
+         + ( ( lane[ 4 ] + lane[ 5 ] ) + ( lane[ 6 ] + lane[ 7 ] ) );
+}
+
+// Воспроизводимое попарное суммирование: листья по 16 * EXACT_LANES элементов,
+// элемент i листа попадает в дорожку i % EXACT_LANES
+double pairwiseSumExact ( const double * x, std::size_t n )
+{
+    const std::size_t leaf = 16 * EXACT_LANES;
+    if ( n <= leaf )
+    {
+        double lane[ EXACT_LANES ] = { 0.0 };
+        for ( std::size_t i = 0; i < n; i++ )
+        {
+            lane[ i % EXACT_LANES ] += x[ i ];
+        }
+        return combineLanes( lane );
+    }
+    const std::size_t half = std::max< std::size_t >( n / 2 / leaf, 1 ) * leaf;
+    return pairwiseSumExact( x, half ) + pairwiseSumExact( x + half, n - half );
+}
+
+MATRIX_NO_FP_CONTRACT double dotExact ( std::size_t n, const double * x, const double * y )
+{
+    double lane[ EXACT_LANES ] = { 0.0 };
+    std::size_t i = 0;
+    for ( ; i + EXACT_LANES <= n; i += EXACT_LANES )
+    {
+        for ( std::size_t l = 0; l < EXACT_LANES; l++ )
+        {
+            const double p = x[ i + l ] * y[ i + l ];
+            lane[ l ] += p;
+        }
+    }
+    for ( std::size_t l = 0; i < n; i++, l++ )
+    {
+        const double p = x[ i ] * y[ i ];
+        lane[ l ] += p;
+    }
+    return combineLanes( lane );
+}
+
+double absSumExact ( std::size_t n, const double * x )
+{
+    double lane[ EXACT_LANES ] = { 0.0 };
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        lane[ i % EXACT_LANES ] += std::fabs( x[ i ] );
+    }
+    return combineLanes( lane );
+}
+
+MATRIX_NO_FP_CONTRACT void axpyExact ( std::size_t n, double alpha, const double * x, double * y )
+{
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        const double p = alpha * x[ i ];
+        y[ i ] += p;
+    }
+}
+
+MATRIX_NO_FP_CONTRACT void axpbyExact ( std::size_t n, double alpha, const double * x, double beta, double * y )
+{
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        const double p = alpha * x[ i ];
+        const double q = beta * y[ i ];
+        y[ i ] = p + q;
+    }
+}
+
+// Сумма квадратов блока (для евклидовой нормы)
+double blockSumSquares ( const double * x, std::size_t n )
+{
+    return MatrixKernels::dot( n, x, x );
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Воспроизводимый режим
+// ---------------------------------------------------------------------------------
+void MatrixKernels::setReproducible ( bool enabled )
+{
+    reproducibleMode.store( enabled );
+}
+
+bool MatrixKernels::isReproducible ()
+{
+    return reproducibleMode.load();
+}
+// =================================================================================
+
+
+// =================================================================================
+// Векторные операции
+// ---------------------------------------------------------------------------------
+void MatrixKernels::scale ( std::size_t n, double alpha, double * x )
+{
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        x[ i ] *= alpha;
+    }
+}
+
+void MatrixKernels::axpy ( std::size_t n, double alpha, const double * x, double * y )
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) )
+    {
+        axpyExact( n, alpha, x, y );
+        return;
+    }
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        y[ i ] += alpha * x[ i ];
+    }
+}
+
+void MatrixKernels::axpby ( std::size_t n, double alpha, const double * x, double beta, double * y )
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) && beta != 0.0 )
+    {
+        axpbyExact( n, alpha, x, beta, y );
+        return;
+    }
+    if ( beta == 0.0 )
+    {
+        for ( std::size_t i = 0; i < n; i++ )
+        {
+            y[ i ] = alpha * x[ i ];
+        }
+        return;
+    }
+
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        y[ i ] = alpha * x[ i ] + beta * y[ i ];
+    }
+}
+
+bool MatrixKernels::allFinite ( std::size_t n, const double * x )
+{
+    // x - x равно 0 для конечных значений и NaN для inf/NaN, а NaN сохраняется
+    // при сложении. Два SIMD-аккумулятора без ветвлений, проверка - один раз в конце.
+    using namespace MatrixSimd;
+    Pack acc0 = Pack::zero(), acc1 = Pack::zero();
+    std::size_t i = 0;
+    for ( ; i + 2 * Pack::width <= n; i += 2 * Pack::width )
+    {
+        const Pack v0 = Pack::load( x + i );
+        const Pack v1 = Pack::load( x + i + Pack::width );
+        acc0 = acc0 + ( v0 - v0 );
+        acc1 = acc1 + ( v1 - v1 );
+    }
+    double acc = horizontalSum( acc0 + acc1 );
+    for ( ; i < n; i++ )
+    {
+        acc += x[ i ] - x[ i ];
+    }
+    return acc == 0.0;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Поэлементные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+using MatrixSimd::Pack;
+
+// Применяет f к полным пакетам, остаток дополняется до пакета, чтобы все
+// элементы вычислялись одним и тем же кодом
+template< typename F >
+inline void mapPacked ( std::size_t n, const double * x, double * y, F f )
+{
+    std::size_t i = 0;
+    for ( ; i + Pack::width <= n; i += Pack::width )
+    {
+        f( Pack::load( x + i ) ).store( y + i );
+    }
+    if ( i < n )
+    {
+        double lanes[ Pack::width ] = { 0.0 };
+        std::copy( x + i, x + n, lanes );
+        f( Pack::load( lanes ) ).store( lanes );
+        std::copy( lanes, lanes + ( n - i ), y + i );
+    }
+}
+
+// ln 2 = LN2_HI + LN2_LO; у LN2_HI 32 значащих бита, поэтому n * LN2_HI
+// вычисляется точно для |n| < 2^21 (редукция Коди-Уэйта)
+const double LN2_HI = 6.93147180369123816490e-01;
+const double LN2_LO = 1.90821492927058770002e-10;
+const double LOG2E  = 1.44269504088896338700e+00;
+
+// e^x = 2^n * (1 + q), где r = x - n * ln 2, |r| <= ln 2 / 2, а q = e^r - 1
+// вычисляется рядом Тейлора до r^13 (отброшенный член меньше 5e-18)
+inline Pack expReduced ( Pack x, Pack & n )
+{
+    using namespace MatrixSimd;
+    n = roundNearest( x * Pack::broadcast( LOG2E ) );
+    Pack r = fmadd( n, Pack::broadcast( -LN2_HI ), x );
+    r = fmadd( n, Pack::broadcast( -LN2_LO ), r );
+
+    static const double coefficients[] = {
+        1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+        1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+        1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0
+    };
+    Pack p = Pack::broadcast( coefficients[ 0 ] );
+    for ( std::size_t k = 1; k < sizeof( coefficients ) / sizeof( coefficients[ 0 ] ); k++ )
+    {
+        p = fmadd( p, r, Pack::broadcast( coefficients[ k ] ) );
+    }
+    return fmadd( r * r, p, r );
+}
+
+inline Pack expPack ( Pack x )
+{
+    using namespace MatrixSimd;
+    // За пределами [-746, 710] результат - ноль или бесконечность; NaN
+    // проходит через min и max (возвращается второй операнд)
+    x = max( Pack::broadcast( -746.0 ), min( Pack::broadcast( 710.0 ), x ) );
+    Pack n;
+    const Pack q = expReduced( x, n );
+
+    // 2^n = 2^nHi * 2^nLo: обе половины нормализованы, поэтому переполнение
+    // и денормализованные результаты получаются при последнем умножении
+    const Pack nHi = roundNearest( n * Pack::broadcast( 0.5 ) - Pack::broadcast( 0.25 ) );
+    const Pack nLo = n - nHi;
+    return ( ( Pack::broadcast( 1.0 ) + q ) * pow2( nHi ) ) * pow2( nLo );
+}
+
+// e^x - 1 для |x| <= 40 без потери точности около нуля
+inline Pack expm1Pack ( Pack x )
+{
+    using namespace MatrixSimd;
+    Pack n;
+    const Pack q = expReduced( x, n );
+    const Pack s = pow2( n );
+    return fmadd( s, q, s - Pack::broadcast( 1.0 ) );
+}
+
+inline Pack logPack ( Pack x )
+{
+    using namespace MatrixSimd;
+    const Pack one = Pack::broadcast( 1.0 );
+
+    // Денормализованные аргументы предварительно умножаются на 2^54
+    const Pack tiny = lessThan( x, Pack::broadcast( 2.2250738585072014e-308 ) );
+    const Pack scaled = select( tiny, x * Pack::broadcast( 18014398509481984.0 ), x );
+    Pack m, e;
+    splitExponent( scaled, m, e );
+    e = e - select( tiny, Pack::broadcast( 54.0 ), Pack::zero() );
+
+    // m из [sqrt(2) / 2, sqrt(2)): f = m - 1 вычисляется точно
+    const Pack large = lessThan( Pack::broadcast( 1.4142135623730951 ), m );
+    m = select( large, m * Pack::broadcast( 0.5 ), m );
+    e = e + select( large, one, Pack::zero() );
+    const Pack f = m - one;
+
+    // log(1 + f) = 2 * atanh(s) = f - hfsq + s * (hfsq + R), где s = f / (2 + f),
+    // hfsq = f^2 / 2, R = z * (2/3 + 2z/5 + ...), z = s^2 <= 0.0295 (ряд до z^11).
+    // Главный член f точен, поэтому погрешность вносят только поправки.
+    const Pack s = f / ( Pack::broadcast( 2.0 ) + f );
+    const Pack z = s * s;
+    Pack p = Pack::broadcast( 2.0 / 23.0 );
+    for ( int k = 21; k >= 3; k -= 2 )
+    {
+        p = fmadd( p, z, Pack::broadcast( 2.0 / k ) );
+    }
+    const Pack R = z * p;
+    const Pack hfsq = Pack::broadcast( 0.5 ) * f * f;
+    const Pack correction = fmadd( s, hfsq + R, e * Pack::broadcast( LN2_LO ) );
+    Pack result = fmadd( e, Pack::broadcast( LN2_HI ), f - ( hfsq - correction ) );
+
+    const double infinity = std::numeric_limits< double >::infinity();
+    result = select( equalTo( x, Pack::broadcast( infinity ) ), x, result );
+    result = select( equalTo( x, Pack::zero() ), Pack::broadcast( -infinity ), result );
+    return select( isNan( x ) | lessThan( x, Pack::zero() ),
+                   Pack::broadcast( std::numeric_limits< double >::quiet_NaN() ), result );
+}
+
+// tanh(x) = u / (u + 2), u = e^(2|x|) - 1; при |x| >= 20 tanh округляется до 1
+inline Pack tanhPack ( Pack x )
+{
+    using namespace MatrixSimd;
+    const Pack a = min( Pack::broadcast( 20.0 ), abs( x ) );
+    const Pack u = expm1Pack( a + a );
+    return copySign( u / ( u + Pack::broadcast( 2.0 ) ), x );
+}
+
+// Через z = e^(-|x|) <= 1: 1 / (1 + z) для x >= 0 и z / (1 + z) для x < 0,
+// так что e^(-x) не переполняется
+inline Pack sigmoidPack ( Pack x )
+{
+    using namespace MatrixSimd;
+    const Pack z = expPack( Pack::zero() - abs( x ) );
+    const Pack positive = Pack::broadcast( 1.0 ) / ( Pack::broadcast( 1.0 ) + z );
+    return select( lessThan( x, Pack::zero() ), z * positive, positive );
+}
+
+} // namespace
+
+void MatrixKernels::multiplyElements ( std::size_t n, const double * x, const double * y, double * z )
+{
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        z[ i ] = x[ i ] * y[ i ];
+    }
+}
+
+void MatrixKernels::divideElements ( std::size_t n, const double * x, const double * y, double * z )
+{
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        z[ i ] = x[ i ] / y[ i ];
+    }
+}
+
+void MatrixKernels::combineElements ( ElementOperation op, std::size_t n, const double * x, const double * y, double * z )
+{
+    switch ( op )
+    {
+        case AddOperation:
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] + y[ i ];
+            }
+            break;
+        case SubtractOperation:
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] - y[ i ];
+            }
+            break;
+        case MultiplyOperation:
+            multiplyElements( n, x, y, z );
+            break;
+        case DivideOperation:
+            divideElements( n, x, y, z );
+            break;
+    }
+}
+
+void MatrixKernels::combineScalar ( ElementOperation op, std::size_t n, const double * x, double alpha, double * z )
+{
+    switch ( op )
+    {
+        case AddOperation:
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] + alpha;
+            }
+            break;
+        case SubtractOperation:
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] - alpha;
+            }
+            break;
+        case MultiplyOperation:
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] * alpha;
+            }
+            break;
+        case DivideOperation:
+            // Деление, а не умножение на 1 / alpha: результат совпадает с x / alpha
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                z[ i ] = x[ i ] / alpha;
+            }
+            break;
+    }
+}
+
+void MatrixKernels::vexp ( std::size_t n, const double * x, double * y )
+{
+    mapPacked( n, x, y, expPack );
+}
+
+void MatrixKernels::vlog ( std::size_t n, const double * x, double * y )
+{
+    mapPacked( n, x, y, logPack );
+}
+
+void MatrixKernels::vtanh ( std::size_t n, const double * x, double * y )
+{
+    mapPacked( n, x, y, tanhPack );
+}
+
+void MatrixKernels::vsigmoid ( std::size_t n, const double * x, double * y )
+{
+    mapPacked( n, x, y, sigmoidPack );
+}
+
+void MatrixKernels::vrelu ( std::size_t n, const double * x, double * y )
+{
+    // max возвращает второй операнд, если один из них NaN
+    mapPacked( n, x, y, [] ( Pack v ) { return MatrixSimd::max( Pack::zero(), v ); } );
+}
+// =================================================================================
+
+
+// =================================================================================
+// Потоковые поэлементные операции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Элементов double в строке кэша: один проход цикла записывает строку целиком
+const std::size_t LINE_ELEMENTS = 8;
+
+// Расстояние программной предвыборки источников в элементах (16 строк кэша -
+// примерно столько строк успевает прийти из памяти за время обработки одной)
+const std::size_t PREFETCH_ELEMENTS = 16 * LINE_ELEMENTS;
+
+// Объем кэша последнего уровня, если его не удалось определить
+const std::size_t DEFAULT_STREAMING_BYTES = std::size_t( 8 ) << 20;
+
+std::size_t streamingBytesFromEnvironment ()
+{
+    if ( const char * value = std::getenv( "MATRIX_STREAMING_BYTES" ) )
+    {
+        return static_cast< std::size_t >( std::strtoull( value, nullptr, 10 ) );
+    }
+#if defined( __linux__ ) && defined( _SC_LEVEL3_CACHE_SIZE )
+    const long l3 = sysconf( _SC_LEVEL3_CACHE_SIZE );
+    if ( l3 > 0 )
+    {
+        return static_cast< std::size_t >( l3 );
+    }
+    const long l2 = sysconf( _SC_LEVEL2_CACHE_SIZE );
+    if ( l2 > 0 )
+    {
+        return static_cast< std::size_t >( l2 );
+    }
+#endif
+    return DEFAULT_STREAMING_BYTES;
+}
+
+std::atomic< std::size_t > streamingBytes( streamingBytesFromEnvironment() );
+
+// Операции потоковых ядер: значение пакета и отдельного элемента по индексу,
+// признак недопустимого результата (маска для пакета) и предвыборка источников
+struct AddStream
+{
+    const double * x;
+    const double * y;
+
+    Pack pack ( std::size_t i ) const { return Pack::load( x + i ) + Pack::load( y + i ); }
+    double element ( std::size_t i ) const { return x[ i ] + y[ i ]; }
+    Pack invalid ( std::size_t, Pack r ) const { return MatrixSimd::isNan( r - r ); }
+    bool invalid ( std::size_t, double r ) const { return r - r != 0.0; }
+    void prefetch ( std::size_t i ) const { MatrixSimd::prefetchOnce( x + i ); MatrixSimd::prefetchOnce( y + i ); }
+};
+
+struct SubtractStream
+{
+    const double * x;
+    const double * y;
+
+    Pack pack ( std::size_t i ) const { return Pack::load( x + i ) - Pack::load( y + i ); }
+    double element ( std::size_t i ) const { return x[ i ] - y[ i ]; }
+    Pack invalid ( std::size_t, Pack r ) const { return MatrixSimd::isNan( r - r ); }
+    bool invalid ( std::size_t, double r ) const { return r - r != 0.0; }
+    void prefetch ( std::size_t i ) const { MatrixSimd::prefetchOnce( x + i ); MatrixSimd::prefetchOnce( y + i ); }
+};
+
+struct ScaleStream
+{
+    const double * x;
+    double alpha;
+
+    Pack pack ( std::size_t i ) const { return Pack::load( x + i ) * Pack::broadcast( alpha ); }
+    double element ( std::size_t i ) const { return x[ i ] * alpha; }
+    Pack invalid ( std::size_t, Pack r ) const { return MatrixSimd::isNan( r - r ); }
+    bool invalid ( std::size_t, double r ) const { return r - r != 0.0; }
+    void prefetch ( std::size_t i ) const { MatrixSimd::prefetchOnce( x + i ); }
+};
+
+// z[i] = op(i) для i из [from, to). Возвращает false, если хотя бы один
+// результат недопустим. При записи в обход кэша начало обрабатывается 
+// поэлементно до границы строки кэша z, поэтому каждый проход основного
+// цикла записывает выровненную строку целиком.
+template< bool NonTemporal, typename Op >
+bool streamRange ( const Op & op, std::size_t from, std::size_t to, double * z )
+{
+    bool scalarInvalid = false;
+    std::size_t i = from;
+    if ( NonTemporal )
+    {
+        for ( ; i < to && reinterpret_cast< std::uintptr_t >( z + i ) % ( LINE_ELEMENTS * sizeof( double ) ) != 0; i++ )
+        {
+            const double r = op.element( i );
+            scalarInvalid |= op.invalid( i, r );
+            z[ i ] = r;
+        }
+    }
+
+    Pack flags = Pack::zero();
+    for ( ; i + LINE_ELEMENTS <= to; i += LINE_ELEMENTS )
+    {
+        if ( i + PREFETCH_ELEMENTS < to )
+        {
+            op.prefetch( i + PREFETCH_ELEMENTS );
+        }
+        for ( std::size_t k = 0; k < LINE_ELEMENTS; k += Pack::width )
+        {
+            const Pack r = op.pack( i + k );
+            flags = flags | op.invalid( i + k, r );
+            if ( NonTemporal )
+            {
+                r.stream( z + i + k );
+            }
+            else
+            {
+                r.store( z + i + k );
+            }
+        }
+    }
+    if ( NonTemporal )
+    {
+        MatrixSimd::streamFence();
+    }
+
+    for ( ; i < to; i++ )
+    {
+        const double r = op.element( i );
+        scalarInvalid |= op.invalid( i, r );
+        z[ i ] = r;
+    }
+    return ! scalarInvalid && ! MatrixSimd::anyBitSet( flags );
+}
+
+// Выполняет операцию над [0, n): большие массивы делятся между потоками
+// статически, запись в обход кэша - для результата от streamingThreshold() байт.
+// При записи на место источника строки результата уже прочитаны в кэш, и
+// запись в обход кэша только вытесняет их раньше времени (inPlace).
+template< typename Op >
+bool streamApply ( const Op & op, std::size_t n, double * z, bool inPlace )
+{
+    const bool nonTemporal = ! inPlace && n * sizeof( double ) >= streamingBytes.load( std::memory_order_relaxed );
+    std::atomic< bool > valid( true );
+    ThreadPool::RangeBody body = [ & ] ( std::size_t from, std::size_t to )
+    {
+        const bool partValid = nonTemporal ? streamRange< true >( op, from, to, z )
+                                           : streamRange< false >( op, from, to, z );
+        if ( ! partValid )
+        {
+            valid.store( false, std::memory_order_relaxed );
+        }
+    };
+    if ( n >= MatrixKernels::PARALLEL_MIN_ELEMENTS )
+    {
+        ThreadPool::instance().parallelForStatic( 0, n, MatrixKernels::PARALLEL_MIN_ELEMENTS / 4, body );
+    }
+    else
+    {
+        body( 0, n );
+    }
+    return valid.load();
+}
+
+} // namespace
+
+bool MatrixKernels::streamCombine ( ElementOperation op, std::size_t n, const double * x, const double * y, double * z )
+{
+    switch ( op )
+    {
+        case AddOperation:
+        {
+            const AddStream add = { x, y };
+            return streamApply( add, n, z, z == x || z == y );
+        }
+        case SubtractOperation:
+        {
+            const SubtractStream subtract = { x, y };
+            return streamApply( subtract, n, z, z == x || z == y );
+        }
+        default:
+            combineElements( op, n, x, y, z );
+            return allFinite( n, z );
+    }
+}
+
+bool MatrixKernels::streamScale ( std::size_t n, double alpha, const double * x, double * z )
+{
+    const ScaleStream scale = { x, alpha };
+    return streamApply( scale, n, z, z == x );
+}
+
+std::size_t MatrixKernels::streamingThreshold ()
+{
+    return streamingBytes.load();
+}
+
+void MatrixKernels::setStreamingThreshold ( std::size_t bytes )
+{
+    streamingBytes.store( bytes );
+}
+// =================================================================================
+
+
+// =================================================================================
+// Блочное умножение матриц
+// ---------------------------------------------------------------------------------
+// Однопоточное блочное умножение для полосы строк C.
+// Exact - микроядра без FMA для воспроизводимого режима.
+template< bool Exact >
+static void gemmBlocked ( 
+        const MatrixKernels::GemmConfig & config
+    ,   bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+)
+{
+    // C = beta * C
+    for ( int i = 0; i < m; i++ )
+    {
+        double * c = C + static_cast< std::size_t >( i ) * ldc;
+        if ( beta == 0.0 )
+        {
+            std::fill( c, c + n, 0.0 );
+        }
+        else if ( beta != 1.0 )
+        {
+            MatrixKernels::scale( n, beta, c );
+        }
+    }
+
+    if ( alpha == 0.0 || k == 0 )
+    {
+        return;
+    }
+
+    // Воспроизводимый режим использует только микроядра по 4 и 1 строке
+    const int unroll = Exact ? GEMM_UNROLL : config.unroll;
+    double * packedB = transB ? packBuffer( static_cast< std::size_t >( config.kc ) * config.nc ) : nullptr;
+
+    for ( int j0 = 0; j0 < n; j0 += config.nc )
+    {
+        const int nc = std::min( config.nc, n - j0 );
+
+        for ( int p0 = 0; p0 < k; p0 += config.kc )
+        {
+            const int kc = std::min( config.kc, k - p0 );
+
+            // Строки блока op(B)(p0.., j0..) с шагом ldbBlock
+            const double * bBlock;
+            int ldbBlock;
+            if ( transB )
+            {
+                for ( int p = 0; p < kc; p++ )
+                {
+                    for ( int j = 0; j < nc; j++ )
+                    {
+                        packedB[ static_cast< std::size_t >( p ) * nc + j ] = 
+                            B[ static_cast< std::size_t >( j0 + j ) * ldb + p0 + p ];
+                    }
+                }
+                bBlock   = packedB;
+                ldbBlock = nc;
+            }
+            else
+            {
+                bBlock   = B + static_cast< std::size_t >( p0 ) * ldb + j0;
+                ldbBlock = ldb;
+            }
+
+            for ( int i0 = 0; i0 < m; i0 += config.mc )
+            {
+                const int mc = std::min( config.mc, m - i0 );
+
+                for ( int i = i0; i < i0 + mc; i++ )
+                {
+                    double * c = C + static_cast< std::size_t >( i ) * ldc + j0;
+                    int p = 0;
+                    if ( ! Exact && unroll == 8 )
+                    {
+                        double a[ 8 ];
+                        for ( ; p + 8 <= kc; p += 8 )
+                        {
+                            for ( int q = 0; q < 8; q++ )
+                            {
+                                a[ q ] = alpha * elementAt( A, lda, transA, i, p0 + p + q );
+                            }
+                            updateRow8( nc, c, a, bBlock + static_cast< std::size_t >( p ) * ldbBlock, ldbBlock );
+                        }
+                    }
+                    if ( ! Exact && unroll == 2 )
+                    {
+                        for ( ; p + 2 <= kc; p += 2 )
+                        {
+                            const double * b = bBlock + static_cast< std::size_t >( p ) * ldbBlock;
+                            updateRow2( 
+                                    nc, c
+                                ,   alpha * elementAt( A, lda, transA, i, p0 + p     ), b
+                                ,   alpha * elementAt( A, lda, transA, i, p0 + p + 1 ), b + ldbBlock
+                            );
+                        }
+                    }
+                    for ( ; unroll >= 4 && p + 4 <= kc; p += 4 )
+                    {
+                        const double * b = bBlock + static_cast< std::size_t >( p ) * ldbBlock;
+                        ( Exact ? updateRow4Exact : updateRow4 )( 
+                                nc, c
+                            ,   alpha * elementAt( A, lda, transA, i, p0 + p     ), b
+                            ,   alpha * elementAt( A, lda, transA, i, p0 + p + 1 ), b + ldbBlock
+                            ,   alpha * elementAt( A, lda, transA, i, p0 + p + 2 ), b + 2 * ldbBlock
+                            ,   alpha * elementAt( A, lda, transA, i, p0 + p + 3 ), b + 3 * ldbBlock
+                        );
+                    }
+                    for ( ; p < kc; p++ )
+                    {
+                        ( Exact ? updateRow1Exact : updateRow1 )( 
+                                nc, c
+                            ,   alpha * elementAt( A, lda, transA, i, p0 + p )
+                            ,   bBlock + static_cast< std::size_t >( p ) * ldbBlock 
+                        );
+                    }
+                }
+            }
+        }
+    }
+} // static void gemmBlocked
+
+static void gemmSerial ( 
+        const MatrixKernels::GemmConfig & config
+    ,   bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+)
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) )
+    {
+        gemmBlocked< true >( config, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc );
+    }
+    else
+    {
+        gemmBlocked< false >( config, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc );
+    }
+}
+
+// Конфигурация для очередного умножения: в воспроизводимом режиме разбиение
+// на блоки фиксировано, так как от него зависит порядок суммирования
+static MatrixKernels::GemmConfig activeGemmConfig ()
+{
+    return reproducibleMode.load( std::memory_order_relaxed ) ? MatrixKernels::defaultGemmConfig() 
+                                                               : MatrixKernels::gemmConfig();
+}
+
+MatrixKernels::GemmConfig MatrixKernels::defaultGemmConfig ()
+{
+    GemmConfig config = { GEMM_MC, GEMM_KC, GEMM_NC, GEMM_UNROLL, GEMM_PARALLEL_WORK };
+    return config;
+}
+
+MatrixKernels::GemmConfig MatrixKernels::gemmConfig ()
+{
+    std::call_once( gemmConfigLoaded, [] 
+    { 
+        if ( ! gemmConfigSet.load() )
+        {
+            MatrixTuning::loadConfig();
+        }
+    } );
+    std::lock_guard< std::mutex > lock( gemmConfigMutex );
+    return currentGemmConfig;
+}
+
+bool MatrixKernels::isValidGemmConfig ( const GemmConfig & config )
+{
+    return config.mc > 0 && config.kc > 0 && config.nc > 0
+        && ( config.unroll == 1 || config.unroll == 2 || config.unroll == 4 || config.unroll == 8 )
+        && config.parallelWork >= 0.0;
+}
+
+bool MatrixKernels::setGemmConfig ( const GemmConfig & config )
+{
+    if ( ! isValidGemmConfig( config ) )
+    {
+        return false;
+    }
+    std::lock_guard< std::mutex > lock( gemmConfigMutex );
+    currentGemmConfig = config;
+    gemmConfigSet.store( true );
+    return true;
+}
+
+void MatrixKernels::gemm ( 
+        bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+)
+{
+    gemmWithConfig( activeGemmConfig(), transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc );
+}
+
+// Строки C делятся между потоками статическим разбиением: каждый поток пишет 
+// те же строки, которые он обнулял при first-touch инициализации матрицы
+void MatrixKernels::gemmWithConfig ( 
+        const GemmConfig & config
+    ,   bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+)
+{
+    const double work = static_cast< double >( m ) * n * std::max( k, 1 );
+    if ( work < config.parallelWork || m < 2 * config.mc )
+    {
+        gemmSerial( config, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc );
+        return;
+    }
+
+    ThreadPool::instance().parallelForStatic( 0, m, config.mc, 
+        [ = ] ( std::size_t from, std::size_t to )
+        {
+            // Строки op(A) начиная с from: для A^T это сдвиг по столбцам
+            const double * aPanel = transA ? A + from : A + from * lda;
+            gemmSerial( 
+                    config
+                ,   transA, transB
+                ,   static_cast< int >( to - from ), n, k
+                ,   alpha
+                ,   aPanel, lda
+                ,   B, ldb
+                ,   beta
+                ,   C + from * ldc, ldc 
+            );
+        } );
+} // void MatrixKernels::gemmWithConfig
+// =================================================================================
+
+
+// =================================================================================
+// Умножение матриц со смешанной точностью
+// ---------------------------------------------------------------------------------
+// Округление float до bfloat16 (8 бит мантиссы) к ближайшему четному.
+// Результат хранится в float с обнуленными младшими 16 битами.
+static float roundBFloat16 ( float x )
+{
+    if ( std::isnan( x ) )
+    {
+        return x;
+    }
+    std::uint32_t bits;
+    std::memcpy( &bits, &x, sizeof( bits ) );
+    bits += 0x7FFFu + ( ( bits >> 16 ) & 1u );
+    bits &= 0xFFFF0000u;
+    std::memcpy( &x, &bits, sizeof( bits ) );
+    return x;
+}
+
+// Разложение матрицы rows x cols на уровни низкой точности:
+// X ~ X_0 + X_1 + ... + X_levels-1, где X_s = round(X - X_0 - ... - X_s-1).
+// Уровни хранятся подряд, каждый плотно (ld = cols).
+static void splitLowPrecision ( 
+        bool bfloat16, int levels
+    ,   int rows, int cols
+    ,   const double * X, int ldx
+    ,   std::vector< float > & split 
+)
+{
+    const std::size_t count = static_cast< std::size_t >( rows ) * cols;
+    split.resize( count * levels );
+    for ( int i = 0; i < rows; i++ )
+    {
+        const double * x = X + static_cast< std::size_t >( i ) * ldx;
+        for ( int j = 0; j < cols; j++ )
+        {
+            double rest = x[ j ];
+            for ( int s = 0; s < levels; s++ )
+            {
+                float low = static_cast< float >( rest );
+                if ( bfloat16 )
+                {
+                    low = roundBFloat16( low );
+                }
+                split[ s * count + static_cast< std::size_t >( i ) * cols + j ] = low;
+                rest -= low;
+            }
+        }
+    }
+}
+
+// Микроядро с накоплением в float: блок MIXED_MR x MIXED_NR результата 
+// (по два пакета FloatPack на строку) целиком хранится в регистрах
+const int MIXED_MR = 6;
+const int MIXED_NR = 2 * static_cast< int >( MatrixSimd::FloatPack::width );
+
+// Рабочий буфер упаковки блоков float, свой для каждого потока
+static float * packBufferFloat ( std::size_t n )
+{
+    static thread_local std::vector< float > buffer;
+    if ( buffer.size() < n )
+    {
+        buffer.resize( n );
+    }
+    return buffer.data();
+}
+
+// Упаковка блока X[rows x cols] (шаг ldx) в панели по panel строк: элемент
+// (i, p) панели хранится по адресу p * panel + i, неполная панель дополняется
+// нулями. Для блока B передается транспонированный обход (rowStride = 1).
+static void packPanels ( 
+        int rows, int cols, int panel
+    ,   const float * X, std::size_t rowStride, std::size_t colStride
+    ,   float * packed 
+)
+{
+    for ( int i0 = 0; i0 < rows; i0 += panel )
+    {
+        const int height = std::min( panel, rows - i0 );
+        for ( int p = 0; p < cols; p++ )
+        {
+            float * target = packed + static_cast< std::size_t >( p ) * panel;
+            for ( int i = 0; i < height; i++ )
+            {
+                target[ i ] = X[ ( i0 + i ) * rowStride + p * colStride ];
+            }
+            std::fill( target + height, target + panel, 0.0f );
+        }
+        packed += static_cast< std::size_t >( cols ) * panel;
+    }
+}
+
+// tile[MIXED_MR x MIXED_NR] = a * b для упакованных панелей длины kc
+static void mixedMicroKernel ( int kc, const float * a, const float * b, float * tile )
+{
+    using MatrixSimd::FloatPack;
+    FloatPack c0[ MIXED_MR ], c1[ MIXED_MR ];
+    for ( int r = 0; r < MIXED_MR; r++ )
+    {
+        c0[ r ] = FloatPack::zero();
+        c1[ r ] = FloatPack::zero();
+    }
+    for ( int p = 0; p < kc; p++ )
+    {
+        const FloatPack b0 = FloatPack::load( b );
+        const FloatPack b1 = FloatPack::load( b + FloatPack::width );
+        for ( int r = 0; r < MIXED_MR; r++ )
+        {
+            const FloatPack ar = FloatPack::broadcast( a[ r ] );
+            c0[ r ] = MatrixSimd::fmadd( ar, b0, c0[ r ] );
+            c1[ r ] = MatrixSimd::fmadd( ar, b1, c1[ r ] );
+        }
+        a += MIXED_MR;
+        b += MIXED_NR;
+    }
+    for ( int r = 0; r < MIXED_MR; r++ )
+    {
+        c0[ r ].store( tile + r * MIXED_NR );
+        c1[ r ].store( tile + r * MIXED_NR + FloatPack::width );
+    }
+}
+
+// C[rows x n] += Af[rows x k] * Bf[k x n] для полосы строк с накоплением 
+// в float внутри блока длины GEMM_KC. Блоки B (GEMM_KC x GEMM_NC) и A 
+// (GEMM_MC x GEMM_KC) упаковываются в панели микроядра.
+static void gemmLowSerial ( 
+        int rows, int n, int k
+    ,   const float * Af
+    ,   const float * Bf
+    ,   double * C, int ldc 
+)
+{
+    const int nPanels = ( GEMM_NC + MIXED_NR - 1 ) / MIXED_NR;
+    const int mPanels = ( GEMM_MC + MIXED_MR - 1 ) / MIXED_MR;
+    float * packedB = packBufferFloat( static_cast< std::size_t >( GEMM_KC ) * ( nPanels * MIXED_NR + mPanels * MIXED_MR ) );
+    float * packedA = packedB + static_cast< std::size_t >( GEMM_KC ) * nPanels * MIXED_NR;
+    float tile[ MIXED_MR * MIXED_NR ];
+
+    for ( int j0 = 0; j0 < n; j0 += GEMM_NC )
+    {
+        const int nc = std::min( GEMM_NC, n - j0 );
+        for ( int p0 = 0; p0 < k; p0 += GEMM_KC )
+        {
+            const int kc = std::min( GEMM_KC, k - p0 );
+            packPanels( nc, kc, MIXED_NR, Bf + static_cast< std::size_t >( p0 ) * n + j0, 1, n, packedB );
+
+            for ( int i0 = 0; i0 < rows; i0 += GEMM_MC )
+            {
+                const int mc = std::min( GEMM_MC, rows - i0 );
+                packPanels( mc, kc, MIXED_MR, Af + static_cast< std::size_t >( i0 ) * k + p0, k, 1, packedA );
+
+                for ( int jr = 0; jr < nc; jr += MIXED_NR )
+                {
+                    const int width = std::min( MIXED_NR, nc - jr );
+                    const float * b = packedB + static_cast< std::size_t >( jr ) * kc;
+                    for ( int ir = 0; ir < mc; ir += MIXED_MR )
+                    {
+                        const int height = std::min( MIXED_MR, mc - ir );
+                        mixedMicroKernel( kc, packedA + static_cast< std::size_t >( ir ) * kc, b, tile );
+                        for ( int r = 0; r < height; r++ )
+                        {
+                            double * c = C + static_cast< std::size_t >( i0 + ir + r ) * ldc + j0 + jr;
+                            const float * t = tile + r * MIXED_NR;
+                            for ( int j = 0; j < width; j++ )
+                            {
+                                c[ j ] += t[ j ];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MatrixKernels::gemmMixed ( 
+        bool bfloat16, bool floatAccumulation, int refinementSteps
+    ,   int m, int n, int k
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+)
+{
+    const int levels = std::max( refinementSteps, 0 ) + 1;
+    const std::size_t countA = static_cast< std::size_t >( m ) * k;
+    const std::size_t countB = static_cast< std::size_t >( k ) * n;
+
+    std::vector< float > splitA, splitB;
+    splitLowPrecision( bfloat16, levels, m, k, A, lda, splitA );
+    splitLowPrecision( bfloat16, levels, k, n, B, ldb, splitB );
+
+    // Произведение A_p * B_q умножается микроядром на пакетах float, если это
+    // поправка уточнения (p + q > 0): она в 2^-24 раз меньше основного члена,
+    // и ошибка накопления в float для нее пренебрежимо мала. Основной член при 
+    // накоплении в double перемножается обычным умножением в double - 
+    // произведение двух float точно представимо в double. Накопление в float 
+    // зависит от слияния в FMA, поэтому в воспроизводимом режиме все члены 
+    // перемножаются в double.
+    const bool reproducible = reproducibleMode.load( std::memory_order_relaxed );
+    auto inFloat = [ & ] ( int p, int q ) 
+    { 
+        return ! reproducible && ( floatAccumulation || p + q > 0 ); 
+    };
+    const int wideLevels = reproducible ? levels : ( floatAccumulation ? 0 : 1 );
+    std::vector< double > wideA( splitA.begin(), splitA.begin() + wideLevels * countA );
+    std::vector< double > wideB( splitB.begin(), splitB.begin() + wideLevels * countB );
+
+    // Шаг s уточнения добавляет произведения уровней A_p * B_q с p + q == s.
+    // Поправки суммируются от меньших к большим, основной член - последним.
+    const double work = static_cast< double >( m ) * n * std::max( k, 1 );
+    const bool parallel = work >= static_cast< double >( PARALLEL_MIN_ELEMENTS ) * 64 && m >= 2 * GEMM_MC;
+    ThreadPool::RangeBody body = [ & ] ( std::size_t from, std::size_t to )
+    {
+        const int rows = static_cast< int >( to - from );
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            std::fill( C + i * ldc, C + i * ldc + n, 0.0 );
+        }
+        for ( int s = levels - 1; s >= 0; s-- )
+        {
+            for ( int p = 0; p <= s; p++ )
+            {
+                if ( inFloat( p, s - p ) )
+                {
+                    gemmLowSerial( 
+                            rows, n, k
+                        ,   splitA.data() + p * countA + from * k
+                        ,   splitB.data() + ( s - p ) * countB
+                        ,   C + from * ldc, ldc 
+                    );
+                }
+            }
+        }
+    };
+    if ( parallel )
+    {
+        ThreadPool::instance().parallelForStatic( 0, m, GEMM_MC, body );
+    }
+    else
+    {
+        body( 0, m );
+    }
+
+    for ( int s = levels - 1; s >= 0; s-- )
+    {
+        for ( int p = 0; p <= s; p++ )
+        {
+            if ( ! inFloat( p, s - p ) )
+            {
+                gemm( false, false, m, n, k, 1.0, wideA.data() + p * countA, k, 
+                      wideB.data() + ( s - p ) * countB, n, 1.0, C, ldc );
+            }
+        }
+    }
+} // void MatrixKernels::gemmMixed
+// =================================================================================
+
+
+// =================================================================================
+// Скалярное произведение и норма
+// ---------------------------------------------------------------------------------
+double MatrixKernels::dot ( std::size_t n, const double * x, const double * y )
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) )
+    {
+        return dotExact( n, x, y );
+    }
+
+    using namespace MatrixSimd;
+    const std::size_t W = Pack::width;
+
+    // Четыре независимых аккумулятора скрывают задержку сложения
+    Pack acc0 = Pack::zero(), acc1 = Pack::zero(), acc2 = Pack::zero(), acc3 = Pack::zero();
+    std::size_t i = 0;
+    for ( ; i + 4 * W <= n; i += 4 * W )
+    {
+        acc0 = fmadd( Pack::load( x + i         ), Pack::load( y + i         ), acc0 );
+        acc1 = fmadd( Pack::load( x + i + W     ), Pack::load( y + i + W     ), acc1 );
+        acc2 = fmadd( Pack::load( x + i + 2 * W ), Pack::load( y + i + 2 * W ), acc2 );
+        acc3 = fmadd( Pack::load( x + i + 3 * W ), Pack::load( y + i + 3 * W ), acc3 );
+    }
+    double result = horizontalSum( ( acc0 + acc1 ) + ( acc2 + acc3 ) );
+
+    for ( ; i < n; i++ )
+    {
+        result += x[ i ] * y[ i ];
+    }
+    return result;
+}
+
+MATRIX_NO_FP_CONTRACT double MatrixKernels::norm2 ( std::size_t n, const double * x )
+{
+    const double sumSquares = MatrixKernels::dot( n, x, x );
+    if ( sumSquares > std::numeric_limits< double >::min() && sumSquares < std::numeric_limits< double >::infinity() )
+    {
+        return std::sqrt( sumSquares );
+    }
+
+    // Переполнение или потеря значимости: масштабируем на max |x[i]|
+    double maxAbs = 0.0;
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        maxAbs = std::max( maxAbs, std::fabs( x[ i ] ) );
+    }
+    if ( maxAbs == 0.0 || ! ( maxAbs < std::numeric_limits< double >::infinity() ) )
+    {
+        return maxAbs;
+    }
+    double scaled = 0.0;
+    for ( std::size_t i = 0; i < n; i++ )
+    {
+        const double t = x[ i ] / maxAbs;
+        scaled += t * t;
+    }
+    return maxAbs * std::sqrt( scaled );
+}
+// =================================================================================
+
+
+// =================================================================================
+// Умножение матрицы на вектор и обновление ранга 1
+// ---------------------------------------------------------------------------------
+void MatrixKernels::gemv ( 
+        bool transA
+    ,   int m, int n
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * x
+    ,   double beta
+    ,   double * y
+)
+{
+    const bool parallel = static_cast< std::size_t >( m ) * n >= PARALLEL_MIN_ELEMENTS;
+
+    if ( ! transA )
+    {
+        // y[i] = alpha * (A[i] * x) + beta * y[i] - строки независимы
+        ThreadPool::RangeBody body = [ = ] ( std::size_t from, std::size_t to )
+        {
+            for ( std::size_t i = from; i < to; i++ )
+            {
+                const double ax = MatrixKernels::dot( n, A + i * lda, x );
+                MatrixKernels::axpby( 1, alpha, &ax, beta, y + i );
+            }
+        };
+        if ( parallel )
+        {
+            ThreadPool::instance().parallelFor( 0, m, rowGrain( n ), body );
+        }
+        else
+        {
+            body( 0, m );
+        }
+        return;
+    }
+
+    // y = alpha * A^T * x + beta * y: каждый поток накапливает свой блок столбцов y,
+    // проходя по строкам A, поэтому A читается построчно и без гонок записи
+    ThreadPool::RangeBody body = [ = ] ( std::size_t from, std::size_t to )
+    {
+        const std::size_t width = to - from;
+        if ( beta == 0.0 )
+        {
+            std::fill( y + from, y + to, 0.0 );
+        }
+        else if ( beta != 1.0 )
+        {
+            MatrixKernels::scale( width, beta, y + from );
+        }
+        for ( int i = 0; i < m; i++ )
+        {
+            MatrixKernels::axpy( width, alpha * x[ i ], A + static_cast< std::size_t >( i ) * lda + from, y + from );
+        }
+    };
+    if ( parallel )
+    {
+        const std::size_t columnGrain = std::max< std::size_t >( 256, PARALLEL_MIN_ELEMENTS / 4 / std::max( m, 1 ) );
+        ThreadPool::instance().parallelFor( 0, n, columnGrain, body );
+    }
+    else
+    {
+        body( 0, n );
+    }
+}
+
+void MatrixKernels::ger ( 
+        int m, int n
+    ,   double alpha
+    ,   const double * x
+    ,   const double * y
+    ,   double * A, int lda
+)
+{
+    ThreadPool::RangeBody body = [ = ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            MatrixKernels::axpy( n, alpha * x[ i ], y, A + i * lda );
+        }
+    };
+    if ( static_cast< std::size_t >( m ) * n >= PARALLEL_MIN_ELEMENTS )
+    {
+        ThreadPool::instance().parallelFor( 0, m, rowGrain( n ), body );
+    }
+    else
+    {
+        body( 0, m );
+    }
+}
+// =================================================================================
+
+
+// =================================================================================
+// Редукции
+// ---------------------------------------------------------------------------------
+double MatrixKernels::sum ( std::size_t n, const double * x )
+{
+    if ( n <= REDUCTION_BLOCK )
+    {
+        return pairwiseSum( x, n );
+    }
+    std::vector< double > partial = reduceBlocks< double >( n, 
+        [ x ] ( std::size_t from, std::size_t to ) { return pairwiseSum( x + from, to - from ); } );
+    return pairwiseSum( partial.data(), partial.size() );
+}
+
+double MatrixKernels::normFrobenius ( std::size_t n, const double * x )
+{
+    double sumSquares;
+    if ( n <= REDUCTION_BLOCK )
+    {
+        sumSquares = blockSumSquares( x, n );
+    }
+    else
+    {
+        std::vector< double > partial = reduceBlocks< double >( n, 
+            [ x ] ( std::size_t from, std::size_t to ) { return blockSumSquares( x + from, to - from ); } );
+        sumSquares = pairwiseSum( partial.data(), partial.size() );
+    }
+
+    if ( sumSquares > std::numeric_limits< double >::min() && sumSquares < std::numeric_limits< double >::infinity() )
+    {
+        return std::sqrt( sumSquares );
+    }
+    // Переполнение или потеря значимости - последовательный пересчет с масштабированием
+    return MatrixKernels::norm2( n, x );
+}
+
+void MatrixKernels::minMax ( std::size_t n, const double * x, double & minValue, double & maxValue )
+{
+    struct Range { double lo, hi; };
+    auto blockMinMax = [ x ] ( std::size_t from, std::size_t to ) -> Range
+    {
+        using namespace MatrixSimd;
+        Pack lo = Pack::broadcast( x[ from ] ), hi = lo;
+        std::size_t i = from;
+        for ( ; i + Pack::width <= to; i += Pack::width )
+        {
+            const Pack v = Pack::load( x + i );
+            lo = MatrixSimd::min( lo, v );
+            hi = MatrixSimd::max( hi, v );
+        }
+        Range r = { horizontalMin( lo ), horizontalMax( hi ) };
+        for ( ; i < to; i++ )
+        {
+            r.lo = std::min( r.lo, x[ i ] );
+            r.hi = std::max( r.hi, x[ i ] );
+        }
+        return r;
+    };
+
+    std::vector< Range > partial = reduceBlocks< Range >( n, blockMinMax );
+    minValue = partial[ 0 ].lo;
+    maxValue = partial[ 0 ].hi;
+    for ( std::size_t b = 1; b < partial.size(); b++ )
+    {
+        minValue = std::min( minValue, partial[ b ].lo );
+        maxValue = std::max( maxValue, partial[ b ].hi );
+    }
+}
+
+double MatrixKernels::absSum ( std::size_t n, const double * x )
+{
+    if ( reproducibleMode.load( std::memory_order_relaxed ) )
+    {
+        return absSumExact( n, x );
+    }
+    using namespace MatrixSimd;
+    Pack acc0 = Pack::zero(), acc1 = Pack::zero();
+    std::size_t i = 0;
+    for ( ; i + 2 * Pack::width <= n; i += 2 * Pack::width )
+    {
+        acc0 = acc0 + MatrixSimd::abs( Pack::load( x + i ) );
+        acc1 = acc1 + MatrixSimd::abs( Pack::load( x + i + Pack::width ) );
+    }
+    double result = horizontalSum( acc0 + acc1 );
+    for ( ; i < n; i++ )
+    {
+        result += std::fabs( x[ i ] );
+    }
+    return result;
+}
+
+MatrixKernels::ApproxStats MatrixKernels::compareApprox ( 
+        std::size_t n
+    ,   const double * a
+    ,   const double * b
+    ,   double rtol 
+)
+{
+    auto blockCompare = [ a, b, rtol ] ( std::size_t from, std::size_t to ) -> ApproxStats
+    {
+        using namespace MatrixSimd;
+        const Pack vrtol = Pack::broadcast( rtol );
+        Pack deviation = Pack::zero();
+        Pack excess    = Pack::broadcast( -std::numeric_limits< double >::infinity() );
+        Pack nanMask   = Pack::zero();
+        std::size_t i = from;
+        for ( ; i + Pack::width <= to; i += Pack::width )
+        {
+            const Pack vb = Pack::load( b + i );
+            const Pack d  = MatrixSimd::abs( Pack::load( a + i ) - vb );
+            // NaN в d отбрасывается инструкцией max, поэтому учитывается отдельно
+            nanMask   = nanMask | isNan( d );
+            deviation = MatrixSimd::max( d, deviation );
+            excess    = MatrixSimd::max( d - vrtol * MatrixSimd::abs( vb ), excess );
+        }
+        ApproxStats r;
+        r.maxDeviation = horizontalMax( deviation );
+        r.maxExcess    = horizontalMax( excess );
+        r.hasNan       = anyBitSet( nanMask );
+        for ( ; i < to; i++ )
+        {
+            const double d = std::fabs( a[ i ] - b[ i ] );
+            r.hasNan       = r.hasNan || ( d != d );
+            r.maxDeviation = std::max( r.maxDeviation, d );
+            r.maxExcess    = std::max( r.maxExcess, d - rtol * std::fabs( b[ i ] ) );
+        }
+        return r;
+    };
+
+    std::vector< ApproxStats > partial = reduceBlocks< ApproxStats >( n, blockCompare );
+    ApproxStats result = partial[ 0 ];
+    for ( std::size_t k = 1; k < partial.size(); k++ )
+    {
+        result.maxDeviation = std::max( result.maxDeviation, partial[ k ].maxDeviation );
+        result.maxExcess    = std::max( result.maxExcess, partial[ k ].maxExcess );
+        result.hasNan       = result.hasNan || partial[ k ].hasNan;
+    }
+    return result;
+}
+
+namespace
+{
+
+// Строк в листе попарного суммирования столбцов и ширина блока столбцов
+const int COLUMN_SUM_LEAF = 8;
+const int COLUMN_BLOCK = 256;
+
+// sums = сумма строк [0, m) блока столбцов ширины width. Результат второй
+// половины пишется в scratch, вложенные уровни используют следующие буферы.
+void columnSumsPairwise ( int m, int width, const double * A, int lda, double * sums, double * scratch )
+{
+    if ( m <= COLUMN_SUM_LEAF )
+    {
+        std::copy( A, A + width, sums );
+        for ( int i = 1; i < m; i++ )
+        {
+            const double * row = A + static_cast< std::size_t >( i ) * lda;
+            for ( int j = 0; j < width; j++ )
+            {
+                sums[ j ] += row[ j ];
+            }
+        }
+        return;
+    }
+    const int half = m / 2;
+    columnSumsPairwise( half, width, A, lda, sums, scratch + width );
+    columnSumsPairwise( m - half, width, A + static_cast< std::size_t >( half ) * lda, lda, scratch, scratch + width );
+    for ( int j = 0; j < width; j++ )
+    {
+        sums[ j ] += scratch[ j ];
+    }
+}
+
+// Обработка блоков столбцов по COLUMN_BLOCK, параллельно для больших матриц
+void forEachColumnBlock ( int m, int n, ThreadPool::RangeBody const & body )
+{
+    const std::size_t blocks = ( n + COLUMN_BLOCK - 1 ) / COLUMN_BLOCK;
+    ThreadPool::RangeBody columns = [ & ] ( std::size_t from, std::size_t to )
+    {
+        body( from * COLUMN_BLOCK, std::min< std::size_t >( n, to * COLUMN_BLOCK ) );
+    };
+    if ( static_cast< std::size_t >( m ) * n >= MatrixKernels::PARALLEL_MIN_ELEMENTS )
+    {
+        ThreadPool::instance().parallelFor( 0, blocks, 1, columns );
+    }
+    else
+    {
+        columns( 0, blocks );
+    }
+}
+
+} // namespace
+
+void MatrixKernels::columnSums ( int m, int n, const double * A, int lda, double * sums )
+{
+    int depth = 1;
+    for ( int rows = m; rows > COLUMN_SUM_LEAF; rows = ( rows + 1 ) / 2 )
+    {
+        depth++;
+    }
+    forEachColumnBlock( m, n, [ = ] ( std::size_t from, std::size_t to )
+    {
+        const int width = static_cast< int >( to - from );
+        std::vector< double > scratch( static_cast< std::size_t >( width ) * depth );
+        columnSumsPairwise( m, width, A + from, lda, sums + from, scratch.data() );
+    });
+}
+
+std::size_t MatrixKernels::argMax ( std::size_t n, const double * x )
+{
+    struct Candidate { double value; std::size_t index; };
+    auto blockArgMax = [ x ] ( std::size_t from, std::size_t to ) -> Candidate
+    {
+        using namespace MatrixSimd;
+        // Дорожка k хранит максимум и номер первого максимума среди элементов
+        // from + k, from + k + width, ...; номера представлены точно в double
+        double lanes[ Pack::width ];
+        for ( std::size_t k = 0; k < Pack::width; k++ )
+        {
+            lanes[ k ] = static_cast< double >( from + k );
+        }
+        const Pack step = Pack::broadcast( static_cast< double >( Pack::width ) );
+        Pack index = Pack::load( lanes ), best = Pack::broadcast( -std::numeric_limits< double >::infinity() );
+        Pack bestIndex = Pack::zero();
+        std::size_t i = from;
+        for ( ; i + Pack::width <= to; i += Pack::width )
+        {
+            const Pack v = Pack::load( x + i );
+            const Pack greater = lessThan( best, v );
+            best = select( greater, v, best );
+            bestIndex = select( greater, index, bestIndex );
+            index = index + step;
+        }
+
+        double values[ Pack::width ], indices[ Pack::width ];
+        best.store( values );
+        bestIndex.store( indices );
+        Candidate result = { -std::numeric_limits< double >::infinity(), to };
+        for ( std::size_t k = 0; k < Pack::width; k++ )
+        {
+            const std::size_t laneIndex = static_cast< std::size_t >( indices[ k ] );
+            if ( values[ k ] > result.value || ( values[ k ] == result.value && laneIndex < result.index ) )
+            {
+                result.value = values[ k ];
+                result.index = laneIndex;
+            }
+        }
+        for ( ; i < to; i++ )
+        {
+            if ( x[ i ] > result.value )
+            {
+                result.value = x[ i ];
+                result.index = i;
+            }
+        }
+        // Ни один элемент не больше -inf: первый -inf, если он есть
+        if ( result.value == -std::numeric_limits< double >::infinity() )
+        {
+            result.index = to;
+            for ( std::size_t j = from; j < to && result.index == to; j++ )
+            {
+                if ( x[ j ] == result.value )
+                {
+                    result.index = j;
+                }
+            }
+            if ( result.index == to )
+            {
+                result.value = std::numeric_limits< double >::quiet_NaN();
+            }
+        }
+        return result;
+    };
+
+    std::vector< Candidate > partial = reduceBlocks< Candidate >( n, blockArgMax );
+    Candidate result = { std::numeric_limits< double >::quiet_NaN(), 0 };
+    for ( std::size_t b = 0; b < partial.size(); b++ )
+    {
+        // Блок из одних NaN имеет значение NaN и пропускается
+        if ( partial[ b ].value > result.value || ( std::isnan( result.value ) && ! std::isnan( partial[ b ].value ) ) )
+        {
+            result = partial[ b ];
+        }
+    }
+    return result.index;
+}
+
+void MatrixKernels::columnArgMax ( int m, int n, const double * A, int lda, int * index )
+{
+    forEachColumnBlock( m, n, [ = ] ( std::size_t from, std::size_t to )
+    {
+        const int width = static_cast< int >( to - from );
+        std::vector< double > best( width, -std::numeric_limits< double >::infinity() );
+        int * target = index + from;
+        std::fill( target, target + width, -1 );
+        for ( int i = 0; i < m; i++ )
+        {
+            const double * row = A + static_cast< std::size_t >( i ) * lda + from;
+            for ( int j = 0; j < width; j++ )
+            {
+                if ( row[ j ] > best[ j ] || ( target[ j ] < 0 && row[ j ] == best[ j ] ) )
+                {
+                    best[ j ] = row[ j ];
+                    target[ j ] = i;
+                }
+            }
+        }
+        // Столбцы из одних NaN
+        for ( int j = 0; j < width; j++ )
+        {
+            target[ j ] = std::max( target[ j ], 0 );
+        }
+    });
+}
+// =================================================================================
+
+
+// =================================================================================
+// Ядра для структурированных матриц
+// ---------------------------------------------------------------------------------
+// Выполняет тело над диапазоном строк/столбцов параллельно, если задача велика
+static void runRange ( std::size_t count, std::size_t work, std::size_t grain, ThreadPool::RangeBody const & body )
+{
+    if ( work >= MatrixKernels::PARALLEL_MIN_ELEMENTS * 16 )
+    {
+        ThreadPool::instance().parallelFor( 0, count, grain, body );
+    }
+    else
+    {
+        body( 0, count );
+    }
+}
+
+void MatrixKernels::trmm ( 
+        bool left, bool upper, bool unitDiagonal
+    ,   int m, int n
+    ,   const double * T, int ldt
+    ,   double * B, int ldb
+)
+{
+    const std::size_t work = static_cast< std::size_t >( m ) * n * ( left ? m : n ) / 2;
+
+    if ( left )
+    {
+        // Строка i результата - комбинация строк B с индексами из треугольника строки i T.
+        // Для верхней T строки обходятся по возрастанию (используются еще не 
+        // измененные строки p > i), для нижней - по убыванию. Столбцы B независимы.
+        runRange( n, work, 64, [ = ] ( std::size_t from, std::size_t to )
+        {
+            const std::size_t width = to - from;
+            for ( int step = 0; step < m; step++ )
+            {
+                const int i = upper ? step : m - 1 - step;
+                double * bi = B + static_cast< std::size_t >( i ) * ldb + from;
+                const double * ti = T + static_cast< std::size_t >( i ) * ldt;
+                if ( ! unitDiagonal )
+                {
+                    MatrixKernels::scale( width, ti[ i ], bi );
+                }
+                const int pBegin = upper ? i + 1 : 0;
+                const int pEnd   = upper ? m : i;
+                for ( int p = pBegin; p < pEnd; p++ )
+                {
+                    MatrixKernels::axpy( width, ti[ p ], B + static_cast< std::size_t >( p ) * ldb + from, bi );
+                }
+            }
+        } );
+        return;
+    }
+
+    // Справа: строки B независимы, строка b заменяется на b * T,
+    // результат накапливается во временной строке потока
+    runRange( m, work, 16, [ = ] ( std::size_t from, std::size_t to )
+    {
+        const double one = 1.0;
+        double * row = packBuffer( n );
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            double * bi = B + i * ldb;
+            std::fill( row, row + n, 0.0 );
+            for ( int p = 0; p < n; p++ )
+            {
+                const double * tp = T + static_cast< std::size_t >( p ) * ldt;
+                const int jBegin = upper ? p + 1 : 0;
+                const int jEnd   = upper ? n : p;
+                MatrixKernels::axpy( jEnd - jBegin, bi[ p ], tp + jBegin, row + jBegin );
+                MatrixKernels::axpy( 1, bi[ p ], unitDiagonal ? &one : tp + p, row + p );
+            }
+            std::copy( row, row + n, bi );
+        }
+    } );
+}
+
+bool MatrixKernels::trsm ( 
+        bool left, bool upper, bool unitDiagonal
+    ,   int m, int n
+    ,   const double * T, int ldt
+    ,   double * B, int ldb
+)
+{
+    const int size = left ? m : n;
+    if ( ! unitDiagonal )
+    {
+        for ( int i = 0; i < size; i++ )
+        {
+            if ( T[ static_cast< std::size_t >( i ) * ldt + i ] == 0.0 )
+            {
+                return false;
+            }
+        }
+    }
+
+    const std::size_t work = static_cast< std::size_t >( m ) * n * size / 2;
+
+    if ( left )
+    {
+        // Прямая (нижняя T) или обратная (верхняя T) подстановка по строкам;
+        // столбцы B независимы
+        runRange( n, work, 64, [ = ] ( std::size_t from, std::size_t to )
+        {
+            const std::size_t width = to - from;
+            for ( int step = 0; step < m; step++ )
+            {
+                const int i = upper ? m - 1 - step : step;
+                double * bi = B + static_cast< std::size_t >( i ) * ldb + from;
+                const double * ti = T + static_cast< std::size_t >( i ) * ldt;
+                const int pBegin = upper ? i + 1 : 0;
+                const int pEnd   = upper ? m : i;
+                for ( int p = pBegin; p < pEnd; p++ )
+                {
+                    MatrixKernels::axpy( width, -ti[ p ], B + static_cast< std::size_t >( p ) * ldb + from, bi );
+                }
+                if ( ! unitDiagonal )
+                {
+                    MatrixKernels::scale( width, 1.0 / ti[ i ], bi );
+                }
+            }
+        } );
+        return true;
+    }
+
+    // Справа: каждая строка x решает x * T = b. Для верхней T неизвестные 
+    // находятся по возрастанию, для нижней - по убыванию
+    runRange( m, work, 16, [ = ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            double * x = B + i * ldb;
+            for ( int step = 0; step < n; step++ )
+            {
+                const int p = upper ? step : n - 1 - step;
+                const double * tp = T + static_cast< std::size_t >( p ) * ldt;
+                if ( ! unitDiagonal )
+                {
+                    x[ p ] /= tp[ p ];
+                }
+                if ( upper )
+                {
+                    MatrixKernels::axpy( n - p - 1, -x[ p ], tp + p + 1, x + p + 1 );
+                }
+                else
+                {
+                    MatrixKernels::axpy( p, -x[ p ], tp, x );
+                }
+            }
+        }
+    } );
+    return true;
+}
+
+void MatrixKernels::syrk ( 
+        bool trans
+    ,   int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   double beta
+    ,   double * C, int ldc
+)
+{
+    const int BLOCK = 128;
+    const int blocks = ( n + BLOCK - 1 ) / BLOCK;
+
+    // Пары блоков (I, J) верхнего треугольника, I <= J
+    std::vector< std::pair< int, int > > pairs;
+    for ( int I = 0; I < blocks; I++ )
+    {
+        for ( int J = I; J < blocks; J++ )
+        {
+            pairs.push_back( std::make_pair( I, J ) );
+        }
+    }
+
+    const GemmConfig config = activeGemmConfig();
+    ThreadPool::RangeBody body = [ & ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t q = from; q < to; q++ )
+        {
+            const int i0 = pairs[ q ].first * BLOCK, j0 = pairs[ q ].second * BLOCK;
+            const int bi = std::min( BLOCK, n - i0 ), bj = std::min( BLOCK, n - j0 );
+            // Блок C(I, J) = op(A)(I, :) * op(A)(J, :)^T
+            const double * aI = trans ? A + i0 : A + static_cast< std::size_t >( i0 ) * lda;
+            const double * aJ = trans ? A + j0 : A + static_cast< std::size_t >( j0 ) * lda;
+            gemmSerial( 
+                    config
+                ,   trans, ! trans
+                ,   bi, bj, k
+                ,   alpha
+                ,   aI, lda
+                ,   aJ, lda
+                ,   beta
+                ,   C + static_cast< std::size_t >( i0 ) * ldc + j0, ldc 
+            );
+        }
+    };
+    if ( static_cast< std::size_t >( n ) * n * k >= PARALLEL_MIN_ELEMENTS * 64 )
+    {
+        ThreadPool::instance().parallelFor( 0, pairs.size(), 1, body );
+    }
+    else
+    {
+        body( 0, pairs.size() );
+    }
+
+    // Нижний треугольник - отражение верхнего
+    for ( int i = 1; i < n; i++ )
+    {
+        for ( int j = 0; j < i; j++ )
+        {
+            C[ static_cast< std::size_t >( i ) * ldc + j ] = C[ static_cast< std::size_t >( j ) * ldc + i ];
+        }
+    }
+}
+
+void MatrixKernels::gbmm ( 
+        int m, int n, int k
+    ,   int kl, int ku
+    ,   const double * band, int ldband
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+)
+{
+    const std::size_t work = static_cast< std::size_t >( m ) * n * ( kl + ku + 1 );
+    runRange( m, work, 16, [ = ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            double * ci = C + i * ldc;
+            std::fill( ci, ci + n, 0.0 );
+            const int jBegin = std::max( 0, static_cast< int >( i ) - kl );
+            const int jEnd   = std::min( k, static_cast< int >( i ) + ku + 1 );
+            const double * bandRow = band + i * ldband + kl - static_cast< int >( i );
+            for ( int j = jBegin; j < jEnd; j++ )
+            {
+                MatrixKernels::axpy( n, bandRow[ j ], B + static_cast< std::size_t >( j ) * ldb, ci );
+            }
+        }
+    } );
+}
+
+void MatrixKernels::gbmmRight ( 
+        int m, int n, int k
+    ,   int kl, int ku
+    ,   const double * B, int ldb
+    ,   const double * band, int ldband
+    ,   double * C, int ldc
+)
+{
+    const std::size_t work = static_cast< std::size_t >( m ) * k * ( kl + ku + 1 );
+    runRange( m, work, 16, [ = ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            double * ci = C + i * ldc;
+            const double * bi = B + i * ldb;
+            std::fill( ci, ci + n, 0.0 );
+            // Строка p ленточной матрицы занимает столбцы [p - kl, p + ku]
+            for ( int p = 0; p < k; p++ )
+            {
+                const int jBegin = std::max( 0, p - kl );
+                const int jEnd   = std::min( n, p + ku + 1 );
+                const double * bandRow = band + static_cast< std::size_t >( p ) * ldband + kl - p;
+                MatrixKernels::axpy( jEnd - jBegin, bi[ p ], bandRow + jBegin, ci + jBegin );
+            }
+        }
+    } );
+}
+
+void MatrixKernels::diagonalScale ( 
+        bool left
+    ,   int m, int n
+    ,   const double * d
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+)
+{
+    runRange( m, static_cast< std::size_t >( m ) * n * 4, rowGrain( n ), [ = ] ( std::size_t from, std::size_t to )
+    {
+        for ( std::size_t i = from; i < to; i++ )
+        {
+            const double * bi = B + i * ldb;
+            double * ci = C + i * ldc;
+            if ( left )
+            {
+                const double di = d[ i ];
+                for ( int j = 0; j < n; j++ )
+                {
+                    ci[ j ] = di * bi[ j ];
+                }
+            }
+            else
+            {
+                for ( int j = 0; j < n; j++ )
+                {
+                    ci[ j ] = bi[ j ] * d[ j ];
+                }
+            }
+        }
+    } );
+}
+// =================================================================================
+
+
+// =================================================================================
+// LU-разложение и решение систем
+// ---------------------------------------------------------------------------------
+bool MatrixKernels::getrf ( int n, double * A, int lda, int * pivots )
+{
+    for ( int p = 0; p < n; p++ )
+    {
+        // Главный элемент - максимальный по модулю в столбце p
+        int pivot = p;
+        double pivotAbs = std::fabs( A[ static_cast< std::size_t >( p ) * lda + p ] );
+        for ( int i = p + 1; i < n; i++ )
+        {
+            const double candidate = std::fabs( A[ static_cast< std::size_t >( i ) * lda + p ] );
+            if ( candidate > pivotAbs )
+            {
+                pivot = i;
+                pivotAbs = candidate;
+            }
+        }
+        pivots[ p ] = pivot;
+        if ( pivotAbs == 0.0 )
+        {
+            return false;
+        }
+        double * rowP = A + static_cast< std::size_t >( p ) * lda;
+        if ( pivot != p )
+        {
+            std::swap_ranges( rowP, rowP + n, A + static_cast< std::size_t >( pivot ) * lda );
+        }
+
+        // Исключение: строки ниже p обновляются независимо
+        const double inverse = 1.0 / rowP[ p ];
+        const int tail = n - p - 1;
+        runRange( tail, static_cast< std::size_t >( tail ) * tail * 4, rowGrain( tail ), 
+            [ = ] ( std::size_t from, std::size_t to )
+            {
+                for ( std::size_t r = from; r < to; r++ )
+                {
+                    double * rowI = A + ( p + 1 + r ) * lda;
+                    rowI[ p ] *= inverse;
+                    MatrixKernels::axpy( tail, -rowI[ p ], rowP + p + 1, rowI + p + 1 );
+                }
+            } );
+    }
+    return true;
+}
+
+void MatrixKernels::getrs ( 
+        int n, int nrhs
+    ,   const double * LU, int lda
+    ,   const int * pivots
+    ,   double * B, int ldb
+)
+{
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( pivots[ i ] != i )
+        {
+            double * rowI = B + static_cast< std::size_t >( i ) * ldb;
+            std::swap_ranges( rowI, rowI + nrhs, B + static_cast< std::size_t >( pivots[ i ] ) * ldb );
+        }
+    }
+    MatrixKernels::trsm( true, false, true, n, nrhs, LU, lda, B, ldb );
+    MatrixKernels::trsm( true, true, false, n, nrhs, LU, lda, B, ldb );
+}
+// =================================================================================
@@ -0,0 +1,315 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_KERNELS_HPP_
+#define _MATRIX_KERNELS_HPP_
+
+/*****************************************************************************/
+
+#include <cstddef>
+
+/*****************************************************************************/
+
+// Вычислительные ядра над непрерывными массивами double. Матрицы хранятся
+// построчно, ld ("leading dimension") - шаг между началами соседних строк.
+// Ядра не выделяют память на горячем пути и не выполняют проверок размеров -
+// это задача вызывающего кода (класса Matrix).
+namespace MatrixKernels
+{
+
+// Воспроизводимый режим. Разбиение редукций на блоки и порядок суммирования 
+// внутри GEMM не зависят от количества потоков и в обычном режиме, но листья 
+// редукций зависят от ширины SIMD, а компилятор может сливать умножение и 
+// сложение в FMA. В воспроизводимом режиме ядра суммируют в фиксированном 
+// порядке по 8 дорожкам и не используют FMA, поэтому результаты побитово 
+// совпадают между запусками, количеством потоков и машинами (IEEE-754 double).
+// Начальное значение задается переменной окружения MATRIX_REPRODUCIBLE=1.
+void setReproducible ( bool enabled );
+bool isReproducible ();
+
+// x = alpha * x
+void scale ( std::size_t n, double alpha, double * x );
+
+// y = y + alpha * x
+void axpy ( std::size_t n, double alpha, const double * x, double * y );
+
+// y = alpha * x + beta * y
+void axpby ( std::size_t n, double alpha, const double * x, double beta, double * y );
+
+// C = alpha * op(A) * op(B) + beta * C, где op(X) = X или X^T.
+// op(A) имеет размер m x k, op(B) - k x n, C - m x n.
+// При beta == 0 исходное содержимое C не читается.
+void gemm ( 
+        bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+);
+
+// Параметры блочного GEMM. Значения по умолчанию заменяются результатом 
+// автонастройки из кэша или ручной настройкой (см. matrix_tuning.hpp).
+struct GemmConfig
+{
+    int mc;              // строк A в блоке (блок MC x KC - в кэше L2)
+    int kc;              // глубина блока по k
+    int nc;              // столбцов B в блоке (строка блока KC x NC - в кэше L1)
+    int unroll;          // строк B за проход микроядра: 1, 2, 4 или 8
+    double parallelWork; // минимальное m * n * k для параллельного умножения
+};
+
+GemmConfig defaultGemmConfig ();
+
+// Текущая конфигурация. При первом обращении загружается ручная настройка
+// или кэш автонастройки (MatrixTuning::loadConfig), если конфигурация еще не
+// установлена через setGemmConfig.
+GemmConfig gemmConfig ();
+
+// Устанавливает конфигурацию; возвращает false для недопустимых параметров.
+// Конфигурация, установленная до первого умножения, не заменяется загрузкой.
+bool setGemmConfig ( const GemmConfig & config );
+bool isValidGemmConfig ( const GemmConfig & config );
+
+// То же, что gemm, но с явно заданной конфигурацией (для автонастройки).
+// В воспроизводимом режиме gemm всегда использует defaultGemmConfig().
+void gemmWithConfig ( 
+        const GemmConfig & config
+    ,   bool transA, bool transB
+    ,   int m, int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double beta
+    ,   double * C, int ldc
+);
+
+// Смешанная точность: C = A * B, где элементы A и B округляются до float
+// (или до bfloat16 при bfloat16 == true, хранимого в float), а произведения
+// накапливаются в double. При floatAccumulation == true блоки упаковываются
+// в float и умножаются микроядром на пакетах float: суммы внутри блока 
+// длины GEMM_KC накапливаются в регистрах float, и только суммы блоков - 
+// в double. refinementSteps > 0 добавляет поправки от остатков
+// округления A - round(A) и B - round(B), приближая результат к double; 
+// поправки всегда умножаются микроядром на пакетах float (кроме 
+// воспроизводимого режима), поэтому шаг уточнения дешевле умножения в double.
+void gemmMixed ( 
+        bool bfloat16, bool floatAccumulation, int refinementSteps
+    ,   int m, int n, int k
+    ,   const double * A, int lda
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+);
+
+// Проверяет, что все элементы конечны (нет переполнения, inf или NaN)
+bool allFinite ( std::size_t n, const double * x );
+
+// Скалярное произведение x * y (SIMD, четыре независимых аккумулятора)
+double dot ( std::size_t n, const double * x, const double * y );
+
+// Евклидова норма ||x||. При переполнении суммы квадратов пересчитывается 
+// с масштабированием на максимальный по модулю элемент.
+double norm2 ( std::size_t n, const double * x );
+
+// y = alpha * op(A) * x + beta * y, A имеет размер m x n.
+// Для op(A) = A длина x равна n, длина y - m; для op(A) = A^T наоборот.
+// Большие задачи распределяются по строкам (или блокам столбцов) между потоками.
+void gemv ( 
+        bool transA
+    ,   int m, int n
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   const double * x
+    ,   double beta
+    ,   double * y
+);
+
+// A = A + alpha * x * y^T, A имеет размер m x n (обновление ранга 1)
+void ger ( 
+        int m, int n
+    ,   double alpha
+    ,   const double * x
+    ,   const double * y
+    ,   double * A, int lda
+);
+
+// Сумма элементов. Используется попарное суммирование по блокам фиксированного 
+// размера; большие массивы обрабатываются блоками параллельно.
+double sum ( std::size_t n, const double * x );
+
+// Сумма модулей элементов
+double absSum ( std::size_t n, const double * x );
+
+// Евклидова норма массива, вычисляемая параллельно по блокам
+double normFrobenius ( std::size_t n, const double * x );
+
+// Минимальный и максимальный элементы (n > 0)
+void minMax ( std::size_t n, const double * x, double & minValue, double & maxValue );
+
+// Статистика поэлементного сравнения двух массивов
+struct ApproxStats
+{
+    double maxDeviation;    // max |a[i] - b[i]|
+    double maxExcess;       // max (|a[i] - b[i]| - rtol * |b[i]|)
+    bool   hasNan;          // встретилось ли NaN среди разностей
+};
+
+// Поэлементное сравнение a и b с относительным допуском rtol (n > 0)
+ApproxStats compareApprox ( std::size_t n, const double * a, const double * b, double rtol );
+
+// sums[j] = сумма A(i, j) по строкам i < m (A имеет размер m x n). Строки
+// складываются попарно фиксированным деревом, поэтому результат не зависит от
+// количества потоков; потоки обрабатывают непересекающиеся блоки столбцов.
+void columnSums ( int m, int n, const double * A, int lda, double * sums );
+
+// Номер максимального элемента (n > 0). Среди равных выбирается наименьший 
+// номер, NaN пропускаются; если все элементы - NaN, возвращается 0.
+std::size_t argMax ( std::size_t n, const double * x );
+
+// index[j] = номер строки максимального элемента столбца j (правила - как в argMax)
+void columnArgMax ( int m, int n, const double * A, int lda, int * index );
+
+// Минимальное количество элементов, начиная с которого ядра используют пул потоков
+const std::size_t PARALLEL_MIN_ELEMENTS = 1 << 15;
+
+// ---------------------------------------------------------------------------------
+// Поэлементные операции. Результат может записываться на место аргумента.
+// Экспонента, логарифм, tanh и сигмоида вычисляются SIMD-многочленами
+// (редукция аргумента и ряд Тейлора достаточной степени); погрешность
+// указана в единицах последнего разряда (ULP) для нормализованных результатов.
+// Особые значения (inf, NaN, ноль) обрабатываются как в <cmath>.
+// ---------------------------------------------------------------------------------
+
+// z = x .* y и z = x ./ y
+void multiplyElements ( std::size_t n, const double * x, const double * y, double * z );
+void divideElements ( std::size_t n, const double * x, const double * y, double * z );
+
+// Арифметическая операция над парой массивов или массивом и скаляром
+enum ElementOperation { AddOperation, SubtractOperation, MultiplyOperation, DivideOperation };
+
+// z = x op y
+void combineElements ( ElementOperation op, std::size_t n, const double * x, const double * y, double * z );
+
+// z = x op alpha
+void combineScalar ( ElementOperation op, std::size_t n, const double * x, double alpha, double * z );
+
+// Потоковые варианты сложения, вычитания и умножения на скаляр для больших
+// массивов. Эти операции ограничены пропускной способностью памяти, поэтому
+// массив делится между потоками статически (теми же частями, что и при первом
+// касании страниц в MatrixMemory), источники подкачиваются программной
+// предвыборкой, а результат размером не меньше streamingThreshold() байт
+// записывается в обход кэша: его строки не читаются перед записью и не
+// вытесняют из кэша остальные данные. Значения совпадают с combineElements и
+// combineScalar; проверка результата выполняется в том же проходе.
+
+// z = x + y или z = x - y (op - AddOperation или SubtractOperation).
+// Возвращает false, если среди результатов есть inf или NaN.
+bool streamCombine ( ElementOperation op, std::size_t n, const double * x, const double * y, double * z );
+
+// z = alpha * x. Возвращает false, если среди результатов есть inf или NaN.
+bool streamScale ( std::size_t n, double alpha, const double * x, double * z );
+
+// Порог записи в обход кэша в байтах. По умолчанию - объем кэша последнего
+// уровня или значение переменной окружения MATRIX_STREAMING_BYTES.
+std::size_t streamingThreshold ();
+void setStreamingThreshold ( std::size_t bytes );
+
+// y = exp(x), не более 1 ULP
+void vexp ( std::size_t n, const double * x, double * y );
+
+// y = log(x), не более 1 ULP
+void vlog ( std::size_t n, const double * x, double * y );
+
+// y = tanh(x), не более 3 ULP
+void vtanh ( std::size_t n, const double * x, double * y );
+
+// y = 1 / (1 + exp(-x)), не более 3 ULP
+void vsigmoid ( std::size_t n, const double * x, double * y );
+
+// y = max(x, 0), точно (NaN сохраняется)
+void vrelu ( std::size_t n, const double * x, double * y );
+
+// ---------------------------------------------------------------------------------
+// Ядра для структурированных матриц. Треугольная матрица T (n x n) хранится 
+// полностью, читается только верхний (upper) или нижний треугольник; при 
+// unitDiagonal диагональ считается единичной и не читается.
+// ---------------------------------------------------------------------------------
+
+// B = T * B (left) или B = B * T (right) на месте, B имеет размер m x n
+void trmm ( 
+        bool left, bool upper, bool unitDiagonal
+    ,   int m, int n
+    ,   const double * T, int ldt
+    ,   double * B, int ldb
+);
+
+// Решение T * X = B (left) или X * T = B (right) на месте: B заменяется на X.
+// Возвращает false, если на диагонали T встретился ноль.
+bool trsm ( 
+        bool left, bool upper, bool unitDiagonal
+    ,   int m, int n
+    ,   const double * T, int ldt
+    ,   double * B, int ldb
+);
+
+// C = alpha * A * A^T + beta * C (trans == false, A имеет размер n x k) или
+// C = alpha * A^T * A + beta * C (trans == true, A имеет размер k x n).
+// Вычисляются только блоки верхнего треугольника C, нижний заполняется отражением.
+void syrk ( 
+        bool trans
+    ,   int n, int k
+    ,   double alpha
+    ,   const double * A, int lda
+    ,   double beta
+    ,   double * C, int ldc
+);
+
+// C = Band * B, Band - ленточная матрица m x k с kl поддиагоналями и ku 
+// наддиагоналями в ленточном хранении: элемент (i, j) лежит в 
+// band[i * ldband + (j - i + kl)]. B имеет размер k x n, C - m x n.
+void gbmm ( 
+        int m, int n, int k
+    ,   int kl, int ku
+    ,   const double * band, int ldband
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+);
+
+// C = B * Band, B имеет размер m x k, Band - k x n, C - m x n
+void gbmmRight ( 
+        int m, int n, int k
+    ,   int kl, int ku
+    ,   const double * B, int ldb
+    ,   const double * band, int ldband
+    ,   double * C, int ldc
+);
+
+// C = diag(d) * B (left, d длины m) или C = B * diag(d) (right, d длины n).
+// C может совпадать с B.
+void diagonalScale ( 
+        bool left
+    ,   int m, int n
+    ,   const double * d
+    ,   const double * B, int ldb
+    ,   double * C, int ldc
+);
+
+// LU-разложение квадратной матрицы n x n с выбором главного элемента по столбцу:
+// P * A = L * U на месте (L с единичной диагональю хранится под диагональю).
+// pivots[i] - номер строки, переставленной со строкой i на шаге i.
+// Возвращает false, если матрица вырождена (нулевой главный элемент).
+bool getrf ( int n, double * A, int lda, int * pivots );
+
+// Решение A * X = B по LU-разложению из getrf; B (n x nrhs) заменяется на X
+void getrs ( 
+        int n, int nrhs
+    ,   const double * LU, int lda
+    ,   const int * pivots
+    ,   double * B, int ldb
+);
+
+} // namespace MatrixKernels
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_KERNELS_HPP_
@@ -0,0 +1,471 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_memory.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <sys/mman.h>
+#include <unistd.h>
+#define MATRIX_HAVE_MMAP 1
+#endif
+
+#if defined( _WIN32 )
+#include <malloc.h>
+#endif
+
+#if defined( MATRIX_HAVE_LIBNUMA )
+#include <numa.h>
+#elif defined( __linux__ )
+#include <sys/syscall.h>
+#endif
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+const std::size_t CACHE_LINE = 64;
+
+// Начиная с этого размера обнуленные буферы берутся из анонимного отображения
+const std::size_t ZERO_MAPPING_THRESHOLD = std::size_t( 256 ) << 10;
+
+// Режимы mbind из <numaif.h>
+const int MPOL_BIND_MODE       = 2;
+const int MPOL_INTERLEAVE_MODE = 3;
+
+std::atomic< int > gs_policy( MatrixMemory::NumaDefault );
+std::atomic< int > gs_bindNode( 0 );
+std::atomic< std::size_t > gs_largeThreshold( std::size_t( 16 ) << 20 );
+
+std::atomic< std::size_t > gs_largeAllocations( 0 );
+std::atomic< std::size_t > gs_numaPolicyApplied( 0 );
+std::atomic< std::size_t > gs_numaFallbacks( 0 );
+
+std::atomic< int > gs_hugePageMode( MatrixMemory::HugePagesOff );
+std::atomic< std::size_t > gs_hugePageThreshold( std::size_t( 64 ) << 20 );
+
+std::atomic< std::size_t > gs_hugeTlbAllocations( 0 );
+std::atomic< std::size_t > gs_transparentHugePageAllocations( 0 );
+std::atomic< std::size_t > gs_hugePageFallbacks( 0 );
+
+// Начальная настройка из переменных окружения
+void readEnvironment ()
+{
+    if ( const char * policy = std::getenv( "MATRIX_NUMA_POLICY" ) )
+    {
+        const std::string value( policy );
+        if ( value == "firsttouch" )
+        {
+            gs_policy.store( MatrixMemory::NumaFirstTouch );
+        }
+        else if ( value == "interleave" )
+        {
+            gs_policy.store( MatrixMemory::NumaInterleave );
+        }
+        else if ( value.compare( 0, 5, "bind:" ) == 0 )
+        {
+            gs_policy.store( MatrixMemory::NumaBindNode );
+            gs_bindNode.store( std::atoi( value.c_str() + 5 ) );
+        }
+    }
+    if ( const char * threshold = std::getenv( "MATRIX_LARGE_ALLOC_BYTES" ) )
+    {
+        gs_largeThreshold.store( std::strtoull( threshold, nullptr, 10 ) );
+    }
+    if ( const char * huge = std::getenv( "MATRIX_HUGE_PAGES" ) )
+    {
+        const std::string value( huge );
+        if ( value == "thp" )
+        {
+            gs_hugePageMode.store( MatrixMemory::HugePagesTransparent );
+        }
+        else if ( value == "hugetlb" )
+        {
+            gs_hugePageMode.store( MatrixMemory::HugePagesExplicit );
+        }
+    }
+    if ( const char * threshold = std::getenv( "MATRIX_HUGE_PAGE_BYTES" ) )
+    {
+        gs_hugePageThreshold.store( std::strtoull( threshold, nullptr, 10 ) );
+    }
+}
+
+struct EnvironmentReader
+{
+    EnvironmentReader () { readEnvironment(); }
+};
+EnvironmentReader gs_environmentReader;
+
+// Применяет политику interleave / bind к отображенной области.
+// Возвращает false, если mbind недоступен или завершился ошибкой.
+bool applyNumaPolicy ( void * _address, std::size_t _bytes, MatrixMemory::NumaPolicy _policy, int _node )
+{
+#if defined( MATRIX_HAVE_LIBNUMA )
+    if ( numa_available() < 0 
+      || ( _policy == MatrixMemory::NumaBindNode && ( _node < 0 || _node >= MatrixMemory::numaNodeCount() ) ) )
+    {
+        return false;
+    }
+    if ( _policy == MatrixMemory::NumaInterleave )
+    {
+        numa_interleave_memory( _address, _bytes, numa_all_nodes_ptr );
+    }
+    else
+    {
+        numa_tonode_memory( _address, _bytes, _node );
+    }
+    return true;
+#elif defined( __linux__ ) && defined( SYS_mbind )
+    const int nodes = MatrixMemory::numaNodeCount();
+    if ( _node < 0 || _node >= nodes || nodes > static_cast< int >( 8 * sizeof( unsigned long ) ) )
+    {
+        return false;
+    }
+    unsigned long mask = 0;
+    if ( _policy == MatrixMemory::NumaInterleave )
+    {
+        for ( int node = 0; node < nodes; node++ )
+        {
+            mask |= 1UL << node;
+        }
+    }
+    else
+    {
+        mask = 1UL << _node;
+    }
+    const int mode = ( _policy == MatrixMemory::NumaInterleave ) ? MPOL_INTERLEAVE_MODE : MPOL_BIND_MODE;
+    return syscall( SYS_mbind, _address, _bytes, mode, & mask, 8 * sizeof( mask ), 0 ) == 0;
+#else
+    ( void ) _address; ( void ) _bytes; ( void ) _policy; ( void ) _node;
+    return false;
+#endif
+}
+
+#if defined( MATRIX_HAVE_MMAP )
+
+// Размер больших страниц x86-64 / AArch64
+const std::size_t HUGE_PAGE_SIZE = std::size_t( 2 ) << 20;
+
+inline std::size_t roundUp ( std::size_t _value, std::size_t _alignment )
+{
+    return ( _value + _alignment - 1 ) / _alignment * _alignment;
+}
+
+// Отображает область, выровненную по границе большой страницы: отображаем 
+// с запасом и отрезаем невыровненные края
+void * mapAligned ( std::size_t _bytes )
+{
+    const std::size_t total = _bytes + HUGE_PAGE_SIZE;
+    void * raw = mmap( nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( raw == MAP_FAILED )
+    {
+        return nullptr;
+    }
+    char * begin   = static_cast< char * >( raw );
+    char * aligned = reinterpret_cast< char * >( roundUp( reinterpret_cast< std::size_t >( begin ), HUGE_PAGE_SIZE ) );
+    if ( aligned > begin )
+    {
+        munmap( begin, aligned - begin );
+    }
+    const std::size_t tail = ( begin + total ) - ( aligned + _bytes );
+    if ( tail > 0 )
+    {
+        munmap( aligned + _bytes, tail );
+    }
+    return aligned;
+}
+
+// Отображает область под элементы матрицы с учетом режима больших страниц:
+//   HugePagesExplicit    - MAP_HUGETLB (пул hugetlbfs), при неудаче как Transparent;
+//   HugePagesTransparent - madvise(MADV_HUGEPAGE) для выровненной области;
+//   HugePagesOff         - обычное отображение.
+bool mapRegion ( std::size_t _bytes, MatrixMemory::HugePageMode _mode, MatrixMemory::Region & _region )
+{
+#if defined( MAP_HUGETLB )
+    if ( _mode == MatrixMemory::HugePagesExplicit )
+    {
+        const std::size_t bytes = roundUp( _bytes, HUGE_PAGE_SIZE );
+        void * address = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, 
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+        if ( address != MAP_FAILED )
+        {
+            _region.data      = static_cast< double * >( address );
+            _region.bytes     = bytes;
+            _region.mapped    = true;
+            _region.hugePages = MatrixMemory::HugePagesExplicit;
+            gs_hugeTlbAllocations.fetch_add( 1 );
+            return true;
+        }
+    }
+#endif
+
+    const bool wantHuge = ( _mode != MatrixMemory::HugePagesOff );
+    const std::size_t bytes = wantHuge ? roundUp( _bytes, HUGE_PAGE_SIZE ) : _bytes;
+    void * address = wantHuge ? mapAligned( bytes ) : nullptr;
+    if ( ! wantHuge )
+    {
+        address = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        address = ( address == MAP_FAILED ) ? nullptr : address;
+    }
+    if ( address == nullptr )
+    {
+        return false;
+    }
+
+    _region.data   = static_cast< double * >( address );
+    _region.bytes  = bytes;
+    _region.mapped = true;
+
+    if ( wantHuge )
+    {
+#if defined( MADV_HUGEPAGE )
+        if ( madvise( address, bytes, MADV_HUGEPAGE ) == 0 )
+        {
+            _region.hugePages = MatrixMemory::HugePagesTransparent;
+            gs_transparentHugePageAllocations.fetch_add( 1 );
+            return true;
+        }
+#endif
+        gs_hugePageFallbacks.fetch_add( 1 );
+    }
+    return true;
+}
+
+#endif // MATRIX_HAVE_MMAP
+
+// Нужна ли параллельная инициализация области
+bool useParallelFirstTouch ( const MatrixMemory::Region & _region )
+{
+    return _region.placement == MatrixMemory::PlacementFirstTouch;
+}
+
+// Минимальная часть статического разбиения - 1 МБ
+const std::size_t FIRST_TOUCH_MIN_ELEMENTS = ( std::size_t( 1 ) << 20 ) / sizeof( double );
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Настройки
+// ---------------------------------------------------------------------------------
+void MatrixMemory::setNumaPolicy ( NumaPolicy _policy, int _node )
+{
+    gs_policy.store( _policy );
+    gs_bindNode.store( _node );
+}
+
+MatrixMemory::NumaPolicy MatrixMemory::getNumaPolicy ()
+{
+    return static_cast< NumaPolicy >( gs_policy.load() );
+}
+
+int MatrixMemory::getNumaBindNode ()
+{
+    return gs_bindNode.load();
+}
+
+void MatrixMemory::setLargeAllocationThreshold ( std::size_t _bytes )
+{
+    gs_largeThreshold.store( _bytes );
+}
+
+std::size_t MatrixMemory::getLargeAllocationThreshold ()
+{
+    return gs_largeThreshold.load();
+}
+
+int MatrixMemory::numaNodeCount ()
+{
+#if defined( MATRIX_HAVE_LIBNUMA )
+    if ( numa_available() >= 0 )
+    {
+        return std::max( 1, numa_num_configured_nodes() );
+    }
+    return 1;
+#else
+    static const int nodes = [] 
+    {
+        int count = 0;
+        while ( std::ifstream( "/sys/devices/system/node/node" + std::to_string( count ) + "/cpulist" ) )
+        {
+            count++;
+        }
+        return std::max( count, 1 );
+    }();
+    return nodes;
+#endif
+}
+
+void MatrixMemory::setHugePageMode ( HugePageMode _mode )
+{
+    gs_hugePageMode.store( _mode );
+}
+
+MatrixMemory::HugePageMode MatrixMemory::getHugePageMode ()
+{
+    return static_cast< HugePageMode >( gs_hugePageMode.load() );
+}
+
+void MatrixMemory::setHugePageThreshold ( std::size_t _bytes )
+{
+    gs_hugePageThreshold.store( _bytes );
+}
+
+std::size_t MatrixMemory::getHugePageThreshold ()
+{
+    return gs_hugePageThreshold.load();
+}
+
+MatrixMemory::Statistics MatrixMemory::getStatistics ()
+{
+    Statistics stats;
+    stats.largeAllocations  = gs_largeAllocations.load();
+    stats.numaPolicyApplied = gs_numaPolicyApplied.load();
+    stats.numaFallbacks     = gs_numaFallbacks.load();
+    stats.hugeTlbAllocations                = gs_hugeTlbAllocations.load();
+    stats.transparentHugePageAllocations    = gs_transparentHugePageAllocations.load();
+    stats.hugePageFallbacks                 = gs_hugePageFallbacks.load();
+    return stats;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Выделение и освобождение памяти
+// ---------------------------------------------------------------------------------
+bool MatrixMemory::allocate ( std::size_t _count, Region & _region, bool _zeroed )
+{
+    const std::size_t bytes = std::max< std::size_t >( _count, 1 ) * sizeof( double );
+    _region.data      = nullptr;
+    _region.bytes     = bytes;
+    _region.mapped    = false;
+    _region.hugePages = HugePagesOff;
+    _region.placement = PlacementDefault;
+
+    const NumaPolicy policy = getNumaPolicy();
+    const bool large = bytes >= getLargeAllocationThreshold();
+    if ( large )
+    {
+        gs_largeAllocations.fetch_add( 1 );
+    }
+
+#if defined( MATRIX_HAVE_MMAP )
+    const HugePageMode hugeMode = ( bytes >= getHugePageThreshold() ) ? getHugePageMode() : HugePagesOff;
+    // Анонимное отображение уже заполнено нулями, причем страницы, в которые 
+    // никто не пишет, физически не выделяются
+    const bool zeroMapping = _zeroed && bytes >= ZERO_MAPPING_THRESHOLD;
+    if ( ( large && policy != NumaDefault ) || hugeMode != HugePagesOff || zeroMapping )
+    {
+        if ( mapRegion( bytes, hugeMode, _region ) )
+        {
+            if ( policy == NumaFirstTouch )
+            {
+                _region.placement = PlacementFirstTouch;
+            }
+            else if ( policy == NumaInterleave || policy == NumaBindNode )
+            {
+                // Без mbind остается параллельная инициализация first-touch
+                if ( applyNumaPolicy( _region.data, _region.bytes, policy, getNumaBindNode() ) )
+                {
+                    _region.placement = PlacementNumaPolicy;
+                    gs_numaPolicyApplied.fetch_add( 1 );
+                }
+                else
+                {
+                    _region.placement = PlacementFirstTouch;
+                    gs_numaFallbacks.fetch_add( 1 );
+                }
+            }
+            // При политике first-touch нули записываются явно и параллельно,
+            // чтобы страницы распределились по узлам рабочих потоков
+            if ( _zeroed && useParallelFirstTouch( _region ) )
+            {
+                fillZero( _region, _count );
+            }
+            return true;
+        }
+    }
+#else
+    ( void ) policy;
+#endif
+
+    void * memory = nullptr;
+#if defined( _WIN32 )
+    memory = _aligned_malloc( bytes, CACHE_LINE );
+#else
+    if ( posix_memalign( & memory, CACHE_LINE, bytes ) != 0 )
+    {
+        memory = nullptr;
+    }
+#endif
+    _region.data = static_cast< double * >( memory );
+    if ( _region.data != nullptr && _zeroed )
+    {
+        std::memset( _region.data, 0, bytes );
+    }
+    return _region.data != nullptr;
+}
+
+void MatrixMemory::release ( Region & _region )
+{
+    if ( _region.data == nullptr )
+    {
+        return;
+    }
+#if defined( MATRIX_HAVE_MMAP )
+    if ( _region.mapped )
+    {
+        munmap( _region.data, _region.bytes );
+        _region.data = nullptr;
+        return;
+    }
+#endif
+#if defined( _WIN32 )
+    _aligned_free( _region.data );
+#else
+    std::free( _region.data );
+#endif
+    _region.data = nullptr;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Инициализация с учетом NUMA-политики
+// ---------------------------------------------------------------------------------
+void MatrixMemory::fillZero ( const Region & _region, std::size_t _count )
+{
+    double * data = _region.data;
+    if ( ! useParallelFirstTouch( _region ) )
+    {
+        std::fill( data, data + _count, 0.0 );
+        return;
+    }
+    ThreadPool::instance().parallelForStatic( 0, _count, FIRST_TOUCH_MIN_ELEMENTS,
+        [ data ] ( std::size_t from, std::size_t to ) { std::fill( data + from, data + to, 0.0 ); } );
+}
+
+void MatrixMemory::copy ( const Region & _region, const double * _source, std::size_t _count )
+{
+    double * data = _region.data;
+    if ( ! useParallelFirstTouch( _region ) )
+    {
+        std::memcpy( data, _source, _count * sizeof( double ) );
+        return;
+    }
+    ThreadPool::instance().parallelForStatic( 0, _count, FIRST_TOUCH_MIN_ELEMENTS,
+        [ data, _source ] ( std::size_t from, std::size_t to ) 
+        { 
+            std::memcpy( data + from, _source + from, ( to - from ) * sizeof( double ) ); 
+        } );
+}
+// =================================================================================
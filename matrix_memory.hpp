@@ -0,0 +1,134 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_MEMORY_HPP_
+#define _MATRIX_MEMORY_HPP_
+
+/*****************************************************************************/
+
+#include <cstddef>
+
+/*****************************************************************************/
+
+// Выделение памяти под элементы матриц с учетом NUMA-топологии.
+// Небольшие буферы выделяются в куче с выравниванием по кэш-линии. Буферы
+// от порога "больших" выделений (по умолчанию 16 МБ) при включенной NUMA-политике 
+// отображаются через mmap, после чего к ним применяется политика размещения.
+//
+// Буферы от порога больших страниц (по умолчанию 64 МБ) при включенном режиме
+// больших страниц также отображаются через mmap и выравниваются по 2 МБ, что 
+// сокращает промахи TLB при упаковке блоков GEMM и транспонировании.
+//
+// Начальные значения читаются из переменных окружения:
+//   MATRIX_NUMA_POLICY       = default | firsttouch | interleave | bind:<узел>
+//   MATRIX_LARGE_ALLOC_BYTES = порог больших выделений в байтах
+//   MATRIX_HUGE_PAGES        = off | thp | hugetlb
+//   MATRIX_HUGE_PAGE_BYTES   = порог больших страниц в байтах
+namespace MatrixMemory
+{
+
+enum HugePageMode
+{
+    // Обычные страницы 4 КБ
+    HugePagesOff = 0,
+
+    // Прозрачные большие страницы: madvise(MADV_HUGEPAGE), ядро подменяет 
+    // страницы в фоне. Если THP отключены в системе, остаются обычные страницы.
+    HugePagesTransparent,
+
+    // Явные большие страницы из пула hugetlbfs (MAP_HUGETLB). Если пул пуст 
+    // или не настроен, используется режим HugePagesTransparent.
+    HugePagesExplicit
+};
+
+enum NumaPolicy
+{
+    // Поведение операционной системы: страницы размещаются на узле потока,
+    // первым записавшим в них (при последовательной инициализации - на одном узле)
+    NumaDefault = 0,
+
+    // Инициализация (заполнение нулями и копирование) выполняется параллельно
+    // статическим разбиением пула потоков: строки матрицы попадают на узлы
+    // потоков, которые затем обрабатывают их в параллельных ядрах
+    NumaFirstTouch,
+
+    // Страницы чередуются между всеми узлами (mbind MPOL_INTERLEAVE).
+    // Если mbind недоступен, область инициализируется как при NumaFirstTouch.
+    NumaInterleave,
+
+    // Все страницы размещаются на заданном узле (mbind MPOL_BIND), при
+    // недоступном mbind - как при NumaFirstTouch
+    NumaBindNode
+};
+
+// Фактическое размещение страниц выделенной области
+enum NumaPlacement
+{
+    // Последовательная инициализация, страницы размещает операционная система
+    PlacementDefault = 0,
+
+    // Параллельная инициализация first-touch: политика NumaFirstTouch либо
+    // замена NumaInterleave / NumaBindNode, если mbind не удался
+    PlacementFirstTouch,
+
+    // Применена политика mbind (interleave / bind)
+    PlacementNumaPolicy
+};
+
+// Описание выделенной области, необходимое для ее освобождения
+struct Region
+{
+    double * data;
+    std::size_t bytes;
+    bool mapped;        // область получена через mmap
+    HugePageMode hugePages; // какие большие страницы удалось получить
+    NumaPlacement placement; // как размещаются страницы области
+};
+
+// Счетчики выделений с момента запуска программы
+struct Statistics
+{
+    std::size_t largeAllocations;   // выделения от порога больших
+    std::size_t numaPolicyApplied;  // успешные mbind (interleave / bind)
+    std::size_t numaFallbacks;      // mbind не удался - использован first-touch
+
+    std::size_t hugeTlbAllocations;             // получены страницы MAP_HUGETLB
+    std::size_t transparentHugePageAllocations; // принят madvise(MADV_HUGEPAGE)
+    std::size_t hugePageFallbacks;              // большие страницы недоступны
+};
+
+void setNumaPolicy ( NumaPolicy _policy, int _node = 0 );
+NumaPolicy getNumaPolicy ();
+int getNumaBindNode ();
+
+void setLargeAllocationThreshold ( std::size_t _bytes );
+std::size_t getLargeAllocationThreshold ();
+
+void setHugePageMode ( HugePageMode _mode );
+HugePageMode getHugePageMode ();
+
+void setHugePageThreshold ( std::size_t _bytes );
+std::size_t getHugePageThreshold ();
+
+// Количество NUMA-узлов системы (1, если топология недоступна)
+int numaNodeCount ();
+
+Statistics getStatistics ();
+
+// Выделяет память под _count элементов. Возвращает false при нехватке памяти.
+// При _zeroed == true память гарантированно заполнена нулями: буферы от 256 КБ
+// берутся из анонимного отображения (нулевые страницы ОС, без записи), меньшие 
+// обнуляются явно.
+bool allocate ( std::size_t _count, Region & _region, bool _zeroed = false );
+
+void release ( Region & _region );
+
+// Заполнение нулями и копирование с учетом размещения области: при 
+// PlacementFirstTouch область обрабатывается параллельно статическим разбиением пула
+void fillZero ( const Region & _region, std::size_t _count );
+void copy ( const Region & _region, const double * _source, std::size_t _count );
+
+} // namespace MatrixMemory
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_MEMORY_HPP_
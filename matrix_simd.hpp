@@ -0,0 +1,330 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_SIMD_HPP_
+#define _MATRIX_SIMD_HPP_
+
+/*****************************************************************************/
+
+// Тонкая обертка над SIMD-регистрами для вычислительных ядер.
+// Ширина пакета выбирается при компиляции: AVX (4 x double), SSE2 (2 x double)
+// или скалярная реализация (1 x double) для прочих платформ. FloatPack - 
+// аналогичный пакет из float (8, 4 или 1 элемент) для смешанной точности.
+// Только для внутреннего использования в *.cpp файлах ядер.
+
+#include <cmath>
+#include <cstddef>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#endif
+
+/*****************************************************************************/
+
+namespace MatrixSimd
+{
+
+#if defined( __AVX__ )
+
+struct Pack
+{
+    static const std::size_t width = 4;
+    __m256d v;
+
+    Pack () {}
+    Pack ( __m256d _v ) : v( _v ) {}
+
+    static Pack zero () { return _mm256_setzero_pd(); }
+    static Pack broadcast ( double _x ) { return _mm256_set1_pd( _x ); }
+    static Pack load ( const double * _p ) { return _mm256_loadu_pd( _p ); }
+    void store ( double * _p ) const { _mm256_storeu_pd( _p, v ); }
+
+    // Запись в обход кэша; _p выровнен на 32 байта
+    void stream ( double * _p ) const { _mm256_stream_pd( _p, v ); }
+};
+
+inline Pack operator + ( Pack a, Pack b ) { return _mm256_add_pd( a.v, b.v ); }
+inline Pack operator - ( Pack a, Pack b ) { return _mm256_sub_pd( a.v, b.v ); }
+inline Pack operator * ( Pack a, Pack b ) { return _mm256_mul_pd( a.v, b.v ); }
+inline Pack operator / ( Pack a, Pack b ) { return _mm256_div_pd( a.v, b.v ); }
+
+// a * b + c (одна инструкция FMA, если она доступна)
+inline Pack fmadd ( Pack a, Pack b, Pack c )
+{
+#if defined( __FMA__ )
+    return _mm256_fmadd_pd( a.v, b.v, c.v );
+#else
+    return _mm256_add_pd( _mm256_mul_pd( a.v, b.v ), c.v );
+#endif
+}
+
+inline Pack min ( Pack a, Pack b ) { return _mm256_min_pd( a.v, b.v ); }
+inline Pack max ( Pack a, Pack b ) { return _mm256_max_pd( a.v, b.v ); }
+inline Pack abs ( Pack a ) { return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), a.v ); }
+
+// Маска "элемент равен NaN" в виде пакета (все биты 1 или 0)
+inline Pack isNan ( Pack a ) { return _mm256_cmp_pd( a.v, a.v, _CMP_UNORD_Q ); }
+inline Pack operator | ( Pack a, Pack b ) { return _mm256_or_pd( a.v, b.v ); }
+inline bool anyBitSet ( Pack a ) { return _mm256_movemask_pd( a.v ) != 0; }
+
+// Маски сравнения и выбор по маске: select(mask, a, b) = mask ? a : b
+inline Pack lessThan ( Pack a, Pack b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_LT_OQ ); }
+inline Pack equalTo ( Pack a, Pack b ) { return _mm256_cmp_pd( a.v, b.v, _CMP_EQ_OQ ); }
+inline Pack select ( Pack mask, Pack a, Pack b ) { return _mm256_blendv_pd( b.v, a.v, mask.v ); }
+inline Pack bitAnd ( Pack a, Pack b ) { return _mm256_and_pd( a.v, b.v ); }
+
+// Сдвиги 64-битных представлений на 52 бита (поле порядка). Без AVX2
+// целочисленные сдвиги выполняются по половинам регистра.
+inline Pack shiftLeft52 ( Pack a )
+{
+#if defined( __AVX2__ )
+    return _mm256_castsi256_pd( _mm256_slli_epi64( _mm256_castpd_si256( a.v ), 52 ) );
+#else
+    const __m128i lo = _mm_slli_epi64( _mm_castpd_si128( _mm256_castpd256_pd128( a.v ) ), 52 );
+    const __m128i hi = _mm_slli_epi64( _mm_castpd_si128( _mm256_extractf128_pd( a.v, 1 ) ), 52 );
+    return _mm256_insertf128_pd( _mm256_castpd128_pd256( _mm_castsi128_pd( lo ) ), _mm_castsi128_pd( hi ), 1 );
+#endif
+}
+
+inline Pack shiftRight52 ( Pack a )
+{
+#if defined( __AVX2__ )
+    return _mm256_castsi256_pd( _mm256_srli_epi64( _mm256_castpd_si256( a.v ), 52 ) );
+#else
+    const __m128i lo = _mm_srli_epi64( _mm_castpd_si128( _mm256_castpd256_pd128( a.v ) ), 52 );
+    const __m128i hi = _mm_srli_epi64( _mm_castpd_si128( _mm256_extractf128_pd( a.v, 1 ) ), 52 );
+    return _mm256_insertf128_pd( _mm256_castpd128_pd256( _mm_castsi128_pd( lo ) ), _mm_castsi128_pd( hi ), 1 );
+#endif
+}
+
+struct FloatPack
+{
+    static const std::size_t width = 8;
+    __m256 v;
+
+    FloatPack () {}
+    FloatPack ( __m256 _v ) : v( _v ) {}
+
+    static FloatPack zero () { return _mm256_setzero_ps(); }
+    static FloatPack broadcast ( float _x ) { return _mm256_set1_ps( _x ); }
+    static FloatPack load ( const float * _p ) { return _mm256_loadu_ps( _p ); }
+    void store ( float * _p ) const { _mm256_storeu_ps( _p, v ); }
+};
+
+inline FloatPack fmadd ( FloatPack a, FloatPack b, FloatPack c )
+{
+#if defined( __FMA__ )
+    return _mm256_fmadd_ps( a.v, b.v, c.v );
+#else
+    return _mm256_add_ps( _mm256_mul_ps( a.v, b.v ), c.v );
+#endif
+}
+
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+
+struct Pack
+{
+    static const std::size_t width = 2;
+    __m128d v;
+
+    Pack () {}
+    Pack ( __m128d _v ) : v( _v ) {}
+
+    static Pack zero () { return _mm_setzero_pd(); }
+    static Pack broadcast ( double _x ) { return _mm_set1_pd( _x ); }
+    static Pack load ( const double * _p ) { return _mm_loadu_pd( _p ); }
+    void store ( double * _p ) const { _mm_storeu_pd( _p, v ); }
+    void stream ( double * _p ) const { _mm_stream_pd( _p, v ); }
+};
+
+inline Pack operator + ( Pack a, Pack b ) { return _mm_add_pd( a.v, b.v ); }
+inline Pack operator - ( Pack a, Pack b ) { return _mm_sub_pd( a.v, b.v ); }
+inline Pack operator * ( Pack a, Pack b ) { return _mm_mul_pd( a.v, b.v ); }
+inline Pack operator / ( Pack a, Pack b ) { return _mm_div_pd( a.v, b.v ); }
+inline Pack fmadd ( Pack a, Pack b, Pack c ) { return _mm_add_pd( _mm_mul_pd( a.v, b.v ), c.v ); }
+inline Pack min ( Pack a, Pack b ) { return _mm_min_pd( a.v, b.v ); }
+inline Pack max ( Pack a, Pack b ) { return _mm_max_pd( a.v, b.v ); }
+inline Pack abs ( Pack a ) { return _mm_andnot_pd( _mm_set1_pd( -0.0 ), a.v ); }
+inline Pack isNan ( Pack a ) { return _mm_cmpunord_pd( a.v, a.v ); }
+inline Pack operator | ( Pack a, Pack b ) { return _mm_or_pd( a.v, b.v ); }
+inline bool anyBitSet ( Pack a ) { return _mm_movemask_pd( a.v ) != 0; }
+
+inline Pack lessThan ( Pack a, Pack b ) { return _mm_cmplt_pd( a.v, b.v ); }
+inline Pack equalTo ( Pack a, Pack b ) { return _mm_cmpeq_pd( a.v, b.v ); }
+inline Pack select ( Pack mask, Pack a, Pack b ) { return _mm_or_pd( _mm_and_pd( mask.v, a.v ), _mm_andnot_pd( mask.v, b.v ) ); }
+inline Pack bitAnd ( Pack a, Pack b ) { return _mm_and_pd( a.v, b.v ); }
+inline Pack shiftLeft52 ( Pack a ) { return _mm_castsi128_pd( _mm_slli_epi64( _mm_castpd_si128( a.v ), 52 ) ); }
+inline Pack shiftRight52 ( Pack a ) { return _mm_castsi128_pd( _mm_srli_epi64( _mm_castpd_si128( a.v ), 52 ) ); }
+
+struct FloatPack
+{
+    static const std::size_t width = 4;
+    __m128 v;
+
+    FloatPack () {}
+    FloatPack ( __m128 _v ) : v( _v ) {}
+
+    static FloatPack zero () { return _mm_setzero_ps(); }
+    static FloatPack broadcast ( float _x ) { return _mm_set1_ps( _x ); }
+    static FloatPack load ( const float * _p ) { return _mm_loadu_ps( _p ); }
+    void store ( float * _p ) const { _mm_storeu_ps( _p, v ); }
+};
+
+inline FloatPack fmadd ( FloatPack a, FloatPack b, FloatPack c ) { return _mm_add_ps( _mm_mul_ps( a.v, b.v ), c.v ); }
+
+#else
+
+struct Pack
+{
+    static const std::size_t width = 1;
+    double v;
+
+    Pack () {}
+    Pack ( double _v ) : v( _v ) {}
+
+    static Pack zero () { return 0.0; }
+    static Pack broadcast ( double _x ) { return _x; }
+    static Pack load ( const double * _p ) { return * _p; }
+    void store ( double * _p ) const { * _p = v; }
+    void stream ( double * _p ) const { * _p = v; }
+};
+
+inline Pack operator + ( Pack a, Pack b ) { return a.v + b.v; }
+inline Pack operator - ( Pack a, Pack b ) { return a.v - b.v; }
+inline Pack operator * ( Pack a, Pack b ) { return a.v * b.v; }
+inline Pack operator / ( Pack a, Pack b ) { return a.v / b.v; }
+inline Pack fmadd ( Pack a, Pack b, Pack c ) { return a.v * b.v + c.v; }
+inline Pack min ( Pack a, Pack b ) { return a.v < b.v ? a.v : b.v; }
+inline Pack max ( Pack a, Pack b ) { return a.v > b.v ? a.v : b.v; }
+inline Pack abs ( Pack a ) { return std::fabs( a.v ); }
+inline Pack isNan ( Pack a ) { return ( a.v != a.v ) ? 1.0 : 0.0; }
+inline Pack operator | ( Pack a, Pack b ) { return ( a.v != 0.0 || b.v != 0.0 ) ? 1.0 : 0.0; }
+inline bool anyBitSet ( Pack a ) { return a.v != 0.0; }
+
+inline Pack lessThan ( Pack a, Pack b ) { return ( a.v < b.v ) ? 1.0 : 0.0; }
+inline Pack equalTo ( Pack a, Pack b ) { return ( a.v == b.v ) ? 1.0 : 0.0; }
+inline Pack select ( Pack mask, Pack a, Pack b ) { return mask.v != 0.0 ? a : b; }
+inline Pack copySign ( Pack magnitude, Pack sign ) { return std::copysign( magnitude.v, sign.v ); }
+inline Pack pow2 ( Pack n ) { return std::ldexp( 1.0, static_cast< int >( n.v ) ); }
+
+inline void splitExponent ( Pack x, Pack & mantissa, Pack & exponent )
+{
+    int e = 0;
+    mantissa = 2.0 * std::frexp( x.v, & e );
+    exponent = static_cast< double >( e - 1 );
+}
+
+struct FloatPack
+{
+    static const std::size_t width = 1;
+    float v;
+
+    FloatPack () {}
+    FloatPack ( float _v ) : v( _v ) {}
+
+    static FloatPack zero () { return 0.0f; }
+    static FloatPack broadcast ( float _x ) { return _x; }
+    static FloatPack load ( const float * _p ) { return * _p; }
+    void store ( float * _p ) const { * _p = v; }
+};
+
+inline FloatPack fmadd ( FloatPack a, FloatPack b, FloatPack c ) { return a.v * b.v + c.v; }
+
+#endif
+
+#if defined( __AVX__ ) || defined( __SSE2__ ) || defined( _M_X64 )
+
+// Знак sign, модуль magnitude
+inline Pack copySign ( Pack magnitude, Pack sign )
+{
+    return abs( magnitude ) | bitAnd( sign, Pack::broadcast( -0.0 ) );
+}
+
+// 2^n для целых n из [-1022, 1023]: после сложения с 2^52 + 1023 младшие
+// биты мантиссы равны n + 1023 и сдвигаются в поле порядка
+inline Pack pow2 ( Pack n )
+{
+    return shiftLeft52( n + Pack::broadcast( 4503599627371519.0 ) );
+}
+
+// x = mantissa * 2^exponent, mantissa из [1, 2) (для положительных нормализованных x)
+inline void splitExponent ( Pack x, Pack & mantissa, Pack & exponent )
+{
+    const Pack magic = Pack::broadcast( 4503599627370496.0 ); // 2^52
+    exponent = ( shiftRight52( x ) | magic ) - magic - Pack::broadcast( 1023.0 );
+    mantissa = bitAnd( x, Pack::broadcast( 2.2250738585072009e-308 ) ) | Pack::broadcast( 1.0 );
+}
+
+#endif
+
+// Округление до ближайшего целого (|x| < 2^51)
+inline Pack roundNearest ( Pack x )
+{
+    const Pack magic = Pack::broadcast( 6755399441055744.0 ); // 1.5 * 2^52
+    return ( x + magic ) - magic;
+}
+
+// Горизонтальные операции над элементами пакета
+inline double horizontalSum ( Pack a )
+{
+    double lanes[ Pack::width ];
+    a.store( lanes );
+    double result = lanes[ 0 ];
+    for ( std::size_t i = 1; i < Pack::width; i++ )
+    {
+        result += lanes[ i ];
+    }
+    return result;
+}
+
+inline double horizontalMin ( Pack a )
+{
+    double lanes[ Pack::width ];
+    a.store( lanes );
+    double result = lanes[ 0 ];
+    for ( std::size_t i = 1; i < Pack::width; i++ )
+    {
+        result = lanes[ i ] < result ? lanes[ i ] : result;
+    }
+    return result;
+}
+
+inline double horizontalMax ( Pack a )
+{
+    double lanes[ Pack::width ];
+    a.store( lanes );
+    double result = lanes[ 0 ];
+    for ( std::size_t i = 1; i < Pack::width; i++ )
+    {
+        result = lanes[ i ] > result ? lanes[ i ] : result;
+    }
+    return result;
+}
+
+// Программная предвыборка строки кэша, которая будет прочитана один раз
+inline void prefetchOnce ( const double * _p )
+{
+#if defined( __GNUC__ )
+    __builtin_prefetch( _p, 0, 0 );
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+    _mm_prefetch( reinterpret_cast< const char * >( _p ), _MM_HINT_NTA );
+#else
+    ( void ) _p;
+#endif
+}
+
+// Упорядочивает записи в обход кэша перед последующими записями (в том числе
+// перед сигналом о завершении части другому потоку)
+inline void streamFence ()
+{
+#if defined( __AVX__ ) || defined( __SSE2__ ) || defined( _M_X64 )
+    _mm_sfence();
+#endif
+}
+
+} // namespace MatrixSimd
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_SIMD_HPP_
@@ -0,0 +1,513 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_sketch.hpp"
+#include "matrix_kernels.hpp"
+#include "matrix_spectral.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Определение для std::min, принимающего аргументы по ссылке
+const int Sketch::SPARSE_NONZEROS;
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+// Ширина полосы столбцов (или пакета строк), обрабатываемой одной задачей
+static const int SKETCH_PANEL = 64;
+
+static void runPanels ( std::size_t count, std::size_t work, ThreadPool::RangeBody const & body )
+{
+	if ( work >= MatrixKernels::PARALLEL_MIN_ELEMENTS * 16 )
+	{
+		ThreadPool::instance().parallelFor( 0, count, 1, body );
+	}
+	else
+	{
+		body( 0, count );
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// Sketch
+// ---------------------------------------------------------------------------------
+Sketch::Sketch(Kind _kind, int _rows, int _dimension, unsigned long long _seed)
+	: kind(_kind), rows(_rows), dimension(_dimension), nonzeros(0), paddedDimension(0)
+{
+	if (_rows <= 0 || _dimension <= 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+
+	std::mt19937_64 generator(_seed);
+	switch (_kind)
+	{
+	case Gaussian:
+	{
+		std::normal_distribution< double > gaussian(0.0, 1.0 / std::sqrt(static_cast< double >(_rows)));
+		this->dense.resize(static_cast< std::size_t >(_rows) * _dimension);
+		for (double & x : this->dense)
+		{
+			x = gaussian(generator);
+		}
+		break;
+	}
+	case SparseSign:
+	{
+		this->nonzeros = std::min(SPARSE_NONZEROS, _rows);
+		const double value = 1.0 / std::sqrt(static_cast< double >(this->nonzeros));
+		std::uniform_int_distribution< int > row(0, _rows - 1);
+		this->positions.resize(static_cast< std::size_t >(_dimension) * this->nonzeros);
+		this->values.resize(this->positions.size());
+		for (int j = 0; j < _dimension; j++)
+		{
+			int * column = this->positions.data() + static_cast< std::size_t >(j) * this->nonzeros;
+			for (int t = 0; t < this->nonzeros; t++)
+			{
+				// Строки в столбце различны
+				do
+				{
+					column[t] = row(generator);
+				}
+				while (std::find(column, column + t, column[t]) != column + t);
+				this->values[static_cast< std::size_t >(j) * this->nonzeros + t] = (generator() & 1) ? value : -value;
+			}
+		}
+		break;
+	}
+	case SRHT:
+	{
+		this->paddedDimension = 1;
+		while (this->paddedDimension < _dimension)
+		{
+			this->paddedDimension *= 2;
+		}
+		if (_rows > this->paddedDimension)
+		{
+			throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+		}
+		this->signs.resize(_dimension);
+		for (double & s : this->signs)
+		{
+			s = (generator() & 1) ? 1.0 : -1.0;
+		}
+		// Выборка без возвращения: первые rows элементов случайной перестановки
+		std::vector< int > permutation(this->paddedDimension);
+		for (int i = 0; i < this->paddedDimension; i++)
+		{
+			permutation[i] = i;
+		}
+		for (int i = 0; i < _rows; i++)
+		{
+			std::uniform_int_distribution< int > pick(i, this->paddedDimension - 1);
+			std::swap(permutation[i], permutation[pick(generator)]);
+		}
+		this->sampled.assign(permutation.begin(), permutation.begin() + _rows);
+		break;
+	}
+	}
+}
+
+Sketch::Kind Sketch::getKind(void) const
+{
+	return this->kind;
+}
+
+int Sketch::getNumRows(void) const
+{
+	return this->rows;
+}
+
+int Sketch::getDimension(void) const
+{
+	return this->dimension;
+}
+
+void Sketch::hadamard(int order, int width, double * data)
+{
+	for (int half = 1; half < order; half *= 2)
+	{
+		for (int block = 0; block < order; block += 2 * half)
+		{
+			for (int i = block; i < block + half; i++)
+			{
+				double * x = data + static_cast< std::size_t >(i) * width;
+				double * y = x + static_cast< std::size_t >(half) * width;
+				for (int c = 0; c < width; c++)
+				{
+					const double a = x[c], b = y[c];
+					x[c] = a + b;
+					y[c] = a - b;
+				}
+			}
+		}
+	}
+}
+
+Matrix Sketch::apply(const Matrix & A) const
+{
+	if (A.rows != this->dimension)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const int d = this->dimension, n = A.cols, s = this->rows;
+	Matrix result(s, n);
+
+	switch (this->kind)
+	{
+	case Gaussian:
+		MatrixKernels::gemm(false, false, s, n, d, 1.0, this->dense.data(), d, A.data, n, 0.0, result.data, n);
+		break;
+
+	case SparseSign:
+	{
+		// Строка j матрицы A добавляется в nnz строк результата; полосы столбцов независимы
+		const std::size_t panels = (n + SKETCH_PANEL - 1) / SKETCH_PANEL;
+		runPanels(panels, static_cast< std::size_t >(d) * this->nonzeros * n, [ & ] ( std::size_t from, std::size_t to )
+		{
+			for (std::size_t panel = from; panel < to; panel++)
+			{
+				const int c0 = static_cast< int >(panel) * SKETCH_PANEL;
+				const int width = std::min(SKETCH_PANEL, n - c0);
+				for (int j = 0; j < d; j++)
+				{
+					const double * aj = A.data + static_cast< std::size_t >(j) * n + c0;
+					for (int t = 0; t < this->nonzeros; t++)
+					{
+						const std::size_t index = static_cast< std::size_t >(j) * this->nonzeros + t;
+						double * target = result.data + static_cast< std::size_t >(this->positions[index]) * n + c0;
+						MatrixKernels::axpy(width, this->values[index], aj, target);
+					}
+				}
+			}
+		});
+		break;
+	}
+
+	case SRHT:
+	{
+		// Полоса столбцов A копируется со знаками в буфер paddedDimension x width,
+		// преобразуется и прореживается по выбранным строкам
+		const int order = this->paddedDimension;
+		const double scale = 1.0 / std::sqrt(static_cast< double >(s));
+		const std::size_t panels = (n + SKETCH_PANEL - 1) / SKETCH_PANEL;
+		const std::size_t work = static_cast< std::size_t >(order) * n * 8;
+		runPanels(panels, work, [ & ] ( std::size_t from, std::size_t to )
+		{
+			std::vector< double > buffer(static_cast< std::size_t >(order) * SKETCH_PANEL);
+			for (std::size_t panel = from; panel < to; panel++)
+			{
+				const int c0 = static_cast< int >(panel) * SKETCH_PANEL;
+				const int width = std::min(SKETCH_PANEL, n - c0);
+				std::fill(buffer.begin(), buffer.begin() + static_cast< std::size_t >(order) * width, 0.0);
+				for (int j = 0; j < d; j++)
+				{
+					const double * aj = A.data + static_cast< std::size_t >(j) * n + c0;
+					double * bj = buffer.data() + static_cast< std::size_t >(j) * width;
+					for (int c = 0; c < width; c++)
+					{
+						bj[c] = this->signs[j] * aj[c];
+					}
+				}
+				hadamard(order, width, buffer.data());
+				for (int r = 0; r < s; r++)
+				{
+					const double * br = buffer.data() + static_cast< std::size_t >(this->sampled[r]) * width;
+					double * target = result.data + static_cast< std::size_t >(r) * n + c0;
+					for (int c = 0; c < width; c++)
+					{
+						target[c] = scale * br[c];
+					}
+				}
+			}
+		});
+		break;
+	}
+	}
+
+	if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return result;
+}
+
+Matrix Sketch::applyTransposed(const Matrix & A) const
+{
+	if (A.cols != this->dimension)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const int d = this->dimension, m = A.rows, s = this->rows;
+	Matrix result(m, s);
+
+	switch (this->kind)
+	{
+	case Gaussian:
+		MatrixKernels::gemm(false, true, m, s, d, 1.0, A.data, d, this->dense.data(), d, 0.0, result.data, s);
+		break;
+
+	case SparseSign:
+	{
+		// Строки A независимы: result[i][position] += value * A[i][j]
+		const std::size_t panels = (m + SKETCH_PANEL - 1) / SKETCH_PANEL;
+		runPanels(panels, static_cast< std::size_t >(m) * d * this->nonzeros, [ & ] ( std::size_t from, std::size_t to )
+		{
+			for (int i = static_cast< int >(from) * SKETCH_PANEL; i < std::min(m, static_cast< int >(to) * SKETCH_PANEL); i++)
+			{
+				const double * ai = A.data + static_cast< std::size_t >(i) * d;
+				double * target = result.data + static_cast< std::size_t >(i) * s;
+				for (int j = 0; j < d; j++)
+				{
+					const int * column = this->positions.data() + static_cast< std::size_t >(j) * this->nonzeros;
+					const double * value = this->values.data() + static_cast< std::size_t >(j) * this->nonzeros;
+					for (int t = 0; t < this->nonzeros; t++)
+					{
+						target[column[t]] += value[t] * ai[j];
+					}
+				}
+			}
+		});
+		break;
+	}
+
+	case SRHT:
+	{
+		// Пакет строк A транспонируется в столбцы буфера paddedDimension x width
+		const int order = this->paddedDimension;
+		const double scale = 1.0 / std::sqrt(static_cast< double >(s));
+		const std::size_t panels = (m + SKETCH_PANEL - 1) / SKETCH_PANEL;
+		const std::size_t work = static_cast< std::size_t >(order) * m * 8;
+		runPanels(panels, work, [ & ] ( std::size_t from, std::size_t to )
+		{
+			std::vector< double > buffer(static_cast< std::size_t >(order) * SKETCH_PANEL);
+			for (std::size_t panel = from; panel < to; panel++)
+			{
+				const int r0 = static_cast< int >(panel) * SKETCH_PANEL;
+				const int width = std::min(SKETCH_PANEL, m - r0);
+				std::fill(buffer.begin(), buffer.begin() + static_cast< std::size_t >(order) * width, 0.0);
+				for (int c = 0; c < width; c++)
+				{
+					const double * ai = A.data + static_cast< std::size_t >(r0 + c) * d;
+					for (int j = 0; j < d; j++)
+					{
+						buffer[static_cast< std::size_t >(j) * width + c] = this->signs[j] * ai[j];
+					}
+				}
+				hadamard(order, width, buffer.data());
+				for (int c = 0; c < width; c++)
+				{
+					double * target = result.data + static_cast< std::size_t >(r0 + c) * s;
+					for (int r = 0; r < s; r++)
+					{
+						target[r] = scale * buffer[static_cast< std::size_t >(this->sampled[r]) * width + c];
+					}
+				}
+			}
+		});
+		break;
+	}
+	}
+
+	if ( ! MatrixKernels::allFinite(result.elementCount(), result.data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return result;
+}
+
+Matrix Sketch::toMatrix() const
+{
+	Matrix identity(this->dimension, this->dimension);
+	for (int i = 0; i < this->dimension; i++)
+	{
+		identity.data[static_cast< std::size_t >(i) * this->dimension + i] = 1.0;
+	}
+	return this->apply(identity);
+}
+// =================================================================================
+
+
+// =================================================================================
+// LowRank
+// ---------------------------------------------------------------------------------
+LowRank::LowRank(const Matrix & _U, const Matrix & _V)
+	: U(_U), V(_V)
+{
+	if (_U.getNumColumns() != _V.getNumColumns())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+}
+
+int LowRank::getNumRows(void) const
+{
+	return this->U.getNumRows();
+}
+
+int LowRank::getNumColumns(void) const
+{
+	return this->V.getNumRows();
+}
+
+int LowRank::getRank(void) const
+{
+	return this->U.getNumColumns();
+}
+
+const Matrix & LowRank::getU(void) const
+{
+	return this->U;
+}
+
+const Matrix & LowRank::getV(void) const
+{
+	return this->V;
+}
+
+Matrix LowRank::toMatrix() const
+{
+	Matrix result(this->getNumRows(), this->getNumColumns(), Matrix::uninitialized);
+	return result.gemm(1.0, this->U, this->V, 0.0, Matrix::NoTrans, Matrix::Trans);
+}
+
+const Matrix operator * (const LowRank & l, const Matrix & m)
+{
+	if (l.getNumColumns() != m.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix core(l.getRank(), m.getNumColumns(), Matrix::uninitialized);
+	core.gemm(1.0, l.V, m, 0.0, Matrix::Trans);
+	Matrix result(l.getNumRows(), m.getNumColumns(), Matrix::uninitialized);
+	result.gemm(1.0, l.U, core, 0.0);
+	return result;
+}
+
+const Matrix operator * (const Matrix & m, const LowRank & l)
+{
+	if (m.getNumColumns() != l.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix core(m.getNumRows(), l.getRank(), Matrix::uninitialized);
+	core.gemm(1.0, m, l.U, 0.0);
+	Matrix result(m.getNumRows(), l.getNumColumns(), Matrix::uninitialized);
+	result.gemm(1.0, core, l.V, 0.0, Matrix::NoTrans, Matrix::Trans);
+	return result;
+}
+
+const Vector operator * (const LowRank & l, const Vector & v)
+{
+	if (l.getNumColumns() != v.getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector core(l.getRank());
+	core.gemv(1.0, l.V, v, 0.0, Matrix::Trans);
+	Vector result(l.getNumRows());
+	result.gemv(1.0, l.U, core, 0.0);
+	return result;
+}
+
+const LowRank operator * (const LowRank & left, const LowRank & right)
+{
+	if (left.getNumColumns() != right.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	// U1 * (V1^T * U2) * V2^T: ядро k1 x k2 присоединяется к сомножителю меньшего ранга
+	Matrix core(left.getRank(), right.getRank(), Matrix::uninitialized);
+	core.gemm(1.0, left.V, right.U, 0.0, Matrix::Trans);
+	if (left.getRank() >= right.getRank())
+	{
+		Matrix u(left.getNumRows(), right.getRank(), Matrix::uninitialized);
+		u.gemm(1.0, left.U, core, 0.0);
+		return LowRank(u, right.V);
+	}
+	Matrix v(right.getNumColumns(), left.getRank(), Matrix::uninitialized);
+	v.gemm(1.0, right.V, core, 0.0, Matrix::NoTrans, Matrix::Trans);
+	return LowRank(left.U, v);
+}
+// =================================================================================
+
+
+// =================================================================================
+// Приближенные произведения и разложения
+// ---------------------------------------------------------------------------------
+Matrix approximateProduct(const Matrix & A, const Matrix & B, int sketchSize,
+                          Sketch::Kind kind, unsigned long long seed)
+{
+	if (A.getNumColumns() != B.getNumRows())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const Sketch sketch(kind, sketchSize, A.getNumColumns(), seed);
+	const Matrix left = sketch.applyTransposed(A);
+	const Matrix right = sketch.apply(B);
+	Matrix result(A.getNumRows(), B.getNumColumns(), Matrix::uninitialized);
+	return result.gemm(1.0, left, right, 0.0);
+}
+
+Matrix rangeFinder(const Matrix & A, int size, Sketch::Kind kind,
+                   int powerIterations, unsigned long long seed)
+{
+	const int m = A.getNumRows(), n = A.getNumColumns();
+	if (size < 1 || size > std::min(m, n) || powerIterations < 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	const Sketch sketch(kind, size, n, seed);
+	Matrix Q = orthonormalBasis(sketch.applyTransposed(A));
+
+	// Степенной метод с переортогонализацией: Q = orth(A * orth(A^T * Q))
+	Matrix Z(n, size, Matrix::uninitialized), Y(m, size, Matrix::uninitialized);
+	for (int step = 0; step < powerIterations; step++)
+	{
+		Z.gemm(1.0, A, Q, 0.0, Matrix::Trans);
+		Y.gemm(1.0, A, orthonormalBasis(Z), 0.0);
+		Q = orthonormalBasis(Y);
+	}
+	return Q;
+}
+
+LowRank lowRankApprox(const Matrix & A, int k, int oversampling, int powerIterations,
+                      Sketch::Kind kind, unsigned long long seed)
+{
+	const int m = A.getNumRows(), n = A.getNumColumns();
+	if (k < 1 || k > std::min(m, n) || oversampling < 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	const int l = std::min(k + oversampling, std::min(m, n));
+	const Matrix Q = rangeFinder(A, l, kind, powerIterations, seed);
+
+	Matrix B(l, n, Matrix::uninitialized);
+	B.gemm(1.0, Q, A, 0.0, Matrix::Trans);
+	const SingularValueDecomposition decomposition = svd(B);
+
+	// Первые k компонент: U = Q * U_B * diag(sigma), V = V_B
+	Matrix scaledU(l, k, Matrix::uninitialized), V(n, k, Matrix::uninitialized);
+	for (int i = 0; i < l; i++)
+	{
+		for (int j = 0; j < k; j++)
+		{
+			scaledU[i][j] = decomposition.U[i][j] * decomposition.singularValues[j];
+		}
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < k; j++)
+		{
+			V[i][j] = decomposition.V[i][j];
+		}
+	}
+	Matrix U(m, k, Matrix::uninitialized);
+	U.gemm(1.0, Q, scaledU, 0.0);
+	return LowRank(U, V);
+}
+// =================================================================================
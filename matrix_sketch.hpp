@@ -0,0 +1,138 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_SKETCH_HPP_
+#define _MATRIX_SKETCH_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+#include "vector.hpp"
+
+#include <vector>
+
+// Случайное сжатие (sketching) и малоранговые приближения больших плотных
+// матриц. Все операторы сжатия S (s x d) нормированы так, что E[S^T * S] = I:
+// ||S * x|| приближает ||x||, а (A * S^T) * (S * B) - произведение A * B.
+// При одинаковом seed операторы и результаты воспроизводимы.
+
+/*****************************************************************************/
+
+// Оператор сжатия размерности dimension до rows (rows x dimension)
+class Sketch
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	enum Kind
+	{
+		Gaussian,    // плотная матрица N(0, 1/rows), применение - GEMM
+		SparseSign,  // в каждом столбце SPARSE_NONZEROS элементов +-1/sqrt(nnz), O(nnz * n)
+		SRHT         // выборка строк преобразования Уолша-Адамара со случайными знаками, O(d log d * n)
+	};
+
+	static const int SPARSE_NONZEROS = 8;
+
+private:
+	Kind kind;
+	int rows;
+	int dimension;
+
+	// Gaussian: элементы S построчно
+	std::vector< double > dense;
+
+	// SparseSign: для столбца j - строки positions[j * nnz + t] и значения values[j * nnz + t]
+	int nonzeros;
+	std::vector< int > positions;
+	std::vector< double > values;
+
+	// SRHT: S = sqrt(1 / rows) * R * H * D, H - преобразование порядка paddedDimension
+	// (степень двойки), D - знаки signs, R - выбранные строки sampled
+	int paddedDimension;
+	std::vector< double > signs;
+	std::vector< int > sampled;
+
+	// Быстрое (ненормированное) преобразование Уолша-Адамара каждого столбца
+	// матрицы order x width, хранящейся построчно: бабочки над целыми строками
+	static void hadamard(int order, int width, double * data);
+
+public:
+
+	// Оператор rows x dimension. Если размеры не положительны (или для SRHT
+	// rows больше дополненной до степени двойки размерности), генерируется
+	// исключение с текстом "Invalid dimensions".
+	Sketch(Kind _kind, int _rows, int _dimension, unsigned long long _seed = 0);
+
+	Kind getKind(void) const;
+	int getNumRows(void) const;
+	int getDimension(void) const;
+
+	// S * A (количество строк A равно dimension)
+	Matrix apply(const Matrix & A) const;
+
+	// A * S^T (количество столбцов A равно dimension)
+	Matrix applyTransposed(const Matrix & A) const;
+
+	// Явная матрица S
+	Matrix toMatrix() const;
+};
+
+/*****************************************************************************/
+
+// Малоранговая матрица U * V^T (U - m x k, V - n x k), хранящая только
+// сомножители: O((m + n) * k) памяти вместо O(m * n). Произведения с другими
+// матрицами вычисляются через сомножители без построения полной матрицы.
+class LowRank
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	Matrix U;
+	Matrix V;
+
+public:
+
+	// Количество столбцов U и V должно совпадать, иначе генерируется
+	// исключение с текстом "Size mismatch"
+	LowRank(const Matrix & _U, const Matrix & _V);
+
+	int getNumRows(void) const;
+	int getNumColumns(void) const;
+	int getRank(void) const;
+
+	const Matrix & getU(void) const;
+	const Matrix & getV(void) const;
+
+	// Полная матрица U * V^T
+	Matrix toMatrix() const;
+
+	// U * (V^T * B): O((m + n) * k * p) вместо O(m * n * p)
+	friend const Matrix operator * (const LowRank & l, const Matrix & m);
+	// (A * U) * V^T
+	friend const Matrix operator * (const Matrix & m, const LowRank & l);
+	friend const Vector operator * (const LowRank & l, const Vector & v);
+	// Произведение малоранговых матриц остается малоранговым (ранг - меньший из двух)
+	friend const LowRank operator * (const LowRank & left, const LowRank & right);
+};
+
+/*****************************************************************************/
+
+// Приближенное произведение (A * S^T) * (S * B) с оператором сжатия
+// внутренней размерности до sketchSize. Ошибка порядка
+// ||A||_F * ||B||_F / sqrt(sketchSize).
+Matrix approximateProduct(const Matrix & A, const Matrix & B, int sketchSize,
+                          Sketch::Kind kind = Sketch::Gaussian, unsigned long long seed = 0);
+
+// Рандомизированный поиск образа: матрица m x size с ортонормированными
+// столбцами, приближающая пространство столбцов A. powerIterations шагов
+// степенного метода уточняют базис при медленно убывающем спектре.
+// Если size вне [1, min(m, n)], генерируется исключение с текстом "Invalid dimensions".
+Matrix rangeFinder(const Matrix & A, int size, Sketch::Kind kind = Sketch::Gaussian,
+                   int powerIterations = 0, unsigned long long seed = 0);
+
+// Приближение ранга k: A ~ U * V^T, где U = Q * U_B * diag(sigma), V = V_B по
+// сингулярному разложению B = Q^T * A малой размерности (k + oversampling) x n.
+LowRank lowRankApprox(const Matrix & A, int k, int oversampling = 10, int powerIterations = 2,
+                      Sketch::Kind kind = Sketch::Gaussian, unsigned long long seed = 0);
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_SKETCH_HPP_
@@ -0,0 +1,986 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_spectral.hpp"
+#include "matrix_kernels.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// =================================================================================
+// Отражения Хаусхолдера
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Количество отражений в блоке (ширина панели)
+const int BLOCK = 32;
+
+const double EPSILON = std::numeric_limits< double >::epsilon();
+
+// Отражение H = I - tau * v * v^T, для которого H * x = beta * e_1.
+// x заменяется на v (v[0] = 1), возвращается tau.
+double householder ( int n, double * x, double & beta )
+{
+	const double alpha = x[0];
+	const double tailNorm = (n > 1) ? MatrixKernels::norm2(n - 1, x + 1) : 0.0;
+	x[0] = 1.0;
+	if (tailNorm == 0.0)
+	{
+		beta = alpha;
+		return 0.0;
+	}
+	beta = -std::copysign(std::hypot(alpha, tailNorm), alpha);
+	MatrixKernels::scale(n - 1, 1.0 / (alpha - beta), x + 1);
+	return (beta - alpha) / beta;
+}
+
+// Блок из count отражений в компактной форме H_0 * H_1 * ... = I - V^T * T * V.
+// Строка j матрицы V (count x length) - вектор v_j, действующий на индексы
+// offset .. offset + length - 1; T - верхнетреугольная count x count.
+struct BlockReflector
+{
+	int offset;
+	int count;
+	int length;
+	std::vector< double > V;
+	std::vector< double > T;
+};
+
+// T(j, j) = tau_j, T(0:j, j) = -tau_j * T(0:j, 0:j) * V(0:j, :) * v_j
+void formT ( BlockReflector & block, const std::vector< double > & taus )
+{
+	const int b = block.count;
+	std::vector< double > gram(static_cast< std::size_t >(b) * b);
+	MatrixKernels::gemm(false, true, b, b, block.length, 1.0, block.V.data(), block.length,
+	                    block.V.data(), block.length, 0.0, gram.data(), b);
+
+	block.T.assign(static_cast< std::size_t >(b) * b, 0.0);
+	for (int j = 0; j < b; j++)
+	{
+		block.T[j * b + j] = taus[j];
+		for (int i = 0; i < j; i++)
+		{
+			double s = 0.0;
+			for (int t = i; t < j; t++)
+			{
+				s += block.T[i * b + t] * gram[t * b + j];
+			}
+			block.T[i * b + j] = -taus[j] * s;
+		}
+	}
+}
+
+// Z(offset : offset + length, :) = H * Z, где H = I - V^T * op(T) * V, Z имеет cols столбцов
+void applyLeft ( const BlockReflector & block, bool transpose, int cols, double * Z, int ldz )
+{
+	const int b = block.count;
+	double * rows = Z + static_cast< std::size_t >(block.offset) * ldz;
+	std::vector< double > Y(static_cast< std::size_t >(b) * cols), TY(Y.size());
+	MatrixKernels::gemm(false, false, b, cols, block.length, 1.0, block.V.data(), block.length, rows, ldz, 0.0, Y.data(), cols);
+	MatrixKernels::gemm(transpose, false, b, cols, b, 1.0, block.T.data(), b, Y.data(), cols, 0.0, TY.data(), cols);
+	MatrixKernels::gemm(true, false, block.length, cols, b, -1.0, block.V.data(), block.length, TY.data(), cols, 1.0, rows, ldz);
+}
+
+// X(:, offset : offset + length) = X * H, где H = I - V^T * op(T) * V, X имеет rows строк
+void applyRight ( const BlockReflector & block, bool transpose, int rows, double * X, int ldx )
+{
+	if (rows <= 0)
+	{
+		return;
+	}
+	const int b = block.count;
+	double * cols = X + block.offset;
+	std::vector< double > Y(static_cast< std::size_t >(rows) * b), YT(Y.size());
+	MatrixKernels::gemm(false, true, rows, b, block.length, 1.0, cols, ldx, block.V.data(), block.length, 0.0, Y.data(), b);
+	MatrixKernels::gemm(false, transpose, rows, b, b, 1.0, Y.data(), b, block.T.data(), b, 0.0, YT.data(), b);
+	MatrixKernels::gemm(false, false, rows, block.length, b, -1.0, YT.data(), b, block.V.data(), block.length, 1.0, cols, ldx);
+}
+
+// Блочное LQ-разложение X (r x c, r <= c): X * H_0 * H_1 * ... = [L 0].
+// L (нижнетреугольная r x r) остается в первых r столбцах X.
+std::vector< BlockReflector > factorLQ ( int r, int c, double * X, int ldx )
+{
+	std::vector< BlockReflector > blocks;
+	for (int p = 0; p < r; p += BLOCK)
+	{
+		const int b = std::min(BLOCK, r - p);
+		BlockReflector block;
+		block.offset = p;
+		block.count = b;
+		block.length = c - p;
+		block.V.assign(static_cast< std::size_t >(b) * block.length, 0.0);
+		std::vector< double > taus(b);
+
+		// Панель: отражения строятся по строкам и сразу применяются к строкам панели
+		for (int j = 0; j < b; j++)
+		{
+			const int i = p + j;
+			const int length = c - i;
+			double * xi = X + static_cast< std::size_t >(i) * ldx + i;
+			double beta;
+			const double tau = householder(length, xi, beta);
+			std::copy(xi, xi + length, block.V.begin() + static_cast< std::size_t >(j) * block.length + j);
+			taus[j] = tau;
+
+			for (int q = i + 1; q < p + b; q++)
+			{
+				double * xq = X + static_cast< std::size_t >(q) * ldx + i;
+				MatrixKernels::axpy(length, -tau * MatrixKernels::dot(length, xq, xi), xi, xq);
+			}
+			xi[0] = beta;
+			std::fill(xi + 1, xi + length, 0.0);
+		}
+
+		formT(block, taus);
+		applyRight(block, false, r - p - b, X + static_cast< std::size_t >(p + b) * ldx, ldx);
+		blocks.push_back(std::move(block));
+	}
+	return blocks;
+}
+
+void transpose ( int rows, int cols, const double * source, int lds, double * target, int ldt )
+{
+	const int TILE = 32;
+	for (int i0 = 0; i0 < rows; i0 += TILE)
+	{
+		for (int j0 = 0; j0 < cols; j0 += TILE)
+		{
+			for (int i = i0; i < std::min(rows, i0 + TILE); i++)
+			{
+				for (int j = j0; j < std::min(cols, j0 + TILE); j++)
+				{
+					target[static_cast< std::size_t >(j) * ldt + i] = source[static_cast< std::size_t >(i) * lds + j];
+				}
+			}
+		}
+	}
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Приведение симметричной матрицы к трехдиагональному виду
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// A (n x n, обе половины) = Q * T * Q^T, Q = H_0 * H_1 * ... * H_(n-3).
+// d - диагональ T, e - наддиагональ. Содержимое A разрушается.
+// Панель из BLOCK отражений строится по схеме LAPACK dsytrd/dlatrd: строки
+// панели обновляются по накопленным V, W, а остаток матрицы - одним
+// обновлением ранга 2 * BLOCK: A22 = A22 - V * W^T - W * V^T (два вызова GEMM).
+std::vector< BlockReflector > tridiagonalize ( int n, double * A, double * d, double * e )
+{
+	std::vector< BlockReflector > blocks;
+	std::vector< double > V, W, y, t1, t2;
+	for (int p = 0; p < n - 2; p += BLOCK)
+	{
+		const int b = std::min(BLOCK, n - 2 - p);
+		V.assign(static_cast< std::size_t >(n) * b, 0.0);
+		W.assign(V.size(), 0.0);
+		std::vector< double > taus(b);
+
+		for (int j = 0; j < b; j++)
+		{
+			const int i = p + j;
+			double * ai = A + static_cast< std::size_t >(i) * n;
+			const std::size_t rowI = static_cast< std::size_t >(i) * b;
+
+			// Строка i с учетом предыдущих отражений панели
+			if (j > 0)
+			{
+				MatrixKernels::gemv(false, n - i, j, -1.0, W.data() + rowI, b, V.data() + rowI, 1.0, ai + i);
+				MatrixKernels::gemv(false, n - i, j, -1.0, V.data() + rowI, b, W.data() + rowI, 1.0, ai + i);
+			}
+			d[i] = ai[i];
+
+			const int length = n - i - 1;
+			double * v = ai + i + 1;
+			const double tau = householder(length, v, e[i]);
+			taus[j] = tau;
+			for (int r = 0; r < length; r++)
+			{
+				V[static_cast< std::size_t >(i + 1 + r) * b + j] = v[r];
+			}
+
+			// w = tau * (A22 - V * W^T - W * V^T) * v - (tau / 2) * (w^T v) * v
+			const std::size_t rowNext = static_cast< std::size_t >(i + 1) * b;
+			y.resize(length);
+			MatrixKernels::gemv(false, length, length, 1.0, ai + n + i + 1, n, v, 0.0, y.data());
+			if (j > 0)
+			{
+				t1.resize(j);
+				t2.resize(j);
+				MatrixKernels::gemv(true, length, j, 1.0, W.data() + rowNext, b, v, 0.0, t1.data());
+				MatrixKernels::gemv(true, length, j, 1.0, V.data() + rowNext, b, v, 0.0, t2.data());
+				MatrixKernels::gemv(false, length, j, -1.0, V.data() + rowNext, b, t1.data(), 1.0, y.data());
+				MatrixKernels::gemv(false, length, j, -1.0, W.data() + rowNext, b, t2.data(), 1.0, y.data());
+			}
+			MatrixKernels::scale(length, tau, y.data());
+			MatrixKernels::axpy(length, -0.5 * tau * MatrixKernels::dot(length, y.data(), v), v, y.data());
+			for (int r = 0; r < length; r++)
+			{
+				W[static_cast< std::size_t >(i + 1 + r) * b + j] = y[r];
+			}
+		}
+
+		const int q = p + b;
+		const std::size_t rowQ = static_cast< std::size_t >(q) * b;
+		double * a22 = A + static_cast< std::size_t >(q) * n + q;
+		MatrixKernels::gemm(false, true, n - q, n - q, b, -1.0, V.data() + rowQ, b, W.data() + rowQ, b, 1.0, a22, n);
+		MatrixKernels::gemm(false, true, n - q, n - q, b, -1.0, W.data() + rowQ, b, V.data() + rowQ, b, 1.0, a22, n);
+
+		// Векторы панели действуют на индексы p + 1 .. n - 1
+		BlockReflector block;
+		block.offset = p + 1;
+		block.count = b;
+		block.length = n - p - 1;
+		block.V.resize(static_cast< std::size_t >(b) * block.length);
+		transpose(block.length, b, V.data() + static_cast< std::size_t >(p + 1) * b, b, block.V.data(), block.length);
+		formT(block, taus);
+		blocks.push_back(std::move(block));
+	}
+
+	if (n >= 2)
+	{
+		const std::size_t last = static_cast< std::size_t >(n - 2) * n + (n - 2);
+		d[n - 2] = A[last];
+		e[n - 2] = A[last + 1];
+	}
+	d[n - 1] = A[static_cast< std::size_t >(n) * n - 1];
+	return blocks;
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Собственные значения трехдиагональной матрицы ("разделяй и властвуй")
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Размер подзадачи, решаемой неявным QL-алгоритмом
+const int LEAF_SIZE = 32;
+
+// Сортировка собственных значений d по возрастанию вместе со столбцами Q
+void sortEigen ( int n, double * d, double * Q, int ldq )
+{
+	std::vector< int > order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [ d ] ( int a, int b ) { return d[a] < d[b]; });
+
+	std::vector< double > values(d, d + n), row(n);
+	for (int j = 0; j < n; j++)
+	{
+		d[j] = values[order[j]];
+	}
+	for (int i = 0; i < n; i++)
+	{
+		double * qi = Q + static_cast< std::size_t >(i) * ldq;
+		for (int j = 0; j < n; j++)
+		{
+			row[j] = qi[order[j]];
+		}
+		std::copy(row.begin(), row.end(), qi);
+	}
+}
+
+// Неявный QL-алгоритм со сдвигами Уилкинсона. e[i] - элемент (i, i + 1),
+// e[n - 1] - рабочий. Вращения накапливаются в столбцах Q (исходно единичной).
+void tridiagonalQL ( int n, double * d, double * e, double * Q, int ldq )
+{
+	e[n - 1] = 0.0;
+	for (int l = 0; l < n; l++)
+	{
+		int iterations = 0;
+		int m;
+		do
+		{
+			for (m = l; m < n - 1; m++)
+			{
+				if (std::fabs(e[m]) <= EPSILON * (std::fabs(d[m]) + std::fabs(d[m + 1])))
+				{
+					break;
+				}
+			}
+			if (m == l)
+			{
+				break;
+			}
+			if (++iterations > 60)
+			{
+				throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+			}
+
+			double g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+			double r = std::hypot(g, 1.0);
+			g = d[m] - d[l] + e[l] / (g + std::copysign(r, g));
+			double s = 1.0, c = 1.0, p = 0.0;
+			int i;
+			for (i = m - 1; i >= l; i--)
+			{
+				double f = s * e[i];
+				const double b = c * e[i];
+				r = std::hypot(f, g);
+				e[i + 1] = r;
+				if (r == 0.0)
+				{
+					d[i + 1] -= p;
+					e[m] = 0.0;
+					break;
+				}
+				s = f / r;
+				c = g / r;
+				g = d[i + 1] - p;
+				r = (d[i] - g) * s + 2.0 * c * b;
+				p = s * r;
+				d[i + 1] = g + p;
+				g = c * r - b;
+				for (int k = 0; k < n; k++)
+				{
+					double * qk = Q + static_cast< std::size_t >(k) * ldq;
+					f = qk[i + 1];
+					qk[i + 1] = s * qk[i] + c * f;
+					qk[i] = c * qk[i] - s * f;
+				}
+			}
+			if (r == 0.0 && i >= l)
+			{
+				continue;
+			}
+			d[l] -= p;
+			e[l] = g;
+			e[m] = 0.0;
+		}
+		while (m != l);
+	}
+}
+
+// Корень j векового уравнения 1 + rho * sum z_i^2 / (d_i - lambda) = 0
+// (d по возрастанию, rho > 0, ||z|| = 1). Корень хранится как сдвиг mu от
+// ближайшего полюса d[origin], чтобы разности d_i - lambda = (d_i - d[origin]) - mu
+// вычислялись без потери точности.
+void solveSecular ( int k, const double * d, const double * z, double rho, int j, int & origin, double & mu )
+{
+	auto secular = [ = ] ( int from, double shift, double & derivative )
+	{
+		double f = 1.0;
+		derivative = 0.0;
+		for (int i = 0; i < k; i++)
+		{
+			const double delta = (d[i] - d[from]) - shift;
+			const double term = rho * z[i] / delta;
+			f += term * z[i];
+			derivative += term * z[i] / delta;
+		}
+		return f;
+	};
+
+	double lo, hi, derivative;
+	if (j < k - 1)
+	{
+		const double half = 0.5 * (d[j + 1] - d[j]);
+		if (secular(j, half, derivative) >= 0.0)
+		{
+			origin = j;
+			lo = 0.0;
+			hi = half;
+		}
+		else
+		{
+			origin = j + 1;
+			lo = -half;
+			hi = 0.0;
+		}
+	}
+	else
+	{
+		origin = j;
+		lo = 0.0;
+		hi = rho;
+	}
+
+	// Метод Ньютона с защитой делением отрезка пополам
+	mu = 0.5 * (lo + hi);
+	for (int iteration = 0; iteration < 200; iteration++)
+	{
+		const double f = secular(origin, mu, derivative);
+		if (f == 0.0)
+		{
+			break;
+		}
+		if (f < 0.0)
+		{
+			lo = mu;
+		}
+		else
+		{
+			hi = mu;
+		}
+		if (hi - lo <= 2.0 * EPSILON * std::max(std::fabs(lo), std::fabs(hi)))
+		{
+			break;
+		}
+		double next = mu - f / derivative;
+		if ( ! (next > lo && next < hi))
+		{
+			next = 0.5 * (lo + hi);
+		}
+		mu = next;
+	}
+}
+
+// Собственные значения и векторы D + rho * z * z^T, где D = diag(d), и
+// обновление Q = Q * U. Q - столбцы собственных векторов двух подзадач.
+void mergeRankOne ( int n, double * d, double * z, double rho, double * Q, int ldq )
+{
+	const double zNorm = MatrixKernels::norm2(n, z);
+	MatrixKernels::scale(n, 1.0 / zNorm, z);
+	rho *= zNorm * zNorm;
+
+	std::vector< int > order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [ d ] ( int a, int b ) { return d[a] < d[b]; });
+
+	double dMax = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		dMax = std::max(dMax, std::fabs(d[i]));
+	}
+	const double tolerance = 8.0 * EPSILON * std::max(dMax, rho);
+
+	// Исключение (deflation): малые компоненты z и близкие собственные значения.
+	// Для пары близких значений вращение обнуляет одну из компонент z.
+	std::vector< int > kept;
+	for (int i : order)
+	{
+		if (rho * std::fabs(z[i]) <= tolerance)
+		{
+			continue;
+		}
+		if ( ! kept.empty())
+		{
+			const int p = kept.back();
+			const double tau = std::hypot(z[p], z[i]);
+			const double c = z[i] / tau, s = z[p] / tau;
+			if (std::fabs((d[i] - d[p]) * c * s) <= tolerance)
+			{
+				for (int r = 0; r < n; r++)
+				{
+					double * qr = Q + static_cast< std::size_t >(r) * ldq;
+					const double qp = qr[p], qi = qr[i];
+					qr[p] = c * qp - s * qi;
+					qr[i] = s * qp + c * qi;
+				}
+				const double dp = d[p];
+				d[p] = c * c * dp + s * s * d[i];
+				d[i] = s * s * dp + c * c * d[i];
+				z[p] = 0.0;
+				z[i] = tau;
+				kept.back() = i;
+				continue;
+			}
+		}
+		kept.push_back(i);
+	}
+	std::sort(kept.begin(), kept.end(), [ d ] ( int a, int b ) { return d[a] < d[b]; });
+
+	const int k = static_cast< int >(kept.size());
+	if (k == 0)
+	{
+		return;
+	}
+	std::vector< double > dk(k), zk(k);
+	for (int j = 0; j < k; j++)
+	{
+		dk[j] = d[kept[j]];
+		zk[j] = z[kept[j]];
+	}
+
+	// delta(i, j) = dk_i - lambda_j, по корню на столбец
+	std::vector< double > U(static_cast< std::size_t >(k) * k), lambda(k);
+	ThreadPool::instance().parallelFor(0, k, std::max(1, 4096 / k), [ & ] ( std::size_t from, std::size_t to )
+	{
+		for (std::size_t j = from; j < to; j++)
+		{
+			int origin;
+			double mu;
+			solveSecular(k, dk.data(), zk.data(), rho, static_cast< int >(j), origin, mu);
+			lambda[j] = dk[origin] + mu;
+			for (int i = 0; i < k; i++)
+			{
+				U[static_cast< std::size_t >(i) * k + j] = (dk[i] - dk[origin]) - mu;
+			}
+		}
+	});
+
+	// Компоненты z пересчитываются по найденным корням (Gu, Eisenstat, 1994),
+	// что сохраняет ортогональность собственных векторов
+	for (int i = 0; i < k; i++)
+	{
+		const double * deltaI = U.data() + static_cast< std::size_t >(i) * k;
+		double product = std::fabs(deltaI[k - 1]) / rho;
+		for (int j = 0; j < k; j++)
+		{
+			if (j != i)
+			{
+				product *= std::fabs(deltaI[j < i ? j : j - 1]) / std::fabs(dk[j] - dk[i]);
+			}
+		}
+		zk[i] = std::copysign(std::sqrt(product), zk[i]);
+	}
+
+	for (int i = 0; i < k; i++)
+	{
+		double * ui = U.data() + static_cast< std::size_t >(i) * k;
+		for (int j = 0; j < k; j++)
+		{
+			ui[j] = zk[i] / ui[j];
+		}
+	}
+	std::vector< double > norms(k, 0.0);
+	for (int i = 0; i < k; i++)
+	{
+		const double * ui = U.data() + static_cast< std::size_t >(i) * k;
+		for (int j = 0; j < k; j++)
+		{
+			norms[j] += ui[j] * ui[j];
+		}
+	}
+	for (int i = 0; i < k; i++)
+	{
+		double * ui = U.data() + static_cast< std::size_t >(i) * k;
+		for (int j = 0; j < k; j++)
+		{
+			ui[j] /= std::sqrt(norms[j]);
+		}
+	}
+
+	// Q(:, kept) = Q(:, kept) * U
+	std::vector< double > Qk(static_cast< std::size_t >(n) * k), product(Qk.size());
+	for (int r = 0; r < n; r++)
+	{
+		const double * qr = Q + static_cast< std::size_t >(r) * ldq;
+		for (int j = 0; j < k; j++)
+		{
+			Qk[static_cast< std::size_t >(r) * k + j] = qr[kept[j]];
+		}
+	}
+	MatrixKernels::gemm(false, false, n, k, k, 1.0, Qk.data(), k, U.data(), k, 0.0, product.data(), k);
+	for (int r = 0; r < n; r++)
+	{
+		double * qr = Q + static_cast< std::size_t >(r) * ldq;
+		for (int j = 0; j < k; j++)
+		{
+			qr[kept[j]] = product[static_cast< std::size_t >(r) * k + j];
+		}
+	}
+	for (int j = 0; j < k; j++)
+	{
+		d[kept[j]] = lambda[j];
+	}
+}
+
+// T = diag(T1, T2) + |beta| * v * v^T, v = (e_last; sign(beta) * e_first):
+// подзадачи T1, T2 решаются рекурсивно и объединяются через mergeRankOne.
+// Q (n x n) должна быть нулевой, результат - по возрастанию d.
+void divideAndConquer ( int n, double * d, double * e, double * Q, int ldq )
+{
+	if (n <= LEAF_SIZE)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			Q[static_cast< std::size_t >(i) * ldq + i] = 1.0;
+		}
+		std::vector< double > offDiagonal(e, e + n);
+		tridiagonalQL(n, d, offDiagonal.data(), Q, ldq);
+		sortEigen(n, d, Q, ldq);
+		return;
+	}
+
+	const int m = n / 2;
+	const double beta = e[m - 1];
+	d[m - 1] -= std::fabs(beta);
+	d[m] -= std::fabs(beta);
+
+	double * Q2 = Q + static_cast< std::size_t >(m) * ldq + m;
+	divideAndConquer(m, d, e, Q, ldq);
+	divideAndConquer(n - m, d + m, e + m, Q2, ldq);
+
+	std::vector< double > z(n);
+	const double * lastRow = Q + static_cast< std::size_t >(m - 1) * ldq;
+	std::copy(lastRow, lastRow + m, z.begin());
+	const double sign = (beta < 0.0) ? -1.0 : 1.0;
+	for (int j = 0; j < n - m; j++)
+	{
+		z[m + j] = sign * Q2[j];
+	}
+
+	if (beta != 0.0)
+	{
+		mergeRankOne(n, d, z.data(), std::fabs(beta), Q, ldq);
+	}
+	sortEigen(n, d, Q, ldq);
+}
+
+} // namespace
+
+SymmetricEigen eigenSymmetric(const Matrix & A)
+{
+	if (A.getNumRows() != A.getNumColumns())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const int n = A.getNumRows();
+	if ( ! MatrixKernels::allFinite(A.elementCount(), A.data))
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+
+	// Рабочая копия: нижний треугольник отражается из верхнего
+	std::vector< double > work(A.data, A.data + A.elementCount());
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < i; j++)
+		{
+			work[static_cast< std::size_t >(i) * n + j] = work[static_cast< std::size_t >(j) * n + i];
+		}
+	}
+
+	std::vector< double > d(n), e(n, 0.0);
+	const std::vector< BlockReflector > blocks = tridiagonalize(n, work.data(), d.data(), e.data());
+
+	// Собственные векторы A = Q * (собственные векторы T)
+	std::vector< double > vectors(static_cast< std::size_t >(n) * n, 0.0);
+	divideAndConquer(n, d.data(), e.data(), vectors.data(), n);
+	for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+	{
+		applyLeft(*block, false, n, vectors.data(), n);
+	}
+
+	return SymmetricEigen{ Vector(n, d.data()), Matrix(n, n, vectors.data()) };
+}
+// =================================================================================
+
+
+// =================================================================================
+// Сингулярное разложение (односторонний метод Якоби)
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+const int MAX_SWEEPS = 60;
+
+// Вращения пар строк M (r x c) до их взаимной ортогональности; те же вращения
+// применяются к строкам G (r x r). Пары выбираются по круговой схеме турнира:
+// в каждом раунде r / 2 непересекающихся пар обрабатываются параллельно.
+void jacobiRows ( int r, int c, double * M, int ldm, double * G, int ldg )
+{
+	const int players = r + (r % 2);
+	const double tolerance = EPSILON * std::sqrt(static_cast< double >(c));
+	const std::size_t work = static_cast< std::size_t >(r / 2) * (c + r);
+
+	std::vector< int > ring(players);
+	std::iota(ring.begin(), ring.end(), 0);
+	std::vector< std::pair< int, int > > pairs;
+
+	// Квадраты норм строк обновляются при вращении и пересчитываются в начале прохода
+	std::vector< double > norms(r);
+	for (int sweep = 0; sweep < MAX_SWEEPS; sweep++)
+	{
+		for (int i = 0; i < r; i++)
+		{
+			const double * mi = M + static_cast< std::size_t >(i) * ldm;
+			norms[i] = MatrixKernels::dot(c, mi, mi);
+		}
+		std::atomic< int > rotations(0);
+		for (int round = 0; round < players - 1; round++)
+		{
+			pairs.clear();
+			for (int i = 0; i < players / 2; i++)
+			{
+				const int a = ring[i], b = ring[players - 1 - i];
+				if (a < r && b < r)
+				{
+					pairs.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+				}
+			}
+			std::rotate(ring.begin() + 1, ring.end() - 1, ring.end());
+
+			auto body = [ & ] ( std::size_t from, std::size_t to )
+			{
+				int local = 0;
+				for (std::size_t q = from; q < to; q++)
+				{
+					double * mi = M + static_cast< std::size_t >(pairs[q].first) * ldm;
+					double * mj = M + static_cast< std::size_t >(pairs[q].second) * ldm;
+					double & alpha = norms[pairs[q].first];
+					double & beta = norms[pairs[q].second];
+					const double gamma = MatrixKernels::dot(c, mi, mj);
+					// Отслеживаемые нормы нулевых строк могут уйти в малые отрицательные
+					// значения; при gamma = 0 и alpha = beta zeta была бы 0 / 0
+					if (gamma == 0.0 || alpha <= 0.0 || beta <= 0.0 || std::fabs(gamma) <= tolerance * std::sqrt(alpha) * std::sqrt(beta))
+					{
+						continue;
+					}
+					const double zeta = (beta - alpha) / (2.0 * gamma);
+					const double t = std::copysign(1.0, zeta) / (std::fabs(zeta) + std::sqrt(1.0 + zeta * zeta));
+					const double cs = 1.0 / std::sqrt(1.0 + t * t), sn = cs * t;
+
+					double * gi = G + static_cast< std::size_t >(pairs[q].first) * ldg;
+					double * gj = G + static_cast< std::size_t >(pairs[q].second) * ldg;
+					for (int x = 0; x < c; x++)
+					{
+						const double u = mi[x], v = mj[x];
+						mi[x] = cs * u - sn * v;
+						mj[x] = sn * u + cs * v;
+					}
+					for (int x = 0; x < r; x++)
+					{
+						const double u = gi[x], v = gj[x];
+						gi[x] = cs * u - sn * v;
+						gj[x] = sn * u + cs * v;
+					}
+					alpha -= t * gamma;
+					beta += t * gamma;
+					local++;
+				}
+				rotations += local;
+			};
+			if (work >= MatrixKernels::PARALLEL_MIN_ELEMENTS)
+			{
+				const std::size_t grain = std::max< std::size_t >(1, 4096 / (c + r));
+				ThreadPool::instance().parallelFor(0, pairs.size(), grain, body);
+			}
+			else
+			{
+				body(0, pairs.size());
+			}
+		}
+		if (rotations == 0)
+		{
+			return;
+		}
+	}
+}
+
+// X (r x c, r <= c) = P^T * diag(sigma) * E: sigma по убыванию, P (r x r)
+// ортогональна, строки E (r x c) ортонормированы. Содержимое X разрушается.
+// После X = [L 0] * Q вращения применяются к строкам L^T (Drmac, Veselic, 2008):
+// для треугольного множителя это требует заметно меньше проходов, а
+// накопленные вращения сразу дают строки E.
+void svdRows ( int r, int c, double * X, std::vector< double > & sigma,
+               std::vector< double > & P, std::vector< double > & E )
+{
+	const std::vector< BlockReflector > blocks = factorLQ(r, c, X, c);
+
+	// M = L^T, G = I; после вращений G * L^T = diag(sigma) * P, откуда
+	// L = P^T * diag(sigma) * G и X = P^T * diag(sigma) * ([G 0] * Q)
+	std::vector< double > M(static_cast< std::size_t >(r) * r);
+	transpose(r, r, X, c, M.data(), r);
+	std::vector< double > G(static_cast< std::size_t >(r) * r, 0.0);
+	for (int i = 0; i < r; i++)
+	{
+		G[static_cast< std::size_t >(i) * r + i] = 1.0;
+	}
+	jacobiRows(r, r, M.data(), r, G.data(), r);
+
+	std::vector< double > norms(r);
+	for (int i = 0; i < r; i++)
+	{
+		norms[i] = MatrixKernels::norm2(r, M.data() + static_cast< std::size_t >(i) * r);
+	}
+	std::vector< int > order(r);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [ & ] ( int a, int b ) { return norms[a] > norms[b]; });
+
+	sigma.resize(r);
+	P.assign(static_cast< std::size_t >(r) * r, 0.0);
+	E.assign(static_cast< std::size_t >(r) * c, 0.0);
+	std::vector< bool > valid(r, true);
+	for (int j = 0; j < r; j++)
+	{
+		const int i = order[j];
+		sigma[j] = norms[i];
+		std::copy(G.begin() + static_cast< std::size_t >(i) * r, G.begin() + static_cast< std::size_t >(i + 1) * r,
+		          E.begin() + static_cast< std::size_t >(j) * c);
+		double * pj = P.data() + static_cast< std::size_t >(j) * r;
+		if (norms[i] > 0.0)
+		{
+			std::copy(M.begin() + static_cast< std::size_t >(i) * r, M.begin() + static_cast< std::size_t >(i + 1) * r, pj);
+			MatrixKernels::scale(r, 1.0 / norms[i], pj);
+		}
+		else
+		{
+			valid[j] = false;
+		}
+	}
+
+	// Строки для нулевых сингулярных значений дополняют P до ортогональной матрицы
+	for (int j = 0; j < r; j++)
+	{
+		double * pj = P.data() + static_cast< std::size_t >(j) * r;
+		for (int candidate = 0; candidate < r && ! valid[j]; candidate++)
+		{
+			std::fill(pj, pj + r, 0.0);
+			pj[candidate] = 1.0;
+			for (int pass = 0; pass < 2; pass++)
+			{
+				for (int i = 0; i < r; i++)
+				{
+					if (valid[i])
+					{
+						const double * pi = P.data() + static_cast< std::size_t >(i) * r;
+						MatrixKernels::axpy(r, -MatrixKernels::dot(r, pi, pj), pi, pj);
+					}
+				}
+			}
+			const double norm = MatrixKernels::norm2(r, pj);
+			if (norm > 0.5)
+			{
+				MatrixKernels::scale(r, 1.0 / norm, pj);
+				valid[j] = true;
+			}
+		}
+	}
+
+	// E = [G 0] * H_(r-1) * ... * H_0
+	for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+	{
+		applyRight(*block, true, r, E.data(), c);
+	}
+}
+
+// Ортонормированный базис пространства строк X (r x c, r <= c): строки Q
+std::vector< double > orthonormalRows ( int r, int c, std::vector< double > X )
+{
+	const std::vector< BlockReflector > blocks = factorLQ(r, c, X.data(), c);
+	std::vector< double > Q(static_cast< std::size_t >(r) * c, 0.0);
+	for (int i = 0; i < r; i++)
+	{
+		Q[static_cast< std::size_t >(i) * c + i] = 1.0;
+	}
+	for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+	{
+		applyRight(*block, true, r, Q.data(), c);
+	}
+	return Q;
+}
+
+} // namespace
+
+SingularValueDecomposition svd(const Matrix & A)
+{
+	const int m = A.getNumRows(), n = A.getNumColumns();
+	if ( ! MatrixKernels::allFinite(A.elementCount(), A.data))
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+
+	// Разлагается строчно-ориентированная X с r <= c: A^T для высокой матрицы, A - для широкой
+	const bool tall = (m >= n);
+	const int r = tall ? n : m, c = tall ? m : n;
+	std::vector< double > X(A.elementCount());
+	if (tall)
+	{
+		transpose(m, n, A.data, n, X.data(), m);
+	}
+	else
+	{
+		std::copy(A.data, A.data + A.elementCount(), X.begin());
+	}
+
+	std::vector< double > sigma, P, E;
+	svdRows(r, c, X.data(), sigma, P, E);
+
+	// X = P^T * S * E: для высокой A = E^T * S * P, для широкой A = P^T * S * E
+	std::vector< double > Pt(P.size()), Et(E.size());
+	transpose(r, r, P.data(), r, Pt.data(), r);
+	transpose(r, c, E.data(), c, Et.data(), r);
+	Matrix left(c, r, Et.data()), right(r, r, Pt.data());
+	const Vector values(r, sigma.data());
+	return tall ? SingularValueDecomposition{ left, values, right }
+	            : SingularValueDecomposition{ right, values, left };
+}
+
+SingularValueDecomposition randomizedSvd(const Matrix & A, int rank, int oversampling,
+                                         int powerIterations, unsigned long long seed)
+{
+	const int m = A.getNumRows(), n = A.getNumColumns();
+	if (rank < 1 || rank > std::min(m, n) || oversampling < 0 || powerIterations < 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	if ( ! MatrixKernels::allFinite(A.elementCount(), A.data))
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	const int l = std::min(rank + oversampling, std::min(m, n));
+
+	// Базис хранится строками: Q^T (l x m). Y^T = Omega^T * A^T
+	std::mt19937_64 generator(seed);
+	std::normal_distribution< double > gaussian;
+	std::vector< double > omega(static_cast< std::size_t >(l) * n);
+	for (double & x : omega)
+	{
+		x = gaussian(generator);
+	}
+	std::vector< double > Y(static_cast< std::size_t >(l) * m), Z(static_cast< std::size_t >(l) * n);
+	MatrixKernels::gemm(false, true, l, m, n, 1.0, omega.data(), n, A.data, n, 0.0, Y.data(), m);
+	std::vector< double > Q = orthonormalRows(l, m, Y);
+
+	// Степенной метод с переортогонализацией на каждом шаге
+	for (int step = 0; step < powerIterations; step++)
+	{
+		MatrixKernels::gemm(false, false, l, n, m, 1.0, Q.data(), m, A.data, n, 0.0, Z.data(), n);
+		const std::vector< double > basis = orthonormalRows(l, n, Z);
+		MatrixKernels::gemm(false, true, l, m, n, 1.0, basis.data(), n, A.data, n, 0.0, Y.data(), m);
+		Q = orthonormalRows(l, m, Y);
+	}
+
+	// B = Q^T * A (l x n) = P^T * S * E, откуда A ~ (Q * P^T) * S * E
+	MatrixKernels::gemm(false, false, l, n, m, 1.0, Q.data(), m, A.data, n, 0.0, Z.data(), n);
+	std::vector< double > sigma, P, E;
+	svdRows(l, n, Z.data(), sigma, P, E);
+
+	std::vector< double > Ut(static_cast< std::size_t >(l) * m);
+	MatrixKernels::gemm(false, false, l, m, l, 1.0, P.data(), l, Q.data(), m, 0.0, Ut.data(), m);
+
+	// Первые rank компонент
+	std::vector< double > U(static_cast< std::size_t >(m) * rank), V(static_cast< std::size_t >(n) * rank);
+	transpose(rank, m, Ut.data(), m, U.data(), rank);
+	transpose(rank, n, E.data(), n, V.data(), rank);
+	return SingularValueDecomposition{ Matrix(m, rank, U.data()), Vector(rank, sigma.data()), Matrix(n, rank, V.data()) };
+}
+// =================================================================================
+
+Matrix orthonormalBasis(const Matrix & Y)
+{
+	const int m = Y.getNumRows(), l = Y.getNumColumns();
+	if (l > m)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	if ( ! MatrixKernels::allFinite(Y.elementCount(), Y.data))
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	std::vector< double > rows(Y.elementCount());
+	transpose(m, l, Y.data, l, rows.data(), m);
+	const std::vector< double > basis = orthonormalRows(l, m, std::move(rows));
+
+	Matrix result(m, l, Matrix::uninitialized);
+	transpose(l, m, basis.data(), m, result.data, l);
+	return result;
+}
+// =================================================================================
@@ -0,0 +1,67 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_SPECTRAL_HPP_
+#define _MATRIX_SPECTRAL_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+#include "vector.hpp"
+
+// Спектральные разложения. Приведения к трехдиагональному виду и к
+// треугольному (LQ) выполняются блоками по отражениям Хаусхолдера,
+// обновления остатка матрицы - через GEMM, поэтому основная часть работы
+// распределяется по потокам вместе с умножением матриц.
+// Для неквадратной матрицы там, где нужна квадратная, генерируется исключение
+// с текстом "Size mismatch", для матрицы с inf или NaN - "Values are out of range".
+
+/*****************************************************************************/
+
+// Собственные значения (по возрастанию) и ортонормированные собственные
+// векторы - столбцы матрицы vectors: A * vectors = vectors * diag(values)
+struct SymmetricEigen
+{
+	Vector values;
+	Matrix vectors;
+};
+
+// Сокращенное сингулярное разложение A = U * diag(singularValues) * V^T.
+// Для A размера m x n и p = min(m, n): U - m x p, V - n x p, столбцы
+// ортонормированы, сингулярные значения упорядочены по убыванию.
+struct SingularValueDecomposition
+{
+	Matrix U;
+	Vector singularValues;
+	Matrix V;
+};
+
+/*****************************************************************************/
+
+// Разложение симметричной матрицы: блочное приведение к трехдиагональному
+// виду, затем метод "разделяй и властвуй" (Cuppen) для трехдиагональной
+// матрицы. Читается только верхний треугольник A.
+SymmetricEigen eigenSymmetric(const Matrix & A);
+
+// Сингулярное разложение: блочное LQ-разложение (предобусловливание),
+// затем односторонний метод Якоби для треугольного множителя. Пары строк
+// каждого раунда вращений независимы и обрабатываются параллельно.
+// Малые сингулярные значения вычисляются с высокой относительной точностью.
+SingularValueDecomposition svd(const Matrix & A);
+
+// Приближенное разложение ранга rank (Halko, Martinsson, Tropp, 2011):
+// проекция на случайное подпространство размерности rank + oversampling,
+// powerIterations шагов степенного метода уточняют подпространство при
+// медленно убывающем спектре. Стоимость - O(m * n * (rank + oversampling))
+// на шаг вместо O(m * n * min(m, n)). При одинаковом seed результат
+// воспроизводим. Если rank вне [1, min(m, n)] или oversampling, powerIterations
+// отрицательны, генерируется исключение с текстом "Invalid dimensions".
+SingularValueDecomposition randomizedSvd(const Matrix & A, int rank, int oversampling = 10,
+                                         int powerIterations = 2, unsigned long long seed = 0);
+
+// Ортонормированный базис пространства столбцов Y (m x l, l <= m): матрица
+// m x l с ортонормированными столбцами (блочное LQ-разложение Y^T). Если
+// столбцов больше, чем строк, генерируется исключение с текстом "Size mismatch".
+Matrix orthonormalBasis(const Matrix & Y);
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_SPECTRAL_HPP_
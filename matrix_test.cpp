@@ -5,8 +5,66 @@
 #include "testslib.hpp"
 
 #include "matrix.hpp"
-
+#include "matrix_async.hpp"
+#include "matrix_cache.hpp"
+#include "matrix_compressed.hpp"
+#include "matrix_convolution.hpp"
+#include "matrix_distributed.hpp"
+#include "matrix_functions.hpp"
+#include "matrix_incremental.hpp"
+#include "matrix_sketch.hpp"
+#include "matrix_spectral.hpp"
+#include "matrix_tiles.hpp"
+#include "matrix_tuning.hpp"
+#include "vector.hpp"
+#include "structured.hpp"
+#include "threadpool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <set>
 #include <sstream>
+#include <thread>
+
+/*****************************************************************************/
+
+
+// Выполняется первым: конфигурация GEMM загружается лениво при первом умножении
+// в процессе, и установленная до него вручную не должна заменяться загрузкой
+DECLARE_OOP_TEST( matrix_test_gemm_config_before_first_multiply )
+{
+	const char * previous = std::getenv( "MATRIX_GEMM_CONFIG" );
+	const std::string saved = previous ? previous : "";
+	setenv( "MATRIX_GEMM_CONFIG", "mc=32 kc=96 nc=64 unroll=8", 1 );
+
+	const MatrixKernels::GemmConfig manual = { 17, 33, 45, 2, 0.0 };
+	assert( MatrixKernels::setGemmConfig( manual ) );
+	Matrix a( 40, 40 );
+	for ( int i = 0; i < 40; i++ )
+		for ( int k = 0; k < 40; k++ )
+			a[ i ][ k ] = ( i * 7 + k ) % 5 - 2.0;
+	Matrix product = a * a;
+	assert( product[ 0 ][ 0 ] != 0.0 );
+
+	const MatrixKernels::GemmConfig current = MatrixKernels::gemmConfig();
+	assert( current.mc == 17 && current.kc == 33 && current.nc == 45 && current.unroll == 2 );
+
+	if ( previous )
+		setenv( "MATRIX_GEMM_CONFIG", saved.c_str(), 1 );
+	else
+		unsetenv( "MATRIX_GEMM_CONFIG" );
+	assert( MatrixKernels::setGemmConfig( MatrixKernels::defaultGemmConfig() ) );
+}
+
 
 /*****************************************************************************/
 
@@ -424,4 +482,2071 @@ DECLARE_OOP_TEST( matrix_test_output_stream )
 
 
 
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_copy_on_write )
+{
+	double data[] = { 1.0, 2.0, 3.0, 4.0 };
+	Matrix::setCopyOnWrite( true );
+
+	Matrix m1( 2, 2, data );
+	Matrix m2 = m1;
+	assert( m1.isShared() );
+	assert( m2.isShared() );
+
+	const Matrix & cm2 = m2;
+	assert( cm2[ 1 ][ 1 ] == 4.0 );
+	assert( m2.isShared() );
+
+	// Через константную матрицу разделяемый буфер недоступен для записи
+	static_assert( std::is_same< decltype( cm2[ 0 ][ 0 ] ), double >::value, "const access must not yield a reference" );
+
+	m2[ 0 ][ 0 ] = 10.0;
+	assert( ! m1.isShared() );
+	assert( ! m2.isShared() );
+	assert( m1[ 0 ][ 0 ] == 1.0 );
+	assert( m2[ 0 ][ 0 ] == 10.0 );
+
+	Matrix m3( 1, 1 );
+	m3 = m1;
+	assert( m3.isShared() );
+	m3 *= 2.0;
+	assert( m3[ 1 ][ 0 ] == 6.0 );
+	assert( m1[ 1 ][ 0 ] == 3.0 );
+
+	Matrix::setCopyOnWrite( false );
+
+	Matrix m4 = m1;
+	assert( ! m4.isShared() );
+	assert( m4 == m1 );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_fused_operations )
+{
+	double dataA[] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+	double dataB[] = { 1.0, 0.0, -1.0, 2.0, 1.0, 0.0 };
+	double dataC[] = { 1.0, 1.0, 1.0, 1.0 };
+
+	Matrix a( 2, 3, dataA );
+	Matrix b( 3, 2, dataB );
+	Matrix c( 2, 2, dataC );
+
+	// c = 2 * a * b - c
+	c.gemm( 2.0, a, b, -1.0 );
+	Matrix expected = a * b * 2.0;
+	expected -= Matrix( 2, 2, dataC );
+	assert( c == expected );
+
+	// op(A) = a^T (3 x 2), op(B) = b^T (2 x 3)
+	Matrix t( 3, 3 );
+	t.gemm( 1.0, a, b, 0.0, Matrix::Trans, Matrix::Trans );
+	Matrix ba = b * a;
+	for ( int i = 0; i < 3; i++ )
+		for ( int k = 0; k < 3; k++ )
+			assert( t[ i ][ k ] == ba[ k ][ i ] );
+
+	Matrix x( 2, 3, dataA );
+	x.axpy( -1.0, a );
+	assert( x == Matrix( 2, 3 ) );
+
+	x.scaleAdd( 3.0, 0.5, a );
+	assert( x[ 1 ][ 2 ] == 3.0 );
+
+	double dataS[] = { 0.0, 1.0, 1.0, 0.0 };
+	Matrix s( 2, 2, dataS );
+	Matrix r = a * 1.0;
+	Matrix sq = c;
+	sq *= s;
+	assert( sq[ 0 ][ 0 ] == c[ 0 ][ 1 ] );
+	assert( sq[ 1 ][ 1 ] == c[ 1 ][ 0 ] );
+
+	r *= b;
+	assert( r == a * b );
+
+	// *= выбирает то же ядро, что и *: треугольный множитель, плотный, сам на себя
+	const int n = 70;
+	Matrix dense( n, n ), upper( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			dense[ i ][ j ] = ( ( i * 13 + j * 7 ) % 19 ) / 9.0 - 1.0;
+			if ( j >= i )
+				upper[ i ][ j ] = 1.0 / ( 1.0 + i + j );
+		}
+	}
+	Matrix inPlace( dense );
+	inPlace *= upper;
+	assert( inPlace == dense * upper );
+	inPlace = dense;
+	inPlace *= inPlace;
+	assert( inPlace == dense * dense );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_vector_gemv )
+{
+	double dataA[] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+	double dataX[] = { 1.0, -1.0, 2.0 };
+	double dataY[] = { 1.0, 1.0 };
+
+	Matrix a( 2, 3, dataA );
+	Vector x( 3, dataX );
+	Vector y( 2, dataY );
+
+	Vector ax = a * x;
+	assert( ax.getSize() == 2 );
+	assert( ax[ 0 ] == 5.0 );
+	assert( ax[ 1 ] == 11.0 );
+	assert( Vector( a * x.toMatrix() ) == ax );
+
+	// y = 2 * A^T * y - x
+	Vector r( x );
+	r.gemv( 2.0, a, y, -1.0, Matrix::Trans );
+	assert( r[ 0 ] == 9.0 );
+	assert( r[ 1 ] == 15.0 );
+	assert( r[ 2 ] == 16.0 );
+
+	assert( dot( x, x ) == 6.0 );
+	assert( equalDoubles( x.norm2(), sqrt( 6.0 ) ) );
+	assert( x.normInf() == 2.0 );
+
+	a.ger( 1.0, y, x );
+	assert( a[ 0 ][ 0 ] == 2.0 );
+	assert( a[ 1 ][ 1 ] == 4.0 );
+	assert( a[ 1 ][ 2 ] == 8.0 );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_approx_equal_reductions )
+{
+	double data1[] = { 1.0, -2.0, 3.0, -4.0 };
+	double data2[] = { 1.0, -2.0, 3.0, -4.001 };
+
+	Matrix m1( 2, 2, data1 );
+	Matrix m2( 2, 2, data2 );
+
+	Matrix::Comparison c = Matrix::approxEqual( m1, m2, 1e-6, 0.0 );
+	assert( ! c.equal );
+	assert( equalDoubles( c.maxDeviation, 0.001, 1e-12 ) );
+	assert( Matrix::approxEqual( m1, m2, 0.0, 1e-3 ).equal );
+	assert( Matrix::approxEqual( m1, m1 ).equal );
+	assert( ! Matrix::approxEqual( m1, Matrix( 1, 4, data1 ) ).equal );
+
+	assert( m1.sum() == -2.0 );
+	assert( m1.minElement() == -4.0 );
+	assert( m1.maxElement() == 3.0 );
+	assert( m1.trace() == -3.0 );
+	assert( m1.norm1() == 6.0 );
+	assert( m1.normInf() == 7.0 );
+	assert( equalDoubles( m1.normFrobenius(), sqrt( 30.0 ) ) );
+
+	// Большая матрица обрабатывается параллельно по блокам
+	Matrix big( 300, 500 );
+	for ( int i = 0; i < 300; i++ )
+		for ( int k = 0; k < 500; k++ )
+			big[ i ][ k ] = ( i + k ) % 2 ? 0.1 : -0.1;
+	big[ 17 ][ 33 ] = 1000.0;
+
+	assert( equalDoubles( big.sum(), 1000.1, 1e-9 ) );
+	assert( big.maxElement() == 1000.0 );
+	assert( big.minElement() == -0.1 );
+	assert( equalDoubles( big.normInf(), 49.9 + 1000.0, 1e-9 ) );
+
+	// Суммы по столбцам компенсируются: малые слагаемые не теряются на фоне единицы
+	Matrix tall( 20001, 2 );
+	tall[ 0 ][ 0 ] = 1.0;
+	for ( int i = 1; i < 20001; i++ )
+		tall[ i ][ 0 ] = 1e-16;
+	assert( std::fabs( tall.norm1() - ( 1.0 + 2e-12 ) ) < 1e-15 );
+
+	// Пустая (перемещенная) матрица: нормы и сумма равны 0, экстремумов нет
+	Matrix moved( std::move( tall ) );
+	assert( tall.sum() == 0.0 && tall.normFrobenius() == 0.0 );
+	assert( tall.norm1() == 0.0 && tall.normInf() == 0.0 );
+	try
+	{
+		tall.maxElement();
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Invalid dimensions" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_numa_policies )
+{
+	const std::size_t oldThreshold = MatrixMemory::getLargeAllocationThreshold();
+	MatrixMemory::setLargeAllocationThreshold( 4096 );
+
+	MatrixMemory::NumaPolicy policies[] = {
+			MatrixMemory::NumaFirstTouch
+		,	MatrixMemory::NumaInterleave
+		,	MatrixMemory::NumaBindNode
+	};
+
+	for ( int p = 0; p < 3; p++ )
+	{
+		MatrixMemory::setNumaPolicy( policies[ p ], 0 );
+		MatrixMemory::Statistics before = MatrixMemory::getStatistics();
+
+		Matrix m( 200, 200 );
+		assert( m.sum() == 0.0 && m.normInf() == 0.0 );
+
+		for ( int i = 0; i < 200; i++ )
+			m[ i ][ i ] = i;
+		Matrix copy = m;
+		assert( copy == m );
+		assert( copy.trace() == 199.0 * 200.0 / 2.0 );
+
+		MatrixMemory::Statistics after = MatrixMemory::getStatistics();
+		assert( after.largeAllocations == before.largeAllocations + 2 );
+		if ( policies[ p ] != MatrixMemory::NumaFirstTouch )
+			assert( after.numaPolicyApplied + after.numaFallbacks 
+			     == before.numaPolicyApplied + before.numaFallbacks + 2 );
+
+		// Размещение области соответствует тому, что удалось применить
+		MatrixMemory::Region region;
+		before = MatrixMemory::getStatistics();
+		assert( MatrixMemory::allocate( 40000, region, true ) );
+		after = MatrixMemory::getStatistics();
+		if ( ! region.mapped )
+			assert( region.placement == MatrixMemory::PlacementDefault );
+		else if ( after.numaPolicyApplied > before.numaPolicyApplied )
+			assert( region.placement == MatrixMemory::PlacementNumaPolicy );
+		else
+			assert( region.placement == MatrixMemory::PlacementFirstTouch );
+		MatrixMemory::release( region );
+	}
+
+	// Узла нет - mbind не применяется, и область инициализируется параллельно
+	MatrixMemory::setNumaPolicy( MatrixMemory::NumaBindNode, MatrixMemory::numaNodeCount() );
+	const MatrixMemory::Statistics beforeFallback = MatrixMemory::getStatistics();
+	MatrixMemory::Region fallback;
+	assert( MatrixMemory::allocate( 40000, fallback, true ) );
+	if ( fallback.mapped )
+	{
+		assert( fallback.placement == MatrixMemory::PlacementFirstTouch );
+		assert( MatrixMemory::getStatistics().numaFallbacks == beforeFallback.numaFallbacks + 1 );
+	}
+	for ( int i = 0; i < 40000; i++ )
+		assert( fallback.data[ i ] == 0.0 );
+	MatrixMemory::release( fallback );
+
+	assert( MatrixMemory::numaNodeCount() >= 1 );
+
+	MatrixMemory::setNumaPolicy( MatrixMemory::NumaDefault );
+	MatrixMemory::setLargeAllocationThreshold( oldThreshold );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_huge_pages )
+{
+	const std::size_t oldThreshold = MatrixMemory::getHugePageThreshold();
+	MatrixMemory::setHugePageThreshold( 4096 );
+
+	MatrixMemory::HugePageMode modes[] = { MatrixMemory::HugePagesTransparent, MatrixMemory::HugePagesExplicit };
+	for ( int k = 0; k < 2; k++ )
+	{
+		MatrixMemory::setHugePageMode( modes[ k ] );
+		MatrixMemory::Statistics before = MatrixMemory::getStatistics();
+
+		Matrix m( 100, 100 );
+		m[ 99 ][ 99 ] = 1.0;
+		assert( m.sum() == 1.0 );
+
+		MatrixMemory::Statistics after = MatrixMemory::getStatistics();
+		assert( after.hugeTlbAllocations + after.transparentHugePageAllocations + after.hugePageFallbacks
+		     == before.hugeTlbAllocations + before.transparentHugePageAllocations + before.hugePageFallbacks + 1 );
+	}
+
+	// Ниже порога большие страницы не запрашиваются
+	MatrixMemory::Statistics before = MatrixMemory::getStatistics();
+	Matrix small( 10, 10 );
+	MatrixMemory::Statistics after = MatrixMemory::getStatistics();
+	assert( after.hugePageFallbacks == before.hugePageFallbacks );
+	assert( after.transparentHugePageAllocations == before.transparentHugePageAllocations );
+
+	MatrixMemory::setHugePageMode( MatrixMemory::HugePagesOff );
+	MatrixMemory::setHugePageThreshold( oldThreshold );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_uninitialized_constructor )
+{
+	Matrix m( 2, 3, Matrix::uninitialized );
+	assert( m.getNumRows() == 2 );
+	assert( m.getNumColumns() == 3 );
+
+	for ( int i = 0; i < 2; i++ )
+		for ( int k = 0; k < 3; k++ )
+			m[ i ][ k ] = i + k;
+	assert( m.sum() == 9.0 );
+
+	try
+	{
+		Matrix bad( 0, 3, Matrix::uninitialized );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Invalid dimensions" ) );
+		delete _e;
+	}
+
+	// Большая нулевая матрица берется из нулевых страниц ОС
+	Matrix zero( 512, 512 );
+	assert( zero.minElement() == 0.0 && zero.maxElement() == 0.0 );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_async_operations )
+{
+	double dataA[] = { 1.0, 2.0, 3.0, 4.0 };
+	double dataB[] = { 0.0, 1.0, 1.0, 0.0 };
+	Matrix a( 2, 2, dataA );
+	Matrix b( 2, 2, dataB );
+
+	MatrixFuture ab = Matrix::async::multiply( a, b );
+	MatrixFuture ba = Matrix::async::multiply( b, a );
+	MatrixFuture sum = Matrix::async::add( ab, ba );
+	MatrixFuture scaled = Matrix::async::scale( sum, 0.5 );
+
+	// Входы скопированы при постановке операций
+	a[ 0 ][ 0 ] = 100.0;
+
+	Matrix expected = ( Matrix( 2, 2, dataA ) * b + b * Matrix( 2, 2, dataA ) ) * 0.5;
+	assert( scaled.get() == expected );
+	assert( ab.isReady() && ba.isReady() && sum.isReady() );
+
+	MatrixFuture g = Matrix::async::gemm( 2.0, ab, b, 1.0, expected, Matrix::Trans );
+	Matrix gExpected( expected );
+	gExpected.gemm( 2.0, ab.get(), b, 1.0, Matrix::Trans );
+	assert( g.get() == gExpected );
+
+	// Ошибка входа передается всем зависимым операциям
+	MatrixFuture bad = Matrix::async::multiply( Matrix( 3, 3 ), b );
+	MatrixFuture dependent = Matrix::async::add( bad, b );
+	try
+	{
+		dependent.get();
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+	}
+
+	ThreadPool & pool = ThreadPool::instance();
+	const int threads = pool.getNumThreads();
+	pool.setNumThreads( 4 );
+
+	// Параллельный цикл внутри узла использует другие потоки пула
+	std::mutex idsMutex;
+	std::set< std::thread::id > ids;
+	MatrixFuture nested = Matrix::async::apply( [ & ] ( const Matrix & _m )
+	{
+		Matrix r( _m );
+		ThreadPool::instance().parallelFor( 0, 16, 1, [ & ] ( std::size_t, std::size_t )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+			std::lock_guard< std::mutex > lock( idsMutex );
+			ids.insert( std::this_thread::get_id() );
+		} );
+		return r;
+	}, b );
+	assert( nested.get() == b );
+	assert( ids.size() > 1 );
+
+	// Ожидание незавершенной операции в функции узла отклоняется
+	MatrixFuture slow = Matrix::async::apply( [] ( const Matrix & _m )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+		return _m;
+	}, a );
+	MatrixFuture blocking = Matrix::async::apply( [ slow ] ( const Matrix & )
+	{
+		return slow.get();
+	}, b );
+	try
+	{
+		blocking.get();
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Blocking wait in worker thread" ) );
+		delete _e;
+	}
+	assert( slow.get() == a );
+	pool.setNumThreads( threads );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_structured_matrices )
+{
+	const int n = 80;
+	Matrix a( n, n ), lower( n, n ), diag( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 7 + j * 3 ) % 11 ) - 5.0;
+			if ( j <= i )
+			{
+				lower[ i ][ j ] = ( ( i + 2 * j ) % 5 ) + 1.0;
+			}
+		}
+		diag[ i ][ i ] = i + 1.0;
+	}
+
+	// Эталон - плотное умножение без распознавания структуры
+	Matrix expected( n, n );
+	expected.gemm( 1.0, lower, a, 0.0 );
+
+	// Треугольный и диагональный сомножители распознаются оператором *
+	assert( Matrix::approxEqual( lower * a, expected ).equal );
+	Matrix scaledRows( n, n );
+	scaledRows.gemm( 1.0, diag, a, 0.0 );
+	assert( lower * a == TriangularMatrix( lower, TriangularMatrix::Lower ) * a );
+	assert( diag * a == scaledRows );
+	assert( DiagonalMatrix( diag ) * a == scaledRows );
+
+	// TRSM обращает TRMM
+	TriangularMatrix t( lower, TriangularMatrix::Lower );
+	assert( Matrix::approxEqual( t.solve( t * a ), a, 1e-9, 1e-9 ).equal );
+	assert( Matrix::approxEqual( t.solveRight( a * t ), a, 1e-9, 1e-9 ).equal );
+	TriangularMatrix u( a, TriangularMatrix::Upper, true );
+	assert( u( 3, 3 ) == 1.0 && u( 3, 2 ) == 0.0 );
+	assert( Matrix::approxEqual( u.solve( u * a ), a, 1e-9, 1e-9 ).equal );
+
+	try
+	{
+		TriangularMatrix( Matrix( 3, 3 ), TriangularMatrix::Upper ).solve( Matrix( 3, 1 ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Singular matrix" ) );
+		delete _e;
+	}
+
+	// SYRK совпадает с A * A^T
+	SymmetricMatrix s = SymmetricMatrix::syrk( a );
+	Matrix aat( n, n );
+	aat.gemm( 1.0, a, a, 0.0, Matrix::NoTrans, Matrix::Trans );
+	assert( Matrix::approxEqual( s.toMatrix(), aat ).equal );
+	assert( s( 5, 9 ) == s( 9, 5 ) );
+
+	// Ленточная матрица
+	BandedMatrix band( a, 2, 1 );
+	assert( band( 10, 8 ) == a[ 10 ][ 8 ] && band( 10, 12 ) == 0.0 );
+	Matrix bandDense = band.toMatrix();
+	assert( Matrix::approxEqual( band * a, bandDense * a ).equal );
+	assert( Matrix::approxEqual( a * band, a * bandDense ).equal );
+	try
+	{
+		band.set( 0, 5, 1.0 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Out of range" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_mixed_precision )
+{
+	const int n = 96;
+	Matrix a( n, n ), b( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			a[ i ][ j ] = 1.0 / ( i + j + 1.0 );
+			b[ i ][ j ] = ( ( i * 5 + j ) % 13 ) / 7.0 - 0.9;
+		}
+	}
+	const Matrix exact = a * b;
+
+	// Без уточнения ошибка порядка единицы округления float
+	Matrix::AccuracyReport report;
+	Matrix single = Matrix::multiplyMixed( a, b, Matrix::SinglePrecision, Matrix::AccumulateDouble, 0, &report );
+	assert( report.relativeError > 0.0 && report.relativeError < 16 * report.unitRoundoff );
+	assert( Matrix::approxEqual( single, exact, 1e-5, 1e-5 ).equal );
+
+	// Один шаг уточнения возвращает точность double
+	Matrix::multiplyMixed( a, b, Matrix::SinglePrecision, Matrix::AccumulateDouble, 1, &report );
+	assert( report.relativeError < 1e-13 );
+
+	// Накопление в float (по умолчанию); размеры не кратны блокам микроядра
+	Matrix c( 101, 70 ), d( 70, 37 );
+	for ( int i = 0; i < 101; i++ )
+	{
+		for ( int j = 0; j < 70; j++ )
+		{
+			c[ i ][ j ] = a[ i % n ][ j ];
+			d[ j ][ i % 37 ] = b[ j ][ i % n ];
+		}
+	}
+	Matrix::multiplyMixed( c, d, Matrix::SinglePrecision, Matrix::AccumulateFloat, 0, &report );
+	assert( report.relativeError > 0.0 && report.relativeError < 64 * report.unitRoundoff );
+	assert( report.maxAbsError < 1e-4 );
+
+	// bfloat16: каждый шаг уточнения снижает ошибку
+	double previous = 1.0;
+	for ( int steps = 0; steps < 3; steps++ )
+	{
+		Matrix::multiplyMixed( a, b, Matrix::BFloat16Precision, Matrix::AccumulateFloat, steps, &report );
+		assert( report.relativeError < previous );
+		previous = report.relativeError;
+	}
+
+	// Глобальная настройка применяется операторами * и *=; по умолчанию 
+	// произведения накапливаются в double, и шаг уточнения дает точность double
+	Matrix::setMultiplyPrecision( Matrix::SinglePrecision );
+	assert( Matrix::getMultiplyPrecision().accumulation == Matrix::AccumulateDouble );
+	Matrix::setMultiplyPrecision( Matrix::SinglePrecision, Matrix::AccumulateDouble, 1 );
+	assert( Matrix::getMultiplyPrecision().refinementSteps == 1 );
+	Matrix refined = a * b;
+	Matrix inPlace( a );
+	inPlace *= b;
+	assert( inPlace == refined && ! ( refined == exact ) );
+	Matrix::setMultiplyPrecision( Matrix::DoublePrecision );
+	assert( Matrix::approxEqual( refined, exact, 1e-12, 1e-12 ).equal );
+	assert( a * b == exact );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_reproducible_mode )
+{
+	const int n = 300;
+	Matrix a( n, n ), b( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			a[ i ][ j ] = 1.0 / ( 1.0 + i + 3 * j ) - 0.01;
+			b[ i ][ j ] = ( ( i * 31 + j * 17 ) % 101 ) * 1e-3 - 0.05;
+		}
+	}
+
+	ThreadPool & pool = ThreadPool::instance();
+	const int threads = pool.getNumThreads();
+	Matrix::setReproducible( true );
+	assert( Matrix::isReproducible() );
+
+	// Эталон вычисляется в одном потоке
+	pool.setNumThreads( 1 );
+	const Matrix product = a * b;
+	const Matrix chain = a + b + product;
+	const double total = chain.sum();
+	const double norm = product.normFrobenius();
+	const double rowNorm = product.normInf();
+
+	for ( int count = 2; count <= 4; count++ )
+	{
+		pool.setNumThreads( count );
+		Matrix p = a * b;
+		assert( p == product );
+		assert( p.sum() == product.sum() );
+		assert( ( a + b + p ).sum() == total );
+		assert( p.normFrobenius() == norm );
+		assert( p.normInf() == rowNorm );
+	}
+
+	// Обычный режим отличается от воспроизводимого не более чем на погрешность округления
+	Matrix::setReproducible( false );
+	pool.setNumThreads( threads );
+	assert( Matrix::approxEqual( a * b, product, 1e-12, 1e-12 ).equal );
+	assert( std::fabs( ( a * b ).normFrobenius() - norm ) <= 1e-12 * norm );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_matrix_functions )
+{
+	// Стохастическая матрица цепи Маркова
+	double dataP[] = { 0.9, 0.1, 0.0,
+	                   0.2, 0.7, 0.1,
+	                   0.0, 0.3, 0.7 };
+	Matrix p( 3, 3, dataP );
+
+	Matrix identity( 3, 3 );
+	for ( int i = 0; i < 3; i++ )
+	{
+		identity[ i ][ i ] = 1.0;
+	}
+	assert( pow( p, 0 ) == identity );
+	assert( pow( p, 1 ) == p );
+
+	Matrix expected( identity );
+	for ( int k = 1; k <= 37; k++ )
+	{
+		expected = expected * p;
+	}
+	Matrix p37 = pow( p, 37 );
+	assert( Matrix::approxEqual( p37, expected, 1e-14, 1e-12 ).equal );
+	for ( int i = 0; i < 3; i++ )
+	{
+		assert( std::fabs( p37[ i ][ 0 ] + p37[ i ][ 1 ] + p37[ i ][ 2 ] - 1.0 ) < 1e-12 );
+	}
+
+	// 1 - 2P + 3P^2 + 0.5P^4 - P^5
+	std::vector< double > coefficients = { 1.0, -2.0, 3.0, 0.0, 0.5, -1.0 };
+	Matrix poly = identity - 2.0 * p + 3.0 * pow( p, 2 ) + 0.5 * pow( p, 4 ) - pow( p, 5 );
+	assert( Matrix::approxEqual( polynomial( p, coefficients ), poly, 1e-13, 1e-13 ).equal );
+
+	// exp диагональной и нильпотентной матриц известна точно
+	double dataD[] = { 1.0, 0.0, 0.0, -2.0 };
+	Matrix expD = expm( Matrix( 2, 2, dataD ) );
+	assert( std::fabs( expD[ 0 ][ 0 ] - std::exp( 1.0 ) ) < 1e-14 );
+	assert( std::fabs( expD[ 1 ][ 1 ] - std::exp( -2.0 ) ) < 1e-15 );
+	assert( expD[ 0 ][ 1 ] == 0.0 );
+
+	double dataN[] = { 0.0, 30.0, 0.0, 0.0 };
+	Matrix expN = expm( Matrix( 2, 2, dataN ) );
+	assert( std::fabs( expN[ 0 ][ 1 ] - 30.0 ) < 1e-12 && std::fabs( expN[ 0 ][ 0 ] - 1.0 ) < 1e-12 );
+
+	// exp(A) * exp(-A) = I
+	Matrix a( 3, 3, dataP ), minusA( 3, 3 );
+	minusA.axpy( -5.0, a );
+	a.scaleAdd( 5.0, 0.0, a );
+	assert( Matrix::approxEqual( expm( a ) * expm( minusA ), identity, 1e-12, 0.0 ).equal );
+
+	double dataInf[] = { 1.0, HUGE_VAL, 0.0, 1.0 };
+	try
+	{
+		expm( Matrix( 2, 2, dataInf ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Values are out of range" ) );
+		delete _e;
+	}
+
+	try
+	{
+		pow( Matrix( 2, 3 ), 2 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_gemm_tuning )
+{
+	MatrixKernels::GemmConfig config = MatrixKernels::defaultGemmConfig();
+	assert( MatrixTuning::parseConfig( "mc=32, kc=96 unroll=8", config ) );
+	assert( config.mc == 32 && config.kc == 96 && config.unroll == 8 );
+	assert( config.nc == MatrixKernels::defaultGemmConfig().nc );
+
+	MatrixKernels::GemmConfig parsed = MatrixKernels::defaultGemmConfig();
+	assert( MatrixTuning::parseConfig( MatrixTuning::formatConfig( config ), parsed ) );
+	assert( parsed.mc == config.mc && parsed.kc == config.kc && parsed.nc == config.nc );
+	assert( parsed.unroll == config.unroll && parsed.parallelWork == config.parallelWork );
+
+	assert( ! MatrixTuning::parseConfig( "unroll=3", parsed ) );
+	assert( ! MatrixTuning::parseConfig( "mc=0", parsed ) );
+	assert( ! MatrixTuning::parseConfig( "block=64", parsed ) );
+	assert( ! MatrixTuning::parseConfig( "mc=abc", parsed ) );
+	assert( ! MatrixKernels::setGemmConfig( MatrixKernels::GemmConfig{ 64, 256, 512, 5, 0.0 } ) );
+
+	// Результат не зависит от блоков, микроядра и порога параллельности
+	Matrix a( 150, 170 ), b( 170, 130 );
+	for ( int i = 0; i < 170; i++ )
+	{
+		for ( int j = 0; j < 150; j++ )
+		{
+			a[ j ][ i ] = ( ( i * 37 + j * 11 ) % 101 ) / 101.0 - 0.5;
+		}
+		for ( int j = 0; j < 130; j++ )
+		{
+			b[ i ][ j ] = ( ( i * 13 + j * 29 ) % 97 ) / 97.0 - 0.5;
+		}
+	}
+	const Matrix expected = a * b;
+	const MatrixKernels::GemmConfig configs[] = {
+		{ 32, 96, 64, 8, 0.0 },
+		{ 17, 33, 45, 2, 0.0 },
+		{ 64, 256, 512, 1, 1e18 },
+		{ 128, 512, 2048, 8, 1e18 },
+	};
+	for ( const MatrixKernels::GemmConfig & c : configs )
+	{
+		assert( MatrixKernels::setGemmConfig( c ) );
+		assert( Matrix::approxEqual( a * b, expected, 1e-13, 1e-13 ).equal );
+	}
+	assert( MatrixKernels::setGemmConfig( MatrixKernels::defaultGemmConfig() ) );
+
+	// Кэш: строка текущего процессора заменяется, чужие строки сохраняются
+	const std::string path = "/tmp/matrix_tuning_test.cache";
+	{
+		std::ofstream file( path, std::ios::trunc );
+		file << "# comment\nOther CPU x64\tmc=128 kc=512 nc=1024 unroll=8 parallel=1\n";
+	}
+	assert( MatrixTuning::writeCache( path, configs[ 0 ] ) );
+	assert( MatrixTuning::writeCache( path, configs[ 1 ] ) );
+	MatrixKernels::GemmConfig cached = MatrixKernels::defaultGemmConfig();
+	assert( MatrixTuning::readCache( path, cached ) );
+	assert( cached.mc == 17 && cached.kc == 33 && cached.nc == 45 && cached.unroll == 2 );
+
+	std::ifstream file( path );
+	std::string line;
+	int lines = 0;
+	while ( std::getline( file, line ) )
+	{
+		lines++;
+	}
+	assert( lines == 3 );
+
+	// Ошибочная ручная настройка не заменяется кэшем: используются значения по умолчанию
+	const char * previousCache = std::getenv( "MATRIX_TUNING_CACHE" );
+	const std::string savedCache = previousCache ? previousCache : "";
+	setenv( "MATRIX_TUNING_CACHE", path.c_str(), 1 );
+	setenv( "MATRIX_GEMM_CONFIG", "mc=abc", 1 );
+	assert( MatrixTuning::loadConfig() );
+	const MatrixKernels::GemmConfig loaded = MatrixKernels::gemmConfig();
+	assert( loaded.mc == MatrixKernels::defaultGemmConfig().mc && loaded.kc == MatrixKernels::defaultGemmConfig().kc );
+	unsetenv( "MATRIX_GEMM_CONFIG" );
+	if ( previousCache )
+		setenv( "MATRIX_TUNING_CACHE", savedCache.c_str(), 1 );
+	else
+		unsetenv( "MATRIX_TUNING_CACHE" );
+	std::remove( path.c_str() );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_spectral )
+{
+	// max |Q^T Q - I|
+	auto orthogonalityError = [] ( const Matrix & q )
+	{
+		const int k = q.getNumColumns();
+		Matrix gram( k, k );
+		gram.gemm( 1.0, q, q, 0.0, Matrix::Trans );
+		double error = 0.0;
+		for ( int i = 0; i < k; i++ )
+		{
+			for ( int j = 0; j < k; j++ )
+			{
+				error = std::max( error, std::fabs( gram[ i ][ j ] - ( i == j ? 1.0 : 0.0 ) ) );
+			}
+		}
+		return error;
+	};
+	// U * diag(s) * V^T
+	auto reconstruct = [] ( const SingularValueDecomposition & d )
+	{
+		Matrix us( d.U );
+		for ( int i = 0; i < us.getNumRows(); i++ )
+		{
+			for ( int j = 0; j < us.getNumColumns(); j++ )
+			{
+				us[ i ][ j ] *= d.singularValues[ j ];
+			}
+		}
+		Matrix result( d.U.getNumRows(), d.V.getNumRows() );
+		return result.gemm( 1.0, us, d.V, 0.0, Matrix::NoTrans, Matrix::Trans );
+	};
+
+	// Размер больше блока отражений и листа "разделяй и властвуй"
+	const int n = 90;
+	Matrix a( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = i; j < n; j++ )
+		{
+			a[ i ][ j ] = a[ j ][ i ] = ( ( i * 37 + j * 53 ) % 101 ) / 101.0 - 0.5;
+		}
+	}
+	SymmetricEigen eigen = eigenSymmetric( a );
+	assert( orthogonalityError( eigen.vectors ) < 1e-13 );
+	Matrix av = a * eigen.vectors;
+	for ( int j = 0; j < n; j++ )
+	{
+		assert( j == 0 || eigen.values[ j - 1 ] <= eigen.values[ j ] );
+		for ( int i = 0; i < n; i++ )
+		{
+			assert( std::fabs( av[ i ][ j ] - eigen.vectors[ i ][ j ] * eigen.values[ j ] ) < 1e-12 );
+		}
+	}
+
+	// Кратные собственные значения 0, 1, 2 (исключение при слиянии подзадач)
+	Matrix scaled( eigen.vectors );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			scaled[ i ][ j ] *= j % 3;
+		}
+	}
+	Matrix repeated( n, n );
+	repeated.gemm( 1.0, scaled, eigen.vectors, 0.0, Matrix::NoTrans, Matrix::Trans );
+	SymmetricEigen multiple = eigenSymmetric( repeated );
+	assert( orthogonalityError( multiple.vectors ) < 1e-13 );
+	for ( int j = 0; j < n; j++ )
+	{
+		assert( std::fabs( multiple.values[ j ] - j * 3 / n ) < 1e-12 );
+	}
+
+	// Высокая и широкая матрицы
+	Matrix tall( 130, 70 );
+	for ( int i = 0; i < 130; i++ )
+	{
+		for ( int j = 0; j < 70; j++ )
+		{
+			tall[ i ][ j ] = ( ( i * 29 + j * 17 + i * j ) % 89 ) / 89.0 - 0.5;
+		}
+	}
+	SingularValueDecomposition decomposition = svd( tall );
+	assert( decomposition.U.getNumRows() == 130 && decomposition.U.getNumColumns() == 70 );
+	assert( decomposition.V.getNumRows() == 70 && decomposition.V.getNumColumns() == 70 );
+	assert( Matrix::approxEqual( reconstruct( decomposition ), tall, 1e-12, 0.0 ).equal );
+	assert( orthogonalityError( decomposition.U ) < 1e-12 && orthogonalityError( decomposition.V ) < 1e-12 );
+
+	// Сингулярные значения - корни собственных значений A^T A
+	Matrix gram( 70, 70 );
+	gram.gemm( 1.0, tall, tall, 0.0, Matrix::Trans );
+	SymmetricEigen gramEigen = eigenSymmetric( gram );
+	for ( int j = 0; j < 70; j++ )
+	{
+		assert( j == 0 || decomposition.singularValues[ j - 1 ] >= decomposition.singularValues[ j ] );
+		const double expected = std::sqrt( std::max( 0.0, gramEigen.values[ 69 - j ] ) );
+		assert( std::fabs( decomposition.singularValues[ j ] - expected ) < 1e-10 * decomposition.singularValues[ 0 ] );
+	}
+
+	Matrix wide( 40, 75 );
+	for ( int i = 0; i < 40; i++ )
+	{
+		for ( int j = 0; j < 75; j++ )
+		{
+			wide[ i ][ j ] = tall[ j ][ i ];
+		}
+	}
+	SingularValueDecomposition wideDecomposition = svd( wide );
+	assert( wideDecomposition.U.getNumColumns() == 40 && wideDecomposition.V.getNumRows() == 75 );
+	assert( Matrix::approxEqual( reconstruct( wideDecomposition ), wide, 1e-12, 0.0 ).equal );
+
+	// Матрица ранга 5: нулевые сингулярные значения и точное восстановление
+	// по случайному разложению ранга 5
+	Matrix left( 120, 5 ), right( 5, 80 );
+	for ( int i = 0; i < 120; i++ )
+	{
+		for ( int j = 0; j < 5; j++ )
+		{
+			left[ i ][ j ] = ( ( i * 7 + j * 31 ) % 23 ) / 23.0 - 0.5;
+		}
+	}
+	for ( int i = 0; i < 5; i++ )
+	{
+		for ( int j = 0; j < 80; j++ )
+		{
+			right[ i ][ j ] = ( ( i * 13 + j * 5 + i * j ) % 19 ) / 19.0 - 0.5;
+		}
+	}
+	Matrix lowRank = left * right;
+	SingularValueDecomposition full = svd( lowRank );
+	assert( full.singularValues[ 5 ] < 1e-12 * full.singularValues[ 0 ] );
+	assert( orthogonalityError( full.U ) < 1e-12 );
+
+	// Точно вырожденная матрица ранга 1: строки L^T после вращений становятся
+	// нулевыми, U не должна содержать NaN
+	Matrix rankOne( 80, 60 );
+	for ( int i = 0; i < 80; i++ )
+	{
+		for ( int j = 0; j < 60; j++ )
+		{
+			rankOne[ i ][ j ] = ( i + 1 ) * ( j % 7 + 1 );
+		}
+	}
+	SingularValueDecomposition degenerate = svd( rankOne );
+	for ( int i = 0; i < 80; i++ )
+	{
+		for ( int j = 0; j < 60; j++ )
+		{
+			assert( std::isfinite( degenerate.U[ i ][ j ] ) );
+		}
+	}
+	assert( degenerate.singularValues[ 1 ] < 1e-12 * degenerate.singularValues[ 0 ] );
+	assert( Matrix::approxEqual( reconstruct( degenerate ), rankOne, 1e-12 * degenerate.singularValues[ 0 ], 1e-12 ).equal );
+
+	SingularValueDecomposition randomized = randomizedSvd( lowRank, 5, 5, 1, 7 );
+	assert( randomized.U.getNumColumns() == 5 && randomized.V.getNumColumns() == 5 );
+	assert( Matrix::approxEqual( reconstruct( randomized ), lowRank, 1e-12, 0.0 ).equal );
+	for ( int j = 0; j < 5; j++ )
+	{
+		assert( std::fabs( randomized.singularValues[ j ] - full.singularValues[ j ] ) < 1e-12 * full.singularValues[ 0 ] );
+	}
+
+	try
+	{
+		randomizedSvd( lowRank, 81 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Invalid dimensions" ) );
+		delete _e;
+	}
+	try
+	{
+		eigenSymmetric( tall );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_sketching )
+{
+	const int d = 100, n = 30;
+	Matrix a( d, n ), b( 20, d );
+	for ( int i = 0; i < d; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 31 + j * 7 + i * j ) % 53 ) / 53.0 - 0.5;
+		}
+		for ( int j = 0; j < 20; j++ )
+		{
+			b[ j ][ i ] = ( ( i * 11 + j * 23 ) % 41 ) / 41.0 - 0.5;
+		}
+	}
+
+	// Все виды сжатия согласованы со своей явной матрицей
+	const Sketch::Kind kinds[] = { Sketch::Gaussian, Sketch::SparseSign, Sketch::SRHT };
+	for ( Sketch::Kind kind : kinds )
+	{
+		const Sketch sketch( kind, 40, d, 3 );
+		const Matrix s = sketch.toMatrix();
+		assert( s.getNumRows() == 40 && s.getNumColumns() == d );
+		assert( Matrix::approxEqual( sketch.apply( a ), s * a, 1e-13, 0.0 ).equal );
+
+		Matrix expected( 20, 40 );
+		expected.gemm( 1.0, b, s, 0.0, Matrix::NoTrans, Matrix::Trans );
+		assert( Matrix::approxEqual( sketch.applyTransposed( b ), expected, 1e-13, 0.0 ).equal );
+
+		// Тот же seed - тот же оператор
+		assert( Sketch( kind, 40, d, 3 ).toMatrix() == s );
+	}
+
+	// Столбцы SparseSign и SRHT имеют единичную норму точно
+	const Matrix sparse = Sketch( Sketch::SparseSign, 40, d, 1 ).toMatrix();
+	const Matrix srht = Sketch( Sketch::SRHT, 64, d, 1 ).toMatrix();
+	Matrix gramSparse( d, d ), gramSrht( d, d );
+	gramSparse.gemm( 1.0, sparse, sparse, 0.0, Matrix::Trans );
+	gramSrht.gemm( 1.0, srht, srht, 0.0, Matrix::Trans );
+	assert( std::fabs( gramSparse.trace() - d ) < 1e-12 );
+	assert( std::fabs( gramSrht.trace() - d ) < 1e-12 );
+
+	// Матрица ранга 4 восстанавливается точно
+	Matrix left( 80, 4 ), right( 4, 60 );
+	for ( int i = 0; i < 80; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			left[ i ][ j ] = ( ( i * 17 + j * 5 ) % 29 ) / 29.0 - 0.5;
+		}
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		for ( int j = 0; j < 60; j++ )
+		{
+			right[ i ][ j ] = ( ( i * 7 + j * 13 + i * j ) % 31 ) / 31.0 - 0.5;
+		}
+	}
+	const Matrix product = left * right;
+	for ( Sketch::Kind kind : kinds )
+	{
+		const Matrix q = rangeFinder( product, 8, kind, 1, 5 );
+		Matrix projection( 8, 60 ), restored( 80, 60 );
+		projection.gemm( 1.0, q, product, 0.0, Matrix::Trans );
+		restored.gemm( 1.0, q, projection, 0.0 );
+		assert( Matrix::approxEqual( restored, product, 1e-12, 0.0 ).equal );
+
+		const LowRank approximation = lowRankApprox( product, 4, 4, 1, kind, 5 );
+		assert( approximation.getRank() == 4 );
+		assert( Matrix::approxEqual( approximation.toMatrix(), product, 1e-12, 0.0 ).equal );
+	}
+
+	// Произведения через сомножители совпадают с произведениями полной матрицы
+	Matrix v( 60, 4 );
+	for ( int i = 0; i < 60; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			v[ i ][ j ] = right[ j ][ i ];
+		}
+	}
+	const LowRank lowRank( left, v );
+	assert( lowRank.getNumRows() == 80 && lowRank.getNumColumns() == 60 );
+	assert( Matrix::approxEqual( lowRank.toMatrix(), product, 1e-14, 0.0 ).equal );
+
+	Matrix c( 60, 7 ), e( 9, 80 );
+	for ( int i = 0; i < 60; i++ )
+	{
+		for ( int j = 0; j < 7; j++ )
+		{
+			c[ i ][ j ] = ( i + 2 * j ) % 5 - 2.0;
+		}
+	}
+	for ( int i = 0; i < 9; i++ )
+	{
+		for ( int j = 0; j < 80; j++ )
+		{
+			e[ i ][ j ] = ( 3 * i + j ) % 7 - 3.0;
+		}
+	}
+	assert( Matrix::approxEqual( lowRank * c, product * c, 1e-12, 1e-12 ).equal );
+	assert( Matrix::approxEqual( e * lowRank, e * product, 1e-12, 1e-12 ).equal );
+
+	Vector x( 60 );
+	for ( int i = 0; i < 60; i++ )
+	{
+		x[ i ] = i % 3 - 1.0;
+	}
+	assert( Matrix::approxEqual( ( lowRank * x ).toMatrix(), ( product * x ).toMatrix(), 1e-12, 1e-12 ).equal );
+
+	const LowRank square = lowRank * LowRank( c, Matrix( 80, 7 ) );
+	assert( square.getRank() == 4 && square.getNumRows() == 80 && square.getNumColumns() == 80 );
+
+	// Приближенное произведение несмещено: для большого размера сжатия ошибка мала
+	Matrix exact = b * a;
+	Matrix approximate = approximateProduct( b, a, 2000, Sketch::Gaussian, 11 );
+	assert( ( approximate - exact ).normFrobenius() < 0.1 * b.normFrobenius() * a.normFrobenius() );
+
+	try
+	{
+		LowRank( Matrix( 5, 2 ), Matrix( 6, 3 ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_distributed_multiply )
+{
+	Matrix a( 37, 29 ), b( 29, 23 );
+	for ( int i = 0; i < 37; i++ )
+	{
+		for ( int j = 0; j < 29; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 13 + j * 7 + i * j ) % 47 ) / 47.0 - 0.5;
+		}
+	}
+	for ( int i = 0; i < 29; i++ )
+	{
+		for ( int j = 0; j < 23; j++ )
+		{
+			b[ i ][ j ] = ( ( i * 5 + j * 17 ) % 43 ) / 43.0 - 0.5;
+		}
+	}
+	const Matrix expected = a * b;
+
+	// Разные решетки, в том числе с несовпадающими границами блоков A и B
+	const int grids[][ 2 ] = { { 1, 1 }, { 2, 2 }, { 1, 3 }, { 3, 2 } };
+	for ( const auto & grid : grids )
+	{
+		assert( Matrix::approxEqual( distributedMultiply( a, b, grid[ 0 ], grid[ 1 ] ), expected, 1e-13, 0.0 ).equal );
+	}
+
+	// Узкие полосы: буфер обмена вмещает полосы шириной 2
+	ProcessGroup::run( 4, 2 * ( 19 + 12 ), [ & ] ( ProcessGroup & group )
+	{
+		ProcessGrid grid( group, 2, 2 );
+		DistributedMatrix localA( grid, a ), localB( grid, b ), localC( grid, 37, 23 );
+		DistributedMatrix::multiply( localA, localB, localC );
+
+		Matrix block( localC.getLocal().getNumRows(), localC.getLocal().getNumColumns() );
+		for ( int i = 0; i < block.getNumRows(); i++ )
+		{
+			for ( int j = 0; j < block.getNumColumns(); j++ )
+			{
+				block[ i ][ j ] = expected[ localC.getRowBegin() + i ][ localC.getColBegin() + j ];
+			}
+		}
+		assert( Matrix::approxEqual( localC.getLocal(), block, 1e-13, 0.0 ).equal );
+
+		double values[ 3 ] = { 0.0, 0.0, 0.0 };
+		if ( group.getRank() == 2 )
+		{
+			values[ 0 ] = 1.0; values[ 1 ] = 2.0; values[ 2 ] = 3.0;
+		}
+		group.broadcast( values, 3, 2 );
+		assert( values[ 0 ] == 1.0 && values[ 1 ] == 2.0 && values[ 2 ] == 3.0 );
+	} );
+
+	// Ошибка в одном процессе не оставляет остальные ждать на барьере
+	try
+	{
+		ProcessGroup::run( 3, 16, [] ( ProcessGroup & group )
+		{
+			if ( group.getRank() == 1 )
+			{
+				throw new Matrix::OutOfRangeException();
+			}
+			group.barrier();
+		} );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Process failed" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_compressed_storage )
+{
+	// Данные с короткой мантиссой (отсчеты с шагом 1/64), гладкие данные
+	// полной точности и произвольные данные
+	Matrix smooth( 300, 200 ), precise( 300, 200 ), noisy( 70, 50 );
+	for ( int i = 0; i < 300; i++ )
+	{
+		for ( int j = 0; j < 200; j++ )
+		{
+			smooth[ i ][ j ] = std::floor( 512.0 * std::sin( i * 0.01 + j * 0.02 ) ) / 64.0;
+			precise[ i ][ j ] = std::sin( i * 0.01 + j * 0.02 );
+		}
+	}
+	for ( int i = 0; i < 70; i++ )
+	{
+		for ( int j = 0; j < 50; j++ )
+		{
+			noisy[ i ][ j ] = std::sin( i * 12.9898 + j * 78.233 ) * 43758.5453;
+		}
+	}
+	noisy[ 3 ][ 4 ] = -0.0;
+
+	const CompressedMatrix compressedSmooth( smooth ), compressedPrecise( precise ), compressedNoisy( noisy );
+	assert( compressedSmooth.decompress() == smooth );
+	assert( compressedPrecise.decompress() == precise );
+	assert( compressedNoisy.decompress() == noisy );
+	assert( std::signbit( compressedNoisy.decompress()[ 3 ][ 4 ] ) );
+
+	// Короткая мантисса сжимается в несколько раз, полная точность - 
+	// только за счет старших байтов
+	assert( compressedSmooth.getCompressionRatio() > 3.0 );
+	assert( compressedPrecise.getCompressionRatio() > 1.1 && compressedPrecise.getCompressionRatio() < 2.0 );
+
+	// Пустая матрица (после перемещения) не сжимается и не расширяется
+	Matrix source( 2, 2 ), taken( std::move( source ) );
+	const CompressedMatrix compressedEmpty( source );
+	assert( compressedEmpty.getNumRows() == 0 && compressedEmpty.getNumColumns() == 0 );
+	assert( compressedEmpty.getCompressedSize() == 0 );
+	assert( compressedEmpty.getCompressionRatio() == 1.0 );
+
+	// Поэлементный доступ распаковывает только нужный блок
+	assert( compressedSmooth.at( 0, 0 ) == smooth[ 0 ][ 0 ] );
+	assert( compressedSmooth.at( 299, 199 ) == smooth[ 299 ][ 199 ] );
+	assert( compressedSmooth.at( 41, 17 ) == smooth[ 41 ][ 17 ] );
+
+	// Потоковая обработка по блокам
+	double expected = 0.0;
+	for ( int i = 0; i < 300; i++ )
+	{
+		for ( int j = 0; j < 200; j++ )
+		{
+			expected += smooth[ i ][ j ];
+		}
+	}
+	assert( std::fabs( compressedSmooth.sum() - expected ) < 1e-9 );
+
+	// Сохранение и загрузка
+	std::stringstream stream;
+	compressedSmooth.save( stream );
+	compressedNoisy.save( stream );
+	assert( CompressedMatrix::load( stream ).decompress() == smooth );
+	assert( CompressedMatrix::load( stream ).decompress() == noisy );
+
+	std::stringstream damaged;
+	compressedNoisy.save( damaged );
+	std::string bytes = damaged.str();
+	bytes[ bytes.size() / 2 ] ^= 0x5A;
+	damaged.str( bytes );
+	try
+	{
+		CompressedMatrix::load( damaged );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Corrupted data" ) );
+		delete _e;
+	}
+
+	// Размеры в заголовке (после сигнатуры) больше, чем помещается в поток
+	std::stringstream oversized;
+	compressedNoisy.save( oversized );
+	bytes = oversized.str();
+	const std::int32_t huge = 0x7FFFFFFF;
+	std::memcpy( &bytes[ 4 ], &huge, sizeof( huge ) );
+	std::memcpy( &bytes[ 8 ], &huge, sizeof( huge ) );
+	oversized.str( bytes );
+	try
+	{
+		CompressedMatrix::load( oversized );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Corrupted data" ) );
+		delete _e;
+	}
+	try
+	{
+		compressedSmooth.at( 300, 0 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Out of range" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_elementwise )
+{
+	// 300 x 150 - параллельная обработка по строкам
+	Matrix a( 300, 150 ), b( 300, 150 );
+	for ( int i = 0; i < 300; i++ )
+	{
+		for ( int j = 0; j < 150; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 37 + j * 11 ) % 101 ) / 10.0 - 5.0;
+			b[ i ][ j ] = ( ( i * 13 + j * 29 ) % 89 ) / 20.0 + 0.25;
+		}
+	}
+
+	const Matrix product = hadamard( a, b ), quotient = divide( a, b );
+	const Matrix exponent = a.map( Matrix::Exp ), logarithm = b.map( Matrix::Log );
+	const Matrix tanh = a.map( Matrix::Tanh ), sigmoid = a.map( Matrix::Sigmoid ), relu = a.map( Matrix::Relu );
+	const Matrix custom = a.map( [] ( double x ) { return x * x + 1.0; } );
+	const Matrix zipped = Matrix::zipWith( a, b, [] ( double x, double y ) { return x - 2.0 * y; } );
+	for ( int i = 0; i < 300; i++ )
+	{
+		for ( int j = 0; j < 150; j++ )
+		{
+			const double x = a[ i ][ j ], y = b[ i ][ j ];
+			assert( product[ i ][ j ] == x * y );
+			assert( quotient[ i ][ j ] == x / y );
+			assert( std::fabs( exponent[ i ][ j ] - std::exp( x ) ) <= 4e-16 * std::exp( x ) );
+			assert( std::fabs( logarithm[ i ][ j ] - std::log( y ) ) <= 4e-16 * std::fabs( std::log( y ) ) );
+			assert( std::fabs( tanh[ i ][ j ] - std::tanh( x ) ) <= 8e-16 * std::fabs( std::tanh( x ) ) );
+			assert( std::fabs( sigmoid[ i ][ j ] - 1.0 / ( 1.0 + std::exp( -x ) ) ) <= 8e-16 / ( 1.0 + std::exp( -x ) ) );
+			assert( relu[ i ][ j ] == ( x > 0.0 ? x : 0.0 ) );
+			assert( custom[ i ][ j ] == x * x + 1.0 );
+			assert( zipped[ i ][ j ] == x - 2.0 * y );
+		}
+	}
+
+	// Операции на месте
+	Matrix c( a );
+	c.multiplyElements( b ).divideElements( b );
+	assert( Matrix::approxEqual( c, a, 1e-14, 1e-15 ).equal );
+	c.apply( Matrix::Relu ).apply( [] ( double x ) { return -x; } );
+	assert( c.maxElement() <= 0.0 );
+
+	try
+	{
+		a.map( Matrix::Log );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Values are out of range" ) );
+		delete _e;
+	}
+	try
+	{
+		hadamard( a, Matrix( 150, 300 ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_convolution )
+{
+	// Изображение 70 x 90, ядра 5 x 4 (четная ширина - проверка положения центра для Same)
+	Matrix image( 70, 90 );
+	for ( int i = 0; i < 70; i++ )
+	{
+		for ( int j = 0; j < 90; j++ )
+		{
+			image[ i ][ j ] = std::sin( i * 0.3 + j * 0.17 ) + ( ( i * 7 + j ) % 5 ) * 0.1;
+		}
+	}
+	std::vector< Matrix > kernels( 3, Matrix( 5, 4 ) );
+	for ( int t = 0; t < 3; t++ )
+	{
+		for ( int p = 0; p < 5; p++ )
+		{
+			for ( int q = 0; q < 4; q++ )
+			{
+				kernels[ t ][ p ][ q ] = ( ( p * 3 + q * 5 + t * 7 ) % 11 ) / 11.0 - 0.4;
+			}
+		}
+	}
+
+	// Прямое вычисление полной свертки
+	const auto naive = [ & ] ( const Matrix & kernel, bool flip )
+	{
+		Matrix full( 74, 93 );
+		for ( int i = 0; i < 74; i++ )
+		{
+			for ( int j = 0; j < 93; j++ )
+			{
+				double sum = 0.0;
+				for ( int p = 0; p < 5; p++ )
+				{
+					for ( int q = 0; q < 4; q++ )
+					{
+						const int si = flip ? i - p : i - 4 + p, sj = flip ? j - q : j - 3 + q;
+						if ( si >= 0 && si < 70 && sj >= 0 && sj < 90 )
+						{
+							sum += image[ si ][ sj ] * kernel[ p ][ q ];
+						}
+					}
+				}
+				full[ i ][ j ] = sum;
+			}
+		}
+		return full;
+	};
+	const auto crop = [] ( const Matrix & full, int top, int left, int rows, int cols )
+	{
+		Matrix result( rows, cols );
+		for ( int i = 0; i < rows; i++ )
+		{
+			for ( int j = 0; j < cols; j++ )
+			{
+				result[ i ][ j ] = full[ i + top ][ j + left ];
+			}
+		}
+		return result;
+	};
+
+	const Convolution::Method methods[] = { Convolution::Im2col, Convolution::Fft };
+	for ( Convolution::Method method : methods )
+	{
+		const Matrix full = naive( kernels[ 0 ], true ), flipped = naive( kernels[ 0 ], false );
+		assert( Matrix::approxEqual( convolve2d( image, kernels[ 0 ], Convolution::Full, method ), full, 1e-12, 1e-12 ).equal );
+		assert( Matrix::approxEqual( convolve2d( image, kernels[ 0 ], Convolution::Same, method ),
+		                             crop( full, 2, 1, 70, 90 ), 1e-12, 1e-12 ).equal );
+		assert( Matrix::approxEqual( convolve2d( image, kernels[ 0 ], Convolution::Valid, method ),
+		                             crop( full, 4, 3, 66, 87 ), 1e-12, 1e-12 ).equal );
+		assert( Matrix::approxEqual( correlate2d( image, kernels[ 0 ], Convolution::Valid, method ),
+		                             crop( flipped, 4, 3, 66, 87 ), 1e-12, 1e-12 ).equal );
+
+		// Набор ядер
+		const std::vector< Matrix > bank = convolve2d( image, kernels, Convolution::Same, method );
+		assert( bank.size() == 3 );
+		for ( int t = 0; t < 3; t++ )
+		{
+			assert( Matrix::approxEqual( bank[ t ], crop( naive( kernels[ t ], true ), 2, 1, 70, 90 ), 1e-12, 1e-12 ).equal );
+		}
+	}
+
+	// Малые ядра - im2col, крупные - БПФ
+	assert( Convolution::chooseMethod( 100, 100, 3, 3 ) == Convolution::Im2col );
+	assert( Convolution::chooseMethod( 512, 512, 31, 31 ) == Convolution::Fft );
+
+	try
+	{
+		convolve2d( kernels[ 0 ], image, Convolution::Valid );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+	try
+	{
+		convolve2d( image, std::vector< Matrix >() );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Invalid dimensions" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_broadcast_and_axis_reductions )
+{
+	// 400 x 130 - параллельная обработка строк и блоков столбцов
+	Matrix a( 400, 130 );
+	Vector row( 130 ), column( 400 );
+	for ( int i = 0; i < 400; i++ )
+	{
+		for ( int j = 0; j < 130; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 31 + j * 17 ) % 97 ) / 8.0 - 6.0;
+		}
+		column[ i ] = 1.0 + ( i % 7 ) * 0.5;
+	}
+	for ( int j = 0; j < 130; j++ )
+	{
+		row[ j ] = 0.25 * j - 10.0;
+	}
+
+	const Matrix shifted = broadcastRow( a, Matrix::Subtract, row );
+	const Matrix scaled = broadcastColumn( a, Matrix::Divide, column );
+	Matrix inPlace( a );
+	inPlace.broadcastRow( Matrix::Add, row ).broadcastColumn( Matrix::Multiply, column );
+	for ( int i = 0; i < 400; i++ )
+	{
+		for ( int j = 0; j < 130; j++ )
+		{
+			assert( shifted[ i ][ j ] == a[ i ][ j ] - row[ j ] );
+			assert( scaled[ i ][ j ] == a[ i ][ j ] / column[ i ] );
+			assert( inPlace[ i ][ j ] == ( a[ i ][ j ] + row[ j ] ) * column[ i ] );
+		}
+	}
+
+	// Элементы кратны 1/8, поэтому суммы точны
+	const Vector rowSums = a.rowSums(), columnMeans = a.columnMeans();
+	const std::vector< int > rowArgMax = a.rowArgMax(), columnArgMax = a.columnArgMax();
+	for ( int i = 0; i < 400; i++ )
+	{
+		double sum = 0.0;
+		int best = 0;
+		for ( int j = 0; j < 130; j++ )
+		{
+			sum += a[ i ][ j ];
+			best = a[ i ][ j ] > a[ i ][ best ] ? j : best;
+		}
+		assert( rowSums[ i ] == sum );
+		assert( rowArgMax[ i ] == best );
+	}
+	for ( int j = 0; j < 130; j++ )
+	{
+		double sum = 0.0;
+		int best = 0;
+		for ( int i = 0; i < 400; i++ )
+		{
+			sum += a[ i ][ j ];
+			best = a[ i ][ j ] > a[ best ][ j ] ? i : best;
+		}
+		assert( std::fabs( columnMeans[ j ] - sum / 400.0 ) < 1e-14 );
+		assert( columnArgMax[ j ] == best );
+	}
+
+	// NaN пропускаются, среди равных выбирается первый
+	Matrix b( 2, 11 );
+	b[ 0 ][ 0 ] = std::nan( "" );
+	b[ 0 ][ 5 ] = 3.0;
+	b[ 0 ][ 9 ] = 3.0;
+	b[ 1 ][ 0 ] = 3.0;
+	assert( b.rowArgMax()[ 0 ] == 5 );
+	assert( b.columnArgMax()[ 0 ] == 1 );
+	assert( b.columnArgMax()[ 3 ] == 0 );
+
+	try
+	{
+		a.broadcastRow( Matrix::Add, column );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+	try
+	{
+		broadcastColumn( a, Matrix::Divide, Vector( 400 ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Values are out of range" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_stack_reshape_gather )
+{
+	// Части 300 x 70 и 300 x 50 - параллельное копирование
+	Matrix left( 300, 70 ), right( 300, 50 ), bottom( 20, 120 );
+	for ( int i = 0; i < 300; i++ )
+	{
+		for ( int j = 0; j < 70; j++ )
+		{
+			left[ i ][ j ] = i * 1000.0 + j;
+		}
+		for ( int j = 0; j < 50; j++ )
+		{
+			right[ i ][ j ] = -( i * 1000.0 + j );
+		}
+	}
+	for ( int i = 0; i < 20; i++ )
+	{
+		for ( int j = 0; j < 120; j++ )
+		{
+			bottom[ i ][ j ] = 0.5 * ( i + j );
+		}
+	}
+
+	std::vector< Matrix > columns;
+	columns.push_back( left );
+	columns.push_back( right );
+	const Matrix wide = hstack( columns );
+	std::vector< Matrix > rows;
+	rows.push_back( wide );
+	rows.push_back( bottom );
+	const Matrix tall = vstack( rows );
+	assert( wide.getNumRows() == 300 && wide.getNumColumns() == 120 );
+	assert( tall.getNumRows() == 320 && tall.getNumColumns() == 120 );
+	for ( int i = 0; i < 320; i++ )
+	{
+		for ( int j = 0; j < 120; j++ )
+		{
+			const double expected = i >= 300 ? bottom[ i - 300 ][ j ] : j < 70 ? left[ i ][ j ] : right[ i ][ j - 70 ];
+			assert( tall[ i ][ j ] == expected );
+		}
+	}
+
+	// Изменение размеров сохраняет построчный порядок элементов
+	Matrix flat = left.reshaped( 1, 300 * 70 );
+	assert( flat.getNumRows() == 1 && flat[ 0 ][ 71 ] == left[ 1 ][ 1 ] );
+	flat.reshape( 70, 300 );
+	assert( flat[ 69 ][ 299 ] == left[ 299 ][ 69 ] );
+
+	// Присвоение матрицы с общим буфером переносит и размеры
+	const bool copyOnWrite = Matrix::isCopyOnWrite();
+	Matrix::setCopyOnWrite( true );
+	Matrix square( 2, 3 ), alias( 1, 1 );
+	alias = square;
+	square = alias.reshaped( 3, 2 );
+	assert( square.getNumRows() == 3 && square.getNumColumns() == 2 );
+	Matrix::setCopyOnWrite( copyOnWrite );
+
+	// Выборка с повторами и запись строк (повтор - побеждает последняя строка)
+	std::vector< int > indices;
+	indices.push_back( 299 );
+	indices.push_back( 0 );
+	indices.push_back( 150 );
+	indices.push_back( 0 );
+	const Matrix batch = left.selectRows( indices );
+	assert( batch.getNumRows() == 4 );
+	for ( int j = 0; j < 70; j++ )
+	{
+		assert( batch[ 0 ][ j ] == left[ 299 ][ j ] && batch[ 1 ][ j ] == left[ 0 ][ j ] );
+		assert( batch[ 2 ][ j ] == left[ 150 ][ j ] && batch[ 3 ][ j ] == left[ 0 ][ j ] );
+	}
+	Matrix target( 300, 70 );
+	Matrix update( 4, 70 );
+	for ( int k = 0; k < 4; k++ )
+	{
+		for ( int j = 0; j < 70; j++ )
+		{
+			update[ k ][ j ] = k + 1.0;
+		}
+	}
+	target.scatterRows( indices, update );
+	assert( target[ 299 ][ 5 ] == 1.0 && target[ 150 ][ 5 ] == 3.0 && target[ 0 ][ 5 ] == 4.0 );
+	assert( target[ 1 ][ 5 ] == 0.0 );
+
+	try
+	{
+		left.reshape( 7, 7 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+	try
+	{
+		indices.push_back( 300 );
+		left.selectRows( indices );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Out of range" ) );
+		delete _e;
+	}
+	try
+	{
+		rows.push_back( left );
+		vstack( rows );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_incremental_updates )
+{
+	const int n = 120;
+	Matrix A( n, n ), B( n, 90 ), U( n, 3 ), V( 3, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			A[ i ][ j ] = std::sin( i * 1.3 + j * 0.7 ) + ( i == j ? n : 0.0 );
+		}
+		for ( int j = 0; j < 90; j++ )
+		{
+			B[ i ][ j ] = std::cos( i * 0.4 - j * 0.9 );
+		}
+		for ( int k = 0; k < 3; k++ )
+		{
+			U[ i ][ k ] = std::sin( i * 0.2 + k );
+			V[ k ][ i ] = std::cos( i * 0.3 - k );
+		}
+	}
+	std::vector< int > rows;
+	rows.push_back( 7 );
+	rows.push_back( 100 );
+	Matrix values( 2, n );
+	for ( int j = 0; j < n; j++ )
+	{
+		values[ 0 ][ j ] = 0.5 * j / n;
+		values[ 1 ][ j ] = ( j == 100 ? 3.0 * n : 1.0 );
+	}
+
+	// Кэшированное произведение совпадает с пересчитанным после каждого изменения
+	CachedProduct cached( A, B );
+	cached.setLeftRows( rows, values );
+	assert( Matrix::approxEqual( cached.getProduct(), cached.getLeft() * cached.getRight(), 1e-11, 1e-11 ).equal );
+	cached.updateLeft( U, V );
+	assert( Matrix::approxEqual( cached.getProduct(), cached.getLeft() * cached.getRight(), 1e-11, 1e-11 ).equal );
+	Matrix W( 3, 90 );
+	for ( int k = 0; k < 3; k++ )
+	{
+		for ( int j = 0; j < 90; j++ )
+		{
+			W[ k ][ j ] = std::sin( k * 2.1 + j * 0.1 );
+		}
+	}
+	cached.updateRight( U, W );
+	assert( Matrix::approxEqual( cached.getProduct(), cached.getLeft() * cached.getRight(), 1e-11, 1e-11 ).equal );
+
+	// Обратная матрица по формуле Шермана-Моррисона-Вудбери
+	Matrix identity( n, n );
+	for ( int i = 0; i < n; i++ )
+	{
+		identity[ i ][ i ] = 1.0;
+	}
+	UpdatableInverse inverse( A );
+	inverse.update( U, V );
+	inverse.setRows( rows, values );
+	assert( Matrix::approxEqual( inverse.getMatrix() * inverse.getInverse(), identity, 1e-11, 0.0 ).equal );
+	const Matrix solution = inverse.solve( B );
+	assert( Matrix::approxEqual( inverse.getMatrix() * solution, B, 1e-11, 1e-11 ).equal );
+
+	// Разложение Холецкого для S = A^T A и его обновления ранга 1
+	Matrix S( n, n );
+	S.gemm( 1.0, A, A, 0.0, Matrix::Trans );
+	CholeskyFactorization cholesky( S );
+	const Matrix & R = cholesky.getFactor();
+	Matrix product( n, n );
+	product.gemm( 1.0, R, R, 0.0, Matrix::Trans );
+	assert( Matrix::approxEqual( product, S, 1e-8, 1e-12 ).equal );
+
+	Vector x( n );
+	for ( int i = 0; i < n; i++ )
+	{
+		x[ i ] = 10.0 * std::sin( i * 0.5 );
+	}
+	cholesky.update( x );
+	cholesky.update( U );
+	S.ger( 1.0, x, x );
+	S.gemm( 1.0, U, U, 1.0, Matrix::NoTrans, Matrix::Trans );
+	product.gemm( 1.0, R, R, 0.0, Matrix::Trans );
+	assert( Matrix::approxEqual( product, S, 1e-8, 1e-12 ).equal );
+	cholesky.downdate( x );
+	S.ger( -1.0, x, x );
+	assert( Matrix::approxEqual( cholesky.solve( S ), identity, 1e-9, 0.0 ).equal );
+
+	// Понижение ранга, нарушающее положительную определенность
+	const Matrix before( R );
+	try
+	{
+		x[ 0 ] = 1e3 * n;
+		cholesky.downdate( x );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Singular matrix" ) );
+		delete _e;
+	}
+	assert( cholesky.getFactor() == before );
+	try
+	{
+		UpdatableInverse singular( Matrix( 3, 3 ) );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Singular matrix" ) );
+		delete _e;
+	}
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_product_cache )
+{
+	const std::size_t previousCapacity = ProductCache::getCapacity();
+	ProductCache::clear();
+	ProductCache::resetStatistics();
+	// 16 результатов 80 x 80 по 50 КБ в каждом сегменте
+	ProductCache::setCapacity( ProductCache::SHARDS * 16 * 80 * 80 * sizeof( double ) );
+
+	Matrix a( 80, 70 ), b( 70, 80 );
+	for ( int i = 0; i < 80; i++ )
+	{
+		for ( int j = 0; j < 70; j++ )
+		{
+			a[ i ][ j ] = std::sin( i * 0.1 + j * 0.37 );
+			b[ j ][ i ] = std::cos( i * 0.21 - j * 0.05 );
+		}
+	}
+
+	// Хэш зависит от содержимого и размеров
+	const ProductCache::Hash ha = ProductCache::hash( a );
+	assert( ProductCache::hash( Matrix( a ) ).low == ha.low && ProductCache::hash( Matrix( a ) ).high == ha.high );
+	assert( ProductCache::hash( a.reshaped( 70, 80 ) ).low != ha.low );
+
+	const Matrix first = a * b;
+	Matrix second = a * b;
+	ProductCache::Statistics stats = ProductCache::getStatistics();
+	assert( stats.misses == 1 && stats.hits == 1 && stats.entries == 1 );
+	assert( second == first && second.isShared() );
+
+	// Запись в выданный результат не меняет кэш
+	second[ 0 ][ 0 ] += 1.0;
+	assert( ! ( second == first ) );
+	assert( a * b == first );
+
+	// Измененный операнд - другой ключ
+	Matrix c( a );
+	c[ 5 ][ 5 ] += 1e-12;
+	const Matrix third = c * b;
+	assert( ! ( third == first ) );
+	stats = ProductCache::getStatistics();
+	assert( stats.misses == 2 && stats.hits == 2 && stats.entries == 2 );
+
+	// Малые произведения не кэшируются
+	Matrix small( 10, 10 );
+	small = small * small;
+	assert( ProductCache::getStatistics().misses == 2 );
+
+	// Вытеснение при уменьшении объема: общий объем вмещает один результат
+	ProductCache::setCapacity( 80 * 80 * sizeof( double ) + 1024 );
+	stats = ProductCache::getStatistics();
+	assert( stats.entries == 1 && stats.evictions == 1 );
+	ProductCache::setCapacity( 80 * 80 * sizeof( double ) - 1 );
+	stats = ProductCache::getStatistics();
+	assert( stats.entries == 0 && stats.evictions == 2 );
+
+	// Результат больше capacity / SHARDS кэшируется; новый результат 
+	// вытесняет старый из любого сегмента
+	ProductCache::setCapacity( 80 * 80 * sizeof( double ) + 1024 );
+	ProductCache::resetStatistics();
+	const Matrix fourth = a * b, fifth = a * b, sixth = c * b;
+	assert( fifth == first && sixth == third );
+	stats = ProductCache::getStatistics();
+	assert( stats.hits == 1 && stats.misses == 2 && stats.evictions == 1 );
+	assert( stats.entries == 1 && stats.bytes == 80 * 80 * sizeof( double ) );
+
+	ProductCache::setCapacity( previousCapacity );
+	ProductCache::clear();
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_streaming_elementwise )
+{
+	// 300 x 257: границы частей разбиения не совпадают со строками кэша
+	const int rows = 300, cols = 257;
+	Matrix a( rows, cols ), b( rows, cols );
+	for ( int i = 0; i < rows; i++ )
+	{
+		for ( int j = 0; j < cols; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 31 + j * 17 ) % 97 ) / 8.0 + 0.5;
+			b[ i ][ j ] = ( ( i * 13 + j * 7 ) % 89 ) / 4.0 - 11.0;
+		}
+	}
+
+	// Запись в обход кэша (порог 0) и обычная запись дают одинаковый результат
+	const std::size_t previousThreshold = MatrixKernels::streamingThreshold();
+	const std::size_t thresholds[] = { 0, static_cast< std::size_t >( -1 ) };
+	for ( std::size_t threshold : thresholds )
+	{
+		MatrixKernels::setStreamingThreshold( threshold );
+		const Matrix sum = a + b, difference = a - b, scaled = a * 0.75;
+		Matrix accumulated( a ), reduced( a ), multiplied( a );
+		accumulated += b;
+		reduced -= b;
+		multiplied *= 3.0;
+
+		// Знаки элементов и множителя не ограничены (b содержит отрицательные)
+		const Matrix negated = b * -2.0;
+		Matrix halved( b );
+		halved *= -0.5;
+		for ( int i = 0; i < rows; i++ )
+		{
+			for ( int j = 0; j < cols; j++ )
+			{
+				assert( sum[ i ][ j ] == a[ i ][ j ] + b[ i ][ j ] );
+				assert( difference[ i ][ j ] == a[ i ][ j ] - b[ i ][ j ] );
+				assert( scaled[ i ][ j ] == a[ i ][ j ] * 0.75 );
+				assert( accumulated[ i ][ j ] == sum[ i ][ j ] );
+				assert( reduced[ i ][ j ] == difference[ i ][ j ] );
+				assert( multiplied[ i ][ j ] == a[ i ][ j ] * 3.0 );
+				assert( negated[ i ][ j ] == b[ i ][ j ] * -2.0 );
+				assert( halved[ i ][ j ] == b[ i ][ j ] * -0.5 );
+			}
+		}
+
+		// Переполнение в последнем элементе обнаруживается в том же проходе
+		Matrix huge( a );
+		huge[ rows - 1 ][ cols - 1 ] = 1e308;
+		try
+		{
+			huge += huge;
+			assert( ! "Exception must have been thrown" );
+		}
+		catch ( Matrix::Exception * _e )
+		{
+			assert( ! strcmp( _e->msg.c_str(), "Values are out of range" ) );
+			delete _e;
+		}
+		try
+		{
+			Matrix product = b * -1e308;
+			assert( ! "Exception must have been thrown" );
+		}
+		catch ( Matrix::Exception * _e )
+		{
+			assert( ! strcmp( _e->msg.c_str(), "Values are out of range" ) );
+			delete _e;
+		}
+	}
+	MatrixKernels::setStreamingThreshold( previousThreshold );
+}
+
+
+/*****************************************************************************/
+
+
+DECLARE_OOP_TEST( matrix_test_tiling )
+{
+	const int rows = 301, cols = 1500;
+	Matrix a( rows, cols );
+	for ( int i = 0; i < rows; i++ )
+	{
+		for ( int j = 0; j < cols; j++ )
+		{
+			a[ i ][ j ] = ( ( i * 31 + j * 17 ) % 97 ) / 8.0 - 6.0;
+		}
+	}
+
+	// Размеры по умолчанию: строки тайла не длиннее MAX_TILE_COLS, тайл - не
+	// больше DEFAULT_TILE_ELEMENTS; крайние тайлы обрезаются по матрице
+	const ConstTiling automatic( a );
+	assert( automatic.getTileCols() == ConstTiling::MAX_TILE_COLS );
+	assert( automatic.getTileRows() == 32 );
+	assert( automatic.size() == 10 * 2 );
+	assert( automatic[ 19 ].row == 288 && automatic[ 19 ].col == 1024 );
+	assert( automatic[ 19 ].rows == 13 && automatic[ 19 ].cols == 476 );
+	assert( automatic[ 19 ]( 2, 3 ) == a[ 290 ][ 1027 ] );
+
+	// Каждый элемент покрыт ровно одним тайлом
+	Matrix cover( rows, cols );
+	Tiling( cover, 7, 64 ).forEach( [] ( const Tile & t )
+	{
+		for ( int i = 0; i < t.rows; i++ )
+		{
+			for ( int j = 0; j < t.cols; j++ )
+			{
+				t( i, j ) += 1.0;
+			}
+		}
+	} );
+	assert( cover.sum() == static_cast< double >( rows ) * cols );
+	assert( cover.minElement() == 1.0 && cover.maxElement() == 1.0 );
+
+	// Редукция по тайлам (элементы кратны 1/8, суммы точны); итераторы -
+	// для стандартных алгоритмов
+	const double total = automatic.reduce( 0.0, [] ( const ConstTile & t )
+	{
+		double s = 0.0;
+		for ( int i = 0; i < t.rows; i++ )
+		{
+			const double * row = t.rowData( i );
+			s = std::accumulate( row, row + t.cols, s );
+		}
+		return s;
+	}, std::plus< double >() );
+	assert( total == a.sum() );
+	std::size_t elements = 0;
+	std::for_each( automatic.begin(), automatic.end(), [ & ] ( const ConstTile & t ) { elements += t.elementCount(); } );
+	assert( elements == static_cast< std::size_t >( rows ) * cols );
+
+	// Изменяемое разбиение отделяет матрицу от разделяемого буфера
+	const bool cow = Matrix::isCopyOnWrite();
+	Matrix::setCopyOnWrite( true );
+	Matrix copy( a );
+	Tiling( copy ).forEach( [] ( const Tile & t ) { t( 0, 0 ) = 0.0; } );
+	assert( copy[ 32 ][ 1024 ] == 0.0 && a[ 32 ][ 1024 ] != 0.0 );
+
+	// Пока разбиение существует, копии матрицы не разделяют ее буфер
+	{
+		Tiling live( copy );
+		Tiling liveCopy( live );
+		Matrix snapshot( copy ), assigned( 1, 1 );
+		assigned = copy;
+		assert( ! copy.isShared() && ! snapshot.isShared() );
+		liveCopy.forEach( [] ( const Tile & t ) { t( 0, 0 ) = 5.0; } );
+		assert( copy[ 0 ][ 0 ] == 5.0 && snapshot[ 0 ][ 0 ] == 0.0 && assigned[ 0 ][ 0 ] == 0.0 );
+
+		// Присвоение копирует элементы в закрепленный буфер, тайлы остаются действительными
+		copy = a;
+		assert( copy == a && ! a.isShared() );
+		live.forEach( [] ( const Tile & t ) { t( 0, 0 ) = 7.0; } );
+		assert( copy[ 0 ][ 0 ] == 7.0 && a[ 0 ][ 0 ] == -6.0 );
+		copy = std::move( snapshot );
+		live.forEach( [] ( const Tile & t ) { t( 0, 0 ) = 8.0; } );
+		assert( copy[ 0 ][ 0 ] == 8.0 && snapshot[ 0 ][ 0 ] == 0.0 );
+		try
+		{
+			copy = Matrix( 2, 2 );
+			assert( ! "Exception must have been thrown" );
+		}
+		catch ( Matrix::Exception * _e )
+		{
+			assert( ! strcmp( _e->msg.c_str(), "Size mismatch" ) );
+			delete _e;
+		}
+	}
+	Matrix shared( copy );
+	assert( copy.isShared() );
+	Matrix::setCopyOnWrite( cow );
+
+	// Перемещенная (пустая) матрица разбивается без тайлов
+	Matrix moved( std::move( shared ) );
+	assert( Tiling( shared ).size() == 0 && ConstTiling( shared ).size() == 0 );
+
+	try
+	{
+		ConstTiling( a, -1, 8 );
+		assert( ! "Exception must have been thrown" );
+	}
+	catch ( Matrix::Exception * _e )
+	{
+		assert( ! strcmp( _e->msg.c_str(), "Invalid dimensions" ) );
+		delete _e;
+	}
+}
+
+
 /*****************************************************************************/
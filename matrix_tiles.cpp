@@ -0,0 +1,193 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_tiles.hpp"
+
+#include <algorithm>
+
+// =================================================================================
+// Буфер матрицы
+// ---------------------------------------------------------------------------------
+template<>
+double * BasicTiling< Tile >::buffer(Matrix & m)
+{
+	// Записи через тайлы не должны попасть в копии, разделяющие буфер
+	m.detach();
+	return m.data;
+}
+
+template<>
+const double * BasicTiling< ConstTile >::buffer(const Matrix & m)
+{
+	return m.data;
+}
+
+template<>
+Matrix::Buffer * BasicTiling< Tile >::pin(Matrix & m)
+{
+	if (m.buffer != nullptr)
+	{
+		m.buffer->pins.fetch_add(1);
+	}
+	return m.buffer;
+}
+
+template<>
+Matrix::Buffer * BasicTiling< ConstTile >::pin(const Matrix &)
+{
+	return nullptr;
+}
+
+template< typename TileType >
+void BasicTiling< TileType >::unpin()
+{
+	if (this->pinned != nullptr)
+	{
+		this->pinned->pins.fetch_sub(1);
+		this->pinned = nullptr;
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// Разбиение
+// ---------------------------------------------------------------------------------
+template< typename TileType >
+const std::size_t BasicTiling< TileType >::DEFAULT_TILE_ELEMENTS;
+
+template< typename TileType >
+const int BasicTiling< TileType >::MAX_TILE_COLS;
+
+template< typename TileType >
+BasicTiling< TileType >::BasicTiling(MatrixType & m, int _tileRows, int _tileCols)
+	: tileRows(_tileRows), tileCols(_tileCols), pinned(nullptr)
+{
+	if (_tileRows < 0 || _tileCols < 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+
+	// По умолчанию - строки до MAX_TILE_COLS элементов и столько строк,
+	// сколько помещается в DEFAULT_TILE_ELEMENTS (не меньше 1 x 1 для пустой матрицы)
+	const int rows = m.getNumRows();
+	const int cols = m.getNumColumns();
+	if (this->tileCols == 0)
+	{
+		this->tileCols = std::max(1, std::min(cols, MAX_TILE_COLS));
+	}
+	if (this->tileRows == 0)
+	{
+		const std::size_t fit = DEFAULT_TILE_ELEMENTS / this->tileCols;
+		this->tileRows = static_cast< int >(std::max< std::size_t >(1, std::min< std::size_t >(fit, rows)));
+	}
+
+	typename TileType::Element * data = BasicTiling::buffer(m);
+	this->pinned = BasicTiling::pin(m);
+	for (int row = 0; row < rows; row += this->tileRows)
+	{
+		for (int col = 0; col < cols; col += this->tileCols)
+		{
+			TileType tile;
+			tile.row = row;
+			tile.col = col;
+			tile.rows = std::min(this->tileRows, rows - row);
+			tile.cols = std::min(this->tileCols, cols - col);
+			tile.stride = cols;
+			tile.data = data + static_cast< std::size_t >(row) * cols + col;
+			this->tiles.push_back(tile);
+		}
+	}
+}
+
+template< typename TileType >
+BasicTiling< TileType >::BasicTiling(const BasicTiling & _copy)
+	: tiles(_copy.tiles), tileRows(_copy.tileRows), tileCols(_copy.tileCols), pinned(_copy.pinned)
+{
+	if (this->pinned != nullptr)
+	{
+		this->pinned->pins.fetch_add(1);
+	}
+}
+
+template< typename TileType >
+BasicTiling< TileType > & BasicTiling< TileType >::operator = (const BasicTiling & _right)
+{
+	if (this == &_right)
+	{
+		return *this;
+	}
+
+	// Новый буфер закрепляется до освобождения старого: они могут совпадать
+	if (_right.pinned != nullptr)
+	{
+		_right.pinned->pins.fetch_add(1);
+	}
+	this->unpin();
+	this->tiles    = _right.tiles;
+	this->tileRows = _right.tileRows;
+	this->tileCols = _right.tileCols;
+	this->pinned   = _right.pinned;
+	return *this;
+}
+
+template< typename TileType >
+BasicTiling< TileType >::~BasicTiling()
+{
+	this->unpin();
+}
+
+template< typename TileType >
+std::size_t BasicTiling< TileType >::size(void) const
+{
+	return this->tiles.size();
+}
+
+template< typename TileType >
+int BasicTiling< TileType >::getTileRows(void) const
+{
+	return this->tileRows;
+}
+
+template< typename TileType >
+int BasicTiling< TileType >::getTileCols(void) const
+{
+	return this->tileCols;
+}
+
+template< typename TileType >
+const TileType & BasicTiling< TileType >::operator [] (std::size_t index) const
+{
+	if (index >= this->tiles.size())
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return this->tiles[index];
+}
+
+template< typename TileType >
+typename BasicTiling< TileType >::const_iterator BasicTiling< TileType >::begin(void) const
+{
+	return this->tiles.begin();
+}
+
+template< typename TileType >
+typename BasicTiling< TileType >::const_iterator BasicTiling< TileType >::end(void) const
+{
+	return this->tiles.end();
+}
+
+template< typename TileType >
+void BasicTiling< TileType >::forEach(const std::function< void (const TileType &) > & body) const
+{
+	ThreadPool::instance().parallelFor(0, this->tiles.size(), 1, [ & ] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t t = from; t < to; t++)
+		{
+			body(this->tiles[t]);
+		}
+	});
+}
+
+template class BasicTiling< Tile >;
+template class BasicTiling< ConstTile >;
+// =================================================================================
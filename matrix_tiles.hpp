@@ -0,0 +1,166 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_TILES_HPP_
+#define _MATRIX_TILES_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+#include "threadpool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// Разбиение матрицы на прямоугольные тайлы для пользовательских параллельных
+// алгоритмов. Тайл - представление фрагмента буфера без копирования и без
+// проверок индексов: указатель на левый верхний элемент, размеры и шаг между
+// строками. Размер тайла по умолчанию подобран так, чтобы тайл помещался в
+// кэш L2, а его строки были достаточно длинными для векторизации.
+//
+// Тайлы хранятся в векторе, поэтому итераторы разбиения - итераторы
+// произвольного доступа, и разбиение можно передавать стандартным алгоритмам,
+// в том числе параллельным (C++17):
+//
+//     Tiling tiles( m );
+//     std::for_each( std::execution::par, tiles.begin(), tiles.end(),
+//                    [] ( const Tile & t ) { ... } );
+//
+// forEach и reduce выполняют то же на пуле потоков библиотеки. Результат
+// reduce объединяется по порядку тайлов и не зависит от количества потоков.
+//
+// Разбиение изменяемой матрицы получает собственную копию буфера (при
+// copy-on-write) и закрепляет его: пока разбиение (или его копия) существует,
+// копии матрицы получают собственные элементы, и записи через тайлы видны 
+// только в этой матрице. Присвоение матрице копирует элементы в закрепленный
+// буфер (присвоение матрицы другого размера генерирует исключение с текстом
+// "Size mismatch"). Пока разбиение используется, матрицу нельзя удалять - 
+// тайлы ссылаются на ее буфер. Разбиение пустой 
+// (перемещенной) матрицы не содержит тайлов.
+
+/*****************************************************************************/
+
+template< typename T >
+struct BasicTile
+{
+	// Matrix для изменяемых тайлов, const Matrix - для константных
+	typedef typename std::conditional< std::is_const< T >::value, const Matrix, Matrix >::type MatrixType;
+	typedef T Element;
+
+	int row;        // первая строка тайла в матрице
+	int col;        // первый столбец
+	int rows;
+	int cols;
+	int stride;     // шаг между строками тайла (количество столбцов матрицы)
+	T * data;       // элемент (row, col)
+
+	T & operator () (int i, int j) const { return data[ static_cast< std::size_t >(i) * stride + j ]; }
+
+	// Начало строки i тайла (cols элементов подряд)
+	T * rowData(int i) const { return data + static_cast< std::size_t >(i) * stride; }
+
+	std::size_t elementCount() const { return static_cast< std::size_t >(rows) * cols; }
+};
+
+typedef BasicTile< double > Tile;
+typedef BasicTile< const double > ConstTile;
+
+/*****************************************************************************/
+
+// TileType - Tile для изменяемой матрицы и ConstTile для константной
+template< typename TileType >
+class BasicTiling
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	// Элементов в тайле по умолчанию (256 КБ) и наибольшая длина строки тайла
+	static const std::size_t DEFAULT_TILE_ELEMENTS = std::size_t( 1 ) << 15;
+	static const int MAX_TILE_COLS = 1024;
+
+	typedef TileType value_type;
+	typedef typename std::vector< TileType >::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+private:
+	typedef typename TileType::MatrixType MatrixType;
+
+	std::vector< TileType > tiles;
+	int tileRows;
+	int tileCols;
+
+	// Буфер, закрепленный изменяемым разбиением (nullptr для константного)
+	Matrix::Buffer * pinned;
+
+	// Начало буфера матрицы. Для изменяемых тайлов матрица сначала получает
+	// собственную копию буфера.
+	static typename TileType::Element * buffer(MatrixType & m);
+
+	// Закрепляет буфер матрицы, в который будут писать тайлы
+	static Matrix::Buffer * pin(MatrixType & m);
+	void unpin();
+
+public:
+
+	// Разбиение на тайлы tileRows x tileCols (крайние тайлы могут быть меньше).
+	// Нулевой размер выбирается автоматически. Для отрицательных размеров
+	// генерируется исключение с текстом "Invalid dimensions".
+	explicit BasicTiling(MatrixType & m, int _tileRows = 0, int _tileCols = 0);
+
+	BasicTiling(const BasicTiling & _copy);
+	BasicTiling & operator = (const BasicTiling & _right);
+	~BasicTiling();
+
+	std::size_t size(void) const;
+	int getTileRows(void) const;
+	int getTileCols(void) const;
+
+	const TileType & operator [] (std::size_t index) const;
+
+	const_iterator begin(void) const;
+	const_iterator end(void) const;
+
+	// body(tile) для всех тайлов на пуле потоков (по тайлу на часть)
+	void forEach(const std::function< void (const TileType &) > & body) const;
+
+	// combine(...combine(combine(init, map(tile0)), map(tile1))..., map(tileN-1)):
+	// map вычисляется параллельно, объединение - по порядку тайлов
+	template< typename R, typename Map, typename Combine >
+	R reduce(R init, Map map, Combine combine) const;
+};
+
+typedef BasicTiling< Tile > Tiling;
+typedef BasicTiling< ConstTile > ConstTiling;
+
+/*****************************************************************************/
+
+template< typename TileType >
+template< typename R, typename Map, typename Combine >
+R BasicTiling< TileType >::reduce(R init, Map map, Combine combine) const
+{
+	// Обертка исключает std::vector< bool >, элементы которого нельзя
+	// записывать из разных потоков
+	struct Partial
+	{
+		R value;
+	};
+	std::vector< Partial > partial(this->tiles.size(), Partial{ init });
+	ThreadPool::instance().parallelFor(0, this->tiles.size(), 1, [ & ] (std::size_t from, std::size_t to)
+	{
+		for (std::size_t t = from; t < to; t++)
+		{
+			partial[t].value = map(this->tiles[t]);
+		}
+	});
+
+	R result = init;
+	for (std::size_t t = 0; t < partial.size(); t++)
+	{
+		result = combine(result, partial[t].value);
+	}
+	return result;
+}
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_TILES_HPP_
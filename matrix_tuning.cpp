@@ -0,0 +1,328 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "matrix_tuning.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+// Варианты параметров, перебираемые автонастройкой
+const int CANDIDATE_MC[]     = { 32, 64, 96, 128, 192 };
+const int CANDIDATE_KC[]     = { 128, 192, 256, 384, 512 };
+const int CANDIDATE_NC[]     = { 256, 512, 1024, 2048 };
+const int CANDIDATE_UNROLL[] = { 1, 2, 4, 8 };
+
+// Размеры тестового умножения: m не меньше наибольшего MC, n - наибольшего NC / 2
+const int TUNE_M = 192;
+const int TUNE_N = 1024;
+const int TUNE_K = 384;
+
+// Новое значение параметра принимается, если оно быстрее хотя бы на 2%
+const double IMPROVEMENT = 0.98;
+
+// Лучшее из repeats времен умножения m x k на k x n, в секундах
+double timeGemm (
+        const MatrixKernels::GemmConfig & config
+    ,   int m, int n, int k
+    ,   const std::vector< double > & A
+    ,   const std::vector< double > & B
+    ,   std::vector< double > & C
+    ,   int repeats
+)
+{
+    double best = std::numeric_limits< double >::infinity();
+    for ( int r = 0; r < repeats; r++ )
+    {
+        const auto start = std::chrono::steady_clock::now();
+        MatrixKernels::gemmWithConfig( config, false, false, m, n, k, 1.0, A.data(), k, B.data(), n, 0.0, C.data(), n );
+        const std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min( best, elapsed.count() );
+    }
+    return best;
+}
+
+std::vector< double > tuneOperand ( std::size_t count )
+{
+    std::vector< double > result( count );
+    for ( std::size_t i = 0; i < count; i++ )
+    {
+        result[ i ] = static_cast< double >( ( i * 7919 ) % 1009 ) / 1009.0 - 0.5;
+    }
+    return result;
+}
+
+// Покоординатный поиск значения одного параметра при остальных фиксированных
+template< std::size_t N >
+void tuneParameter (
+        MatrixKernels::GemmConfig & best, double & bestTime
+    ,   int MatrixKernels::GemmConfig::* parameter, const int ( & candidates )[ N ]
+    ,   const std::vector< double > & A, const std::vector< double > & B, std::vector< double > & C
+)
+{
+    for ( int value : candidates )
+    {
+        if ( value == best.*parameter )
+        {
+            continue;
+        }
+        MatrixKernels::GemmConfig candidate = best;
+        candidate.*parameter = value;
+        const double time = timeGemm( candidate, TUNE_M, TUNE_N, TUNE_K, A, B, C, 2 );
+        if ( time < bestTime * IMPROVEMENT )
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+}
+
+// Наименьшая работа m * n * k, начиная с которой параллельное умножение
+// квадратных матриц быстрее последовательного
+double tuneParallelWork ( const MatrixKernels::GemmConfig & config )
+{
+    if ( ThreadPool::instance().getNumThreads() < 2 )
+    {
+        return config.parallelWork;
+    }
+    const int multiples[] = { 2, 3, 4, 6, 8, 12 };
+    for ( int multiple : multiples )
+    {
+        const int n = multiple * config.mc;
+        const std::vector< double > A = tuneOperand( static_cast< std::size_t >( n ) * n );
+        std::vector< double > C( A.size() );
+
+        MatrixKernels::GemmConfig serial = config, parallel = config;
+        serial.parallelWork = std::numeric_limits< double >::max();
+        parallel.parallelWork = 0.0;
+        const int repeats = 3;
+        const double serialTime = timeGemm( serial, n, n, n, A, A, C, repeats );
+        const double parallelTime = timeGemm( parallel, n, n, n, A, A, C, repeats );
+        if ( parallelTime < serialTime * 0.9 )
+        {
+            return static_cast< double >( n ) * n * n;
+        }
+    }
+    // Для проверенных размеров параллельное умножение не окупается
+    const double largest = 12.0 * config.mc;
+    return 2.0 * largest * largest * largest;
+}
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Файл кэша
+// ---------------------------------------------------------------------------------
+std::string MatrixTuning::cachePath ()
+{
+    if ( const char * path = std::getenv( "MATRIX_TUNING_CACHE" ) )
+    {
+        return path;
+    }
+    if ( const char * home = std::getenv( "HOME" ) )
+    {
+        return std::string( home ) + "/.matrix_gemm_tuning";
+    }
+    return std::string();
+}
+
+std::string MatrixTuning::cpuKey ()
+{
+    std::string model = "unknown";
+#if defined( __linux__ )
+    std::ifstream cpuinfo( "/proc/cpuinfo" );
+    std::string line;
+    while ( std::getline( cpuinfo, line ) )
+    {
+        if ( line.compare( 0, 10, "model name" ) == 0 )
+        {
+            const std::size_t colon = line.find( ':' );
+            if ( colon != std::string::npos )
+            {
+                model = line.substr( line.find_first_not_of( ' ', colon + 1 ) );
+            }
+            break;
+        }
+    }
+#endif
+    std::replace( model.begin(), model.end(), '\t', ' ' );
+    return model + " x" + std::to_string( ThreadPool::instance().getNumThreads() );
+}
+
+std::string MatrixTuning::formatConfig ( const MatrixKernels::GemmConfig & config )
+{
+    std::ostringstream stream;
+    stream << "mc=" << config.mc << " kc=" << config.kc << " nc=" << config.nc
+           << " unroll=" << config.unroll << " parallel=" << static_cast< long long >( config.parallelWork );
+    return stream.str();
+}
+
+bool MatrixTuning::parseConfig ( const std::string & text, MatrixKernels::GemmConfig & config )
+{
+    std::string normalized( text );
+    std::replace( normalized.begin(), normalized.end(), ',', ' ' );
+    std::istringstream stream( normalized );
+
+    MatrixKernels::GemmConfig parsed = config;
+    std::string token;
+    bool any = false;
+    while ( stream >> token )
+    {
+        const std::size_t equals = token.find( '=' );
+        if ( equals == std::string::npos )
+        {
+            return false;
+        }
+        const std::string name = token.substr( 0, equals );
+        char * end = nullptr;
+        const double value = std::strtod( token.c_str() + equals + 1, & end );
+        if ( end == token.c_str() + equals + 1 || * end != '\0' )
+        {
+            return false;
+        }
+        if      ( name == "mc" )       parsed.mc = static_cast< int >( value );
+        else if ( name == "kc" )       parsed.kc = static_cast< int >( value );
+        else if ( name == "nc" )       parsed.nc = static_cast< int >( value );
+        else if ( name == "unroll" )   parsed.unroll = static_cast< int >( value );
+        else if ( name == "parallel" ) parsed.parallelWork = value;
+        else                           return false;
+        any = true;
+    }
+    if ( ! any || ! MatrixKernels::isValidGemmConfig( parsed ) )
+    {
+        return false;
+    }
+    config = parsed;
+    return true;
+}
+
+bool MatrixTuning::readCache ( const std::string & path, MatrixKernels::GemmConfig & config )
+{
+    std::ifstream file( path );
+    const std::string key = cpuKey();
+    std::string line;
+    while ( std::getline( file, line ) )
+    {
+        const std::size_t tab = line.find( '\t' );
+        if ( tab != std::string::npos && line.compare( 0, tab, key ) == 0 && tab == key.size() )
+        {
+            return parseConfig( line.substr( tab + 1 ), config );
+        }
+    }
+    return false;
+}
+
+// Строка текущего процессора заменяется, строки других процессоров сохраняются.
+// Файл записывается во временный и переименовывается, чтобы параллельно
+// запущенные процессы не прочитали его частично.
+bool MatrixTuning::writeCache ( const std::string & path, const MatrixKernels::GemmConfig & config )
+{
+    const std::string key = cpuKey();
+    std::vector< std::string > lines;
+    {
+        std::ifstream file( path );
+        std::string line;
+        while ( std::getline( file, line ) )
+        {
+            const std::size_t tab = line.find( '\t' );
+            if ( ! ( tab == key.size() && line.compare( 0, tab, key ) == 0 ) )
+            {
+                lines.push_back( line );
+            }
+        }
+    }
+    lines.push_back( key + "\t" + formatConfig( config ) );
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file( temporary, std::ios::trunc );
+        for ( const std::string & line : lines )
+        {
+            file << line << '\n';
+        }
+        if ( ! file )
+        {
+            return false;
+        }
+    }
+    return std::rename( temporary.c_str(), path.c_str() ) == 0;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Автонастройка
+// ---------------------------------------------------------------------------------
+MatrixKernels::GemmConfig MatrixTuning::autotune ()
+{
+    const std::vector< double > A = tuneOperand( static_cast< std::size_t >( TUNE_M ) * TUNE_K );
+    const std::vector< double > B = tuneOperand( static_cast< std::size_t >( TUNE_K ) * TUNE_N );
+    std::vector< double > C( static_cast< std::size_t >( TUNE_M ) * TUNE_N );
+
+    // Блоки подбираются на однопоточном умножении
+    MatrixKernels::GemmConfig best = MatrixKernels::defaultGemmConfig();
+    best.parallelWork = std::numeric_limits< double >::max();
+    timeGemm( best, TUNE_M, TUNE_N, TUNE_K, A, B, C, 1 );
+    double bestTime = timeGemm( best, TUNE_M, TUNE_N, TUNE_K, A, B, C, 2 );
+
+    tuneParameter( best, bestTime, & MatrixKernels::GemmConfig::unroll, CANDIDATE_UNROLL, A, B, C );
+    tuneParameter( best, bestTime, & MatrixKernels::GemmConfig::kc, CANDIDATE_KC, A, B, C );
+    tuneParameter( best, bestTime, & MatrixKernels::GemmConfig::nc, CANDIDATE_NC, A, B, C );
+    tuneParameter( best, bestTime, & MatrixKernels::GemmConfig::mc, CANDIDATE_MC, A, B, C );
+
+    best.parallelWork = MatrixKernels::defaultGemmConfig().parallelWork;
+    best.parallelWork = tuneParallelWork( best );
+
+    MatrixKernels::setGemmConfig( best );
+    return best;
+}
+
+bool MatrixTuning::loadConfig ()
+{
+    MatrixKernels::GemmConfig config = MatrixKernels::defaultGemmConfig();
+
+    // Ручная настройка имеет приоритет над кэшем. Ошибочное значение не 
+    // заменяется кэшем: используются значения по умолчанию.
+    if ( const char * manual = std::getenv( "MATRIX_GEMM_CONFIG" ) )
+    {
+        if ( ! parseConfig( manual, config ) )
+        {
+            std::fprintf( stderr, "MATRIX_GEMM_CONFIG: invalid value \"%s\", using defaults\n", manual );
+            config = MatrixKernels::defaultGemmConfig();
+        }
+        return MatrixKernels::setGemmConfig( config );
+    }
+
+    const std::string path = cachePath();
+    if ( ! path.empty() && readCache( path, config ) )
+    {
+        return MatrixKernels::setGemmConfig( config );
+    }
+
+    const char * tune = std::getenv( "MATRIX_AUTOTUNE" );
+    if ( tune != nullptr && std::atoi( tune ) > 0 )
+    {
+        config = autotune();
+        if ( ! path.empty() )
+        {
+            writeCache( path, config );
+        }
+        return true;
+    }
+    return false;
+}
+// =================================================================================
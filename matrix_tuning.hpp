@@ -0,0 +1,62 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _MATRIX_TUNING_HPP_
+#define _MATRIX_TUNING_HPP_
+
+/*****************************************************************************/
+
+#include "matrix_kernels.hpp"
+
+#include <string>
+
+/*****************************************************************************/
+
+// Автонастройка блочного GEMM под процессор. Подбираются размеры блоков
+// MC, KC, NC, вариант микроядра (количество строк B за проход) и порог
+// перехода к параллельному умножению. Результат сохраняется в файл кэша,
+// по строке на процессор: ключ - модель процессора и количество потоков,
+// поэтому один файл можно разделять между машинами разных поколений.
+//
+// При первом умножении конфигурация загружается в следующем порядке:
+//   MATRIX_GEMM_CONFIG  = "mc=64 kc=256 nc=512 unroll=4 parallel=2097152" -
+//                         ручная настройка, кэш не читается (при ошибке 
+//                         разбора - сообщение в stderr и значения по умолчанию);
+//   строка кэша для текущего процессора;
+//   при MATRIX_AUTOTUNE=1 - автонастройка с сохранением результата в кэш;
+//   иначе - значения по умолчанию.
+// Путь к кэшу задается переменной MATRIX_TUNING_CACHE, по умолчанию
+// $HOME/.matrix_gemm_tuning.
+namespace MatrixTuning
+{
+
+// Путь к файлу кэша (пустая строка, если он не определен)
+std::string cachePath ();
+
+// Ключ текущего процессора в кэше
+std::string cpuKey ();
+
+// Текстовое представление "mc=.. kc=.. nc=.. unroll=.. parallel=.." и разбор.
+// Пропущенные в строке параметры сохраняют значения из config.
+// Возвращает false, если строка не разобрана или параметры недопустимы.
+std::string formatConfig ( const MatrixKernels::GemmConfig & config );
+bool parseConfig ( const std::string & text, MatrixKernels::GemmConfig & config );
+
+// Чтение и запись строки кэша для текущего процессора
+bool readCache ( const std::string & path, MatrixKernels::GemmConfig & config );
+bool writeCache ( const std::string & path, const MatrixKernels::GemmConfig & config );
+
+// Поиск конфигурации на текущем процессоре (покоординатный спуск по
+// параметрам блоков и замер порога параллельности). Занимает порядка секунды.
+// Найденная конфигурация устанавливается текущей и возвращается.
+MatrixKernels::GemmConfig autotune ();
+
+// Загрузка конфигурации при запуске (см. порядок выше). Вызывается один раз
+// из MatrixKernels::gemmConfig(), если конфигурация не была установлена явно.
+// Возвращает true, если конфигурация изменена.
+bool loadConfig ();
+
+} // namespace MatrixTuning
+
+/*****************************************************************************/
+
+#endif //  _MATRIX_TUNING_HPP_
@@ -0,0 +1,534 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "structured.hpp"
+#include "matrix_kernels.hpp"
+
+#include <algorithm>
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+// Переполнение в структурированных ядрах, как и в операторах Matrix,
+// обнаруживается по inf/NaN в результате
+static void checkFinite ( std::size_t count, const double * data )
+{
+	if ( ! MatrixKernels::allFinite(count, data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+}
+
+static void checkSquare ( const Matrix & _matrix )
+{
+	if ( _matrix.getNumRows() != _matrix.getNumColumns() )
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+}
+// =================================================================================
+
+
+// =================================================================================
+// DiagonalMatrix
+// ---------------------------------------------------------------------------------
+DiagonalMatrix::DiagonalMatrix(int size)
+	: diagonal(size)
+{
+}
+
+DiagonalMatrix::DiagonalMatrix(const Vector & _diagonal)
+	: diagonal(_diagonal)
+{
+}
+
+DiagonalMatrix::DiagonalMatrix(const Matrix & _matrix)
+	: diagonal(_matrix.getNumRows())
+{
+	checkSquare(_matrix);
+	const int n = _matrix.getNumRows();
+	double * d = this->diagonal.getData();
+	for (int i = 0; i < n; i++)
+	{
+		d[i] = _matrix.data[static_cast< std::size_t >(i) * n + i];
+	}
+}
+
+int DiagonalMatrix::getSize(void) const
+{
+	return this->diagonal.getSize();
+}
+
+const Vector & DiagonalMatrix::getDiagonal(void) const
+{
+	return this->diagonal;
+}
+
+double DiagonalMatrix::operator[] (int _index) const
+{
+	return this->diagonal[_index];
+}
+
+double & DiagonalMatrix::operator[] (int _index)
+{
+	return this->diagonal[_index];
+}
+
+Matrix DiagonalMatrix::toMatrix() const
+{
+	const int n = this->getSize();
+	Matrix result(n, n);
+	const double * d = this->diagonal.getData();
+	for (int i = 0; i < n; i++)
+	{
+		result.data[static_cast< std::size_t >(i) * n + i] = d[i];
+	}
+	return result;
+}
+
+Matrix DiagonalMatrix::solve(const Matrix & _right) const
+{
+	const int n = this->getSize();
+	if (_right.getNumRows() != n)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector inverse(n);
+	const double * d = this->diagonal.getData();
+	for (int i = 0; i < n; i++)
+	{
+		if (d[i] == 0.0)
+		{
+			throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+		}
+		inverse.getData()[i] = 1.0 / d[i];
+	}
+	Matrix result(n, _right.cols, Matrix::uninitialized);
+	MatrixKernels::diagonalScale(true, n, _right.cols, inverse.getData(),
+	                             _right.data, _right.cols, result.data, result.cols);
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+// Масштабирование строк (left) или столбцов плотной матрицы
+Matrix DiagonalMatrix::scale(bool _left, const DiagonalMatrix & d, const Matrix & m)
+{
+	if (d.getSize() != (_left ? m.getNumRows() : m.getNumColumns()))
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(m.rows, m.cols, Matrix::uninitialized);
+	MatrixKernels::diagonalScale(_left, m.rows, m.cols, d.diagonal.getData(),
+	                             m.data, m.cols, result.data, result.cols);
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+const Matrix operator * (const DiagonalMatrix & d, const Matrix & m)
+{
+	return DiagonalMatrix::scale(true, d, m);
+}
+
+const Matrix operator * (const Matrix & m, const DiagonalMatrix & d)
+{
+	return DiagonalMatrix::scale(false, d, m);
+}
+
+const Vector operator * (const DiagonalMatrix & d, const Vector & v)
+{
+	if (d.getSize() != v.getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector result(v.getSize());
+	MatrixKernels::diagonalScale(false, 1, v.getSize(), d.diagonal.getData(),
+	                             v.getData(), v.getSize(), result.getData(), v.getSize());
+	checkFinite(result.getSize(), result.getData());
+	return result;
+}
+
+const DiagonalMatrix operator * (const DiagonalMatrix & left, const DiagonalMatrix & right)
+{
+	if (left.getSize() != right.getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	DiagonalMatrix result(left.getSize());
+	MatrixKernels::diagonalScale(false, 1, left.getSize(), right.diagonal.getData(),
+	                             left.diagonal.getData(), left.getSize(),
+	                             result.diagonal.getData(), left.getSize());
+	checkFinite(result.getSize(), result.diagonal.getData());
+	return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// TriangularMatrix
+// ---------------------------------------------------------------------------------
+TriangularMatrix::TriangularMatrix(const Matrix & _matrix, Part _part, bool _unitDiagonal)
+	: storage(_matrix), part(_part), unitDiagonal(_unitDiagonal)
+{
+	checkSquare(_matrix);
+	this->storage.detach();
+	const int n = this->storage.rows;
+	for (int i = 0; i < n; i++)
+	{
+		double * row = this->storage.data + static_cast< std::size_t >(i) * n;
+		if (_part == Upper)
+		{
+			std::fill(row, row + i, 0.0);
+		}
+		else
+		{
+			std::fill(row + i + 1, row + n, 0.0);
+		}
+		if (_unitDiagonal)
+		{
+			row[i] = 1.0;
+		}
+	}
+}
+
+int TriangularMatrix::getSize(void) const
+{
+	return this->storage.rows;
+}
+
+TriangularMatrix::Part TriangularMatrix::getPart(void) const
+{
+	return this->part;
+}
+
+bool TriangularMatrix::isUnitDiagonal(void) const
+{
+	return this->unitDiagonal;
+}
+
+double TriangularMatrix::operator() (int _row, int _col) const
+{
+	return this->storage[_row][_col];
+}
+
+Matrix TriangularMatrix::toMatrix() const
+{
+	return this->storage;
+}
+
+Matrix TriangularMatrix::solve(const Matrix & _right) const
+{
+	if (_right.getNumRows() != this->getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(_right.rows, _right.cols, Matrix::uninitialized);
+	MatrixMemory::copy(result.buffer->region, _right.data, _right.elementCount());
+	if ( ! MatrixKernels::trsm(true, this->part == Upper, this->unitDiagonal, result.rows, result.cols,
+	                           this->storage.data, this->storage.cols, result.data, result.cols) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+Matrix TriangularMatrix::solveRight(const Matrix & _left) const
+{
+	if (_left.getNumColumns() != this->getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(_left.rows, _left.cols, Matrix::uninitialized);
+	MatrixMemory::copy(result.buffer->region, _left.data, _left.elementCount());
+	if ( ! MatrixKernels::trsm(false, this->part == Upper, this->unitDiagonal, result.rows, result.cols,
+	                           this->storage.data, this->storage.cols, result.data, result.cols) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+Vector TriangularMatrix::solve(const Vector & _right) const
+{
+	if (_right.getSize() != this->getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector result(_right);
+	if ( ! MatrixKernels::trsm(true, this->part == Upper, this->unitDiagonal, result.getSize(), 1,
+	                           this->storage.data, this->storage.cols, result.getData(), 1) )
+	{
+		throw new Matrix::SingularMatrixException(__func__, __LINE__, __FILE__);
+	}
+	checkFinite(result.getSize(), result.getData());
+	return result;
+}
+
+// TRMM с треугольным сомножителем слева (left) или справа
+Matrix TriangularMatrix::multiply(bool _left, const TriangularMatrix & t, const Matrix & m)
+{
+	if (t.getSize() != (_left ? m.getNumRows() : m.getNumColumns()))
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Matrix result(m.rows, m.cols, Matrix::uninitialized);
+	MatrixMemory::copy(result.buffer->region, m.data, m.elementCount());
+	MatrixKernels::trmm(_left, t.part == Upper, t.unitDiagonal, result.rows, result.cols,
+	                    t.storage.data, t.storage.cols, result.data, result.cols);
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+const Matrix operator * (const TriangularMatrix & t, const Matrix & m)
+{
+	return TriangularMatrix::multiply(true, t, m);
+}
+
+const Matrix operator * (const Matrix & m, const TriangularMatrix & t)
+{
+	return TriangularMatrix::multiply(false, t, m);
+}
+
+Vector TriangularMatrix::multiply(const TriangularMatrix & t, const Vector & v)
+{
+	if (t.getSize() != v.getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector result(v);
+	MatrixKernels::trmm(true, t.part == Upper, t.unitDiagonal, result.getSize(), 1,
+	                    t.storage.data, t.storage.cols, result.getData(), 1);
+	checkFinite(result.getSize(), result.getData());
+	return result;
+}
+
+const Vector operator * (const TriangularMatrix & t, const Vector & v)
+{
+	return TriangularMatrix::multiply(t, v);
+}
+// =================================================================================
+
+
+// =================================================================================
+// SymmetricMatrix
+// ---------------------------------------------------------------------------------
+SymmetricMatrix::SymmetricMatrix(Matrix && _storage)
+	: storage(std::move(_storage))
+{
+}
+
+SymmetricMatrix::SymmetricMatrix(int size)
+	: storage(size, size)
+{
+}
+
+SymmetricMatrix::SymmetricMatrix(const Matrix & _matrix, TriangularMatrix::Part _source)
+	: storage(_matrix)
+{
+	checkSquare(_matrix);
+	this->storage.detach();
+	const int n = this->storage.rows;
+	double * data = this->storage.data;
+	for (int i = 1; i < n; i++)
+	{
+		for (int j = 0; j < i; j++)
+		{
+			const std::size_t lowerIndex = static_cast< std::size_t >(i) * n + j;
+			const std::size_t upperIndex = static_cast< std::size_t >(j) * n + i;
+			if (_source == TriangularMatrix::Upper)
+			{
+				data[lowerIndex] = data[upperIndex];
+			}
+			else
+			{
+				data[upperIndex] = data[lowerIndex];
+			}
+		}
+	}
+}
+
+SymmetricMatrix SymmetricMatrix::syrk(const Matrix & _a, Matrix::TransposeFlag _trans, double _alpha)
+{
+	const bool trans = (_trans == Matrix::Trans);
+	const int n = trans ? _a.cols : _a.rows;
+	const int k = trans ? _a.rows : _a.cols;
+	Matrix result(n, n, Matrix::uninitialized);
+	MatrixKernels::syrk(trans, n, k, _alpha, _a.data, _a.cols, 0.0, result.data, result.cols);
+	checkFinite(result.elementCount(), result.data);
+	return SymmetricMatrix(std::move(result));
+}
+
+int SymmetricMatrix::getSize(void) const
+{
+	return this->storage.rows;
+}
+
+double SymmetricMatrix::operator() (int _row, int _col) const
+{
+	return this->storage[_row][_col];
+}
+
+void SymmetricMatrix::set(int _row, int _col, double _value)
+{
+	this->storage[_row][_col] = _value;
+	this->storage[_col][_row] = _value;
+}
+
+Matrix SymmetricMatrix::toMatrix() const
+{
+	return this->storage;
+}
+
+const Matrix operator * (const SymmetricMatrix & s, const Matrix & m)
+{
+	return s.storage * m;
+}
+
+const Matrix operator * (const Matrix & m, const SymmetricMatrix & s)
+{
+	return m * s.storage;
+}
+
+const Vector operator * (const SymmetricMatrix & s, const Vector & v)
+{
+	return s.storage * v;
+}
+// =================================================================================
+
+
+// =================================================================================
+// BandedMatrix
+// ---------------------------------------------------------------------------------
+int BandedMatrix::bandWidth(void) const
+{
+	return this->lower + this->upper + 1;
+}
+
+bool BandedMatrix::isInBand(int _row, int _col) const
+{
+	return _col - _row <= this->upper && _row - _col <= this->lower;
+}
+
+BandedMatrix::BandedMatrix(int _rows, int _cols, int _lower, int _upper)
+	: rows(_rows), cols(_cols), lower(_lower), upper(_upper)
+{
+	if (_rows <= 0 || _cols <= 0 || _lower < 0 || _upper < 0)
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	this->band.assign(static_cast< std::size_t >(_rows) * this->bandWidth(), 0.0);
+}
+
+BandedMatrix::BandedMatrix(const Matrix & _matrix, int _lower, int _upper)
+	: BandedMatrix(_matrix.getNumRows(), _matrix.getNumColumns(), _lower, _upper)
+{
+	for (int i = 0; i < this->rows; i++)
+	{
+		const int jBegin = std::max(0, i - this->lower);
+		const int jEnd = std::min(this->cols, i + this->upper + 1);
+		const double * source = _matrix.data + static_cast< std::size_t >(i) * this->cols;
+		double * target = this->band.data() + static_cast< std::size_t >(i) * this->bandWidth() + this->lower - i;
+		std::copy(source + jBegin, source + jEnd, target + jBegin);
+	}
+}
+
+int BandedMatrix::getNumRows(void) const
+{
+	return this->rows;
+}
+
+int BandedMatrix::getNumColumns(void) const
+{
+	return this->cols;
+}
+
+int BandedMatrix::getLowerBandwidth(void) const
+{
+	return this->lower;
+}
+
+int BandedMatrix::getUpperBandwidth(void) const
+{
+	return this->upper;
+}
+
+double BandedMatrix::operator() (int _row, int _col) const
+{
+	if (_row < 0 || _row >= this->rows || _col < 0 || _col >= this->cols)
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	if ( ! this->isInBand(_row, _col) )
+	{
+		return 0.0;
+	}
+	return this->band[static_cast< std::size_t >(_row) * this->bandWidth() + (_col - _row + this->lower)];
+}
+
+void BandedMatrix::set(int _row, int _col, double _value)
+{
+	if (_row < 0 || _row >= this->rows || _col < 0 || _col >= this->cols || ! this->isInBand(_row, _col))
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	this->band[static_cast< std::size_t >(_row) * this->bandWidth() + (_col - _row + this->lower)] = _value;
+}
+
+Matrix BandedMatrix::toMatrix() const
+{
+	Matrix result(this->rows, this->cols);
+	for (int i = 0; i < this->rows; i++)
+	{
+		const int jBegin = std::max(0, i - this->lower);
+		const int jEnd = std::min(this->cols, i + this->upper + 1);
+		const double * source = this->band.data() + static_cast< std::size_t >(i) * this->bandWidth() + this->lower - i;
+		std::copy(source + jBegin, source + jEnd, result.data + static_cast< std::size_t >(i) * this->cols + jBegin);
+	}
+	return result;
+}
+
+// Произведение с ленточным сомножителем слева (left) или справа
+Matrix BandedMatrix::multiply(bool _left, const BandedMatrix & b, const Matrix & m)
+{
+	if (_left ? b.cols != m.getNumRows() : m.getNumColumns() != b.rows)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	if (_left)
+	{
+		Matrix result(b.rows, m.cols, Matrix::uninitialized);
+		MatrixKernels::gbmm(b.rows, m.cols, b.cols, b.lower, b.upper, b.band.data(), b.bandWidth(),
+		                    m.data, m.cols, result.data, result.cols);
+		checkFinite(result.elementCount(), result.data);
+		return result;
+	}
+	Matrix result(m.rows, b.cols, Matrix::uninitialized);
+	MatrixKernels::gbmmRight(m.rows, b.cols, b.rows, b.lower, b.upper, m.data, m.cols,
+	                         b.band.data(), b.bandWidth(), result.data, result.cols);
+	checkFinite(result.elementCount(), result.data);
+	return result;
+}
+
+const Matrix operator * (const BandedMatrix & b, const Matrix & m)
+{
+	return BandedMatrix::multiply(true, b, m);
+}
+
+const Matrix operator * (const Matrix & m, const BandedMatrix & b)
+{
+	return BandedMatrix::multiply(false, b, m);
+}
+
+const Vector operator * (const BandedMatrix & b, const Vector & v)
+{
+	if (b.cols != v.getSize())
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	Vector result(b.rows);
+	MatrixKernels::gbmm(b.rows, 1, b.cols, b.lower, b.upper, b.band.data(), b.bandWidth(),
+	                    v.getData(), 1, result.getData(), 1);
+	checkFinite(result.getSize(), result.getData());
+	return result;
+}
+// =================================================================================
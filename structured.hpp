@@ -0,0 +1,211 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _STRUCTURED_HPP_
+#define _STRUCTURED_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+#include "vector.hpp"
+
+#include <vector>
+
+// Матрицы специальной структуры. Каждый тип хранит только значимые элементы
+// (или помнит, какие из них значимы) и умножается на плотные Matrix и Vector
+// специализированными ядрами вместо общего GEMM. Нарушение согласования
+// размеров приводит к исключению с текстом "Size mismatch", как и для Matrix.
+
+/*****************************************************************************/
+
+// Диагональная матрица n x n, хранящая только диагональ.
+// Умножение на плотную матрицу - масштабирование строк или столбцов за O(n^2).
+class DiagonalMatrix
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	Vector diagonal;
+
+	// Масштабирование строк (left) или столбцов плотной матрицы
+	static Matrix scale(bool _left, const DiagonalMatrix & d, const Matrix & m);
+
+public:
+
+	// Нулевая диагональная матрица заданного порядка
+	explicit DiagonalMatrix(int size);
+
+	// Диагональная матрица с заданной диагональю
+	explicit DiagonalMatrix(const Vector & _diagonal);
+
+	// Диагональ квадратной матрицы; недиагональные элементы игнорируются.
+	// Для неквадратной матрицы генерируется исключение с текстом "Size mismatch".
+	explicit DiagonalMatrix(const Matrix & _matrix);
+
+	int getSize(void) const;
+
+	const Vector & getDiagonal(void) const;
+
+	// Доступ к i-му диагональному элементу
+	double operator[] (int _index) const;
+	double & operator[] (int _index);
+
+	Matrix toMatrix() const;
+
+	// Решение D * X = B. При нулевом элементе диагонали генерируется
+	// исключение с текстом "Singular matrix".
+	Matrix solve(const Matrix & _right) const;
+
+	friend const Matrix operator * (const DiagonalMatrix & d, const Matrix & m);
+	friend const Matrix operator * (const Matrix & m, const DiagonalMatrix & d);
+	friend const Vector operator * (const DiagonalMatrix & d, const Vector & v);
+	friend const DiagonalMatrix operator * (const DiagonalMatrix & left, const DiagonalMatrix & right);
+};
+
+/*****************************************************************************/
+
+// Верхне- или нижнетреугольная матрица n x n. Хранится в плотном виде,
+// элементы вне треугольника равны нулю. Умножение (TRMM) выполняет вдвое
+// меньше операций, чем GEMM, а решение систем (TRSM) - подстановкой.
+class TriangularMatrix
+{
+
+/*-----------------------------------------------------------------*/
+public:
+	enum Part { Upper, Lower };
+
+private:
+	Matrix storage;
+	Part part;
+	bool unitDiagonal;
+
+	// TRMM с треугольным сомножителем слева (left) или справа
+	static Matrix multiply(bool _left, const TriangularMatrix & t, const Matrix & m);
+	static Vector multiply(const TriangularMatrix & t, const Vector & v);
+
+public:
+
+	// Треугольник part квадратной матрицы; остальные элементы обнуляются.
+	// При unitDiagonal == true диагональ считается единичной независимо от
+	// значений в исходной матрице. Для неквадратной матрицы генерируется
+	// исключение с текстом "Size mismatch".
+	TriangularMatrix(const Matrix & _matrix, Part _part, bool _unitDiagonal = false);
+
+	int getSize(void) const;
+
+	Part getPart(void) const;
+
+	bool isUnitDiagonal(void) const;
+
+	// Элемент (row, col) с учетом структуры. При некорректных индексах
+	// генерируется исключение с текстом "Out of range".
+	double operator() (int _row, int _col) const;
+
+	Matrix toMatrix() const;
+
+	// Решение T * X = B и X * T = B. При нулевом элементе диагонали
+	// генерируется исключение с текстом "Singular matrix".
+	Matrix solve(const Matrix & _right) const;
+	Matrix solveRight(const Matrix & _left) const;
+	Vector solve(const Vector & _right) const;
+
+	friend const Matrix operator * (const TriangularMatrix & t, const Matrix & m);
+	friend const Matrix operator * (const Matrix & m, const TriangularMatrix & t);
+	friend const Vector operator * (const TriangularMatrix & t, const Vector & v);
+};
+
+/*****************************************************************************/
+
+// Симметричная матрица n x n. Хранится полностью (оба треугольника
+// согласованы), поэтому SYMM сводится к GEMM без транспонирования;
+// выигрыш дает построение через SYRK, вычисляющий только половину элементов.
+class SymmetricMatrix
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	Matrix storage;
+
+	explicit SymmetricMatrix(Matrix && _storage);
+
+public:
+
+	// Нулевая симметричная матрица заданного порядка
+	explicit SymmetricMatrix(int size);
+
+	// Симметричная матрица, построенная по треугольнику source квадратной матрицы.
+	// Для неквадратной матрицы генерируется исключение с текстом "Size mismatch".
+	explicit SymmetricMatrix(const Matrix & _matrix,
+	                         TriangularMatrix::Part _source = TriangularMatrix::Upper);
+
+	// SYRK: alpha * A * A^T (NoTrans) или alpha * A^T * A (Trans)
+	static SymmetricMatrix syrk(const Matrix & _a,
+	                            Matrix::TransposeFlag _trans = Matrix::NoTrans,
+	                            double _alpha = 1.0);
+
+	int getSize(void) const;
+
+	double operator() (int _row, int _col) const;
+
+	// Запись элемента сохраняет симметрию: меняются (row, col) и (col, row)
+	void set(int _row, int _col, double _value);
+
+	Matrix toMatrix() const;
+
+	friend const Matrix operator * (const SymmetricMatrix & s, const Matrix & m);
+	friend const Matrix operator * (const Matrix & m, const SymmetricMatrix & s);
+	friend const Vector operator * (const SymmetricMatrix & s, const Vector & v);
+};
+
+/*****************************************************************************/
+
+// Ленточная матрица rows x cols с lower поддиагоналями и upper наддиагоналями.
+// Хранятся только элементы ленты: строка i содержит элементы столбцов
+// [i - lower, i + upper]. Умножение выполняется за O((lower + upper + 1) * n)
+// операций на строку результата.
+class BandedMatrix
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	int rows, cols;
+	int lower, upper;
+	std::vector< double > band;
+
+	int bandWidth(void) const;
+
+	bool isInBand(int _row, int _col) const;
+
+	// Произведение с ленточным сомножителем слева (left) или справа
+	static Matrix multiply(bool _left, const BandedMatrix & b, const Matrix & m);
+
+public:
+
+	// Нулевая ленточная матрица. При неположительных размерах или отрицательной
+	// ширине ленты генерируется исключение с текстом "Invalid dimensions".
+	BandedMatrix(int _rows, int _cols, int _lower, int _upper);
+
+	// Лента плотной матрицы; элементы вне ленты игнорируются
+	BandedMatrix(const Matrix & _matrix, int _lower, int _upper);
+
+	int getNumRows(void) const;
+	int getNumColumns(void) const;
+	int getLowerBandwidth(void) const;
+	int getUpperBandwidth(void) const;
+
+	// Элемент (row, col); вне ленты равен нулю. При индексах вне матрицы
+	// генерируется исключение с текстом "Out of range".
+	double operator() (int _row, int _col) const;
+
+	// Запись элемента. При попытке записи вне ленты генерируется
+	// исключение с текстом "Out of range".
+	void set(int _row, int _col, double _value);
+
+	Matrix toMatrix() const;
+
+	friend const Matrix operator * (const BandedMatrix & b, const Matrix & m);
+	friend const Matrix operator * (const Matrix & m, const BandedMatrix & b);
+	friend const Vector operator * (const BandedMatrix & b, const Vector & v);
+};
+
+/*****************************************************************************/
+
+#endif //  _STRUCTURED_HPP_
@@ -0,0 +1,460 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+namespace
+{
+
+thread_local bool gs_isWorkerThread = false;
+
+// Количество потоков по умолчанию с учетом переменной окружения MATRIX_NUM_THREADS
+int defaultNumThreads ()
+{
+    const char * env = std::getenv( "MATRIX_NUM_THREADS" );
+    if ( env != nullptr && std::atoi( env ) > 0 )
+    {
+        return std::atoi( env );
+    }
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? static_cast< int >( hw ) : 1;
+}
+
+// Список логических процессоров, упорядоченный по NUMA-узлам 
+// (из /sys/devices/system/node/nodeN/cpulist). Если топология недоступна,
+// процессоры перечисляются подряд.
+std::vector< int > cpusInNodeOrder ()
+{
+    std::vector< int > cpus;
+#if defined( __linux__ )
+    for ( int node = 0; ; node++ )
+    {
+        std::ifstream cpulist( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" );
+        if ( ! cpulist )
+        {
+            break;
+        }
+        // Формат: "0-3,8-11"
+        std::string range;
+        while ( std::getline( cpulist, range, ',' ) )
+        {
+            int first = 0, last = 0;
+            char dash = 0;
+            std::istringstream parser( range );
+            parser >> first;
+            if ( parser >> dash >> last )
+            {
+                for ( int cpu = first; cpu <= last; cpu++ )
+                {
+                    cpus.push_back( cpu );
+                }
+            }
+            else if ( ! range.empty() && range != "\n" )
+            {
+                cpus.push_back( first );
+            }
+        }
+    }
+#endif
+    if ( cpus.empty() )
+    {
+        const int hw = std::max( 1u, std::thread::hardware_concurrency() );
+        for ( int cpu = 0; cpu < hw; cpu++ )
+        {
+            cpus.push_back( cpu );
+        }
+    }
+    return cpus;
+}
+
+// Счетчик выполненных частей для вызовов, ожидающих завершения
+struct CompletionLatch
+{
+    std::size_t remaining;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    void countDown ( std::exception_ptr _error )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        if ( _error && ! error )
+        {
+            error = _error;
+        }
+        if ( -- remaining == 0 )
+        {
+            finished.notify_all();
+        }
+    }
+
+    void wait ()
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        finished.wait( lock, [ this ] { return remaining == 0; } );
+    }
+};
+
+// Общее состояние одного вызова parallelFor
+struct ParallelForState
+{
+    std::size_t begin, end, chunkSize, numChunks;
+    ThreadPool::RangeBody const * body;
+    std::atomic< std::size_t > nextChunk;
+    std::atomic< std::size_t > doneChunks;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    // Забирает и выполняет части, пока они не закончатся
+    void run ()
+    {
+        std::size_t chunk;
+        while ( ( chunk = nextChunk.fetch_add( 1 ) ) < numChunks )
+        {
+            const std::size_t from = begin + chunk * chunkSize;
+            const std::size_t to   = std::min( end, from + chunkSize );
+            try
+            {
+                ( * body )( from, to );
+            }
+            catch ( ... )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                if ( ! error )
+                {
+                    error = std::current_exception();
+                }
+            }
+            if ( doneChunks.fetch_add( 1 ) + 1 == numChunks )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+// =================================================================================
+
+
+// =================================================================================
+// Создание и остановка пула
+// ---------------------------------------------------------------------------------
+ThreadPool & ThreadPool::instance ()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool ()
+    :   m_stopping( false )
+    ,   m_pinned( false )
+{
+    const char * pin = std::getenv( "MATRIX_PIN_THREADS" );
+    m_pinned = ( pin != nullptr && std::atoi( pin ) > 0 );
+    startWorkers( defaultNumThreads() - 1 );
+}
+
+ThreadPool::~ThreadPool ()
+{
+    stopWorkers();
+}
+
+void ThreadPool::startWorkers ( int _numWorkers )
+{
+    m_stopping = false;
+    m_workerTasks.assign( _numWorkers, std::deque< std::function< void () > >() );
+    for ( int i = 0; i < _numWorkers; i++ )
+    {
+        m_workers.push_back( std::thread( & ThreadPool::workerLoop, this, i ) );
+    }
+}
+
+// Дожидается выполнения уже поставленных задач и завершает рабочие потоки
+void ThreadPool::stopWorkers ()
+{
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for ( std::size_t i = 0; i < m_workers.size(); i++ )
+    {
+        m_workers[ i ].join();
+    }
+    m_workers.clear();
+}
+
+void ThreadPool::workerLoop ( int _workerIndex )
+{
+    gs_isWorkerThread = true;
+    if ( m_pinned )
+    {
+        // Слот 0 остается вызывающему потоку
+        pinCurrentThread( _workerIndex + 1 );
+    }
+
+    std::deque< std::function< void () > > & ownTasks = m_workerTasks[ _workerIndex ];
+    for ( ;; )
+    {
+        std::function< void () > task;
+        {
+            std::unique_lock< std::mutex > lock( m_mutex );
+            m_condition.wait( lock, [ & ] { return m_stopping || ! ownTasks.empty() || ! m_tasks.empty(); } );
+
+            // Собственная очередь (статическое разбиение) имеет приоритет
+            std::deque< std::function< void () > > & queue = ownTasks.empty() ? m_tasks : ownTasks;
+            if ( queue.empty() )
+            {
+                return;
+            }
+            task = std::move( queue.front() );
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::pinCurrentThread ( int _slot )
+{
+#if defined( __linux__ )
+    static const std::vector< int > cpus = cpusInNodeOrder();
+    cpu_set_t set;
+    CPU_ZERO( & set );
+    CPU_SET( cpus[ _slot % cpus.size() ], & set );
+    pthread_setaffinity_np( pthread_self(), sizeof( set ), & set );
+#else
+    ( void ) _slot;
+#endif
+}
+
+void ThreadPool::setThreadAffinity ( bool _pinned )
+{
+    if ( _pinned == m_pinned )
+    {
+        return;
+    }
+    const int numThreads = getNumThreads();
+    stopWorkers();
+    m_pinned = _pinned;
+    startWorkers( numThreads - 1 );
+}
+
+bool ThreadPool::isThreadAffinityEnabled () const
+{
+    return m_pinned;
+}
+
+int ThreadPool::getNumThreads () const
+{
+    return static_cast< int >( m_workers.size() ) + 1;
+}
+
+void ThreadPool::setNumThreads ( int _numThreads )
+{
+    stopWorkers();
+    startWorkers( std::max( _numThreads, 1 ) - 1 );
+}
+
+bool ThreadPool::isWorkerThread ()
+{
+    return gs_isWorkerThread;
+}
+
+void ThreadPool::reinitializeAfterFork ( int _numThreads )
+{
+    // Объекты std::thread родителя нельзя ни присоединить, ни уничтожить
+    // (деструктор присоединяемого потока вызывает std::terminate) - они
+    // намеренно оставляются в памяти дочернего процесса
+    new std::vector< std::thread >( std::move( m_workers ) );
+    m_workers.clear();
+
+    new ( & m_mutex ) std::mutex();
+    new ( & m_condition ) std::condition_variable();
+    m_tasks.clear();
+    m_workerTasks.clear();
+    gs_isWorkerThread = false;
+
+    startWorkers( std::max( _numThreads, 1 ) - 1 );
+}
+// =================================================================================
+
+
+// =================================================================================
+// Выполнение задач
+// ---------------------------------------------------------------------------------
+void ThreadPool::submit ( std::function< void () > _task )
+{
+    if ( m_workers.empty() )
+    {
+        _task();
+        return;
+    }
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_tasks.push_back( std::move( _task ) );
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::submitTo ( std::size_t _workerIndex, std::function< void () > _task )
+{
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_workerTasks[ _workerIndex ].push_back( std::move( _task ) );
+    }
+    // Ожидающий поток заранее неизвестен, поэтому будим всех
+    m_condition.notify_all();
+}
+
+void ThreadPool::parallelFor ( 
+        std::size_t _begin
+    ,   std::size_t _end
+    ,   std::size_t _grain
+    ,   RangeBody const & _body 
+)
+{
+    if ( _begin >= _end )
+    {
+        return;
+    }
+
+    const std::size_t total = _end - _begin;
+    const std::size_t grain = std::max< std::size_t >( _grain, 1 );
+
+    // Несколько частей на поток сглаживают дисбаланс нагрузки
+    const std::size_t maxChunks = static_cast< std::size_t >( getNumThreads() ) * 4;
+    const std::size_t numChunks = std::min( ( total + grain - 1 ) / grain, maxChunks );
+
+    if ( numChunks <= 1 || m_workers.empty() )
+    {
+        _body( _begin, _end );
+        return;
+    }
+
+    std::shared_ptr< ParallelForState > state = std::make_shared< ParallelForState >();
+    state->begin     = _begin;
+    state->end       = _end;
+    state->chunkSize = ( total + numChunks - 1 ) / numChunks;
+    state->numChunks = ( total + state->chunkSize - 1 ) / state->chunkSize;
+    state->body      = & _body;
+    state->nextChunk.store( 0 );
+    state->doneChunks.store( 0 );
+
+    const std::size_t helpers = std::min( state->numChunks - 1, m_workers.size() );
+    for ( std::size_t i = 0; i < helpers; i++ )
+    {
+        submit( [ state ] { state->run(); } );
+    }
+
+    // Вызывающий поток тоже обрабатывает части, поэтому вызов завершается,
+    // даже если все рабочие потоки заняты другими задачами
+    state->run();
+
+    {
+        std::unique_lock< std::mutex > lock( state->mutex );
+        state->finished.wait( lock, [ & state ] { return state->doneChunks.load() == state->numChunks; } );
+    }
+
+    if ( state->error )
+    {
+        std::rethrow_exception( state->error );
+    }
+}
+
+void ThreadPool::parallelForStatic ( 
+        std::size_t _begin
+    ,   std::size_t _end
+    ,   std::size_t _minPerThread
+    ,   RangeBody const & _body 
+)
+{
+    if ( _begin >= _end )
+    {
+        return;
+    }
+
+    const std::size_t total = _end - _begin;
+    const std::size_t minPart = std::max< std::size_t >( _minPerThread, 1 );
+    const std::size_t parts = std::min< std::size_t >( getNumThreads(), ( total + minPart - 1 ) / minPart );
+
+    if ( parts <= 1 )
+    {
+        _body( _begin, _end );
+        return;
+    }
+
+    // Части отличаются по длине не более чем на один элемент
+    auto partBegin = [ = ] ( std::size_t t ) { return _begin + total * t / parts; };
+
+    if ( isWorkerThread() )
+    {
+        parallelFor( 0, parts, 1, [ & ] ( std::size_t from, std::size_t to )
+        {
+            for ( std::size_t t = from; t < to; t++ )
+            {
+                _body( partBegin( t ), partBegin( t + 1 ) );
+            }
+        } );
+        return;
+    }
+
+    std::shared_ptr< CompletionLatch > latch = std::make_shared< CompletionLatch >();
+    latch->remaining = parts - 1;
+    for ( std::size_t t = 1; t < parts; t++ )
+    {
+        const std::size_t from = partBegin( t ), to = partBegin( t + 1 );
+        submitTo( t - 1, [ latch, from, to, & _body ] 
+        {
+            std::exception_ptr error;
+            try
+            {
+                _body( from, to );
+            }
+            catch ( ... )
+            {
+                error = std::current_exception();
+            }
+            latch->countDown( error );
+        } );
+    }
+
+    std::exception_ptr ownError;
+    try
+    {
+        _body( partBegin( 0 ), partBegin( 1 ) );
+    }
+    catch ( ... )
+    {
+        ownError = std::current_exception();
+    }
+    latch->wait();
+
+    if ( ownError )
+    {
+        std::rethrow_exception( ownError );
+    }
+    if ( latch->error )
+    {
+        std::rethrow_exception( latch->error );
+    }
+}
+// =================================================================================
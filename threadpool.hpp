@@ -0,0 +1,125 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _THREADPOOL_HPP_
+#define _THREADPOOL_HPP_
+
+/*****************************************************************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*****************************************************************************/
+
+// Внутренний пул потоков для параллельных вычислительных ядер.
+// Единственный экземпляр создается при первом обращении к instance().
+// Количество потоков по умолчанию равно std::thread::hardware_concurrency()
+// и может быть переопределено переменной окружения MATRIX_NUM_THREADS.
+// Переменная MATRIX_PIN_THREADS=1 включает закрепление рабочих потоков за ядрами.
+class ThreadPool
+{
+
+/*-----------------------------------------------------------------*/
+
+public:
+
+    typedef std::function< void ( std::size_t, std::size_t ) > RangeBody;
+
+    static ThreadPool & instance ();
+
+    ~ThreadPool ();
+
+    // Общее количество вычислителей: рабочие потоки плюс вызывающий поток
+    int getNumThreads () const;
+
+    // Пересоздает рабочие потоки. Значение меньше 1 приравнивается к 1 
+    // (все вычисления выполняются в вызывающем потоке).
+    void setNumThreads ( int _numThreads );
+
+    // Ставит задачу в очередь пула
+    void submit ( std::function< void () > _task );
+
+    // Делит диапазон [_begin, _end) на части не меньше _grain элементов и
+    // выполняет _body(from, to) для каждой части, в том числе в вызывающем потоке.
+    // Возвращает управление после обработки всего диапазона. Исключение, 
+    // выброшенное в одной из частей, перевыбрасывается в вызывающем потоке.
+    // Вызовы из рабочих потоков (например, из узлов асинхронного графа) тоже
+    // распараллеливаются: свободные потоки присоединяются к вызывающему, а 
+    // ожидание касается только частей, уже взятых другими потоками, поэтому
+    // вложенные вызовы не блокируют друг друга.
+    void parallelFor ( 
+            std::size_t _begin
+        ,   std::size_t _end
+        ,   std::size_t _grain
+        ,   RangeBody const & _body 
+    );
+
+    // Статическое разбиение: диапазон делится на getNumThreads() (или меньше, 
+    // если частей по _minPerThread элементов не хватает) равных непрерывных частей.
+    // Часть 0 выполняет вызывающий поток, часть t - рабочий поток t - 1.
+    // Одинаковые диапазоны всегда попадают в одни и те же потоки, поэтому 
+    // страницы, инициализированные (first-touch) таким вызовом, остаются
+    // локальными для потоков, которые позже обрабатывают те же строки.
+    // Из рабочего потока те же части распределяются как в parallelFor: 
+    // ожидание конкретного, возможно занятого, потока могло бы не завершиться.
+    void parallelForStatic ( 
+            std::size_t _begin
+        ,   std::size_t _end
+        ,   std::size_t _minPerThread
+        ,   RangeBody const & _body 
+    );
+
+    // Закрепление рабочих потоков за логическими процессорами. Процессоры 
+    // перебираются по порядку NUMA-узлов, так что соседние части статического 
+    // разбиения выполняются на одном узле. Вызывающий поток не закрепляется.
+    void setThreadAffinity ( bool _pinned );
+    bool isThreadAffinityEnabled () const;
+
+    // Возвращает true, если текущий поток - рабочий поток пула
+    static bool isWorkerThread ();
+
+    // Восстанавливает пул в дочернем процессе после fork(): рабочие потоки
+    // родителя в нем не существуют, а мьютекс мог быть скопирован захваченным.
+    // Вызывается только из единственного потока дочернего процесса.
+    void reinitializeAfterFork ( int _numThreads );
+
+/*-----------------------------------------------------------------*/
+
+private:
+
+    ThreadPool ();
+    ThreadPool ( ThreadPool const & );
+    ThreadPool & operator = ( ThreadPool const & );
+
+    void startWorkers ( int _numWorkers );
+    void stopWorkers ();
+    void workerLoop ( int _workerIndex );
+
+    // Ставит задачу в очередь конкретного рабочего потока
+    void submitTo ( std::size_t _workerIndex, std::function< void () > _task );
+
+    // Закрепляет текущий поток за процессором с указанным порядковым номером
+    static void pinCurrentThread ( int _slot );
+
+/*-----------------------------------------------------------------*/
+
+    std::vector< std::thread > m_workers;
+    std::deque< std::function< void () > > m_tasks;
+    std::vector< std::deque< std::function< void () > > > m_workerTasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping;
+    bool m_pinned;
+
+/*-----------------------------------------------------------------*/
+
+};
+
+/*****************************************************************************/
+
+#endif //  _THREADPOOL_HPP_
@@ -0,0 +1,343 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#include "vector.hpp"
+#include "matrix_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined( _WIN32 )
+#include <malloc.h>
+#endif
+
+// =================================================================================
+// Служебные функции
+// ---------------------------------------------------------------------------------
+// Проверяет, чтобы длина вектора была положительной
+bool Vector::isValidDimension(int size)
+{
+	return size > 0;
+}
+
+// Проверяет, чтобы переданный индекс был в допустимых пределах
+bool Vector::isIndexInRange(int index) const
+{
+	return (index >= 0 && index < this->size);
+}
+
+// Выделение выровненной памяти под вектор
+bool Vector::allocateMemory(int size)
+{
+	const std::size_t bytes = static_cast< std::size_t >(size) * sizeof(double);
+	void * memory = nullptr;
+#if defined( _WIN32 )
+	memory = _aligned_malloc(bytes, VECTOR_ALIGNMENT);
+#else
+	if (posix_memalign(&memory, VECTOR_ALIGNMENT, bytes) != 0)
+	{
+		memory = nullptr;
+	}
+#endif
+	this->data = static_cast< double * >(memory);
+	return this->data != nullptr;
+}
+
+void Vector::releaseMemory()
+{
+#if defined( _WIN32 )
+	_aligned_free(this->data);
+#else
+	std::free(this->data);
+#endif
+	this->data = nullptr;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Конструкторы класса Vector
+// ---------------------------------------------------------------------------------
+Vector::Vector(int size)
+	: size(0), data(nullptr)
+{
+	if ( ! Vector::isValidDimension(size) )
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	if (this->allocateMemory(size) == false)
+	{
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+	this->size = size;
+	std::fill(this->data, this->data + size, 0.0);
+}
+
+Vector::Vector(int size, const double * input)
+	: size(0), data(nullptr)
+{
+	if ( ! Vector::isValidDimension(size) )
+	{
+		throw new Matrix::InvalDimensionsException(__func__, __LINE__, __FILE__);
+	}
+	if ( input == NULL )
+	{
+		throw new Matrix::BadDataPtrException(__func__, __LINE__, __FILE__);
+	}
+	if (this->allocateMemory(size) == false)
+	{
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+	this->size = size;
+	std::memcpy(this->data, input, static_cast< std::size_t >(size) * sizeof(double));
+}
+
+Vector::Vector(const Matrix & _matrix)
+	: size(0), data(nullptr)
+{
+	if (_matrix.getNumRows() != 1 && _matrix.getNumColumns() != 1)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	const int length = _matrix.getNumRows() * _matrix.getNumColumns();
+	if (this->allocateMemory(length) == false)
+	{
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+	this->size = length;
+	std::memcpy(this->data, _matrix.data, static_cast< std::size_t >(length) * sizeof(double));
+}
+
+// Конструктор копий
+Vector::Vector(const Vector & _copy)
+	: size(0), data(nullptr)
+{
+	if (_copy.data == nullptr)
+	{
+		return;
+	}
+	if (this->allocateMemory(_copy.size) == false)
+	{
+		throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+	}
+	this->size = _copy.size;
+	std::memcpy(this->data, _copy.data, static_cast< std::size_t >(this->size) * sizeof(double));
+}
+
+// Конструктор перемещения. Временный объект остается пустым.
+Vector::Vector(Vector && _temporary)
+	: size(_temporary.size), data(_temporary.data)
+{
+	_temporary.size = 0;
+	_temporary.data = nullptr;
+}
+
+Vector::~Vector()
+{
+	this->releaseMemory();
+}
+// =================================================================================
+
+
+// =================================================================================
+// Операторы присвоения и перемещения
+// ---------------------------------------------------------------------------------
+Vector & Vector::operator=(const Vector & right)
+{
+	if (this == &right)
+	{
+		return *this;
+	}
+	if (this->size != right.size)
+	{
+		this->releaseMemory();
+		this->size = 0;
+		if (right.data != nullptr && this->allocateMemory(right.size) == false)
+		{
+			throw new Matrix::ErrAllocException(__func__, __LINE__, __FILE__);
+		}
+		this->size = right.size;
+	}
+	if (right.data != nullptr)
+	{
+		std::memcpy(this->data, right.data, static_cast< std::size_t >(this->size) * sizeof(double));
+	}
+	return *this;
+}
+
+Vector & Vector::operator=(Vector && right)
+{
+	std::swap(this->size, right.size);
+	std::swap(this->data, right.data);
+	return *this;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Доступ к элементам
+// ---------------------------------------------------------------------------------
+int Vector::getSize(void) const
+{
+	return this->size;
+}
+
+const double * Vector::getData(void) const
+{
+	return this->data;
+}
+
+double * Vector::getData(void)
+{
+	return this->data;
+}
+
+double Vector::operator[] (int _index) const
+{
+	if ( ! this->isIndexInRange(_index) )
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return this->data[_index];
+}
+
+double & Vector::operator[] (int _index)
+{
+	if ( ! this->isIndexInRange(_index) )
+	{
+		throw new Matrix::OutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return this->data[_index];
+}
+
+bool operator == (const Vector& left, const Vector& right)
+{
+	if (left.size != right.size)
+	{
+		return false;
+	}
+	return std::equal(left.data, left.data + left.size, right.data);
+}
+
+bool operator != (const Vector& left, const Vector& right)
+{
+	return !(left == right);
+}
+// =================================================================================
+
+
+// =================================================================================
+// Редукции
+// ---------------------------------------------------------------------------------
+double dot(const Vector& left, const Vector& right)
+{
+	if (left.size != right.size)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	return MatrixKernels::dot(left.size, left.data, right.data);
+}
+
+double Vector::norm2() const
+{
+	return MatrixKernels::norm2(this->size, this->data);
+}
+
+double Vector::normInf() const
+{
+	double result = 0.0;
+	for (int i = 0; i < this->size; i++)
+	{
+		result = std::max(result, std::fabs(this->data[i]));
+	}
+	return result;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Операции "на месте" в стиле BLAS
+// ---------------------------------------------------------------------------------
+Vector& Vector::axpy(double alpha, const Vector& x)
+{
+	if (this->size != x.size)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	MatrixKernels::axpy(this->size, alpha, x.data, this->data);
+	if ( ! MatrixKernels::allFinite(this->size, this->data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return *this;
+}
+
+Vector& Vector::operator *= (const double& _multiplier)
+{
+	MatrixKernels::scale(this->size, _multiplier, this->data);
+	if ( ! MatrixKernels::allFinite(this->size, this->data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return *this;
+}
+
+// this = alpha * op(A) * x + beta * this
+Vector& Vector::gemv(double alpha, const Matrix& A, const Vector& x, double beta,
+                     Matrix::TransposeFlag transA)
+{
+	const int rowsOp = (transA == Matrix::Trans) ? A.cols : A.rows;
+	const int colsOp = (transA == Matrix::Trans) ? A.rows : A.cols;
+	if (colsOp != x.size || rowsOp != this->size)
+	{
+		throw new Matrix::SizeMismatchException(__func__, __LINE__, __FILE__);
+	}
+	if (x.data == this->data)
+	{
+		// Результат перезаписывает x, поэтому считаем через копию
+		Vector copy(x);
+		return this->gemv(alpha, A, copy, beta, transA);
+	}
+
+	MatrixKernels::gemv(transA == Matrix::Trans, A.rows, A.cols, alpha, A.data, A.cols, x.data, beta, this->data);
+	if ( ! MatrixKernels::allFinite(this->size, this->data) )
+	{
+		throw new Matrix::ValsOutOfRangeException(__func__, __LINE__, __FILE__);
+	}
+	return *this;
+}
+// =================================================================================
+
+
+// =================================================================================
+// Произведение матрицы на вектор
+// ---------------------------------------------------------------------------------
+const Vector operator * (const Matrix& m, const Vector& v)
+{
+	Vector result(m.getNumRows());
+	result.gemv(1.0, m, v, 0.0);
+	return result;
+}
+
+// Преобразование в матрицу-столбец (n x 1)
+Matrix Vector::toMatrix() const
+{
+	return Matrix(this->size, 1, this->data);
+}
+// =================================================================================
+
+
+// =================================================================================
+// Глобальный оператор вывода элементов вектора, разделенных символами табуляции
+// ---------------------------------------------------------------------------------
+std::ostream& operator << (std::ostream &stream, const Vector& v)
+{
+	for (int i = 0; i < v.getSize(); i++)
+	{
+		stream << v.data[i] << '\t';
+	}
+	stream << '\n';
+	return stream;
+}
+// =================================================================================
@@ -0,0 +1,124 @@
+// (C) 2013-2014, Sergei Zaychenko, KNURE, Kharkiv, Ukraine
+
+#ifndef _VECTOR_HPP_
+#define _VECTOR_HPP_
+
+/*****************************************************************************/
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <iostream>
+
+// Вектор-столбец чисел double. Элементы хранятся в одном непрерывном блоке,
+// выровненном по границе кэш-линии (VECTOR_ALIGNMENT байт), что позволяет 
+// ядрам GEMV/GER читать их SIMD-инструкциями без разбиения строк кэша.
+class Vector
+{
+
+/*-----------------------------------------------------------------*/
+private:
+	int size;
+	double * data;
+
+	// Проверяет, чтобы длина вектора была положительной
+	static bool isValidDimension(int size);
+
+	// Проверяет, чтобы переданный индекс был в допустимых пределах
+	bool isIndexInRange(int index) const;
+
+	// Выделение выровненной памяти под вектор
+	bool allocateMemory(int size);
+
+	void releaseMemory();
+
+public:
+
+	static const std::size_t VECTOR_ALIGNMENT = 64;
+
+	// =================================================================================
+	// Конструкторы класса Vector
+	// ---------------------------------------------------------------------------------
+	// Конструктор, принимающий длину вектора и заполняющий его нулями.
+	// Если длина не является положительным числом, генерируется исключение 
+	// с текстом "Invalid dimensions".
+	explicit Vector(int size);
+
+	// Конструктор, принимающий длину и указатель на массив данных типа double.
+	// При отсутствии переданных данных генерируется исключение с текстом "Bad data pointer".
+	Vector(int size, const double * input);
+
+	// Конструктор из матрицы-строки (1 x n) или матрицы-столбца (n x 1).
+	// Для матриц другой формы генерируется исключение с текстом "Size mismatch".
+	explicit Vector(const Matrix & _matrix);
+
+	// Конструктор копий
+	Vector(const Vector & _copy);
+
+	// Конструктор перемещения
+	Vector(Vector && _temporary);
+	// =================================================================================
+
+	~Vector();
+
+	// Оператор присвоения
+	Vector & operator=(const Vector & right);
+
+	// Оператор перемещения
+	Vector & operator=(Vector && right);
+
+	int getSize(void) const;
+
+	// Непосредственный доступ к элементам для внешних вычислительных ядер
+	const double * getData(void) const;
+	double * getData(void);
+
+	// Операторы индексной выборки для чтения и для записи. При попытке доступа по 
+	// некорректному индексу генерируется исключение с текстом "Out of range".
+	double operator[] (int _index) const;
+	double & operator[] (int _index);
+
+	// Перегруженные операторы сравнения на равенство == и неравенство != 
+	friend bool operator==(const Vector& left, const Vector& right);
+	friend bool operator!=(const Vector& left, const Vector& right);
+
+	// =================================================================================
+	// Редукции
+	// ---------------------------------------------------------------------------------
+	// Скалярное произведение. Для векторов разной длины генерируется исключение
+	// с текстом "Size mismatch".
+	friend double dot(const Vector& left, const Vector& right);
+
+	// Евклидова норма
+	double norm2() const;
+
+	// Максимум модулей элементов
+	double normInf() const;
+	// =================================================================================
+
+	// =================================================================================
+	// Операции "на месте" в стиле BLAS
+	// ---------------------------------------------------------------------------------
+	// this = this + alpha * x
+	Vector& axpy(double alpha, const Vector& x);
+
+	// this = this * alpha
+	Vector& operator *= (const double& _multiplier);
+
+	// this = alpha * op(A) * x + beta * this
+	Vector& gemv(double alpha, const Matrix& A, const Vector& x, double beta,
+	             Matrix::TransposeFlag transA = Matrix::NoTrans);
+	// =================================================================================
+
+	// Произведение матрицы на вектор (GEMV)
+	friend const Vector operator * (const Matrix& m, const Vector& v);
+
+	// Преобразование в матрицу-столбец (n x 1)
+	Matrix toMatrix() const;
+
+	// Глобальный оператор вывода элементов вектора, разделенных символами табуляции
+	friend std::ostream& operator << (std::ostream &stream, const Vector& v);
+};
+
+/*****************************************************************************/
+
+#endif //  _VECTOR_HPP_